@@ -0,0 +1,59 @@
+#ifndef AREADEFINITION_H
+#define AREADEFINITION_H
+
+#include <QColor>
+#include <QtMath>
+
+// Logical coordinate range of the drawing area on both axes
+const int LogicalMin = -300;
+const int LogicalMax = 300;
+
+// Symbol types that can be drawn
+enum class SymbolType {
+    Cross,  // X
+    Plus,   // +
+    Star    // *
+};
+
+// Structure for area definition
+struct AreaDefinition {
+    int areaNumber;
+    double centerX;
+    double centerY;
+    double sigmaX;          // Sigma along the area's first axis
+    double sigmaY;          // Sigma along the area's second axis
+    SymbolType symbolType;  // Symbol type for this area
+    QColor color;
+    double outlierThreshold = 0;  // Outlier threshold of this area; 0 uses the global one
+    double rotation = 0;    // Counter-clockwise angle of the first axis from the x axis, in degrees
+    double weight = 1;      // Share of the generated points relative to the other areas
+};
+
+// Covariance matrix [xx xy; xy yy] of an area's Gaussian: the sigmas along
+// the area's axes, rotated by the area's rotation
+struct AreaCovariance {
+    double xx;
+    double xy;
+    double yy;
+
+    // Standard deviations of the x and y coordinates and their correlation
+    double marginalSigmaX() const { return qSqrt(xx); }
+    double marginalSigmaY() const { return qSqrt(yy); }
+    double correlation() const { return xy / qSqrt(xx * yy); }
+};
+
+inline AreaCovariance areaCovariance(const AreaDefinition &area)
+{
+    const double varianceU = area.sigmaX * area.sigmaX;
+    const double varianceV = area.sigmaY * area.sigmaY;
+    if (area.rotation == 0) {
+        return {varianceU, 0.0, varianceV};
+    }
+    const double c = qCos(qDegreesToRadians(area.rotation));
+    const double s = qSin(qDegreesToRadians(area.rotation));
+    return {c * c * varianceU + s * s * varianceV,
+            c * s * (varianceU - varianceV),
+            s * s * varianceU + c * c * varianceV};
+}
+
+#endif // AREADEFINITION_H
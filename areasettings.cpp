@@ -0,0 +1,75 @@
+#include "areasettings.h"
+#include <QSettings>
+
+namespace AreaSettings {
+
+QVector<AreaDefinition> load(const QString &filePath)
+{
+    QSettings settings(filePath, QSettings::IniFormat);
+    QVector<AreaDefinition> areas;
+
+    int size = settings.beginReadArray("AreaDefinitions");
+    for (int i = 0; i < size; i++) {
+        settings.setArrayIndex(i);
+        AreaDefinition area;
+        area.areaNumber = settings.value("AreaNumber").toInt();
+
+        // Support both old (MeanX) and new (CenterX) settings keys
+        if (settings.contains("CenterX")) {
+            area.centerX = settings.value("CenterX").toDouble();
+        } else {
+            area.centerX = settings.value("MeanX").toDouble();
+        }
+
+        if (settings.contains("CenterY")) {
+            area.centerY = settings.value("CenterY").toDouble();
+        } else {
+            area.centerY = settings.value("MeanY").toDouble();
+        }
+
+        area.sigmaX = settings.value("SigmaX").toDouble();
+        area.sigmaY = settings.value("SigmaY").toDouble();
+
+        // Default to Plus if symbolType is not saved
+        if (settings.contains("SymbolType")) {
+            area.symbolType = static_cast<SymbolType>(settings.value("SymbolType").toInt());
+        } else {
+            area.symbolType = SymbolType::Plus;
+        }
+
+        area.color = settings.value("Color").value<QColor>();
+        area.outlierThreshold = settings.value("OutlierThreshold", 0.0).toDouble();
+        area.rotation = settings.value("Rotation", 0.0).toDouble();
+        area.weight = settings.value("Weight", 1.0).toDouble();
+        areas.append(area);
+    }
+    settings.endArray();
+    return areas;
+}
+
+bool save(const QString &filePath, const QVector<AreaDefinition> &areas)
+{
+    QSettings settings(filePath, QSettings::IniFormat);
+
+    settings.beginWriteArray("AreaDefinitions");
+    for (int i = 0; i < areas.size(); i++) {
+        const AreaDefinition &area = areas[i];
+        settings.setArrayIndex(i);
+        settings.setValue("AreaNumber", area.areaNumber);
+        settings.setValue("CenterX", area.centerX);
+        settings.setValue("CenterY", area.centerY);
+        settings.setValue("SigmaX", area.sigmaX);
+        settings.setValue("SigmaY", area.sigmaY);
+        settings.setValue("SymbolType", static_cast<int>(area.symbolType));
+        settings.setValue("Color", area.color);
+        settings.setValue("OutlierThreshold", area.outlierThreshold);
+        settings.setValue("Rotation", area.rotation);
+        settings.setValue("Weight", area.weight);
+    }
+    settings.endArray();
+    settings.sync();
+
+    return settings.status() == QSettings::NoError;
+}
+
+} // namespace AreaSettings
@@ -0,0 +1,21 @@
+#ifndef AREASETTINGS_H
+#define AREASETTINGS_H
+
+#include <QString>
+#include <QVector>
+#include "areadefinition.h"
+
+// Area definitions file (INI format, one "AreaDefinitions" array entry per
+// area). Shared by the GUI and the command line tool.
+namespace AreaSettings {
+
+// Read the definitions; a missing file gives an empty list. Files of older
+// versions (MeanX/MeanY keys, no SymbolType) are accepted.
+QVector<AreaDefinition> load(const QString &filePath);
+
+// Write the definitions; false if the file could not be written
+bool save(const QString &filePath, const QVector<AreaDefinition> &areas);
+
+} // namespace AreaSettings
+
+#endif // AREASETTINGS_H
@@ -0,0 +1,392 @@
+#include "areastatistics.h"
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+#include "parallel.h"
+#include "trace.h"
+
+namespace {
+
+const int HistogramBins = LogicalMax - LogicalMin + 1;
+
+// Points sorted by group at a time by addGroupedStatistics(), so their
+// indices fit 32 bits and the sort takes 16 MB
+const qsizetype GroupingChunk = qsizetype(1) << 22;
+
+const qsizetype MinChunk = 4096;
+
+// Regularized upper incomplete gamma function Q(a, x), used for the
+// chi-square survival function: p = Q(dof / 2, chiSquare / 2)
+double upperIncompleteGamma(double a, double x)
+{
+    if (x <= 0.0) {
+        return 1.0;
+    }
+
+    const double logPrefix = -x + a * std::log(x) - std::lgamma(a);
+    const int maxIterations = 500;
+    const double epsilon = 1e-14;
+
+    if (x < a + 1.0) {
+        // Series expansion of P(a, x)
+        double term = 1.0 / a;
+        double sum = term;
+        for (int n = 1; n < maxIterations; n++) {
+            term *= x / (a + n);
+            sum += term;
+            if (qAbs(term) < qAbs(sum) * epsilon) {
+                break;
+            }
+        }
+        return qBound(0.0, 1.0 - sum * std::exp(logPrefix), 1.0);
+    }
+
+    // Continued fraction for Q(a, x) (modified Lentz)
+    const double tiny = 1e-300;
+    double b = x + 1.0 - a;
+    double c = 1.0 / tiny;
+    double d = 1.0 / b;
+    double h = d;
+    for (int n = 1; n < maxIterations; n++) {
+        const double an = -n * (n - a);
+        b += 2.0;
+        d = an * d + b;
+        if (qAbs(d) < tiny) {
+            d = tiny;
+        }
+        c = b + an / c;
+        if (qAbs(c) < tiny) {
+            c = tiny;
+        }
+        d = 1.0 / d;
+        const double delta = d * c;
+        h *= delta;
+        if (qAbs(delta - 1.0) < epsilon) {
+            break;
+        }
+    }
+    return qBound(0.0, std::exp(logPrefix) * h, 1.0);
+}
+
+// Asymptotic Kolmogorov distribution survival function Q_KS(lambda)
+double kolmogorovSurvival(double lambda)
+{
+    if (lambda < 1e-3) {
+        return 1.0;
+    }
+
+    double sum = 0.0;
+    double sign = 1.0;
+    for (int j = 1; j <= 100; j++) {
+        const double term = sign * std::exp(-2.0 * j * j * lambda * lambda);
+        sum += term;
+        if (qAbs(term) < 1e-12) {
+            break;
+        }
+        sign = -sign;
+    }
+    return qBound(0.0, 2.0 * sum, 1.0);
+}
+
+// Standard normal distribution function
+double normalCdf(double x)
+{
+    return 0.5 * std::erfc(-x * M_SQRT1_2);
+}
+
+// Goodness-of-fit of one axis. The generator rejects points whose other
+// coordinate, rounded, leaves the logical range, so the expected weight of
+// coordinate c is the Gaussian at c times the probability that the other
+// coordinate stays in range given c. That factor is the same for every c of
+// an area that is not rotated; for a rotated one it is what makes the
+// marginal differ from a Gaussian truncated on this axis alone.
+AxisFit evaluateAxis(const QVector<qint64> &histogram, qint64 count, double center, double variance,
+                     double otherCenter, double otherVariance, double covariance)
+{
+    AxisFit fit;
+    if (count == 0 || variance <= 0.0) {
+        return fit;
+    }
+
+    // The other coordinate given this one is a Gaussian with a mean that
+    // moves with it and a fixed sigma
+    const double slope = covariance / variance;
+    const double conditionalSigma = std::sqrt(qMax(0.0, otherVariance - covariance * slope));
+
+    // Expected probability of every integer coordinate under the truncated,
+    // discretized Gaussian the sampler draws from
+    QVector<double> expected(HistogramBins);
+    double total = 0.0;
+    for (int i = 0; i < HistogramBins; i++) {
+        const double d = (LogicalMin + i) - center;
+        const double otherMean = otherCenter + slope * d;
+        double inRange;
+        if (conditionalSigma > 0.0) {
+            inRange = normalCdf((LogicalMax + 0.5 - otherMean) / conditionalSigma)
+                      - normalCdf((LogicalMin - 0.5 - otherMean) / conditionalSigma);
+        } else {
+            inRange = otherMean >= LogicalMin - 0.5 && otherMean < LogicalMax + 0.5 ? 1.0 : 0.0;
+        }
+        expected[i] = std::exp(-(d * d) / (2.0 * variance)) * inRange;
+        total += expected[i];
+    }
+    if (total <= 0.0) {
+        return fit;
+    }
+
+    // Chi-square over bins merged left to right until each expects >= 5 points
+    QVector<double> observedBins;
+    QVector<double> expectedBins;
+    double observedBin = 0.0;
+    double expectedBin = 0.0;
+    for (int i = 0; i < HistogramBins; i++) {
+        observedBin += histogram[i];
+        expectedBin += expected[i] / total * count;
+        if (expectedBin >= 5.0) {
+            observedBins.append(observedBin);
+            expectedBins.append(expectedBin);
+            observedBin = 0.0;
+            expectedBin = 0.0;
+        }
+    }
+    if (observedBins.isEmpty()) {
+        return fit;
+    }
+    // Fold the leftover tail into the last bin
+    observedBins.last() += observedBin;
+    expectedBins.last() += expectedBin;
+
+    for (int i = 0; i < observedBins.size(); i++) {
+        const double diff = observedBins[i] - expectedBins[i];
+        fit.chiSquare += diff * diff / expectedBins[i];
+    }
+    fit.degreesOfFreedom = qMax(1, observedBins.size() - 1);
+    fit.chiSquarePValue = upperIncompleteGamma(fit.degreesOfFreedom / 2.0, fit.chiSquare / 2.0);
+
+    // Kolmogorov-Smirnov distance between the empirical and expected CDFs
+    double observedCdf = 0.0;
+    double expectedCdf = 0.0;
+    for (int i = 0; i < HistogramBins; i++) {
+        observedCdf += static_cast<double>(histogram[i]) / count;
+        expectedCdf += expected[i] / total;
+        fit.ksStatistic = qMax(fit.ksStatistic, qAbs(observedCdf - expectedCdf));
+    }
+    const double root = std::sqrt(static_cast<double>(count));
+    fit.ksPValue = kolmogorovSurvival((root + 0.12 + 0.11 / root) * fit.ksStatistic);
+
+    return fit;
+}
+
+} // namespace
+
+AreaStatistics::AreaStatistics()
+    : count(0)
+    , meanXValue(0.0)
+    , meanYValue(0.0)
+    , m2X(0.0)
+    , m2Y(0.0)
+    , coMoment(0.0)
+{
+}
+
+void AreaStatistics::allocateHistograms()
+{
+    histogramX.fill(0, HistogramBins);
+    histogramY.fill(0, HistogramBins);
+}
+
+void AreaStatistics::merge(const AreaStatistics &other)
+{
+    if (other.count == 0) {
+        return;
+    }
+    if (count == 0) {
+        *this = other;
+        return;
+    }
+
+    const double n = static_cast<double>(count + other.count);
+    const double weight = count * static_cast<double>(other.count) / n;
+    const double dx = other.meanXValue - meanXValue;
+    const double dy = other.meanYValue - meanYValue;
+
+    meanXValue += dx * other.count / n;
+    meanYValue += dy * other.count / n;
+    m2X += other.m2X + dx * dx * weight;
+    m2Y += other.m2Y + dy * dy * weight;
+    coMoment += other.coMoment + dx * dy * weight;
+    count += other.count;
+
+    for (int i = 0; i < HistogramBins; i++) {
+        histogramX[i] += other.histogramX[i];
+        histogramY[i] += other.histogramY[i];
+    }
+}
+
+double AreaStatistics::sigmaX() const
+{
+    return count > 1 ? qSqrt(m2X / (count - 1)) : 0.0;
+}
+
+double AreaStatistics::sigmaY() const
+{
+    return count > 1 ? qSqrt(m2Y / (count - 1)) : 0.0;
+}
+
+double AreaStatistics::covariance() const
+{
+    return count > 1 ? coMoment / (count - 1) : 0.0;
+}
+
+double AreaStatistics::correlation() const
+{
+    const double denominator = qSqrt(m2X * m2Y);
+    return denominator > 0.0 ? coMoment / denominator : 0.0;
+}
+
+AreaFit evaluateFit(const AreaStatistics &stats, const AreaDefinition &area)
+{
+    // The coordinates of a rotated area are Gaussians with the marginal
+    // sigmas before the truncation to the logical range
+    const AreaCovariance covariance = areaCovariance(area);
+    AreaFit fit;
+    fit.x = evaluateAxis(stats.getHistogramX(), stats.getCount(), area.centerX, covariance.xx,
+                         area.centerY, covariance.yy, covariance.xy);
+    fit.y = evaluateAxis(stats.getHistogramY(), stats.getCount(), area.centerY, covariance.yy,
+                         area.centerX, covariance.xx, covariance.xy);
+    return fit;
+}
+
+void addGroupedStatistics(const qint16 *xs, const qint16 *ys, const quint16 *slots, qsizetype count,
+                          const QVector<int> &groupOfSlot, QVector<AreaStatistics> &statistics)
+{
+    TraceSpan span("addGroupedStatistics");
+
+    const int groupCount = statistics.size();
+    if (groupCount == 0 || count <= 0) {
+        return;
+    }
+    const int *groups = groupOfSlot.constData();
+    const int slotCount = groupOfSlot.size();
+    auto groupOf = [=](qsizetype i) {
+        if (slots[i] >= slotCount || xs[i] < LogicalMin || xs[i] > LogicalMax
+            || ys[i] < LogicalMin || ys[i] > LogicalMax) {
+            return -1;
+        }
+        return groups[slots[i]];
+    };
+
+    AreaStatistics *statisticsData = statistics.data();
+    QVector<qsizetype> rangeSlots;
+    QVector<qsizetype> groupBegin(groupCount + 1);
+    QVector<quint32> order;
+
+    for (qsizetype chunkBegin = 0; chunkBegin < count; chunkBegin += GroupingChunk) {
+        const qsizetype chunkEnd = qMin(count, chunkBegin + GroupingChunk);
+
+        // Counting sort of the chunk by group: count per range and group,
+        // turn the counts into each range's first slot in every group, then
+        // let each range fill its slots, keeping the points in order
+        const int ranges = Parallel::rangeCount(chunkEnd - chunkBegin, MinChunk);
+        rangeSlots.fill(0, qsizetype(ranges) * groupCount);
+        qsizetype *slotData = rangeSlots.data();
+        Parallel::forRange(chunkEnd - chunkBegin, MinChunk, [=](int task, qsizetype first, qsizetype last) {
+            qsizetype *taskSlots = slotData + qsizetype(task) * groupCount;
+            for (qsizetype i = chunkBegin + first; i < chunkBegin + last; i++) {
+                const int group = groupOf(i);
+                if (group >= 0) {
+                    taskSlots[group]++;
+                }
+            }
+        });
+
+        qsizetype total = 0;
+        for (int group = 0; group < groupCount; group++) {
+            groupBegin[group] = total;
+            for (int task = 0; task < ranges; task++) {
+                const qsizetype rangeCount = slotData[qsizetype(task) * groupCount + group];
+                slotData[qsizetype(task) * groupCount + group] = total;
+                total += rangeCount;
+            }
+        }
+        groupBegin[groupCount] = total;
+
+        order.resize(total);
+        quint32 *orderData = order.data();
+        Parallel::forRange(chunkEnd - chunkBegin, MinChunk, [=](int task, qsizetype first, qsizetype last) {
+            qsizetype *taskSlots = slotData + qsizetype(task) * groupCount;
+            for (qsizetype i = chunkBegin + first; i < chunkBegin + last; i++) {
+                const int group = groupOf(i);
+                if (group >= 0) {
+                    orderData[taskSlots[group]++] = static_cast<quint32>(i - chunkBegin);
+                }
+            }
+        });
+
+        // Every range of the sorted points adds the groups that lie wholly
+        // inside it straight to their statistics, which no other range
+        // touches, and keeps the groups cut by its ends apart; those are
+        // merged in range order afterwards
+        const qsizetype *begins = groupBegin.constData();
+        const int sortedRanges = Parallel::rangeCount(total, MinChunk);
+        QVector<QVector<QPair<int, AreaStatistics>>> partials(sortedRanges);
+        Parallel::forRange(total, MinChunk, [&, begins, orderData, statisticsData](int task, qsizetype first,
+                                                                                  qsizetype last) {
+            int group = static_cast<int>(std::upper_bound(begins, begins + groupCount + 1, first) - begins) - 1;
+            for (qsizetype runBegin = first; runBegin < last; group++) {
+                const qsizetype runEnd = qMin(last, begins[group + 1]);
+                if (runBegin == runEnd) {
+                    continue;
+                }
+                const bool whole = begins[group] >= first && begins[group + 1] <= last;
+                AreaStatistics partial;
+                AreaStatistics &stats = whole ? statisticsData[group] : partial;
+                for (qsizetype k = runBegin; k < runEnd; k++) {
+                    const qsizetype i = chunkBegin + orderData[k];
+                    stats.add(xs[i], ys[i]);
+                }
+                if (!whole) {
+                    partials[task].append(qMakePair(group, partial));
+                }
+                runBegin = runEnd;
+            }
+        });
+        for (const QVector<QPair<int, AreaStatistics>> &taskPartials : partials) {
+            for (const QPair<int, AreaStatistics> &partial : taskPartials) {
+                statisticsData[partial.first].merge(partial.second);
+            }
+        }
+    }
+}
+
+QHash<int, AreaStatistics> computeAreaStatistics(const PointStore &points,
+                                                 const QVector<AreaDefinition> &areas)
+{
+    TraceSpan span("computeAreaStatistics");
+
+    // Map each area slot of the store to the index of its definition (-1 if none)
+    const QVector<int> &areaNumbers = points.getAreaNumbers();
+    QVector<int> definitionForSlot(areaNumbers.size(), -1);
+    for (int slot = 0; slot < areaNumbers.size(); slot++) {
+        for (int i = 0; i < areas.size(); i++) {
+            if (areas[i].areaNumber == areaNumbers[slot]) {
+                definitionForSlot[slot] = i;
+                break;
+            }
+        }
+    }
+
+    QVector<AreaStatistics> perDefinition(areas.size());
+    points.forEachRun(0, points.size(), [&](qsizetype, qsizetype count, const qint16 *xs, const qint16 *ys,
+                                            const quint16 *areaIndices) {
+        addGroupedStatistics(xs, ys, areaIndices, count, definitionForSlot, perDefinition);
+    });
+
+    QHash<int, AreaStatistics> statistics;
+    for (int areaIndex = 0; areaIndex < areas.size(); areaIndex++) {
+        if (perDefinition[areaIndex].getCount() > 0) {
+            statistics.insert(areas[areaIndex].areaNumber, perDefinition[areaIndex]);
+        }
+    }
+    return statistics;
+}
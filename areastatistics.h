@@ -0,0 +1,101 @@
+#ifndef AREASTATISTICS_H
+#define AREASTATISTICS_H
+
+#include <QHash>
+#include <QVector>
+#include "areadefinition.h"
+#include "pointstore.h"
+
+// Streaming statistics of the points generated for one area.
+// Mean, variance and covariance are kept with Welford's algorithm so they can
+// be updated one point at a time without loss of precision; accumulators from
+// different threads are combined with merge() (Chan et al. parallel update).
+// Per-axis histograms over the logical range feed the goodness-of-fit tests;
+// they are allocated with the first point, so statistics of areas without
+// points take no more than the moments.
+class AreaStatistics
+{
+public:
+    AreaStatistics();
+
+    // Add one point
+    void add(int x, int y)
+    {
+        if (histogramX.isEmpty()) {
+            allocateHistograms();
+        }
+        count++;
+        const double dx = x - meanXValue;
+        const double dy = y - meanYValue;
+        meanXValue += dx / count;
+        meanYValue += dy / count;
+        m2X += dx * (x - meanXValue);
+        m2Y += dy * (y - meanYValue);
+        coMoment += dx * (y - meanYValue);
+        histogramX[x - LogicalMin]++;
+        histogramY[y - LogicalMin]++;
+    }
+
+    // Combine with the statistics of a disjoint set of points
+    void merge(const AreaStatistics &other);
+
+    qint64 getCount() const { return count; }
+    double meanX() const { return meanXValue; }
+    double meanY() const { return meanYValue; }
+    double sigmaX() const;
+    double sigmaY() const;
+    double covariance() const;
+    double correlation() const;
+
+    const QVector<qint64> &getHistogramX() const { return histogramX; }
+    const QVector<qint64> &getHistogramY() const { return histogramY; }
+
+private:
+    void allocateHistograms();
+
+    qint64 count;
+    double meanXValue;
+    double meanYValue;
+    double m2X;       // Sum of squared deviations from the mean in X
+    double m2Y;       // Sum of squared deviations from the mean in Y
+    double coMoment;  // Sum of (x - meanX) * (y - meanY)
+    QVector<qint64> histogramX;
+    QVector<qint64> histogramY;
+};
+
+// Goodness-of-fit of one axis against the distribution the generator samples
+// from: the marginal of the area's Gaussian once points outside the logical
+// range on either axis are removed, evaluated at integer coordinates
+struct AxisFit {
+    double chiSquare = 0.0;
+    int degreesOfFreedom = 0;
+    double chiSquarePValue = 1.0;
+    double ksStatistic = 0.0;   // Kolmogorov-Smirnov distance D
+    double ksPValue = 1.0;
+};
+
+struct AreaFit {
+    AxisFit x;
+    AxisFit y;
+};
+
+// Run the chi-square and Kolmogorov-Smirnov tests for both axes
+AreaFit evaluateFit(const AreaStatistics &stats, const AreaDefinition &area);
+
+// Add points to the statistics of their groups, in parallel: point i lies at
+// xs[i], ys[i] and belongs to group groupOfSlot[slots[i]], an index into
+// statistics, or to none if that is -1 or the point is outside the logical
+// range. The points are sorted by group a few million at a time and every
+// thread adds a contiguous run of them, so memory is a few bytes per point
+// of such a chunk whatever the number of groups, and only the groups a
+// thread shares with its neighbours need partial statistics.
+void addGroupedStatistics(const qint16 *xs, const qint16 *ys, const quint16 *slots, qsizetype count,
+                          const QVector<int> &groupOfSlot, QVector<AreaStatistics> &statistics);
+
+// Statistics of the points of every defined area that has any, keyed by area
+// number; computed in parallel. Points of undefined areas and points outside
+// the logical range are ignored.
+QHash<int, AreaStatistics> computeAreaStatistics(const PointStore &points,
+                                                 const QVector<AreaDefinition> &areas);
+
+#endif // AREASTATISTICS_H
@@ -0,0 +1,215 @@
+#include "areatablemodel.h"
+#include "controller.h"
+
+AreaTableModel::AreaTableModel(Controller *controller, QObject *parent)
+    : QAbstractTableModel(parent)
+    , controller(controller)
+{
+}
+
+int AreaTableModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : controller->getAreaDefinitionsCount();
+}
+
+int AreaTableModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QString AreaTableModel::symbolText(SymbolType symbol)
+{
+    switch (symbol) {
+        case SymbolType::Cross: return tr("Cross (x)");
+        case SymbolType::Plus: return tr("Plus (+)");
+        case SymbolType::Star: return tr("Star (*)");
+    }
+    return QString();
+}
+
+QVariant AreaTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= controller->getAreaDefinitionsCount()) {
+        return QVariant();
+    }
+    const AreaDefinition &area = controller->getAreaDefinitions()[index.row()];
+
+    if (role == Qt::TextAlignmentRole) {
+        return static_cast<int>(Qt::AlignCenter);
+    }
+
+    switch (index.column()) {
+        case AreaNumberColumn:
+        case CenterXColumn:
+        case CenterYColumn:
+        case SigmaXColumn:
+        case SigmaYColumn:
+        case RotationColumn:
+        case WeightColumn:
+            if (role == Qt::DisplayRole || role == Qt::EditRole) {
+                switch (index.column()) {
+                    case AreaNumberColumn: return area.areaNumber;
+                    case CenterXColumn: return area.centerX;
+                    case CenterYColumn: return area.centerY;
+                    case SigmaXColumn: return area.sigmaX;
+                    case SigmaYColumn: return area.sigmaY;
+                    case RotationColumn: return area.rotation;
+                    default: return area.weight;
+                }
+            }
+            if (role == Qt::ToolTipRole && index.column() == RotationColumn) {
+                return tr("Counter-clockwise angle of the Sigma X axis from the x axis, in degrees");
+            }
+            if (role == Qt::ToolTipRole && index.column() == WeightColumn) {
+                return tr("Share of the generated points relative to the weights of the other areas");
+            }
+            break;
+        case SymbolColumn:
+            if (role == Qt::DisplayRole) {
+                return symbolText(area.symbolType);
+            }
+            if (role == Qt::EditRole || role == Qt::UserRole) {
+                return static_cast<int>(area.symbolType);
+            }
+            break;
+        case ColorColumn:
+            if (role == Qt::BackgroundRole || role == Qt::EditRole) {
+                return area.color;
+            }
+            break;
+        case ThresholdColumn:
+            if (role == Qt::DisplayRole) {
+                return area.outlierThreshold > 0 ? QString::number(area.outlierThreshold * 100.0, 'g', 4)
+                                                 : tr("global");
+            }
+            if (role == Qt::EditRole) {
+                return area.outlierThreshold * 100.0;
+            }
+            if (role == Qt::ToolTipRole) {
+                return tr("Outlier threshold of this area in percent of the maximum probability; "
+                          "0 uses the global threshold");
+            }
+            break;
+    }
+    return QVariant();
+}
+
+QVariant AreaTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+
+    switch (section) {
+        case AreaNumberColumn: return tr("Area #");
+        case CenterXColumn: return tr("Center X");
+        case CenterYColumn: return tr("Center Y");
+        case SigmaXColumn: return tr("Sigma X");
+        case SigmaYColumn: return tr("Sigma Y");
+        case RotationColumn: return tr("Rotation");
+        case WeightColumn: return tr("Weight");
+        case SymbolColumn: return tr("Symbol");
+        case ColorColumn: return tr("Color");
+        case ThresholdColumn: return tr("Outlier %");
+    }
+    return QVariant();
+}
+
+Qt::ItemFlags AreaTableModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return Qt::NoItemFlags;
+    }
+    return Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsEditable;
+}
+
+bool AreaTableModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (!index.isValid() || index.row() >= controller->getAreaDefinitionsCount()) {
+        return false;
+    }
+
+    AreaDefinition area = controller->getAreaDefinition(index.row());
+    bool ok = true;
+    switch (index.column()) {
+        case AreaNumberColumn:
+            area.areaNumber = value.toInt(&ok);
+            break;
+        case CenterXColumn:
+            area.centerX = value.toDouble(&ok);
+            break;
+        case CenterYColumn:
+            area.centerY = value.toDouble(&ok);
+            break;
+        case SigmaXColumn:
+            area.sigmaX = value.toDouble(&ok);
+            ok = ok && area.sigmaX > 0;
+            break;
+        case SigmaYColumn:
+            area.sigmaY = value.toDouble(&ok);
+            ok = ok && area.sigmaY > 0;
+            break;
+        case RotationColumn:
+            area.rotation = value.toDouble(&ok);
+            ok = ok && qIsFinite(area.rotation);
+            break;
+        case WeightColumn:
+            area.weight = value.toDouble(&ok);
+            ok = ok && area.weight >= 0 && qIsFinite(area.weight);
+            break;
+        case SymbolColumn:
+            if (role != Qt::EditRole && role != Qt::UserRole) {
+                return false;
+            }
+            area.symbolType = static_cast<SymbolType>(value.toInt(&ok));
+            break;
+        case ColorColumn:
+            if (role != Qt::EditRole && role != Qt::BackgroundRole) {
+                return false;
+            }
+            area.color = value.value<QColor>();
+            ok = area.color.isValid();
+            break;
+        case ThresholdColumn:
+            if (value.toString().trimmed().isEmpty()) {
+                area.outlierThreshold = 0;
+            } else {
+                area.outlierThreshold = value.toDouble(&ok) / 100.0;
+                ok = ok && area.outlierThreshold >= 0 && area.outlierThreshold < 1;
+            }
+            break;
+        default:
+            return false;
+    }
+    if (!ok) {
+        return false;
+    }
+
+    controller->updateAreaDefinition(index.row(), area);
+    emit dataChanged(index, index);
+    return true;
+}
+
+void AreaTableModel::appendArea(const AreaDefinition &area)
+{
+    const int row = controller->getAreaDefinitionsCount();
+    beginInsertRows(QModelIndex(), row, row);
+    controller->addAreaDefinition(area);
+    endInsertRows();
+}
+
+void AreaTableModel::removeArea(int row)
+{
+    if (row < 0 || row >= controller->getAreaDefinitionsCount()) {
+        return;
+    }
+    beginRemoveRows(QModelIndex(), row, row);
+    controller->removeAreaDefinition(row);
+    endRemoveRows();
+}
+
+void AreaTableModel::reload()
+{
+    beginResetModel();
+    endResetModel();
+}
@@ -0,0 +1,59 @@
+#ifndef AREATABLEMODEL_H
+#define AREATABLEMODEL_H
+
+#include <QAbstractTableModel>
+#include "areadefinition.h"
+
+class Controller;
+
+// Table model over the controller's area definitions, one row per area.
+// Cells are read straight from the controller and every change is reported
+// for the rows it touches, so views only repaint what changed and editing a
+// cell costs the same with ten areas or ten thousand.
+class AreaTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        AreaNumberColumn,
+        CenterXColumn,
+        CenterYColumn,
+        SigmaXColumn,
+        SigmaYColumn,
+        RotationColumn,
+        WeightColumn,
+        SymbolColumn,
+        ColorColumn,
+        ThresholdColumn,
+        ColumnCount
+    };
+
+    explicit AreaTableModel(Controller *controller, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+
+    // Numeric cells take numbers, the symbol cell a SymbolType value and
+    // the color cell a QColor (edit or background role). The threshold cell
+    // takes a percentage; an empty cell or 0 uses the global threshold. The
+    // weight cell takes a non-negative number.
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+
+    // Add an area at the end / remove one, through the controller
+    void appendArea(const AreaDefinition &area);
+    void removeArea(int row);
+
+    // The controller replaced all of its area definitions
+    void reload();
+
+    static QString symbolText(SymbolType symbol);
+
+private:
+    Controller *controller;
+};
+
+#endif // AREATABLEMODEL_H
@@ -0,0 +1,364 @@
+// Benchmark suite: times generation per area shape, the outlier test, point
+// file round-trips and offscreen rendering of the drawing area, and writes
+// the results as JSON so runs of different versions can be compared.
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSysInfo>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <algorithm>
+#include <functional>
+#include "canvasrenderer.h"
+#include "drawingarea.h"
+#include "outlierdetector.h"
+#include "parallel.h"
+#include "pointfile.h"
+#include "pointgenerator.h"
+
+namespace {
+
+QTextStream &err()
+{
+    static QTextStream stream(stderr);
+    return stream;
+}
+
+// Times a benchmark: one untimed warm-up run, then `repetitions` timed runs.
+// setup runs before every run and is not timed.
+class BenchmarkRunner
+{
+public:
+    explicit BenchmarkRunner(int repetitions) : repetitions(repetitions) {}
+
+    void run(const QString &name, qint64 items, const std::function<void()> &body,
+             const std::function<void()> &setup = nullptr)
+    {
+        QVector<qint64> samples;
+        for (int r = 0; r <= repetitions; r++) {
+            if (setup) {
+                setup();
+            }
+            QElapsedTimer timer;
+            timer.start();
+            body();
+            const qint64 nanoseconds = timer.nsecsElapsed();
+            if (r > 0) {
+                samples.append(nanoseconds);
+            }
+        }
+        std::sort(samples.begin(), samples.end());
+
+        qint64 sum = 0;
+        for (qint64 sample : samples) {
+            sum += sample;
+        }
+        const qint64 median = samples[samples.size() / 2];
+
+        QJsonObject result;
+        result["name"] = name;
+        result["items"] = items;
+        result["repetitions"] = repetitions;
+        result["minNs"] = samples.first();
+        result["medianNs"] = median;
+        result["meanNs"] = static_cast<double>(sum) / samples.size();
+        result["maxNs"] = samples.last();
+        result["itemsPerSecond"] = items / (qMax<qint64>(1, median) / 1e9);
+        results.append(result);
+
+        err() << QString("%1 %2 items: median %3 ms, %4 Mitems/s\n")
+                 .arg(name, -36).arg(items, 9)
+                 .arg(median / 1e6, 9, 'f', 3)
+                 .arg(items / (qMax<qint64>(1, median) / 1e3), 0, 'f', 2);
+        err().flush();
+    }
+
+    const QJsonArray &getResults() const { return results; }
+
+private:
+    int repetitions;
+    QJsonArray results;
+};
+
+AreaDefinition makeArea(int number, double centerX, double centerY, double sigmaX, double sigmaY,
+                        double rotation = 0)
+{
+    AreaDefinition area;
+    area.areaNumber = number;
+    area.centerX = centerX;
+    area.centerY = centerY;
+    area.sigmaX = sigmaX;
+    area.sigmaY = sigmaY;
+    area.rotation = rotation;
+    area.symbolType = SymbolType::Cross;
+    area.color = Qt::blue;
+    return area;
+}
+
+// Area shapes with different acceptance rates: narrow areas accept almost
+// every candidate, wide and off-center ones reject many at the border.
+// Rotated areas take the correlated (Cholesky) path; "rotated" has the
+// sigmas of "default" so the two paths can be compared.
+struct AreaShape {
+    const char *name;
+    AreaDefinition area;
+};
+
+QVector<AreaShape> areaShapes()
+{
+    return {
+        {"narrow", makeArea(1, 0, 0, 5, 5)},
+        {"default", makeArea(1, 0, 0, 50, 50)},
+        {"wide", makeArea(1, 0, 0, 150, 150)},
+        {"off-center", makeArea(1, 250, -250, 60, 60)},
+        {"rotated", makeArea(1, 0, 0, 50, 50, 30)},
+        {"rotated-elongated", makeArea(1, 0, 0, 120, 20, 30)},
+    };
+}
+
+QVector<AreaDefinition> mixedAreas()
+{
+    return {
+        makeArea(1, -100, 100, 30, 60),
+        makeArea(2, 120, 80, 50, 20),
+        makeArea(3, 0, -150, 80, 40),
+    };
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    // Rendering needs no display
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+    QApplication::setApplicationName("mldemo_bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmarks of the point generation, outlier test, "
+                                     "file formats and rendering; results are written as JSON.");
+    parser.addHelpOption();
+    QCommandLineOption outputOption({"o", "output"}, "JSON results file (default: standard output).", "file");
+    QCommandLineOption pointsOption({"n", "points"}, "Points for the generation, outlier and file benchmarks.",
+                                    "count", "1000000");
+    QCommandLineOption repetitionsOption({"r", "repetitions"}, "Timed runs per benchmark.", "count", "5");
+    QCommandLineOption threadsOption({"t", "threads"}, "Worker threads (0 = all cores).", "count", "0");
+    QCommandLineOption filterOption({"f", "filter"}, "Only run benchmarks whose name contains this text.", "text");
+    parser.addOptions({outputOption, pointsOption, repetitionsOption, threadsOption, filterOption});
+    parser.process(app);
+
+    bool pointsOk, repetitionsOk, threadsOk;
+    const qint64 pointCount = parser.value(pointsOption).toLongLong(&pointsOk);
+    const int repetitions = parser.value(repetitionsOption).toInt(&repetitionsOk);
+    const int threads = parser.value(threadsOption).toInt(&threadsOk);
+    if (!pointsOk || pointCount < 1 || !repetitionsOk || repetitions < 1 || !threadsOk || threads < 0) {
+        err() << "mldemo_bench: invalid numeric option\n";
+        return 1;
+    }
+    Parallel::setThreadCount(threads);
+
+    const QString filter = parser.value(filterOption);
+    auto selected = [&filter](const QString &name) {
+        return filter.isEmpty() || name.contains(filter);
+    };
+
+    BenchmarkRunner runner(repetitions);
+    const quint64 seed = 42;
+
+    // Generation, one area per shape
+    for (const AreaShape &shape : areaShapes()) {
+        const QString name = QString("generate/%1").arg(shape.name);
+        if (!selected(name)) {
+            continue;
+        }
+        const PointGenerator generator({shape.area}, pointCount, seed);
+        PointStore points;
+        runner.run(name, pointCount, [&]() {
+            generator.generate(0, pointCount, points);
+        }, [&]() {
+            points.clear();
+        });
+    }
+
+    // Generation with statistics, as in the GUI
+    const QVector<AreaDefinition> areas = mixedAreas();
+    if (selected("generate/mixed+statistics")) {
+        const PointGenerator generator(areas, pointCount, seed);
+        PointStore points;
+        QVector<AreaStatistics> statistics;
+        runner.run("generate/mixed+statistics", pointCount, [&]() {
+            generator.generate(0, pointCount, points, &statistics);
+        }, [&]() {
+            points.clear();
+            statistics.clear();
+        });
+    }
+    if (selected("generate/sobol+statistics")) {
+        const PointGenerator generator(areas, pointCount, seed, PointGenerator::Sampling::Grouped,
+                                       PointGenerator::Sequence::Sobol);
+        PointStore points;
+        QVector<AreaStatistics> statistics;
+        runner.run("generate/sobol+statistics", pointCount, [&]() {
+            generator.generate(0, pointCount, points, &statistics);
+        }, [&]() {
+            points.clear();
+            statistics.clear();
+        });
+    }
+    if (selected("generate/mixture+statistics")) {
+        const PointGenerator generator(areas, pointCount, seed, PointGenerator::Sampling::Mixture);
+        PointStore points;
+        QVector<AreaStatistics> statistics;
+        runner.run("generate/mixture+statistics", pointCount, [&]() {
+            generator.generate(0, pointCount, points, &statistics);
+        }, [&]() {
+            points.clear();
+            statistics.clear();
+        });
+    }
+
+    // Outlier test: the per-point function on one thread, then the parallel pass
+    PointStore points;
+    PointGenerator(areas, pointCount, seed).generate(0, pointCount, points);
+    if (selected("outliers/isOutside")) {
+        const QVector<int> &areaNumbers = points.getAreaNumbers();
+        QVector<AreaDefinition> areaForSlot(areaNumbers.size(), areas.first());
+        for (int slot = 0; slot < areaNumbers.size(); slot++) {
+            for (const AreaDefinition &area : areas) {
+                if (area.areaNumber == areaNumbers[slot]) {
+                    areaForSlot[slot] = area;
+                }
+            }
+        }
+        qint64 outsideCount = 0;
+        runner.run("outliers/isOutside", pointCount, [&]() {
+            outsideCount = 0;
+            for (qsizetype i = 0; i < points.size(); i++) {
+                const PointDataSave point = {points.x(i), points.y(i), areaNumbers[points.areaIndex(i)]};
+                outsideCount += OutlierDetector::isOutside(point, areaForSlot[points.areaIndex(i)]);
+            }
+        });
+    }
+    if (selected("outliers/markOutside")) {
+        QVector<quint8> flags;
+        runner.run("outliers/markOutside", pointCount, [&]() {
+            OutlierDetector::markOutside(points, areas, &flags);
+        });
+    }
+
+    // Save/load round-trips in every format
+    QTemporaryDir directory;
+    if (!directory.isValid()) {
+        err() << "mldemo_bench: cannot create a temporary directory\n";
+        return 1;
+    }
+    const struct {
+        const char *name;
+        PointFileFormat format;
+        const char *suffix;
+    } formats[] = {
+        {"binary", PointFileFormat::Binary, "bin"},
+        {"compressed", PointFileFormat::Compressed, "mlpz"},
+        {"csv", PointFileFormat::Csv, "csv"},
+    };
+    for (const auto &format : formats) {
+        const QString filePath = directory.filePath(QString("points.%1").arg(format.suffix));
+        const QString saveName = QString("io/%1/save").arg(format.name);
+        const QString loadName = QString("io/%1/load").arg(format.name);
+        if (!selected(saveName) && !selected(loadName)) {
+            continue;
+        }
+
+        QString error;
+        bool ok = true;
+        runner.run(saveName, pointCount, [&]() {
+            ok = ok && PointFile::save(filePath, format.format, points, areas, &error);
+        });
+
+        PointStore loaded;
+        if (ok && selected(loadName)) {
+            runner.run(loadName, pointCount, [&]() {
+                ok = ok && PointFile::load(filePath, loaded, &error);
+            }, [&]() {
+                loaded.clear();
+            });
+        }
+        if (!ok || (selected(loadName) && loaded.size() != points.size())) {
+            err() << QString("mldemo_bench: %1 round-trip failed: %2\n").arg(format.name, error);
+            return 1;
+        }
+        QFile::remove(filePath);
+    }
+
+    // Offscreen rendering of the drawing area at several point counts
+    for (qint64 count : {1000, 10000, 100000}) {
+        const QString name = QString("paint/%1").arg(count);
+        if (!selected(name)) {
+            continue;
+        }
+        DrawingArea drawingArea;
+        drawingArea.resize(800, 800);
+        for (const AreaDefinition &area : areas) {
+            drawingArea.addAreaEllipse(QPointF(area.centerX, area.centerY), CanvasRenderer::EllipseSigmas * area.sigmaX,
+                                       CanvasRenderer::EllipseSigmas * area.sigmaY, area.rotation, area.color);
+        }
+        const PointStore shown = points.mid(0, qMin<qsizetype>(count, points.size()));
+
+        // All points in one frame, drawn again every time
+        drawingArea.setPaintBudget(0);
+        QImage image(drawingArea.size(), QImage::Format_ARGB32_Premultiplied);
+        runner.run(name, count, [&]() {
+            drawingArea.render(&image);
+        }, [&]() {
+            drawingArea.setPoints(&shown, QVector<QColor>(areas.size(), Qt::darkGreen),
+                                  QVector<SymbolType>(areas.size(), SymbolType::Plus));
+        });
+    }
+
+    // First frame of the progressive drawing of all points, which the paint
+    // budget keeps short whatever the point count
+    if (selected("paint/first-frame")) {
+        DrawingArea drawingArea;
+        drawingArea.resize(800, 800);
+        QImage image(drawingArea.size(), QImage::Format_ARGB32_Premultiplied);
+        runner.run("paint/first-frame", points.size(), [&]() {
+            drawingArea.render(&image);
+        }, [&]() {
+            drawingArea.setPoints(&points, QVector<QColor>(areas.size(), Qt::darkGreen),
+                                  QVector<SymbolType>(areas.size(), SymbolType::Plus));
+        });
+    }
+
+    QJsonObject report;
+    report["application"] = "mldemo_bench";
+    report["version"] = MLDEMO_VERSION;
+    report["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    report["qtVersion"] = qVersion();
+    report["cpuArchitecture"] = QSysInfo::currentCpuArchitecture();
+    report["os"] = QSysInfo::prettyProductName();
+    report["threads"] = Parallel::threadCount();
+    report["points"] = pointCount;
+    report["results"] = runner.getResults();
+    const QByteArray json = QJsonDocument(report).toJson();
+
+    const QString outputPath = parser.value(outputOption);
+    if (outputPath.isEmpty()) {
+        QTextStream(stdout) << json;
+        return 0;
+    }
+    QFile file(outputPath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+        err() << QString("mldemo_bench: cannot write %1: %2\n").arg(outputPath, file.errorString());
+        return 1;
+    }
+    return 0;
+}
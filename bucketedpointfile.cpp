@@ -0,0 +1,499 @@
+#include "bucketedpointfile.h"
+#include <QObject>
+#include <QtEndian>
+#include <QtMath>
+#include <algorithm>
+#include <cstring>
+#include "areadefinition.h"
+#include "parallel.h"
+#include "pointfile.h"
+#include "trace.h"
+
+namespace {
+
+const char Magic[8] = {'M', 'L', 'D', 'B', 'U', 'C', 'K', 'T'};
+const quint32 FormatVersion = 1;
+const int FixedHeaderSize = 32;
+
+// Points per window of a streaming pass (24 MB of columns)
+const qint64 WindowPoints = 1 << 22;
+const qsizetype MinChunk = 1 << 16;
+
+void setError(QString *errorMessage, const QString &message)
+{
+    if (errorMessage) {
+        *errorMessage = message;
+    }
+}
+
+// Grid cell of a coordinate; values outside the logical range go to the
+// border cells
+inline int cellOf(int value, int gridSize)
+{
+    const int span = LogicalMax - LogicalMin + 1;
+    return qBound(0, (value - LogicalMin) * gridSize / span, gridSize - 1);
+}
+
+inline int bucketOf(int x, int y, int gridSize)
+{
+    return cellOf(y, gridSize) * gridSize + cellOf(x, gridSize);
+}
+
+// Mapped windows of the three columns of a binary points file
+struct SourceWindow {
+    const uchar *xs = nullptr;
+    const uchar *ys = nullptr;
+    const uchar *areaIndices = nullptr;
+
+    bool map(QFile &file, const PointFile::BinaryLayout &layout, qint64 first, qint64 count)
+    {
+        xs = file.map(layout.xOffset + 2 * first, 2 * count);
+        ys = file.map(layout.yOffset + 2 * first, 2 * count);
+        areaIndices = file.map(layout.areaIndexOffset + 2 * first, 2 * count);
+        return xs && ys && areaIndices;
+    }
+
+    void unmap(QFile &file)
+    {
+        for (const uchar *data : {xs, ys, areaIndices}) {
+            if (data) {
+                file.unmap(const_cast<uchar *>(data));
+            }
+        }
+        xs = ys = areaIndices = nullptr;
+    }
+};
+
+} // namespace
+
+BucketedPointFile::BucketedPointFile()
+    : gridSize(0)
+    , pointCount(0)
+    , columnsOffset(0)
+    , memoryBudget(256LL << 20)
+    , cachedBytes(0)
+    , useCounter(0)
+{
+}
+
+BucketedPointFile::~BucketedPointFile()
+{
+    close();
+}
+
+bool BucketedPointFile::build(const QString &sourcePath, const QString &targetPath,
+                              int gridSize, QString *errorMessage)
+{
+    TraceSpan span("BucketedPointFile::build");
+
+    PointFile::BinaryLayout layout;
+    if (!PointFile::readBinaryLayout(sourcePath, layout, errorMessage)) {
+        return false;
+    }
+
+    QFile source(sourcePath);
+    if (!source.open(QIODevice::ReadOnly)) {
+        setError(errorMessage, source.errorString());
+        return false;
+    }
+
+    const qint64 count = static_cast<qint64>(layout.pointCount);
+    const int bucketCount = gridSize * gridSize;
+    const quint16 areaCount = static_cast<quint16>(layout.areaNumbers.size());
+    QVector<quint64> taskCounts(Parallel::threadCount() * bucketCount);
+    quint64 *taskCountData = taskCounts.data();
+
+    // Pass 1: points per bucket
+    std::atomic<bool> badIndex(false);
+    for (qint64 start = 0; start < count; start += WindowPoints) {
+        const qint64 n = qMin(WindowPoints, count - start);
+        SourceWindow window;
+        if (!window.map(source, layout, start, n)) {
+            window.unmap(source);
+            setError(errorMessage, source.errorString());
+            return false;
+        }
+        Parallel::forRange(n, MinChunk, [&](int task, qsizetype begin, qsizetype end) {
+            quint64 *counts = taskCountData + task * bucketCount;
+            for (qsizetype i = begin; i < end; i++) {
+                const int x = qFromLittleEndian<qint16>(window.xs + 2 * i);
+                const int y = qFromLittleEndian<qint16>(window.ys + 2 * i);
+                if (qFromLittleEndian<quint16>(window.areaIndices + 2 * i) >= areaCount) {
+                    badIndex = true;
+                }
+                counts[bucketOf(x, y, gridSize)]++;
+            }
+        });
+        window.unmap(source);
+    }
+    if (badIndex) {
+        setError(errorMessage, QObject::tr("Points file has an invalid area index"));
+        return false;
+    }
+
+    QVector<quint64> bucketFirst(bucketCount + 1, 0);
+    for (int b = 0; b < bucketCount; b++) {
+        quint64 total = 0;
+        for (int task = 0; task < Parallel::threadCount(); task++) {
+            total += taskCountData[task * bucketCount + b];
+        }
+        bucketFirst[b + 1] = bucketFirst[b] + total;
+    }
+
+    // Header, area numbers and bucket directory
+    const qint64 columnsOffset = FixedHeaderSize + 4 * static_cast<qint64>(areaCount) + 8 * static_cast<qint64>(bucketCount + 1);
+    QByteArray header(columnsOffset, Qt::Uninitialized);
+    uchar *out = reinterpret_cast<uchar *>(header.data());
+    std::memcpy(out, Magic, sizeof(Magic));
+    qToLittleEndian<quint32>(FormatVersion, out + 8);
+    qToLittleEndian<quint32>(static_cast<quint32>(gridSize), out + 12);
+    qToLittleEndian<quint32>(areaCount, out + 16);
+    qToLittleEndian<quint32>(0, out + 20);
+    qToLittleEndian<quint64>(static_cast<quint64>(count), out + 24);
+    out += FixedHeaderSize;
+    for (int areaNumber : layout.areaNumbers) {
+        qToLittleEndian<qint32>(areaNumber, out);
+        out += 4;
+    }
+    qToLittleEndian<quint64>(bucketFirst.constData(), bucketCount + 1, out);
+
+    // Written next to the target and renamed once complete
+    const QString partPath = targetPath + ".part";
+    QFile target(partPath);
+    if (!target.open(QIODevice::ReadWrite | QIODevice::Truncate)
+        || target.write(header) != header.size()
+        || !target.resize(columnsOffset + 6 * count)) {
+        setError(errorMessage, target.errorString());
+        QFile::remove(partPath);
+        return false;
+    }
+
+    uchar *columns = count > 0 ? target.map(columnsOffset, 6 * count) : nullptr;
+    if (count > 0 && !columns) {
+        setError(errorMessage, target.errorString());
+        target.close();
+        QFile::remove(partPath);
+        return false;
+    }
+    uchar *targetXs = columns;
+    uchar *targetYs = columns + 2 * count;
+    uchar *targetAreaIndices = columns + 4 * count;
+
+    // Pass 2: scatter every window into its buckets. Each task counts its
+    // slice again and gets a private range of every bucket, so the writes
+    // need no synchronization and keep the source order within a bucket.
+    QVector<quint64> cursor = bucketFirst;
+    for (qint64 start = 0; start < count; start += WindowPoints) {
+        const qint64 n = qMin(WindowPoints, count - start);
+        SourceWindow window;
+        if (!window.map(source, layout, start, n)) {
+            window.unmap(source);
+            setError(errorMessage, source.errorString());
+            target.unmap(columns);
+            target.close();
+            QFile::remove(partPath);
+            return false;
+        }
+
+        const int tasks = Parallel::rangeCount(n, MinChunk);
+        std::fill(taskCounts.begin(), taskCounts.end(), 0);
+        Parallel::forRange(n, MinChunk, [&](int task, qsizetype begin, qsizetype end) {
+            quint64 *counts = taskCountData + task * bucketCount;
+            for (qsizetype i = begin; i < end; i++) {
+                counts[bucketOf(qFromLittleEndian<qint16>(window.xs + 2 * i),
+                                qFromLittleEndian<qint16>(window.ys + 2 * i), gridSize)]++;
+            }
+        });
+
+        // Turn the per-task counts into per-task write positions
+        for (int b = 0; b < bucketCount; b++) {
+            quint64 position = cursor[b];
+            for (int task = 0; task < tasks; task++) {
+                const quint64 taskCount = taskCountData[task * bucketCount + b];
+                taskCountData[task * bucketCount + b] = position;
+                position += taskCount;
+            }
+            cursor[b] = position;
+        }
+
+        Parallel::forRange(n, MinChunk, [&](int task, qsizetype begin, qsizetype end) {
+            quint64 *positions = taskCountData + task * bucketCount;
+            for (qsizetype i = begin; i < end; i++) {
+                const qint16 x = qFromLittleEndian<qint16>(window.xs + 2 * i);
+                const qint16 y = qFromLittleEndian<qint16>(window.ys + 2 * i);
+                const quint64 position = positions[bucketOf(x, y, gridSize)]++;
+                qToLittleEndian<qint16>(x, targetXs + 2 * position);
+                qToLittleEndian<qint16>(y, targetYs + 2 * position);
+                std::memcpy(targetAreaIndices + 2 * position, window.areaIndices + 2 * i, 2);
+            }
+        });
+        window.unmap(source);
+    }
+
+    if (columns) {
+        target.unmap(columns);
+    }
+    target.close();
+
+    QFile::remove(targetPath);
+    if (!QFile::rename(partPath, targetPath)) {
+        setError(errorMessage, QObject::tr("Could not rename %1").arg(partPath));
+        return false;
+    }
+    return true;
+}
+
+bool BucketedPointFile::isBucketedFile(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const QByteArray magic = file.read(sizeof(Magic));
+    return magic.size() == sizeof(Magic) && std::memcmp(magic.constData(), Magic, sizeof(Magic)) == 0;
+}
+
+bool BucketedPointFile::open(const QString &path, QString *errorMessage)
+{
+    close();
+
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        setError(errorMessage, file.errorString());
+        return false;
+    }
+
+    const QByteArray fixed = file.read(FixedHeaderSize);
+    const uchar *data = reinterpret_cast<const uchar *>(fixed.constData());
+    if (fixed.size() < FixedHeaderSize || std::memcmp(data, Magic, sizeof(Magic)) != 0) {
+        setError(errorMessage, QObject::tr("Not a bucketed points file"));
+        file.close();
+        return false;
+    }
+    const quint32 version = qFromLittleEndian<quint32>(data + 8);
+    const quint32 grid = qFromLittleEndian<quint32>(data + 12);
+    const quint32 areaCount = qFromLittleEndian<quint32>(data + 16);
+    const quint64 count = qFromLittleEndian<quint64>(data + 24);
+    const qint64 bucketCount = static_cast<qint64>(grid) * grid;
+    const qint64 offset = FixedHeaderSize + 4 * static_cast<qint64>(areaCount) + 8 * (bucketCount + 1);
+
+    if (version != FormatVersion || grid == 0 || grid > 4096 || areaCount > 65536
+        || file.size() < offset || count > static_cast<quint64>(file.size() - offset) / 6) {
+        setError(errorMessage, QObject::tr("Bucketed points file is truncated or corrupt"));
+        file.close();
+        return false;
+    }
+
+    const QByteArray table = file.read(4 * static_cast<qint64>(areaCount) + 8 * (bucketCount + 1));
+    const uchar *tableData = reinterpret_cast<const uchar *>(table.constData());
+    for (quint32 i = 0; i < areaCount; i++) {
+        areaNumbers.append(qFromLittleEndian<qint32>(tableData + 4 * i));
+    }
+    bucketFirst.resize(bucketCount + 1);
+    qFromLittleEndian<quint64>(tableData + 4 * areaCount, bucketCount + 1, bucketFirst.data());
+    if (bucketFirst.last() != count) {
+        setError(errorMessage, QObject::tr("Bucketed points file is truncated or corrupt"));
+        close();
+        return false;
+    }
+
+    filePath = path;
+    gridSize = static_cast<int>(grid);
+    pointCount = static_cast<qint64>(count);
+    columnsOffset = offset;
+    return true;
+}
+
+void BucketedPointFile::close()
+{
+    file.close();
+    filePath.clear();
+    gridSize = 0;
+    pointCount = 0;
+    areaNumbers.clear();
+    bucketFirst.clear();
+    columnsOffset = 0;
+    cache.clear();
+    cachedBytes = 0;
+}
+
+void BucketedPointFile::setMemoryBudget(qint64 bytes)
+{
+    memoryBudget = bytes;
+    evictToBudget();
+}
+
+QVector<int> BucketedPointFile::bucketsIn(const QRectF &rect) const
+{
+    QVector<int> buckets;
+    if (gridSize == 0) {
+        return buckets;
+    }
+
+    const int x0 = cellOf(qFloor(rect.left()), gridSize);
+    const int x1 = cellOf(qCeil(rect.right()), gridSize);
+    const int y0 = cellOf(qFloor(rect.top()), gridSize);
+    const int y1 = cellOf(qCeil(rect.bottom()), gridSize);
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            buckets.append(y * gridSize + x);
+        }
+    }
+    return buckets;
+}
+
+PointStore BucketedPointFile::pointsIn(const QRectF &rect, qint64 maxPoints)
+{
+    TraceSpan span("BucketedPointFile::pointsIn");
+
+    PointStore result;
+    result.setAreaNumbers(areaNumbers);
+    if (!isOpen()) {
+        return result;
+    }
+
+    const QVector<int> buckets = bucketsIn(rect);
+    qint64 total = 0;
+    for (int bucket : buckets) {
+        total += static_cast<qint64>(bucketFirst[bucket + 1] - bucketFirst[bucket]);
+    }
+    const int stride = (maxPoints > 0 && total > maxPoints)
+                       ? static_cast<int>((total + maxPoints - 1) / maxPoints) : 1;
+
+    qsizetype count = 0;
+    for (int bucket : buckets) {
+        const CachedBucket &cached = loadBucket(bucket, stride);
+        const PointStore &points = cached.points;
+        result.extend(points.size());
+        for (qsizetype i = 0; i < points.size(); i++) {
+            const int x = points.x(i);
+            const int y = points.y(i);
+            if (x >= rect.left() && x <= rect.right() && y >= rect.top() && y <= rect.bottom()) {
+                result.set(count, x, y, points.areaIndex(i));
+                count++;
+            }
+        }
+        result.resize(count);
+    }
+
+    evictToBudget();
+    return result;
+}
+
+bool BucketedPointFile::scan(const ScanFunction &fn, const std::atomic<bool> *cancel,
+                             QString *errorMessage) const
+{
+    QFile scanFile(filePath);
+    if (!scanFile.open(QIODevice::ReadOnly)) {
+        setError(errorMessage, scanFile.errorString());
+        return false;
+    }
+
+    PointFile::BinaryLayout layout;
+    layout.pointCount = static_cast<quint64>(pointCount);
+    layout.xOffset = columnsOffset;
+    layout.yOffset = columnsOffset + 2 * pointCount;
+    layout.areaIndexOffset = columnsOffset + 4 * pointCount;
+
+    // Windows are converted into host-order buffers that are reused
+    const qint64 bufferSize = qMin(WindowPoints, pointCount);
+    QVector<qint16> xBuffer(bufferSize);
+    QVector<qint16> yBuffer(bufferSize);
+    QVector<quint16> areaBuffer(bufferSize);
+    qint16 *xs = xBuffer.data();
+    qint16 *ys = yBuffer.data();
+    quint16 *areaIndices = areaBuffer.data();
+
+    for (qint64 start = 0; start < pointCount; start += WindowPoints) {
+        if (cancel && *cancel) {
+            setError(errorMessage, QObject::tr("Cancelled"));
+            return false;
+        }
+
+        const qint64 n = qMin(WindowPoints, pointCount - start);
+        SourceWindow window;
+        if (!window.map(scanFile, layout, start, n)) {
+            window.unmap(scanFile);
+            setError(errorMessage, scanFile.errorString());
+            return false;
+        }
+        Parallel::forRange(n, MinChunk, [&](int task, qsizetype begin, qsizetype end) {
+            const qsizetype length = end - begin;
+            qFromLittleEndian<qint16>(window.xs + 2 * begin, length, xs + begin);
+            qFromLittleEndian<qint16>(window.ys + 2 * begin, length, ys + begin);
+            qFromLittleEndian<quint16>(window.areaIndices + 2 * begin, length, areaIndices + begin);
+            fn(task, xs + begin, ys + begin, areaIndices + begin, length);
+        });
+        window.unmap(scanFile);
+    }
+    return true;
+}
+
+const BucketedPointFile::CachedBucket &BucketedPointFile::loadBucket(int bucket, int stride)
+{
+    TraceSpan span("BucketedPointFile::loadBucket");
+
+    auto it = cache.find(bucket);
+    if (it != cache.end()) {
+        if (it->stride == stride) {
+            it->lastUse = ++useCounter;
+            return *it;
+        }
+        cachedBytes -= 6 * static_cast<qint64>(it->points.size());
+        cache.erase(it);
+    }
+
+    const qint64 first = static_cast<qint64>(bucketFirst[bucket]);
+    const qint64 n = static_cast<qint64>(bucketFirst[bucket + 1]) - first;
+    const qint64 sampled = (n + stride - 1) / stride;
+
+    CachedBucket entry;
+    entry.stride = stride;
+    entry.lastUse = ++useCounter;
+    entry.points.setAreaNumbers(areaNumbers);
+
+    PointFile::BinaryLayout layout;
+    layout.xOffset = columnsOffset;
+    layout.yOffset = columnsOffset + 2 * pointCount;
+    layout.areaIndexOffset = columnsOffset + 4 * pointCount;
+
+    // Map only this bucket's ranges and unmap them right after copying
+    SourceWindow window;
+    if (n > 0 && window.map(file, layout, first, n)) {
+        entry.points.resize(sampled);
+        entry.points.forEachWritableRun(0, sampled, [&](qsizetype begin, qsizetype length, qint16 *xs, qint16 *ys,
+                                                        quint16 *areaIndices) {
+            if (stride == 1) {
+                qFromLittleEndian<qint16>(window.xs + 2 * begin, length, xs);
+                qFromLittleEndian<qint16>(window.ys + 2 * begin, length, ys);
+                qFromLittleEndian<quint16>(window.areaIndices + 2 * begin, length, areaIndices);
+            } else {
+                for (qsizetype k = 0; k < length; k++) {
+                    const qint64 i = (begin + k) * stride;
+                    xs[k] = qFromLittleEndian<qint16>(window.xs + 2 * i);
+                    ys[k] = qFromLittleEndian<qint16>(window.ys + 2 * i);
+                    areaIndices[k] = qFromLittleEndian<quint16>(window.areaIndices + 2 * i);
+                }
+            }
+        });
+    }
+    window.unmap(file);
+
+    cachedBytes += 6 * static_cast<qint64>(entry.points.size());
+    return *cache.insert(bucket, entry);
+}
+
+// Drop the least recently used buckets until the cache fits the budget
+void BucketedPointFile::evictToBudget()
+{
+    while (cachedBytes > memoryBudget && !cache.isEmpty()) {
+        auto oldest = cache.begin();
+        for (auto it = cache.begin(); it != cache.end(); ++it) {
+            if (it->lastUse < oldest->lastUse) {
+                oldest = it;
+            }
+        }
+        cachedBytes -= 6 * static_cast<qint64>(oldest->points.size());
+        cache.erase(oldest);
+    }
+}
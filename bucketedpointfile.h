@@ -0,0 +1,105 @@
+#ifndef BUCKETEDPOINTFILE_H
+#define BUCKETEDPOINTFILE_H
+
+#include <QFile>
+#include <QHash>
+#include <QRectF>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <functional>
+#include "pointstore.h"
+
+// Spatially bucketed points file for datasets larger than memory.
+// The logical range is cut into a gridSize x gridSize grid (points outside
+// the range fall into the border buckets) and the points of each bucket are
+// stored contiguously, so the points near a viewport are a few short ranges
+// of the file. Nothing is loaded up front: buckets are mapped on demand,
+// copied (subsampled if needed) into a cache bounded by the memory budget and
+// unmapped again.
+//
+// File format (little-endian):
+//   char[8]  magic "MLDBUCKT"
+//   quint32  format version, quint32 grid size, quint32 area count,
+//   quint32  reserved, quint64 point count
+//   qint32[area count]               area numbers
+//   quint64[grid size^2 + 1]         index of the first point of each bucket
+//   qint16[count] x, qint16[count] y, quint16[count] area index (bucket order)
+class BucketedPointFile
+{
+public:
+    // Default grid: 64 x 64 buckets of about 9 x 9 logical units
+    static const int DefaultGridSize = 64;
+
+    BucketedPointFile();
+    ~BucketedPointFile();
+
+    // Build a bucketed file from a binary points file. Both files are
+    // accessed through windows of the mapping, so the source can be larger
+    // than memory; counting and scattering run on the worker pool.
+    static bool build(const QString &sourcePath, const QString &targetPath,
+                      int gridSize = DefaultGridSize, QString *errorMessage = nullptr);
+
+    // Whether the file at filePath is a bucketed points file
+    static bool isBucketedFile(const QString &filePath);
+
+    bool open(const QString &filePath, QString *errorMessage = nullptr);
+    void close();
+    bool isOpen() const { return file.isOpen(); }
+    QString getFilePath() const { return filePath; }
+
+    qint64 getPointCount() const { return pointCount; }
+    int getGridSize() const { return gridSize; }
+    const QVector<int> &getAreaNumbers() const { return areaNumbers; }
+
+    // Upper bound on the bytes of point data kept in the bucket cache
+    void setMemoryBudget(qint64 bytes);
+    qint64 getMemoryBudget() const { return memoryBudget; }
+    qint64 getCachedBytes() const { return cachedBytes; }
+
+    // Buckets whose cells intersect a rectangle in logical coordinates
+    QVector<int> bucketsIn(const QRectF &rect) const;
+
+    // Points inside rect. If the intersecting buckets hold more than
+    // maxPoints points, every n-th point of each bucket is taken so the
+    // result stays under maxPoints; points within a bucket are in generation
+    // order, so the sample is unbiased.
+    PointStore pointsIn(const QRectF &rect, qint64 maxPoints);
+
+    // Callback for streaming passes: a slice of consecutive points with area
+    // indices into getAreaNumbers(); task is below Parallel::threadCount()
+    using ScanFunction = std::function<void(int task, const qint16 *xs, const qint16 *ys,
+                                            const quint16 *areaIndices, qsizetype count)>;
+
+    // Stream over every point in windows of the file, each window split
+    // across the worker pool. Uses its own file handle, so it can run on
+    // another thread while the viewport is paged in. Returns false if the
+    // file cannot be read or cancel was set.
+    bool scan(const ScanFunction &fn, const std::atomic<bool> *cancel = nullptr,
+              QString *errorMessage = nullptr) const;
+
+private:
+    struct CachedBucket {
+        PointStore points;
+        int stride = 1;
+        quint64 lastUse = 0;
+    };
+
+    QFile file;
+    QString filePath;
+    int gridSize;
+    qint64 pointCount;
+    QVector<int> areaNumbers;
+    QVector<quint64> bucketFirst;
+    qint64 columnsOffset;
+
+    QHash<int, CachedBucket> cache;
+    qint64 memoryBudget;
+    qint64 cachedBytes;
+    quint64 useCounter;
+
+    const CachedBucket &loadBucket(int bucket, int stride);
+    void evictToBudget();
+};
+
+#endif // BUCKETEDPOINTFILE_H
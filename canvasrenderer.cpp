@@ -0,0 +1,128 @@
+#include "canvasrenderer.h"
+#include <QtMath>
+
+CanvasRenderer::CanvasRenderer(const QRectF &viewport, const QSize &size, int symbolSize, double lineScale)
+    : viewport(viewport)
+    , size(size)
+    , symbolSize(symbolSize)
+    , lineScale(lineScale)
+{
+}
+
+int CanvasRenderer::defaultSymbolSize(const QSize &size)
+{
+    return qMax(5, qMin(size.width(), size.height()) / 60);
+}
+
+QPoint CanvasRenderer::toPixel(const QPoint &logicalPos) const
+{
+    // Map from the logical viewport to pixels
+    double xScale = size.width() / viewport.width();
+    double yScale = size.height() / viewport.height();
+
+    int pixelX = static_cast<int>((logicalPos.x() - viewport.left()) * xScale);
+    int pixelY = size.height() - static_cast<int>((logicalPos.y() - viewport.top()) * yScale);  // Flip Y as Qt's Y is top-down
+
+    return QPoint(pixelX, pixelY);
+}
+
+QPointF CanvasRenderer::toLogical(const QPointF &pixelPos) const
+{
+    // Map from pixels to the logical viewport
+    double xScale = size.width() / viewport.width();
+    double yScale = size.height() / viewport.height();
+
+    double logicalX = viewport.left() + pixelPos.x() / xScale;
+    double logicalY = viewport.top() + (size.height() - pixelPos.y()) / yScale;  // Flip Y
+
+    return QPointF(logicalX, logicalY);
+}
+
+int CanvasRenderer::pointMargin() const
+{
+    return symbolSize + qCeil(6 * lineScale);
+}
+
+void CanvasRenderer::drawAxes(QPainter &painter) const
+{
+    // Draw a grid (optional, for visualization purposes)
+    painter.setPen(QPen(QColor(220, 220, 220), lineScale));
+
+    // Draw X and Y axes
+    QPoint origin = toPixel(QPoint(0, 0));
+    painter.setPen(QPen(Qt::black, 2 * lineScale));
+    painter.drawLine(0, origin.y(), size.width(), origin.y());  // X-axis
+    painter.drawLine(origin.x(), 0, origin.x(), size.height()); // Y-axis
+}
+
+void CanvasRenderer::drawAreaEllipse(QPainter &painter, const AreaEllipse &ellipse) const
+{
+    QColor fillColor = ellipse.color;
+    fillColor.setAlpha(40);  // Make the fill semi-transparent
+
+    // The pen keeps its width in pixels whatever the transformation
+    QPen pen(ellipse.color, 2 * lineScale);
+    pen.setCosmetic(true);
+
+    // Draw in logical coordinates, where y grows upwards and positive
+    // angles turn counter-clockwise
+    painter.save();
+    painter.translate(0, size.height());
+    painter.scale(size.width() / viewport.width(), -size.height() / viewport.height());
+    painter.translate(ellipse.center.x() - viewport.left(), ellipse.center.y() - viewport.top());
+    painter.rotate(ellipse.rotation);
+    painter.setPen(pen);
+    painter.setBrush(fillColor);
+    painter.drawEllipse(QPointF(0, 0), ellipse.radiusX, ellipse.radiusY);
+    painter.restore();
+}
+
+void CanvasRenderer::drawPoint(QPainter &painter, const QPoint &pos, const QColor &color, SymbolType type,
+                               bool outside) const
+{
+    // Draw circle around point if needed
+    if (outside) {
+        drawPointCircle(painter, pos, color);
+    }
+
+    // Draw the symbol
+    drawSymbol(painter, pos, color, type);
+}
+
+void CanvasRenderer::drawSymbol(QPainter &painter, const QPoint &pos, const QColor &color, SymbolType type) const
+{
+    painter.setPen(QPen(color, 2 * lineScale));
+
+    int halfSize = symbolSize / 2;
+
+    switch (type) {
+        case SymbolType::Cross:
+            painter.drawLine(pos.x() - halfSize, pos.y() - halfSize,
+                            pos.x() + halfSize, pos.y() + halfSize);
+            painter.drawLine(pos.x() + halfSize, pos.y() - halfSize,
+                            pos.x() - halfSize, pos.y() + halfSize);
+            break;
+
+        case SymbolType::Plus:
+            painter.drawLine(pos.x() - halfSize, pos.y(), pos.x() + halfSize, pos.y());
+            painter.drawLine(pos.x(), pos.y() - halfSize, pos.x(), pos.y() + halfSize);
+            break;
+
+        case SymbolType::Star:
+            painter.drawLine(pos.x() - halfSize, pos.y(), pos.x() + halfSize, pos.y());
+            painter.drawLine(pos.x(), pos.y() - halfSize, pos.x(), pos.y() + halfSize);
+            painter.drawLine(pos.x() - halfSize, pos.y() - halfSize,
+                            pos.x() + halfSize, pos.y() + halfSize);
+            painter.drawLine(pos.x() + halfSize, pos.y() - halfSize,
+                            pos.x() - halfSize, pos.y() + halfSize);
+            break;
+    }
+}
+
+void CanvasRenderer::drawPointCircle(QPainter &painter, const QPoint &pos, const QColor &color) const
+{
+    painter.setPen(QPen(color, lineScale));
+    painter.setBrush(Qt::NoBrush);
+    int circleSize = symbolSize + qRound(4 * lineScale);  // Just a bit larger than the symbol
+    painter.drawEllipse(pos, circleSize, circleSize);
+}
@@ -0,0 +1,77 @@
+#ifndef CANVASRENDERER_H
+#define CANVASRENDERER_H
+
+#include <QPainter>
+#include <QPoint>
+#include <QRectF>
+#include <QSize>
+#include <QVector>
+#include <QColor>
+#include "areadefinition.h"
+#include "pointstore.h"
+
+// Structure to store area ellipse data
+struct AreaEllipse {
+    QPointF center;     // Center in logical coordinates
+    double radiusX;     // Radius along the first axis in logical units
+    double radiusY;     // Radius along the second axis in logical units
+    double rotation;    // Counter-clockwise angle of the first axis, in degrees
+    QColor color;
+};
+
+// Everything the drawing area shows, so it can be drawn again elsewhere,
+// e.g. into a much larger image. The points and flags are implicitly shared
+// with the shown ones, so taking a scene copies no point data.
+struct CanvasScene {
+    QRectF viewport;
+    QSize size;             // Size the scene is shown at
+    int symbolSize = 10;    // Symbol size at that size, in pixels
+    QVector<AreaEllipse> ellipses;
+    PointStore points;
+    QVector<QColor> colors;         // Per area slot of the points
+    QVector<SymbolType> symbols;
+    QVector<quint8> outside;        // One flag per point, or empty
+};
+
+// Drawing of the canvas content (axes, area ellipses and point symbols with
+// their outlier circles) for a viewport mapped onto an image of a given
+// size. The drawing area paints through it, and the image export paints
+// the tiles of a larger image with it; a painter translated to a tile draws
+// the same pixels there as it would into the whole image.
+class CanvasRenderer
+{
+public:
+    // Ellipses cover this many sigmas along each axis of an area
+    static constexpr double EllipseSigmas = 3;
+
+    // lineScale multiplies the pen widths and the circle spacing, for
+    // images larger than the canvas they reproduce
+    CanvasRenderer(const QRectF &viewport, const QSize &size, int symbolSize, double lineScale = 1.0);
+
+    // Symbol size the canvas uses at a size
+    static int defaultSymbolSize(const QSize &size);
+
+    // Conversion between logical coordinates and pixels
+    QPoint toPixel(const QPoint &logicalPos) const;
+    QPointF toLogical(const QPointF &pixelPos) const;
+
+    // Pixels around a point that its symbol or circle may cover
+    int pointMargin() const;
+
+    void drawAxes(QPainter &painter) const;
+    void drawAreaEllipse(QPainter &painter, const AreaEllipse &ellipse) const;
+
+    // Draw a point's symbol at pos, circled if it is outside its area
+    void drawPoint(QPainter &painter, const QPoint &pos, const QColor &color, SymbolType type, bool outside) const;
+
+private:
+    void drawSymbol(QPainter &painter, const QPoint &pos, const QColor &color, SymbolType type) const;
+    void drawPointCircle(QPainter &painter, const QPoint &pos, const QColor &color) const;
+
+    QRectF viewport;
+    QSize size;
+    int symbolSize;
+    double lineScale;
+};
+
+#endif // CANVASRENDERER_H
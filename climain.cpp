@@ -0,0 +1,420 @@
+// Headless front end: generates points for an area definitions file, marks
+// outliers or classifies them and streams the result to a points file, block
+// by block, so the number of points is not limited by memory. The points can
+// also be drawn as a large PNG or TIFF image of the canvas.
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QTextStream>
+#include <cstdio>
+#include "areasettings.h"
+#include "canvasrenderer.h"
+#include "imageexport.h"
+#include "outlierdetector.h"
+#include "parallel.h"
+#include "pointfile.h"
+#include "pointgenerator.h"
+#include "trace.h"
+#include "trainer.h"
+
+namespace {
+
+QTextStream &out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+int fail(const QString &message)
+{
+    QTextStream(stderr) << "mldemo_cli: " << message << "\n";
+    return 1;
+}
+
+double pointsPerSecond(qint64 points, qint64 nanoseconds)
+{
+    return points / (qMax<qint64>(1, nanoseconds) / 1e9);
+}
+
+// Train a classifier on a sample drawn from its own sequence
+std::unique_ptr<NeuralNetwork> trainClassifier(const QVector<AreaDefinition> &areas, qsizetype samples,
+                                               int epochs, quint64 seed)
+{
+    PointGenerator generator(areas, samples, seed);
+    PointStore points;
+    generator.generate(0, samples, points);
+
+    TrainingConfig config;
+    config.epochs = epochs;
+    config.seed = static_cast<quint32>(seed);
+
+    Trainer trainer;
+    trainer.setPoints(points, areas);
+    trainer.setConfig(config);
+    QObject::connect(&trainer, &Trainer::epochFinished, &trainer,
+                     [](int epoch, int totalEpochs, double loss, double accuracy, double epochsPerSecond, int) {
+        out() << QString("  epoch %1/%2: loss %3, accuracy %4%, %5 epochs/s\n")
+                 .arg(epoch).arg(totalEpochs)
+                 .arg(loss, 0, 'f', 4)
+                 .arg(accuracy * 100.0, 0, 'f', 2)
+                 .arg(epochsPerSecond, 0, 'f', 1);
+        out().flush();
+    }, Qt::DirectConnection);
+    trainer.start();
+    trainer.wait();
+
+    const NeuralNetwork *network = trainer.getNetwork();
+    return std::unique_ptr<NeuralNetwork>(network ? new NeuralNetwork(*network) : nullptr);
+}
+
+// Side of the canvas the image enlarges: symbols and lines are drawn as on
+// a canvas of this size, scaled to the image
+const int CanvasSide = 600;
+
+// The points as the canvas draws them: equal points draw the same symbol,
+// so one point per logical position, area and outside flag draws the same
+// image as all of them, in memory that does not grow with the count. The
+// cells of an area are allocated with its first point. The kept points are
+// drawn area by area in the order of the areas, not in the order they were
+// generated, so where symbols of different areas overlap the image can
+// differ from the canvas, which draws the later point on top.
+class CanvasPoints
+{
+public:
+    explicit CanvasPoints(const QVector<AreaDefinition> &areas)
+        : areas(areas)
+        , cells(areas.size())
+    {
+    }
+
+    void add(const PointStore &block, const quint8 *outside)
+    {
+        // Area index of each area slot of the block
+        QVector<int> slotAreas;
+        for (int areaNumber : block.getAreaNumbers()) {
+            int area = 0;
+            while (area < areas.size() && areas[area].areaNumber != areaNumber) {
+                area++;
+            }
+            slotAreas.append(area < areas.size() ? area : -1);
+        }
+        for (qsizetype i = 0; i < block.size(); i++) {
+            const int area = slotAreas[block.areaIndex(i)];
+            if (area < 0) {
+                continue;
+            }
+            QVector<quint8> &areaCells = cells[area];
+            if (areaCells.isEmpty()) {
+                areaCells.fill(0, Side * Side);
+            }
+            areaCells[cell(block.x(i), block.y(i))] |= (outside && outside[i]) ? OutsideBit : InsideBit;
+        }
+    }
+
+    CanvasScene scene() const
+    {
+        CanvasScene scene;
+        scene.viewport = QRectF(LogicalMin, LogicalMin, LogicalMax - LogicalMin, LogicalMax - LogicalMin);
+        scene.size = QSize(CanvasSide, CanvasSide);
+        scene.symbolSize = CanvasRenderer::defaultSymbolSize(scene.size);
+
+        QVector<int> areaNumbers;
+        for (const AreaDefinition &area : areas) {
+            scene.ellipses.append({QPointF(area.centerX, area.centerY), CanvasRenderer::EllipseSigmas * area.sigmaX,
+                                   CanvasRenderer::EllipseSigmas * area.sigmaY, area.rotation, area.color});
+            scene.colors.append(area.color);
+            scene.symbols.append(area.symbolType);
+            areaNumbers.append(area.areaNumber);
+        }
+        scene.points.setAreaNumbers(areaNumbers);
+        for (int area = 0; area < areas.size(); area++) {
+            const QVector<quint8> &areaCells = cells[area];
+            if (areaCells.isEmpty()) {
+                continue;
+            }
+            for (int y = LogicalMin; y <= LogicalMax; y++) {
+                for (int x = LogicalMin; x <= LogicalMax; x++) {
+                    const quint8 bits = areaCells[cell(x, y)];
+                    for (quint8 bit : {InsideBit, OutsideBit}) {
+                        if (bits & bit) {
+                            scene.points.append(x, y, areas[area].areaNumber);
+                            scene.outside.append(bit == OutsideBit);
+                        }
+                    }
+                }
+            }
+        }
+        return scene;
+    }
+
+private:
+    static constexpr int Side = LogicalMax - LogicalMin + 1;
+    static constexpr quint8 InsideBit = 1;
+    static constexpr quint8 OutsideBit = 2;
+
+    static int cell(int x, int y)
+    {
+        return (qBound(LogicalMin, y, LogicalMax) - LogicalMin) * Side + qBound(LogicalMin, x, LogicalMax) - LogicalMin;
+    }
+
+    QVector<AreaDefinition> areas;
+    QVector<QVector<quint8>> cells;   // Per area, empty until it has a point
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("mldemo_cli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Generates points for the areas of an area definitions file, "
+                                     "optionally marks outliers or classifies them, and streams "
+                                     "them to a CSV or binary points file.");
+    parser.addHelpOption();
+    QCommandLineOption areasOption({"a", "areas"}, "Area definitions file (INI).", "file");
+    QCommandLineOption countOption({"n", "count"}, "Number of points to generate.", "count", "10000");
+    QCommandLineOption seedOption({"s", "seed"}, "Random seed; the same seed gives the same points.", "seed", "1");
+    QCommandLineOption threadsOption({"t", "threads"}, "Worker threads (0 = all cores).", "count", "0");
+    QCommandLineOption outputOption({"o", "output"}, "Points file to write.", "file");
+    QCommandLineOption formatOption({"f", "format"}, "Output format: csv or binary "
+                                    "(default: binary for *.bin, csv otherwise).", "format");
+    QCommandLineOption outliersOption("outliers", "Mark points outside their area (CSV column Outside).");
+    QCommandLineOption classifyOption("classify", "Train a classifier and predict the area of every "
+                                      "point (CSV column PredictedArea).");
+    QCommandLineOption trainPointsOption("train-points", "Training sample size for --classify.", "count", "100000");
+    QCommandLineOption epochsOption("epochs", "Training epochs for --classify.", "count", "20");
+    QCommandLineOption mixtureOption("mixture", "Draw the area of every point from the area weights, so the "
+                                     "areas are interleaved, instead of generating them one after the other.");
+    QCommandLineOption sobolOption("sobol", "Take the coordinates from a scrambled Sobol sequence "
+                                   "(quasi-random, evenly spread) instead of a pseudo-random stream.");
+    QCommandLineOption blockOption("block", "Points generated and written per block.", "count", "1048576");
+    QCommandLineOption traceOption("trace", "Record trace spans and write them as trace-event JSON.", "file");
+    QCommandLineOption imageOption("image", "Draw the points as the canvas shows them into a PNG or TIFF "
+                                   "image (by the suffix; TIFF is compressed).", "file");
+    QCommandLineOption imageSizeOption("image-size", "Width and height of the --image in pixels.", "pixels", "4096");
+    parser.addOptions({areasOption, countOption, seedOption, threadsOption, outputOption, formatOption,
+                       outliersOption, classifyOption, trainPointsOption, epochsOption, mixtureOption, sobolOption,
+                       blockOption, traceOption, imageOption, imageSizeOption});
+    parser.process(app);
+
+    if (!parser.isSet(areasOption)) {
+        return fail("--areas is required");
+    }
+    bool countOk, seedOk, threadsOk, trainOk, epochsOk, blockOk, imageSizeOk;
+    const qint64 count = parser.value(countOption).toLongLong(&countOk);
+    const quint64 seed = parser.value(seedOption).toULongLong(&seedOk);
+    const int threads = parser.value(threadsOption).toInt(&threadsOk);
+    const qint64 trainPoints = parser.value(trainPointsOption).toLongLong(&trainOk);
+    const int epochs = parser.value(epochsOption).toInt(&epochsOk);
+    const qint64 blockPoints = parser.value(blockOption).toLongLong(&blockOk);
+    const int imageSide = parser.value(imageSizeOption).toInt(&imageSizeOk);
+    if (!countOk || count < 0 || !seedOk || !threadsOk || threads < 0 || !trainOk || trainPoints < 1
+        || !epochsOk || epochs < 1 || !blockOk || blockPoints < 1
+        || !imageSizeOk || imageSide < 1 || imageSide > ImageExport::MaxSide) {
+        return fail("invalid numeric option");
+    }
+
+    const QString outputPath = parser.value(outputOption);
+    PointFileFormat format = QFileInfo(outputPath).suffix() == "bin" ? PointFileFormat::Binary : PointFileFormat::Csv;
+    if (parser.isSet(formatOption)) {
+        const QString name = parser.value(formatOption).toLower();
+        if (name == "csv") {
+            format = PointFileFormat::Csv;
+        } else if (name == "binary" || name == "bin") {
+            format = PointFileFormat::Binary;
+        } else {
+            return fail(QString("unknown format %1").arg(name));
+        }
+    }
+
+    Parallel::setThreadCount(threads);
+    Trace::setEnabled(parser.isSet(traceOption));
+
+    const QVector<AreaDefinition> areas = AreaSettings::load(parser.value(areasOption));
+    if (areas.isEmpty()) {
+        return fail(QString("no area definitions in %1").arg(parser.value(areasOption)));
+    }
+
+    const bool markOutliers = parser.isSet(outliersOption);
+    const bool classify = parser.isSet(classifyOption);
+    const PointGenerator::Sampling sampling = parser.isSet(mixtureOption) ? PointGenerator::Sampling::Mixture
+                                                                          : PointGenerator::Sampling::Grouped;
+    const PointGenerator::Sequence sequence = parser.isSet(sobolOption) ? PointGenerator::Sequence::Sobol
+                                                                        : PointGenerator::Sequence::Random;
+    out() << QString("%1 points, %2 areas, seed %3, %4 threads%5%6\n")
+             .arg(count).arg(areas.size()).arg(seed).arg(Parallel::threadCount())
+             .arg(sampling == PointGenerator::Sampling::Mixture ? ", mixture" : "")
+             .arg(sequence == PointGenerator::Sequence::Sobol ? ", Sobol" : "");
+
+    QElapsedTimer total;
+    total.start();
+
+    std::unique_ptr<NeuralNetwork> network;
+    qint64 trainNanoseconds = 0;
+    if (classify) {
+        QElapsedTimer timer;
+        timer.start();
+        out() << QString("Training on %1 points\n").arg(trainPoints);
+        network = trainClassifier(areas, trainPoints, epochs, seed ^ 0x5DEECE66DULL);
+        trainNanoseconds = timer.nsecsElapsed();
+        if (!network) {
+            return fail("training failed");
+        }
+    }
+
+    PointFileWriter writer;
+    QString error;
+    int extraColumns = (markOutliers ? PointFileWriter::OutsideColumn : 0)
+                       | (classify ? PointFileWriter::PredictedAreaColumn : 0);
+    if (!outputPath.isEmpty() && !writer.open(outputPath, format, count, areas, extraColumns, &error)) {
+        return fail(error);
+    }
+
+    const QString imagePath = parser.value(imageOption);
+    std::unique_ptr<CanvasPoints> canvasPoints(imagePath.isEmpty() ? nullptr : new CanvasPoints(areas));
+
+    // Per-thread classifier workspaces, reused for every block
+    const int predictRows = 4096;
+    QVector<NeuralNetwork::Workspace> workspaces;
+    if (network) {
+        for (int t = 0; t < Parallel::threadCount(); t++) {
+            workspaces.append(network->createWorkspace(predictRows));
+        }
+    }
+
+    PointGenerator generator(areas, count, seed, sampling, sequence);
+    QVector<AreaStatistics> statistics;
+    QVector<quint8> outside;
+    QVector<int> predictedAreas;
+    qint64 outsideCount = 0;
+    qint64 correctCount = 0;
+    qint64 generateNanoseconds = 0;
+    qint64 outlierNanoseconds = 0;
+    qint64 classifyNanoseconds = 0;
+    qint64 writeNanoseconds = 0;
+    qint64 imageNanoseconds = 0;
+    QElapsedTimer timer;
+
+    // Blocks of the sequence, in order; the timer runs while the generator
+    // works on the next block
+    timer.start();
+    const bool completed = generator.generateBlocks(0, count, blockPoints, [&](const PointStore &block) {
+        generateNanoseconds += timer.nsecsElapsed();
+
+        if (markOutliers) {
+            timer.start();
+            outsideCount += OutlierDetector::markOutside(block, areas, &outside);
+            outlierNanoseconds += timer.nsecsElapsed();
+        }
+
+        if (network) {
+            timer.start();
+            predictedAreas.resize(block.size());
+            int *predicted = predictedAreas.data();
+            NeuralNetwork::Workspace *workspaceData = workspaces.data();
+            QVector<qint64> taskCorrect(Parallel::threadCount(), 0);
+            qint64 *correctData = taskCorrect.data();
+            Parallel::forRange(block.size(), predictRows, [&](int task, qsizetype rangeBegin, qsizetype rangeEnd) {
+                NeuralNetwork::Workspace &ws = workspaceData[task];
+                int classes[predictRows];
+                for (qsizetype start = rangeBegin; start < rangeEnd; start += predictRows) {
+                    const int rows = static_cast<int>(qMin<qsizetype>(predictRows, rangeEnd - start));
+                    for (int r = 0; r < rows; r++) {
+                        ws.inputs[2 * r] = Trainer::normalize(block.x(start + r));
+                        ws.inputs[2 * r + 1] = Trainer::normalize(block.y(start + r));
+                    }
+                    network->predict(rows, ws, classes);
+                    for (int r = 0; r < rows; r++) {
+                        predicted[start + r] = areas[classes[r]].areaNumber;
+                        if (classes[r] == block.areaIndex(start + r)) {
+                            correctData[task]++;
+                        }
+                    }
+                }
+            });
+            for (qint64 correct : taskCorrect) {
+                correctCount += correct;
+            }
+            classifyNanoseconds += timer.nsecsElapsed();
+        }
+
+        if (!outputPath.isEmpty()) {
+            timer.start();
+            if (!writer.write(block, markOutliers ? outside.constData() : nullptr,
+                              network ? predictedAreas.constData() : nullptr, &error)) {
+                return false;
+            }
+            writeNanoseconds += timer.nsecsElapsed();
+        }
+
+        if (canvasPoints) {
+            timer.start();
+            canvasPoints->add(block, markOutliers ? outside.constData() : nullptr);
+            imageNanoseconds += timer.nsecsElapsed();
+        }
+        timer.start();
+        return true;
+    }, &statistics);
+    if (!completed) {
+        return fail(error);
+    }
+
+    if (!outputPath.isEmpty()) {
+        timer.start();
+        if (!writer.close(&error)) {
+            return fail(error);
+        }
+        writeNanoseconds += timer.nsecsElapsed();
+    }
+
+    // The image is drawn in tiles and written band by band
+    qint64 imagePoints = 0;
+    if (canvasPoints) {
+        timer.start();
+        const CanvasScene scene = canvasPoints->scene();
+        imagePoints = scene.points.size();
+        if (!ImageExport::write(imagePath, ImageExport::formatFor(imagePath), scene, QSize(imageSide, imageSide),
+                                nullptr, &error)) {
+            return fail(error);
+        }
+        imageNanoseconds += timer.nsecsElapsed();
+    }
+
+    // Summary
+    for (int i = 0; i < areas.size() && i < statistics.size(); i++) {
+        const AreaStatistics &stats = statistics[i];
+        out() << QString("Area %1: %2 points, mean (%3, %4), sigma (%5, %6)\n")
+                 .arg(areas[i].areaNumber).arg(stats.getCount())
+                 .arg(stats.meanX(), 0, 'f', 2).arg(stats.meanY(), 0, 'f', 2)
+                 .arg(stats.sigmaX(), 0, 'f', 2).arg(stats.sigmaY(), 0, 'f', 2);
+    }
+    out() << QString("Generated %1 points in %2 ms (%3 Mpoints/s)\n")
+             .arg(count).arg(generateNanoseconds / 1000000)
+             .arg(pointsPerSecond(count, generateNanoseconds) / 1e6, 0, 'f', 2);
+    if (markOutliers) {
+        out() << QString("Outliers: %1 of %2 points, tested in %3 ms\n")
+                 .arg(outsideCount).arg(count).arg(outlierNanoseconds / 1000000);
+    }
+    if (network) {
+        out() << QString("Classified %1 points in %2 ms (training %3 ms), accuracy %4%\n")
+                 .arg(count).arg(classifyNanoseconds / 1000000).arg(trainNanoseconds / 1000000)
+                 .arg(count > 0 ? 100.0 * correctCount / count : 0.0, 0, 'f', 2);
+    }
+    if (!outputPath.isEmpty()) {
+        out() << QString("Wrote %1 in %2 ms\n").arg(outputPath).arg(writeNanoseconds / 1000000);
+    }
+    if (canvasPoints) {
+        out() << QString("Drew %1 (%2 x %2 pixels, %3 distinct points) in %4 ms\n")
+                 .arg(imagePath).arg(imageSide).arg(imagePoints).arg(imageNanoseconds / 1000000);
+    }
+    out() << QString("Total %1 ms\n").arg(total.elapsed());
+
+    if (parser.isSet(traceOption) && !Trace::writeChromeJson(parser.value(traceOption), &error)) {
+        return fail(error);
+    }
+    return 0;
+}
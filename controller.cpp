@@ -1,5 +1,6 @@
 #include "controller.h"
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QMessageBox>
 #include <QPixmap>
 #include <QPainter>
@@ -10,35 +11,99 @@
 #include <QDateTime>
 #include <QApplication>
 #include <QCoreApplication>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <algorithm>
+#include "areasettings.h"
+#include "imageexport.h"
+#include "outlierdetector.h"
+#include "perfcounters.h"
+#include "pointgenerator.h"
+#include "pointfile.h"
+#include "pointjournal.h"
+#include "trace.h"
 
 Controller::Controller(QObject *parent)
     : QObject(parent)
     , drawingArea(nullptr)
+    , trainer(nullptr)
+    , persistence(new PersistenceWorker(this))
+    , pointsFileFormat(PointFileFormat::Binary)
+    , samplingMode(PointGenerator::Sampling::Grouped)
+    , sequenceMode(PointGenerator::Sequence::Random)
+    , lastLoadMilliseconds(0)
+    , lastSaveMilliseconds(0)
+    , journalBasePointCount(-1)
+    , journalBaseFingerprint(0)
+    , journalPointCount(0)
+    , datasetScanner(nullptr)
+    , datasetMemoryBudget(256LL << 20)
+    , datasetOutsideCount(0)
+    , outsideFlagsStore(nullptr)
+    , outsideFlagsVersion(0)
+    , outlierThreshold(OutlierDetector::DefaultThreshold)
+    , pointsLoader(nullptr)
+    , comparisonArea(nullptr)
 {
+    startupTimer.start();
+    
     // Set up file paths to be relative to the application directory instead of AppData
     QString appDir = QCoreApplication::applicationDirPath();
     
     settingsFilePath = appDir + "/areaDefinitions.ini";
-    pointsFilePath = appDir + "/points.csv";
+    appDirectory = appDir;
+    
+    // Results of background writes
+    connect(persistence, &PersistenceWorker::pointsSaved, this, &Controller::onPointsSaved);
+    connect(persistence, &PersistenceWorker::saveFailed, this, [this](const QString &filePath, const QString &error) {
+        qWarning() << "Saving" << filePath << "failed:" << error;
+        emit statusMessage(tr("Could not save %1: %2").arg(filePath, error));
+    });
+    connect(persistence, &PersistenceWorker::pointsAppended, this,
+            [this](const QString &journalPath, qint64 pointCount, qint64 milliseconds) {
+        emit statusMessage(tr("Appended %1 points to %2 in %3 ms").arg(pointCount).arg(journalPath).arg(milliseconds));
+    });
     
-    // Load settings and points if they exist
+    // Progress of the background jobs for the status bar
+    jobTimer.setInterval(100);
+    connect(&jobTimer, &QTimer::timeout, this, &Controller::reportJobs);
+    
+    // Load settings if they exist; the points follow in the background once
+    // the window is on screen (see onFirstFrame)
     loadSettings();
-    loadPoints();
 }
 
 Controller::~Controller()
 {
-    // Save settings and points when the application closes
-    saveSettings();
-    savePoints();
+    // Jobs work on their own copies, but finish them before the pools go
+    for (TaskGraph &job : pointsJobs + markJobs + exportJobs + cancelledJobs) {
+        job.cancel();
+        job.wait();
+    }
+    
+    // Stop any training run before the points go away
+    if (trainer) {
+        trainer->requestInterruption();
+        trainer->wait();
+    }
+    cancelPointsLoad();
+    closeLargeDataset();
+    
+    // Every change has already been scheduled; wait for the pending writes
+    persistence->flush();
 }
 
 void Controller::setDrawingArea(DrawingArea *area)
 {
     drawingArea = area;
     
-    // Redraw all area circles
-    redrawAreaCircles();
+    if (drawingArea) {
+        connect(drawingArea, &DrawingArea::viewportChanged, this, &Controller::onViewportChanged);
+    }
+    
+    // Redraw all area ellipses
+    redrawAreaEllipses();
     
     // Draw all saved points
     redrawPoints();
@@ -47,49 +112,32 @@ void Controller::setDrawingArea(DrawingArea *area)
 void Controller::clearCanvas()
 {
     if (drawingArea) {
-        // Only clear the points, not the area circles
+        // Only clear the points, not the area ellipses
         drawingArea->clearPoints();
         
-        // Redraw area circles
-        redrawAreaCircles();
+        // Redraw area ellipses
+        redrawAreaEllipses();
     }
 }
 
-void Controller::redrawAreaCircles()
+void Controller::redrawAreaEllipses()
 {
     if (!drawingArea) {
         return;
     }
     
-    drawingArea->clearAreaCircles();
+    drawingArea->clearAreaEllipses();
     
     for (const AreaDefinition &areaDef : areaDefinitions) {
-        int radius = qMax(static_cast<int>(areaDef.sigmaX * 3), 
-                         static_cast<int>(areaDef.sigmaY * 3));
-        drawingArea->addAreaCircle(areaDef.centerX, areaDef.centerY, radius, areaDef.color);
-    }
-}
-
-void Controller::addPoint(int x, int y, const QColor &color, SymbolType symbol)
-{
-    if (drawingArea) {
-        drawingArea->addPoint(x, y, color, symbol);
-    }
-}
-
-void Controller::addPointWithCircle(int x, int y, const QColor &pointColor, 
-                                  SymbolType symbol, const QColor &circleColor)
-{
-    if (drawingArea) {
-        drawingArea->addPointWithCircle(x, y, pointColor, symbol, circleColor);
+        drawingArea->addAreaEllipse(QPointF(areaDef.centerX, areaDef.centerY), areaEllipseRadius(areaDef.sigmaX),
+                                    areaEllipseRadius(areaDef.sigmaY), areaDef.rotation, areaDef.color);
     }
 }
 
-void Controller::addAreaCircle(int x, int y, int radius, const QColor &color)
+// Ellipses cover three sigmas along each axis of the area
+double Controller::areaEllipseRadius(double sigma)
 {
-    if (drawingArea) {
-        drawingArea->addAreaCircle(x, y, radius, color);
-    }
+    return CanvasRenderer::EllipseSigmas * sigma;
 }
 
 void Controller::addAreaDefinition(const AreaDefinition &area)
@@ -97,11 +145,11 @@ void Controller::addAreaDefinition(const AreaDefinition &area)
     areaDefinitions.append(area);
     
     if (drawingArea) {
-        int radius = qMax(static_cast<int>(area.sigmaX * 3), 
-                         static_cast<int>(area.sigmaY * 3));
-        drawingArea->addAreaCircle(area.centerX, area.centerY, radius, area.color);
+        drawingArea->addAreaEllipse(QPointF(area.centerX, area.centerY), areaEllipseRadius(area.sigmaX),
+                                    areaEllipseRadius(area.sigmaY), area.rotation, area.color);
     }
     
+    updateOutsideMarks();
     saveSettings();
 }
 
@@ -110,9 +158,13 @@ void Controller::updateAreaDefinition(int row, const AreaDefinition &area)
     if (row >= 0 && row < areaDefinitions.size()) {
         areaDefinitions[row] = area;
         
-        // Redraw area circles
-        redrawAreaCircles();
+        // Only this area's ellipse changes
+        if (drawingArea) {
+            drawingArea->setAreaEllipse(row, QPointF(area.centerX, area.centerY), areaEllipseRadius(area.sigmaX),
+                                        areaEllipseRadius(area.sigmaY), area.rotation, area.color);
+        }
         
+        updateOutsideMarks();
         saveSettings();
     }
 }
@@ -122,9 +174,11 @@ void Controller::removeAreaDefinition(int row)
     if (row >= 0 && row < areaDefinitions.size()) {
         areaDefinitions.removeAt(row);
         
-        // Redraw area circles
-        redrawAreaCircles();
+        if (drawingArea) {
+            drawingArea->removeAreaEllipse(row);
+        }
         
+        updateOutsideMarks();
         saveSettings();
     }
 }
@@ -152,179 +206,564 @@ AreaDefinition Controller::getAreaDefinition(int row) const
     return defaultArea;
 }
 
+const QVector<AreaDefinition> &Controller::getAreaDefinitions() const
+{
+    return areaDefinitions;
+}
+
 void Controller::saveSettings()
 {
-    QSettings settings(settingsFilePath, QSettings::IniFormat);
+    persistence->saveSettings(settingsFilePath, areaDefinitions);
+}
+
+void Controller::loadSettings()
+{
+    areaDefinitions = AreaSettings::load(settingsFilePath);
+}
+
+QString Controller::pointsFilePathFor(PointFileFormat format) const
+{
+    switch (format) {
+        case PointFileFormat::Compressed:
+            return appDirectory + "/points.mlpz";
+        case PointFileFormat::Csv:
+            return appDirectory + "/points.csv";
+        case PointFileFormat::Binary:
+            break;
+    }
+    return appDirectory + "/points.bin";
+}
+
+QString Controller::journalFilePath() const
+{
+    return appDirectory + "/points.journal";
+}
+
+void Controller::setPointsFileFormat(PointFileFormat format)
+{
+    if (format == pointsFileFormat) {
+        return;
+    }
+    pointsFileFormat = format;
     
-    settings.beginWriteArray("AreaDefinitions");
-    for (int i = 0; i < areaDefinitions.size(); i++) {
-        settings.setArrayIndex(i);
-        settings.setValue("AreaNumber", areaDefinitions[i].areaNumber);
-        settings.setValue("CenterX", areaDefinitions[i].centerX);
-        settings.setValue("CenterY", areaDefinitions[i].centerY);
-        settings.setValue("SigmaX", areaDefinitions[i].sigmaX);
-        settings.setValue("SigmaY", areaDefinitions[i].sigmaY);
-        settings.setValue("SymbolType", static_cast<int>(areaDefinitions[i].symbolType));
-        settings.setValue("Color", areaDefinitions[i].color);
+    // Rewrite the current points in the new format
+    if (!generatedPoints.isEmpty()) {
+        savePoints();
     }
-    settings.endArray();
 }
 
-void Controller::loadSettings()
+PointFileFormat Controller::getPointsFileFormat() const
+{
+    return pointsFileFormat;
+}
+
+void Controller::setSampling(PointGenerator::Sampling sampling)
 {
-    QSettings settings(settingsFilePath, QSettings::IniFormat);
+    samplingMode = sampling;
+}
+
+PointGenerator::Sampling Controller::getSampling() const
+{
+    return samplingMode;
+}
+
+void Controller::setSequence(PointGenerator::Sequence sequence)
+{
+    sequenceMode = sequence;
+}
+
+PointGenerator::Sequence Controller::getSequence() const
+{
+    return sequenceMode;
+}
+
+bool Controller::writePointsFile(const QString &filePath, PointFileFormat format, QString *errorMessage)
+{
+    TraceSpan span("Controller::writePointsFile");
     
-    areaDefinitions.clear();
+    QElapsedTimer timer;
+    timer.start();
     
-    int size = settings.beginReadArray("AreaDefinitions");
-    for (int i = 0; i < size; i++) {
-        settings.setArrayIndex(i);
-        AreaDefinition area;
-        area.areaNumber = settings.value("AreaNumber").toInt();
-        
-        // Support both old (MeanX) and new (CenterX) settings keys
-        if (settings.contains("CenterX")) {
-            area.centerX = settings.value("CenterX").toDouble();
-        } else {
-            area.centerX = settings.value("MeanX").toDouble();
+    bool ok;
+    if (format == PointFileFormat::Compressed) {
+        CompressionStats stats;
+        ok = PointFile::saveCompressed(filePath, generatedPoints, areaDefinitions, errorMessage, &stats);
+        if (ok) {
+            reportCompression(generatedPoints.size(), stats);
         }
-        
-        if (settings.contains("CenterY")) {
-            area.centerY = settings.value("CenterY").toDouble();
-        } else {
-            area.centerY = settings.value("MeanY").toDouble();
-        }
-        
-        area.sigmaX = settings.value("SigmaX").toDouble();
-        area.sigmaY = settings.value("SigmaY").toDouble();
-        
-        // Default to Plus if symbolType is not saved
-        if (settings.contains("SymbolType")) {
-            area.symbolType = static_cast<SymbolType>(settings.value("SymbolType").toInt());
-        } else {
-            area.symbolType = SymbolType::Plus;
+    } else {
+        ok = PointFile::save(filePath, format, generatedPoints, areaDefinitions, errorMessage);
+    }
+    
+    if (ok) {
+        lastSaveMilliseconds = timer.elapsed();
+        PerfCounters::recordSave(lastSaveMilliseconds);
+    }
+    return ok;
+}
+
+bool Controller::readPointsFile(const QString &filePath, QString *errorMessage, CsvParseReport *report)
+{
+    TraceSpan span("Controller::readPointsFile");
+    
+    QElapsedTimer timer;
+    timer.start();
+    
+    bool ok;
+    PointFileFormat format = PointFile::detectFormat(filePath);
+    if (format == PointFileFormat::Compressed) {
+        CompressionStats stats;
+        ok = PointFile::loadCompressed(filePath, generatedPoints, nullptr, errorMessage, &stats);
+        if (ok) {
+            emit statusMessage(tr("Decompressed %1 points (%2:1) at %3 Mpoints/s")
+                               .arg(generatedPoints.size())
+                               .arg(static_cast<double>(stats.rawBytes) / qMax<qint64>(1, stats.compressedBytes), 0, 'f', 2)
+                               .arg(generatedPoints.size() / 1000.0 / qMax<qint64>(1, stats.milliseconds), 0, 'f', 2));
         }
-        
-        area.color = settings.value("Color").value<QColor>();
-        areaDefinitions.append(area);
+    } else if (format == PointFileFormat::Csv) {
+        ok = PointFile::loadCsv(filePath, generatedPoints, errorMessage, report);
+    } else {
+        ok = PointFile::loadBinary(filePath, generatedPoints, nullptr, errorMessage);
+    }
+    
+    if (ok) {
+        lastLoadMilliseconds = timer.elapsed();
+        PerfCounters::recordLoad(lastLoadMilliseconds);
     }
-    settings.endArray();
+    return ok;
+}
+
+void Controller::reportCompression(qint64 pointCount, const CompressionStats &stats)
+{
+    emit statusMessage(tr("Compressed %1 points: %2 KB -> %3 KB (%4:1), encoded at %5 Mpoints/s")
+                       .arg(pointCount)
+                       .arg(stats.rawBytes / 1024)
+                       .arg(stats.compressedBytes / 1024)
+                       .arg(static_cast<double>(stats.rawBytes) / qMax<qint64>(1, stats.compressedBytes), 0, 'f', 2)
+                       .arg(pointCount / 1000.0 / qMax<qint64>(1, stats.milliseconds), 0, 'f', 2));
+}
+
+void Controller::onPointsSaved(const QString &filePath, qint64 pointCount, qint64 milliseconds,
+                               const CompressionStats &stats)
+{
+    lastSaveMilliseconds = milliseconds;
+    
+    if (stats.compressedBytes > 0) {
+        reportCompression(pointCount, stats);
+    } else {
+        emit statusMessage(tr("Saved %1 points to %2 in %3 ms").arg(pointCount).arg(filePath).arg(milliseconds));
+    }
+}
+
+void Controller::reportMalformedLines(const CsvParseReport &report)
+{
+    if (report.malformedCount == 0) {
+        return;
+    }
+    
+    // Name the first malformed line so the file can be fixed
+    const CsvMalformedLine &first = report.malformedLines.first();
+    qWarning() << "Skipped" << report.malformedCount << "malformed lines, the first at line" << first.lineNumber;
+    emit statusMessage(tr("Skipped %1 malformed lines out of %2; line %3: %4")
+                       .arg(report.malformedCount)
+                       .arg(report.lineCount)
+                       .arg(first.lineNumber)
+                       .arg(QString::fromUtf8(first.text.left(80))));
 }
 
 void Controller::savePoints()
 {
-    QFile file(pointsFilePath);
-    if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QTextStream out(&file);
-        
-        // Write header
-        out << "x;y;AreaNumber\n";
-        
-        // Write points
-        for (const PointDataSave &point : generatedPoints) {
-            out << QString::number(point.x) << ";" 
-                << QString::number(point.y) << ";" 
-                << QString::number(point.areaNumber) << "\n";
+    TraceSpan span("Controller::savePoints");
+    
+    waitForPointsLoad();
+    
+    // Only one points file is kept next to the executable; a full save also
+    // folds the journal into it
+    QStringList obsoleteFiles;
+    for (PointFileFormat format : {PointFileFormat::Binary, PointFileFormat::Compressed, PointFileFormat::Csv}) {
+        if (format != pointsFileFormat) {
+            obsoleteFiles << pointsFilePathFor(format);
         }
-        
-        file.close();
     }
+    obsoleteFiles << journalFilePath();
+    journalBasePointCount = -1;
+    journalPointCount = 0;
+    
+    persistence->savePoints(pointsFilePathFor(pointsFileFormat), pointsFileFormat,
+                            generatedPoints, areaDefinitions, obsoleteFiles);
 }
 
 void Controller::loadPoints()
 {
+    TraceSpan span("Controller::loadPoints");
+    
+    // Read back what was last saved, not an older file
+    persistence->flush();
+    
+    cancelJobs(&pointsJobs);
+    cancelPointsLoad();
+    closeLargeDataset();
     generatedPoints.clear();
     
-    QFile file(pointsFilePath);
-    if (file.exists() && file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QTextStream in(&file);
-        
-        // Skip header line
-        if (!in.atEnd()) {
-            in.readLine();
+    PointFileFormat loadedFormat = pointsFileFormat;
+    QString filePath = findPointsFile(&loadedFormat);
+    CsvParseReport report;
+    if (!filePath.isEmpty()) {
+        QString error;
+        if (!readPointsFile(filePath, &error, &report)) {
+            qWarning() << "Loading points failed:" << error;
+            loadedFormat = pointsFileFormat;
         }
-        
-        // Read points
-        while (!in.atEnd()) {
-            QString line = in.readLine();
-            QStringList parts = line.split(';');
-            
-            if (parts.size() >= 3) {
-                PointDataSave point;
-                point.x = parts[0].toInt();
-                point.y = parts[1].toInt();
-                point.areaNumber = parts[2].toInt();
-                generatedPoints.append(point);
-            }
+    }
+    finishLoadingPoints(loadedFormat);
+    
+    // Draw the loaded points if we have a drawing area
+    redrawPoints();
+    updateStatistics();
+    recordVersion(tr("Load Points"));
+    reportMalformedLines(report);
+}
+
+void Controller::loadPointsInBackground()
+{
+    persistence->flush();
+    
+    cancelJobs(&pointsJobs);
+    cancelPointsLoad();
+    closeLargeDataset();
+    generatedPoints.clear();
+    if (drawingArea) {
+        drawingArea->clearPoints();
+    }
+    
+    PointFileFormat format = pointsFileFormat;
+    QString filePath = findPointsFile(&format);
+    if (filePath.isEmpty()) {
+        finishLoadingPoints(pointsFileFormat);
+        redrawPoints();
+        updateStatistics();
+        return;
+    }
+    
+    pointsLoader = new PointsLoader(this);
+    pointsLoader->setSource(filePath);
+    connect(pointsLoader, &PointsLoader::chunkLoaded, this, &Controller::onPointsChunkLoaded);
+    connect(pointsLoader, &QThread::finished, this, &Controller::onPointsLoadFinished);
+    pointsLoader->start();
+    
+    emit statusMessage(tr("Loading %1...").arg(filePath));
+}
+
+// File to load the points from: the one of the selected format, then any
+// other one (a points.csv may have been written by older versions)
+QString Controller::findPointsFile(PointFileFormat *format) const
+{
+    QList<PointFileFormat> formats = {pointsFileFormat, PointFileFormat::Binary,
+                                      PointFileFormat::Compressed, PointFileFormat::Csv};
+    for (PointFileFormat candidate : formats) {
+        QString filePath = pointsFilePathFor(candidate);
+        if (QFile::exists(filePath)) {
+            *format = candidate;
+            return filePath;
         }
+    }
+    return QString();
+}
+
+// Common end of a synchronous and a background load
+void Controller::finishLoadingPoints(PointFileFormat loadedFormat)
+{
+    // Points appended since the last full save
+    replayJournal();
+    
+    // Convert files of another format (e.g. a points.csv written by older
+    // versions) to the selected one
+    if (!generatedPoints.isEmpty() && loadedFormat != pointsFileFormat) {
+        savePoints();
+    }
+}
+
+void Controller::cancelPointsLoad()
+{
+    if (pointsLoader) {
+        pointsLoader->cancel();
+        pointsLoader->wait();
         
-        file.close();
+        // Deleted after the chunks it already queued, which are then ignored
+        pointsLoader->deleteLater();
+        pointsLoader = nullptr;
+    }
+}
+
+// Let a background load finish before the points are modified or saved
+void Controller::waitForPointsLoad()
+{
+    if (pointsLoader) {
+        pointsLoader->wait();
         
-        // Draw the loaded points if we have a drawing area
-        redrawPoints();
+        // Deliver the chunks and the finished notification still queued
+        QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
     }
 }
 
-void Controller::redrawPoints()
+void Controller::onPointsChunkLoaded(const PointStore &chunk)
+{
+    TraceSpan span("Controller::onPointsChunkLoaded");
+    
+    // Ignore chunks of cancelled loads
+    PointsLoader *loader = qobject_cast<PointsLoader *>(sender());
+    if (!loader || loader != pointsLoader) {
+        return;
+    }
+    
+    if (generatedPoints.isEmpty()) {
+        qInfo() << "First points drawn after" << startupTimer.elapsed() << "ms";
+    }
+    
+    generatedPoints.append(chunk);
+    showPoints(generatedPoints);
+    emit statusMessage(tr("Loading points: %1 so far").arg(generatedPoints.size()));
+}
+
+void Controller::onPointsLoadFinished()
+{
+    TraceSpan span("Controller::onPointsLoadFinished");
+    
+    PointsLoader *loader = qobject_cast<PointsLoader *>(sender());
+    if (!loader || loader != pointsLoader) {
+        return;
+    }
+    pointsLoader = nullptr;
+    loader->deleteLater();
+    
+    PointFileFormat loadedFormat = pointsFileFormat;
+    if (loader->succeeded()) {
+        loadedFormat = loader->getFormat();
+        lastLoadMilliseconds = loader->getMilliseconds();
+    } else {
+        // Like a synchronous load, a file that fails part way loads nothing
+        qWarning() << "Loading points failed:" << loader->getErrorMessage();
+        generatedPoints.clear();
+        if (drawingArea) {
+            drawingArea->clearPoints();
+        }
+    }
+    
+    finishLoadingPoints(loadedFormat);
+    showPoints(generatedPoints);
+    updateStatistics();
+    recordVersion(tr("Load Points"));
+    
+    qInfo() << "Points fully loaded after" << startupTimer.elapsed() << "ms:"
+            << generatedPoints.size() << "points";
+    emit statusMessage(tr("Loaded %1 points in %2 ms").arg(generatedPoints.size()).arg(lastLoadMilliseconds));
+    
+    // Last, so the status bar keeps showing it
+    if (loader->succeeded() && loadedFormat == PointFileFormat::Csv) {
+        reportMalformedLines(loader->getCsvReport());
+    }
+}
+
+void Controller::onFirstFrame()
+{
+    qInfo() << "First frame after" << startupTimer.elapsed() << "ms";
+    loadPointsInBackground();
+}
+
+void Controller::replayJournal()
+{
+    journalBasePointCount = -1;
+    journalPointCount = 0;
+    if (!QFile::exists(journalFilePath())) {
+        return;
+    }
+    
+    PointJournal::ReplayResult result;
+    QString error;
+    if (!PointJournal::replay(journalFilePath(), generatedPoints, &result, &error)) {
+        // Left over from a compaction that finished writing the points file
+        qWarning() << "Discarding points journal:" << error;
+        QFile::remove(journalFilePath());
+        return;
+    }
+    
+    journalBasePointCount = static_cast<qint64>(result.basePointCount);
+    journalBaseFingerprint = result.baseFingerprint;
+    journalPointCount = result.pointCount;
+    if (result.truncated) {
+        emit statusMessage(tr("Recovered %1 journal blocks; an incomplete block at the end was dropped")
+                           .arg(result.blockCount));
+    }
+}
+
+bool Controller::exportPoints(const QString &filePath, PointFileFormat format)
+{
+    waitForPointsLoad();
+    
+    QString error;
+    if (!writePointsFile(filePath, format, &error)) {
+        qWarning() << "Exporting" << filePath << "failed:" << error;
+        emit statusMessage(tr("Could not write %1: %2").arg(filePath, error));
+        return false;
+    }
+    return true;
+}
+
+// The scene shares the points shown now, so the export draws them as they
+// are even if they change meanwhile
+void Controller::exportImage(const QString &filePath, const QSize &size)
 {
     if (!drawingArea) {
         return;
     }
     
-    drawingArea->clearPoints();
+    struct Export {
+        bool written = false;
+        QString error;
+        QElapsedTimer timer;
+    };
+    auto result = std::make_shared<Export>();
+    const CanvasScene scene = drawingArea->getScene();
+    const ImageFormat format = ImageExport::formatFor(filePath);
+    TaskGraph job(tr("Exporting %1").arg(QFileInfo(filePath).fileName()), TaskGraph::Priority::Low);
+    job.addTask("Export image", [result, filePath, format, scene, size](TaskContext &context) {
+        result->timer.start();
+        result->written = ImageExport::write(filePath, format, scene, size, &context, &result->error);
+    });
     
-    for (const PointDataSave &point : generatedPoints) {
-        // Find the area color and symbol type
-        QColor color = Qt::black;
-        SymbolType symbol = SymbolType::Cross;
-        
-        for (const AreaDefinition &area : areaDefinitions) {
-            if (area.areaNumber == point.areaNumber) {
-                color = area.color;
-                symbol = area.symbolType;
-                break;
-            }
+    startJob(job, &exportJobs, [this, result, filePath, size] {
+        if (!result->written) {
+            qWarning() << "Exporting" << filePath << "failed:" << result->error;
+            emit statusMessage(tr("Could not write %1: %2").arg(filePath, result->error));
+            return;
         }
-        
-        // Draw point with proper symbol
-        drawingArea->addPoint(point.x, point.y, color, symbol);
+        emit statusMessage(tr("Exported %1 (%2 x %3 pixels) in %4 ms")
+                           .arg(filePath).arg(size.width()).arg(size.height()).arg(result->timer.elapsed()));
+    });
+}
+
+bool Controller::importPoints(const QString &filePath)
+{
+    cancelJobs(&pointsJobs);
+    cancelPointsLoad();
+    closeLargeDataset();
+    
+    QString error;
+    CsvParseReport report;
+    if (!readPointsFile(filePath, &error, &report)) {
+        qWarning() << "Importing" << filePath << "failed:" << error;
+        emit statusMessage(tr("Could not read %1: %2").arg(filePath, error));
+        return false;
     }
+    
+    redrawPoints();
+    updateStatistics();
+    
+    // Keep the imported points as the current dataset
+    savePoints();
+    recordVersion(tr("Import Points"));
+    emit statusMessage(tr("Imported %1 in %2 ms").arg(filePath).arg(lastLoadMilliseconds));
+    reportMalformedLines(report);
+    return true;
 }
 
-// Calculate Gaussian probability density function value
-double Controller::gaussProbability(double x, double center, double sigma) const
+qint64 Controller::getLastLoadMilliseconds() const
 {
-    // Gaussian probability density function:
-    // f(x) = (1 / (sigma * sqrt(2*pi))) * e^(-(x-center)^2 / (2*sigma^2))
+    return lastLoadMilliseconds;
+}
+
+qint64 Controller::getLastSaveMilliseconds() const
+{
+    return lastSaveMilliseconds;
+}
+
+void Controller::redrawPoints()
+{
+    TraceSpan span("Controller::redrawPoints");
     
-    // For efficiency, we can simplify and normalize this to max = 1 at x = center
-    // f(x) = e^(-(x-center)^2 / (2*sigma^2))
+    if (!drawingArea) {
+        return;
+    }
     
-    double exponent = -((x - center) * (x - center)) / (2 * sigma * sigma);
-    return exp(exponent);
+    if (largeDataset.isOpen()) {
+        showDatasetViewport();
+        return;
+    }
+    
+    showPoints(generatedPoints);
 }
 
-// Generate a single coordinate using acceptance-rejection sampling
-bool Controller::generateCoordinate(double center, double sigma, int &coordinate)
+// The drawing area keeps a pointer to the store and only gets the style of
+// each area slot, so showing the points again after a change costs nothing
+// per point
+void Controller::showPoints(const PointStore &points)
 {
-    QRandomGenerator *rng = QRandomGenerator::global();
+    TraceSpan span("Controller::showPoints");
     
-    // Step 2: Randomly choose a value in the range (-300, 300)
-    coordinate = rng->bounded(-300, 301);
+    if (!drawingArea) {
+        updateMemoryCounter();
+        return;
+    }
     
-    // Step 3: Calculate the probability using Gauss function
-    double probability = gaussProbability(coordinate, center, sigma);
+    // Resolve the color and symbol type once per area in the store
+    QVector<QColor> colors;
+    QVector<SymbolType> symbols;
+    areaStyles(points.getAreaNumbers(), areaDefinitions, &colors, &symbols);
     
-    // Step 4: Randomly generate a probability in [0,1]
-    double randomProb = rng->generateDouble();
+    // Marks of an older version of the points are dropped
+    const bool marked = outsideFlagsStore == &points && outsideFlagsVersion == points.version();
     
-    // Step 5: Check if calculated probability > random probability
-    return probability > randomProb;
+    // Large stores are drawn through their display subset, which shares
+    // their area table and keeps every marked point; it cannot index more
+    // points than 32 bits address
+    if (points.size() > PointStore::MaxIndexedPoints) {
+        drawingArea->clearPoints();
+        displaySubset.clear();
+        emit statusMessage(tr("%1 points are too many to draw; at most %2 can be shown")
+                           .arg(points.size()).arg(PointStore::MaxIndexedPoints));
+    } else if (points.size() >= DisplaySubset::MinPoints) {
+        displaySubset.update(points, marked ? &outsideFlags : nullptr);
+        drawingArea->setPoints(&displaySubset.getPoints(), colors, symbols, displaySubset.getOutsideFlags());
+    } else {
+        drawingArea->setPoints(&points, colors, symbols, marked ? &outsideFlags : nullptr);
+        displaySubset.clear();
+    }
+    updateMemoryCounter();
 }
 
-// Generate points according to the specification
+// Color and symbol type of each area slot of a store
+void Controller::areaStyles(const QVector<int> &areaNumbers, const QVector<AreaDefinition> &areas,
+                            QVector<QColor> *colors, QVector<SymbolType> *symbols)
+{
+    colors->fill(Qt::black, areaNumbers.size());
+    symbols->fill(SymbolType::Cross, areaNumbers.size());
+    for (int slot = 0; slot < areaNumbers.size(); slot++) {
+        for (const AreaDefinition &area : areas) {
+            if (area.areaNumber == areaNumbers[slot]) {
+                (*colors)[slot] = area.color;
+                (*symbols)[slot] = area.symbolType;
+                break;
+            }
+        }
+    }
+}
+
+// Memory of the in-memory points, of the large dataset points on screen, of
+// their outside flags and index, of the display subset and of the recorded
+// versions, for the performance overlay
+void Controller::updateMemoryCounter()
+{
+    PerfCounters::setPointStoreBytes(generatedPoints.memoryBytes() + visibleDatasetPoints.memoryBytes()
+                                     + outsideFlags.capacity() + outlierIndex.memoryBytes()
+                                     + displaySubset.memoryBytes() + history.memoryBytes(generatedPoints));
+}
+
+// Generate points according to the specification on the task pool; they
+// replace the current points once they are complete
 void Controller::generatePointsAccordingToSpecification()
 {
+    TraceSpan span("Controller::generatePoints");
+    
     if (areaDefinitions.size() == 0) {
         QMessageBox::warning(nullptr, tr("No Areas Defined"),
                             tr("Please define at least one area before generating points."));
@@ -335,62 +774,138 @@ void Controller::generatePointsAccordingToSpecification()
         return;
     }
     
-    QRandomGenerator *rng = QRandomGenerator::global();
-    
-    // Clear previous points
-    generatedPoints.clear();
-    drawingArea->clearPoints();
-    
-    // Make sure area circles are visible
-    redrawAreaCircles();
+    // A new generation replaces the points, so generations and appends
+    // still running are cancelled instead of waited for
+    cancelJobs(&pointsJobs);
     
     // Calculate total number of points to generate (10000 points total)
-    int totalPoints = 10000;
-    
-    // Calculate how many points to generate for each area
-    int pointsPerArea = totalPoints / areaDefinitions.size();
-    int remainingPoints = totalPoints % areaDefinitions.size(); // handle any remainder
-    
-    // Generate points for each area
-    for (int areaIndex = 0; areaIndex < areaDefinitions.size(); areaIndex++) {
-        AreaDefinition &area = areaDefinitions[areaIndex];
+    const qsizetype totalPoints = 10000;
+    auto generated = std::make_shared<GeneratedPoints>();
+    startJob(generationJob(tr("Generating points"), totalPoints, generated), &pointsJobs, [this, generated] {
+        // Generated points replace an open large dataset or a running load
+        cancelPointsLoad();
+        closeLargeDataset();
+        generatedPoints = generated->points;
         
-        // How many points to generate for this area
-        int pointsForArea = pointsPerArea;
-        if (areaIndex < remainingPoints) {
-            pointsForArea++; // Distribute remainder evenly
-        }
+        // Make sure area ellipses are visible
+        redrawAreaEllipses();
         
-        // Generate points for this area
-        for (int i = 0; i < pointsForArea; i++) {
-            // Generate x coordinate
-            int x;
-            while (!generateCoordinate(area.centerX, area.sigmaX, x)) {
-                // Keep trying until we get a successful x coordinate
-            }
-            
-            // Generate y coordinate
-            int y;
-            while (!generateCoordinate(area.centerY, area.sigmaY, y)) {
-                // Keep trying until we get a successful y coordinate
-            }
-            
-            // Add the point to our list
-            PointDataSave point;
-            point.x = x;
-            point.y = y;
-            point.areaNumber = area.areaNumber;
-            generatedPoints.append(point);
-            
-            // Draw the point with the area's symbol type
-            drawingArea->addPoint(x, y, area.color, area.symbolType);
-            
-            // Process events every so often to keep UI responsive
-            if (i % 100 == 0) {
-                QApplication::processEvents();
-            }
+        areaStatistics.clear();
+        mergeStatistics(*generated);
+        emit statisticsChanged();
+        
+        // Draw the points with their area's symbol type and save them in
+        // the background
+        redrawPoints();
+        savePoints();
+        recordVersion(tr("Generate Points"));
+        emit statusMessage(tr("Generated %1 points across all defined areas").arg(generatedPoints.size()));
+    });
+}
+
+// Job generating count points, shared among the current areas by their
+// weights, into generated. The points are made in chunks so the job can be
+// cancelled between them and reports its progress.
+TaskGraph Controller::generationJob(const QString &name, qsizetype count,
+                                    const std::shared_ptr<GeneratedPoints> &generated) const
+{
+    const PointGenerator generator(areaDefinitions, count, QRandomGenerator::global()->generate64(), samplingMode,
+                                   sequenceMode);
+    for (const AreaDefinition &area : areaDefinitions) {
+        generated->areaNumbers.append(area.areaNumber);
+    }
+    
+    TaskGraph job(name, TaskGraph::Priority::High);
+    job.addTask("Generate points", [generator, generated, count](TaskContext &context) {
+        const qsizetype chunk = qsizetype(1) << 20;
+        for (qsizetype begin = 0; begin < count && !context.isCancelled(); begin += chunk) {
+            const qsizetype end = qMin(count, begin + chunk);
+            generator.generate(begin, end, generated->points, &generated->statistics);
+            context.setProgress(static_cast<double>(end) / count);
         }
+    });
+    return job;
+}
+
+// Merge the statistics of generated points into areaStatistics
+void Controller::mergeStatistics(const GeneratedPoints &generated)
+{
+    for (int areaIndex = 0; areaIndex < generated.statistics.size(); areaIndex++) {
+        areaStatistics[generated.areaNumbers[areaIndex]].merge(generated.statistics[areaIndex]);
+    }
+}
+
+void Controller::startJob(TaskGraph job, QVector<TaskGraph> *jobs, const std::function<void()> &apply)
+{
+    job.setFinishedCallback([this, job, jobs, apply](bool) {
+        QMetaObject::invokeMethod(this, [this, job, jobs, apply] {
+            // A job cancelled after its last task is dropped all the same
+            jobs->removeOne(job);
+            cancelledJobs.removeOne(job);
+            if (!job.isCancelled()) {
+                apply();
+            }
+            reportJobs();
+        }, Qt::QueuedConnection);
+    });
+    jobs->append(job);
+    job.start();
+    
+    if (!jobTimer.isActive()) {
+        jobTimer.start();
     }
+    reportJobs();
+}
+
+void Controller::cancelJobs(QVector<TaskGraph> *jobs)
+{
+    for (TaskGraph &job : *jobs) {
+        job.cancel();
+    }
+    cancelledJobs += *jobs;
+    jobs->clear();
+    reportJobs();
+}
+
+// Progress of the oldest job still running, or the end of the last one
+void Controller::reportJobs()
+{
+    const QVector<TaskGraph> running = pointsJobs + markJobs + exportJobs;
+    if (running.isEmpty()) {
+        jobTimer.stop();
+        emit jobsFinished();
+        return;
+    }
+    
+    const TaskGraph &job = running.first();
+    const QString name = running.size() > 1 ? tr("%1 (+%2 more)").arg(job.getName()).arg(running.size() - 1)
+                                            : job.getName();
+    emit jobProgress(name, qRound(job.progress() * 100));
+}
+
+void Controller::onCancelJobs()
+{
+    if (pointsJobs.isEmpty() && markJobs.isEmpty() && exportJobs.isEmpty()) {
+        return;
+    }
+    cancelJobs(&pointsJobs);
+    cancelJobs(&markJobs);
+    cancelJobs(&exportJobs);
+    emit statusMessage(tr("Cancelled"));
+}
+
+// Recompute the per-area statistics of the current points (e.g. after loading)
+void Controller::updateStatistics()
+{
+    TraceSpan span("Controller::updateStatistics");
+    
+    areaStatistics = computeAreaStatistics(generatedPoints, areaDefinitions);
+    emit statisticsChanged();
+}
+
+const QHash<int, AreaStatistics> &Controller::getAreaStatistics() const
+{
+    return areaStatistics;
 }
 
 void Controller::onClearCanvas()
@@ -404,21 +919,64 @@ void Controller::onGeneratePoints()
         return;
     }
     
-    // Generate points using the specified algorithm
+    // Generate points using the specified algorithm; they are drawn and
+    // saved once the job is done
     generatePointsAccordingToSpecification();
+}
+
+void Controller::onAppendPoints(int count)
+{
+    if (areaDefinitions.isEmpty()) {
+        QMessageBox::warning(nullptr, tr("No Areas Defined"),
+                            tr("Please define at least one area before generating points."));
+        return;
+    }
     
-    // Save the generated points
-    savePoints();
+    if (!drawingArea || count <= 0) {
+        return;
+    }
+    
+    // Appending works on the in-memory points, all of them
+    waitForPointsLoad();
+    closeLargeDataset();
     
-    QMessageBox::information(nullptr, tr("Points Generated"),
-                            tr("Generated and saved %1 points.\nPoints are distributed across all defined areas.").arg(generatedPoints.size()));
+    // The points are made on the task pool; appends do not cancel each
+    // other and are added in the order they finish
+    auto generated = std::make_shared<GeneratedPoints>();
+    startJob(generationJob(tr("Appending %1 points").arg(count), count, generated), &pointsJobs, [this, generated] {
+        // The journal extends the points file as it was last saved, which
+        // is the current store until the first append
+        if (journalBasePointCount < 0) {
+            journalBasePointCount = generatedPoints.size();
+            journalBaseFingerprint = PointJournal::fingerprint(generatedPoints);
+            journalPointCount = 0;
+        }
+        
+        const qsizetype first = generatedPoints.size();
+        const qsizetype count = generated->points.size();
+        generatedPoints.append(generated->points);
+        mergeStatistics(*generated);
+        emit statisticsChanged();
+        showPoints(generatedPoints);
+        
+        // Only the new block is written. A full save that is still waiting
+        // picks the new points up anyway, and once the journal holds a
+        // quarter of the points it is compacted into the points file.
+        journalPointCount += count;
+        if (persistence->hasPendingPoints() || journalPointCount * 4 > generatedPoints.size()) {
+            savePoints();
+        } else {
+            persistence->appendPoints(journalFilePath(), static_cast<quint64>(journalBasePointCount),
+                                      journalBaseFingerprint, generatedPoints.mid(first, count));
+        }
+        recordVersion(tr("Append Points"));
+    });
 }
 
 void Controller::onLoadDrawing()
 {
-    loadPoints();
-    QMessageBox::information(nullptr, tr("Load Points"),
-                             tr("Loaded %1 points from %2").arg(generatedPoints.size()).arg(pointsFilePath));
+    // The points are drawn as they arrive; the status bar reports the end
+    loadPointsInBackground();
 }
 
 void Controller::onClearPoints()
@@ -428,44 +986,41 @@ void Controller::onClearPoints()
     }
     
     // Clear points from the drawing area
+    cancelJobs(&pointsJobs);
+    cancelPointsLoad();
+    closeLargeDataset();
     drawingArea->clearPoints();
     
-    // Make sure area circles are still visible
-    redrawAreaCircles();
+    // Make sure area ellipses are still visible
+    redrawAreaEllipses();
     
-    // Clear the points list
+    // Clear the points list, their outlier index, display subset and statistics
     generatedPoints.clear();
+    outlierIndex.clear();
+    displaySubset.clear();
+    areaStatistics.clear();
+    updateMemoryCounter();
+    emit statisticsChanged();
     
-    // Delete the points file
-    QFile file(pointsFilePath);
-    if (file.exists()) {
-        file.remove();
+    // Delete the points file in every format, after any write still queued
+    QStringList files;
+    for (PointFileFormat format : {PointFileFormat::Binary, PointFileFormat::Compressed, PointFileFormat::Csv}) {
+        files << pointsFilePathFor(format);
     }
+    files << journalFilePath();
+    persistence->removePoints(files);
+    journalBasePointCount = -1;
+    journalPointCount = 0;
     
-    QMessageBox::information(nullptr, tr("Clear Points"),
-                            tr("All points have been cleared."));
-}
-
-// Helper to check if a point is outside its area
-bool Controller::isPointOutsideArea(const PointDataSave &point, const AreaDefinition &area) const
-{
-    // Define a threshold for determining when a point is "outside" the area
-    // A point is considered outside if its probability is less than 5% of the max probability
-    const double threshold = 0.05; 
-    
-    // Calculate the probability at this point's location
-    double probX = gaussProbability(point.x, area.centerX, area.sigmaX);
-    double probY = gaussProbability(point.y, area.centerY, area.sigmaY);
-    
-    // The combined probability is the product of the x and y probabilities
-    double probability = probX * probY;
-    
-    // If the probability is below the threshold, the point is considered outside
-    return probability < threshold;
+    // The cleared points stay in the history, so the clear can be undone
+    recordVersion(tr("Clear Points"));
+    emit statusMessage(tr("All points have been cleared."));
 }
 
 void Controller::onMarkOutsidePoints()
 {
+    TraceSpan span("Controller::markOutsidePoints");
+    
     // Check if there are area definitions and points
     if (areaDefinitions.isEmpty()) {
         QMessageBox::warning(nullptr, tr("No Areas Defined"),
@@ -473,7 +1028,14 @@ void Controller::onMarkOutsidePoints()
         return;
     }
     
-    if (generatedPoints.isEmpty()) {
+    waitForPointsLoad();
+    
+    // For a large dataset the total comes from the streaming pass and only
+    // the points in the viewport are marked
+    const bool outOfCore = largeDataset.isOpen();
+    const PointStore &points = outOfCore ? visibleDatasetPoints : generatedPoints;
+    
+    if (points.isEmpty() && !outOfCore) {
         QMessageBox::warning(nullptr, tr("No Points"),
                             tr("No points to analyze. Please generate or load points first."));
         return;
@@ -483,49 +1045,383 @@ void Controller::onMarkOutsidePoints()
         return;
     }
     
-    // Count of outside points
-    int outsideCount = 0;
+    // The outlier index keeps 32-bit point indices
+    if (points.size() > PointStore::MaxIndexedPoints) {
+        emit statusMessage(tr("%1 points are too many to mark; at most %2 can be marked")
+                           .arg(points.size()).arg(PointStore::MaxIndexedPoints));
+        return;
+    }
     
-    // First, clear the drawing area
-    drawingArea->clearPoints();
+    // A newer mark replaces one still running
+    cancelJobs(&markJobs);
+    if (outlierIndex.isBuiltFor(points, areaDefinitions)) {
+        showOutsideMarks(points, outlierIndex.markOutside(outlierThresholds(), &outsideFlags));
+        return;
+    }
     
-    // Make sure area circles are visible
-    redrawAreaCircles();
+    const PointStore *store = &points;
+    startMarkJob(points, [this, store](qint64 outsideCount) {
+        showOutsideMarks(*store, outsideCount);
+    });
+}
+
+// Sorting the points by their distance from their area center is the slow
+// part of a mark and runs on the task pool, on a snapshot of the store; show
+// receives the outside count once the index and flags were taken over
+void Controller::startMarkJob(const PointStore &points, const std::function<void(qint64)> &show)
+{
+    struct Marks {
+        OutlierIndex index;
+        QVector<quint8> flags;
+    };
+    auto marks = std::make_shared<Marks>();
+    const PointStore snapshot = points;
+    const QVector<AreaDefinition> areas = areaDefinitions;
+    const QVector<double> thresholds = outlierThresholds();
+    TaskGraph job(tr("Marking outside points"), TaskGraph::Priority::High);
+    const int sortTask = job.addTask("Sort outlier distances", [marks, snapshot, areas](TaskContext &) {
+        marks->index.build(snapshot, areas);
+    }, QVector<int>(), 9);
+    job.addTask("Mark outside points", [marks, thresholds](TaskContext &) {
+        marks->index.markOutside(thresholds, &marks->flags);
+    }, {sortTask});
     
-    // Check each point to see if it's outside its assigned area
-    for (const PointDataSave &point : generatedPoints) {
-        bool found = false;
-        bool isOutside = false;
-        QColor color = Qt::black;
-        SymbolType symbol = SymbolType::Cross;
-        
-        // Find the area this point belongs to
-        for (const AreaDefinition &area : areaDefinitions) {
-            if (area.areaNumber == point.areaNumber) {
-                found = true;
-                color = area.color;
-                symbol = area.symbolType;
-                
-                // Check if the point is outside its area
-                isOutside = isPointOutsideArea(point, area);
-                break;
-            }
+    const PointStore *store = &points;
+    const quint64 version = points.version();
+    startJob(job, &markJobs, [this, marks, store, version, show] {
+        // Points that changed meanwhile need a new mark
+        if (store->version() != version) {
+            emit statusMessage(tr("The points changed while they were marked; mark them again"));
+            return;
         }
         
-        // Draw the point
-        if (found && isOutside) {
-            // Mark outside points with a circle in the area's color
-            drawingArea->addPointWithCircle(point.x, point.y, color, symbol, color);
-            outsideCount++;
-        } else {
-            // Draw normal points as before
-            drawingArea->addPoint(point.x, point.y, color, symbol);
+        // Areas that moved since the job started need a new index; moved
+        // thresholds only change the points between the cutoffs
+        if (!marks->index.isBuiltFor(*store, areaDefinitions)) {
+            startMarkJob(*store, show);
+            return;
         }
-    }
+        outlierIndex = std::move(marks->index);
+        outsideFlags = std::move(marks->flags);
+        show(outlierIndex.updateThresholds(outlierThresholds(), &outsideFlags));
+    });
+}
+
+// Draw the outside flags of the last mark on points; the drawing area
+// circles the flagged ones
+void Controller::showOutsideMarks(const PointStore &points, qint64 outsideCount)
+{
+    outsideFlagsStore = &points;
+    outsideFlagsVersion = points.version();
+    
+    // Make sure area ellipses are visible
+    redrawAreaEllipses();
+    showPoints(points);
     
     // Show information about the results
-    QMessageBox::information(nullptr, tr("Outside Points Marked"),
-                            tr("Found %1 points outside their assigned areas (from %2 total points).")
-                            .arg(outsideCount)
-                            .arg(generatedPoints.size()));
-} 
\ No newline at end of file
+    if (largeDataset.isOpen()) {
+        emit statusMessage(tr("Found %1 points outside their assigned areas (from %2 total points); "
+                              "%3 of them are marked in the current view.")
+                           .arg(datasetOutsideCount)
+                           .arg(largeDataset.getPointCount())
+                           .arg(outsideCount));
+        return;
+    }
+    emit statusMessage(tr("Found %1 points outside their assigned areas (from %2 total points).")
+                       .arg(outsideCount)
+                       .arg(points.size()));
+}
+
+void Controller::setOutlierThreshold(double threshold)
+{
+    if (threshold == outlierThreshold) {
+        return;
+    }
+    outlierThreshold = threshold;
+    updateOutsideMarks();
+}
+
+double Controller::getOutlierThreshold() const
+{
+    return outlierThreshold;
+}
+
+QVector<double> Controller::outlierThresholds() const
+{
+    QVector<double> thresholds;
+    for (const AreaDefinition &area : areaDefinitions) {
+        thresholds.append(area.outlierThreshold > 0 ? area.outlierThreshold : outlierThreshold);
+    }
+    return thresholds;
+}
+
+// While outside points are marked, follow the thresholds: with an index of
+// the same points and areas only the points between the old and the new
+// cutoffs change; moved or resized areas need a new index
+void Controller::updateOutsideMarks()
+{
+    if (!outsideFlagsStore || outsideFlagsVersion != outsideFlagsStore->version()) {
+        return;
+    }
+    
+    const PointStore &points = *outsideFlagsStore;
+    const PointStore *store = &points;
+    auto show = [this, store](qint64 outsideCount) {
+        showPoints(*store);
+        emit statusMessage(tr("%1 of %2 points outside their areas").arg(outsideCount).arg(store->size()));
+    };
+    if (outlierIndex.isBuiltFor(points, areaDefinitions)) {
+        show(outlierIndex.updateThresholds(outlierThresholds(), &outsideFlags));
+        return;
+    }
+    
+    // The current marks stay shown until the new index was sorted
+    cancelJobs(&markJobs);
+    startMarkJob(points, show);
+}
+
+void Controller::openLargeDataset(const QString &filePath)
+{
+    cancelJobs(&pointsJobs);
+    cancelPointsLoad();
+    closeLargeDataset();
+    
+    // The in-memory points are replaced by the dataset; their files stay
+    generatedPoints.clear();
+    outlierIndex.clear();
+    displaySubset.clear();
+    areaStatistics.clear();
+    updateMemoryCounter();
+    emit statisticsChanged();
+    if (drawingArea) {
+        drawingArea->clearPoints();
+    }
+    
+    datasetScanner = new DatasetScanner(this);
+    datasetScanner->setSource(filePath);
+    const double threshold = outlierThreshold;
+    datasetScanner->setAreas(areaDefinitions, [threshold](const PointDataSave &point, const AreaDefinition &area) {
+        return OutlierDetector::isOutside(point, area, area.outlierThreshold > 0 ? area.outlierThreshold : threshold);
+    });
+    connect(datasetScanner, &QThread::finished, this, &Controller::onDatasetScanFinished);
+    datasetScanner->start();
+    
+    emit statusMessage(tr("Preparing %1...").arg(filePath));
+}
+
+void Controller::closeLargeDataset()
+{
+    if (datasetScanner) {
+        datasetScanner->cancel();
+        datasetScanner->wait();
+        delete datasetScanner;
+        datasetScanner = nullptr;
+    }
+    
+    largeDataset.close();
+    visibleDatasetPoints.clear();
+    datasetOutsideCount = 0;
+}
+
+bool Controller::hasLargeDataset() const
+{
+    return largeDataset.isOpen();
+}
+
+const DatasetHistory &Controller::getHistory() const
+{
+    return history;
+}
+
+void Controller::undo()
+{
+    if (history.canUndo()) {
+        restoreVersion(history.undo());
+    }
+}
+
+void Controller::redo()
+{
+    if (history.canRedo()) {
+        restoreVersion(history.redo());
+    }
+}
+
+void Controller::recordVersion(const QString &label)
+{
+    history.capture(label, generatedPoints, areaDefinitions);
+    updateMemoryCounter();
+    updateComparison();
+    emit historyChanged();
+}
+
+// Make a recorded version the current dataset: its points replace the
+// in-memory ones (sharing its columns) and its area definitions replace the
+// current ones, and both are saved
+void Controller::restoreVersion(int index)
+{
+    TraceSpan span("Controller::restoreVersion");
+    
+    cancelJobs(&pointsJobs);
+    cancelPointsLoad();
+    closeLargeDataset();
+    
+    const QString label = history.at(index).label;
+    areaDefinitions = history.at(index).areas;
+    generatedPoints = history.points(index);
+    redrawAreaEllipses();
+    saveSettings();
+    emit areaDefinitionsRestored();
+    
+    updateStatistics();
+    redrawPoints();
+    savePoints();
+    updateComparison();
+    emit historyChanged();
+    emit statusMessage(tr("Restored \"%1\" (%2 points)").arg(label).arg(generatedPoints.size()));
+}
+
+void Controller::setComparisonArea(DrawingArea *area)
+{
+    if (comparisonArea && comparisonArea != area) {
+        comparisonArea->clearPoints();
+        comparisonArea->clearAreaEllipses();
+    }
+    comparisonArea = area;
+    updateComparison();
+}
+
+// Show the version undo would restore in the comparison area, with its own
+// area definitions
+void Controller::updateComparison()
+{
+    if (!comparisonArea) {
+        comparisonPoints.clear();
+        return;
+    }
+    
+    comparisonArea->clearAreaEllipses();
+    const int index = history.currentIndex() - 1;
+    if (index < 0) {
+        comparisonArea->clearPoints();
+        comparisonPoints.clear();
+        return;
+    }
+    
+    const QVector<AreaDefinition> &areas = history.at(index).areas;
+    for (const AreaDefinition &areaDef : areas) {
+        comparisonArea->addAreaEllipse(QPointF(areaDef.centerX, areaDef.centerY), areaEllipseRadius(areaDef.sigmaX),
+                                       areaEllipseRadius(areaDef.sigmaY), areaDef.rotation, areaDef.color);
+    }
+    comparisonPoints = history.points(index);
+    QVector<QColor> colors;
+    QVector<SymbolType> symbols;
+    areaStyles(comparisonPoints.getAreaNumbers(), areas, &colors, &symbols);
+    comparisonArea->setPoints(&comparisonPoints, colors, symbols, nullptr);
+}
+
+void Controller::setDatasetMemoryBudget(qint64 bytes)
+{
+    datasetMemoryBudget = bytes;
+    largeDataset.setMemoryBudget(bytes / 2);
+    if (largeDataset.isOpen()) {
+        showDatasetViewport();
+    }
+}
+
+void Controller::onDatasetScanFinished()
+{
+    // Ignore scanners that were cancelled by closeLargeDataset()
+    DatasetScanner *scanner = qobject_cast<DatasetScanner *>(sender());
+    if (!scanner || scanner != datasetScanner) {
+        return;
+    }
+    datasetScanner = nullptr;
+    scanner->deleteLater();
+    
+    QString error = scanner->getErrorMessage();
+    if (!scanner->succeeded() || !largeDataset.open(scanner->getBucketedPath(), &error)) {
+        qWarning() << "Opening the dataset failed:" << error;
+        emit statusMessage(tr("Could not open the dataset: %1").arg(error));
+        return;
+    }
+    largeDataset.setMemoryBudget(datasetMemoryBudget / 2);
+    
+    areaStatistics = scanner->getStatistics();
+    datasetOutsideCount = scanner->getOutsideCount();
+    emit statisticsChanged();
+    emit statusMessage(tr("%1 points, %2 outside their areas; prepared in %3 ms")
+                       .arg(scanner->getPointCount())
+                       .arg(datasetOutsideCount)
+                       .arg(scanner->getMilliseconds()));
+    
+    redrawAreaEllipses();
+    showDatasetViewport();
+}
+
+void Controller::onViewportChanged(const QRectF &viewport)
+{
+    Q_UNUSED(viewport);
+    if (largeDataset.isOpen()) {
+        showDatasetViewport();
+    }
+}
+
+void Controller::showDatasetViewport()
+{
+    TraceSpan span("Controller::showDatasetViewport");
+    
+    if (!drawingArea) {
+        return;
+    }
+    
+    // Half of the budget is for the points on the canvas, each of which costs
+    // its column entries and an outside flag
+    const qint64 maxPoints = qMax<qint64>(1, datasetMemoryBudget / 2 / 7);
+    visibleDatasetPoints = largeDataset.pointsIn(drawingArea->getViewport(), maxPoints);
+    showPoints(visibleDatasetPoints);
+}
+
+bool Controller::isTraining() const
+{
+    return trainer && trainer->isRunning();
+}
+
+void Controller::onTrainClassifier(Optimizer optimizer)
+{
+    TraceSpan span("Controller::trainClassifier");
+    
+    if (isTraining()) {
+        return;
+    }
+    
+    // Train on all points, not the part loaded so far
+    waitForPointsLoad();
+    
+    if (areaDefinitions.isEmpty() || generatedPoints.isEmpty()) {
+        QMessageBox::warning(nullptr, tr("No Training Data"),
+                            tr("Please define areas and generate or load points before training."));
+        return;
+    }
+    
+    if (!trainer) {
+        trainer = new Trainer(this);
+        connect(trainer, &Trainer::epochFinished, this, &Controller::trainingEpochFinished);
+        connect(trainer, &QThread::finished, this, &Controller::trainingStopped);
+    }
+    
+    TrainingConfig config;
+    config.optimizer = optimizer;
+    config.learningRate = (optimizer == Optimizer::Adam) ? 0.005f : 0.05f;
+    
+    trainer->setPoints(generatedPoints, areaDefinitions);
+    trainer->setConfig(config);
+    trainer->start();
+}
+
+void Controller::onStopTraining()
+{
+    if (trainer) {
+        trainer->requestInterruption();
+    }
+}
@@ -4,29 +4,30 @@
 #include <QObject>
 #include <QColor>
 #include <QVector>
+#include <QHash>
 #include <QSettings>
 #include <QRandomGenerator>
 #include <QFile>
 #include <QTextStream>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <functional>
+#include <memory>
+#include "areadefinition.h"
+#include "areastatistics.h"
+#include "pointstore.h"
+#include "pointfile.h"
 #include "drawingarea.h"
-
-// Structure for area definition
-struct AreaDefinition {
-    int areaNumber;
-    double centerX;
-    double centerY;
-    double sigmaX;
-    double sigmaY;
-    SymbolType symbolType;  // Symbol type for this area
-    QColor color;
-};
-
-// Structure for point data to save
-struct PointDataSave {
-    int x;
-    int y;
-    int areaNumber;
-};
+#include "trainer.h"
+#include "persistenceworker.h"
+#include "bucketedpointfile.h"
+#include "datasetscanner.h"
+#include "pointsloader.h"
+#include "outlierindex.h"
+#include "displaysubset.h"
+#include "datasethistory.h"
+#include "pointgenerator.h"
+#include "taskscheduler.h"
 
 class Controller : public QObject
 {
@@ -45,56 +46,264 @@ public:
     void removeAreaDefinition(int row);
     int getAreaDefinitionsCount() const;
     AreaDefinition getAreaDefinition(int row) const;
+    const QVector<AreaDefinition> &getAreaDefinitions() const;
     
-    // Save/load settings
+    // Save/load settings; saving is debounced and done in the background
     void saveSettings();
     void loadSettings();
     
-    // Save/load points
+    // Save/load points; saving is debounced and done in the background
     void savePoints();
     void loadPoints();
     
+    // Load the points on a worker thread, drawing them as chunks arrive.
+    // Changes to the points wait for the load; replacing them cancels it.
+    void loadPointsInBackground();
+    
+    // Format used by savePoints(); loadPoints() accepts any format
+    void setPointsFileFormat(PointFileFormat format);
+    PointFileFormat getPointsFileFormat() const;
+    
+    // Import/export points in any supported format
+    bool exportPoints(const QString &filePath, PointFileFormat format);
+    bool importPoints(const QString &filePath);
+    
+    // Export what the drawing area shows as a PNG or TIFF image (by the file
+    // suffix) of any size, drawn in tiles on the task pool
+    void exportImage(const QString &filePath, const QSize &size);
+    
+    // Duration of the most recent points load/save
+    qint64 getLastLoadMilliseconds() const;
+    qint64 getLastSaveMilliseconds() const;
+    
+    // How generated points are shared among the areas: grouped by area, or
+    // interleaved by drawing each point's area from the area weights
+    void setSampling(PointGenerator::Sampling sampling);
+    PointGenerator::Sampling getSampling() const;
+    
+    // Source of the generated coordinates: pseudo-random, or a scrambled
+    // Sobol sequence that covers the areas more evenly
+    void setSequence(PointGenerator::Sequence sequence);
+    PointGenerator::Sequence getSequence() const;
+    
     // Redraw points from the saved points list
     void redrawPoints();
+    
+    // Per-area statistics of the current points, keyed by area number
+    const QHash<int, AreaStatistics> &getAreaStatistics() const;
+    void updateStatistics();
+    
+    // Global outlier threshold, as a fraction of the maximum probability at
+    // the center; areas may override it. Changing it while outside points
+    // are marked updates the marks.
+    void setOutlierThreshold(double threshold);
+    double getOutlierThreshold() const;
+    
+    // Classifier training on the current points
+    bool isTraining() const;
+    
+    // Out-of-core datasets: a points file that is bucketed on disk and only
+    // paged in for the visible part of the drawing area. Statistics and
+    // outlier counts come from a streaming pass on a worker thread.
+    void openLargeDataset(const QString &filePath);
+    void closeLargeDataset();
+    bool hasLargeDataset() const;
+    
+    // Memory for the points of a large dataset: half for the bucket cache,
+    // half for the points shown in the viewport
+    void setDatasetMemoryBudget(qint64 bytes);
+    
+    // Versions of the points and area definitions, recorded after every
+    // change of the points; undo and redo restore both and save them
+    const DatasetHistory &getHistory() const;
+    void undo();
+    void redo();
+    
+    // Second drawing area that shows the version undo would restore, next
+    // to the current one (null to stop)
+    void setComparisonArea(DrawingArea *area);
+
+signals:
+    // The per-area statistics were recomputed or cleared
+    void statisticsChanged();
+    
+    // Short, non-modal progress or result message for the status bar
+    void statusMessage(const QString &message);
+    
+    // Progress of the background jobs, polled while any is running, and the
+    // end of the last one
+    void jobProgress(const QString &name, int percent);
+    void jobsFinished();
+    
+    // A version was recorded or restored; the area definitions were
+    // replaced by those of a restored version
+    void historyChanged();
+    void areaDefinitionsRestored();
+    
+    // Forwarded from the training worker thread
+    void trainingEpochFinished(int epoch, int totalEpochs, double loss, double accuracy,
+                               double epochsPerSecond, int sampleCount);
+    void trainingStopped();
 
 public slots:
     // Basic drawing operations
     void clearCanvas();
-    void addPoint(int x, int y, const QColor &color, SymbolType symbol);
-    void addPointWithCircle(int x, int y, const QColor &pointColor, 
-                          SymbolType symbol, const QColor &circleColor);
-    void addAreaCircle(int x, int y, int radius, const QColor &color);
     
     // Demo operations for the UI
     void onClearCanvas();
     
     // Points generation 
     void onGeneratePoints();
+    void onAppendPoints(int count);
     
     // File operations
     void onLoadDrawing();
     void onClearPoints();
     void onMarkOutsidePoints();
+    
+    // Cancel every background job; what they computed is dropped
+    void onCancelJobs();
+    
+    // Page in the large dataset for the visible region
+    void onViewportChanged(const QRectF &viewport);
+    
+    // Startup: log the time to the first frame and start loading the points
+    void onFirstFrame();
+    
+    // Classifier training
+    void onTrainClassifier(Optimizer optimizer);
+    void onStopTraining();
 
 private:
     DrawingArea *drawingArea;
     QVector<AreaDefinition> areaDefinitions;
-    QVector<PointDataSave> generatedPoints;
+    PointStore generatedPoints;
+    QHash<int, AreaStatistics> areaStatistics;
+    Trainer *trainer;
+    PersistenceWorker *persistence;
     
     // Settings and file paths
     QString settingsFilePath;
-    QString pointsFilePath;
+    QString appDirectory;
+    PointFileFormat pointsFileFormat;
+    PointGenerator::Sampling samplingMode;
+    PointGenerator::Sequence sequenceMode;
+    
+    // Timings of the last points load/save
+    qint64 lastLoadMilliseconds;
+    qint64 lastSaveMilliseconds;
+    
+    // Points file the journal extends (-1 until the first append after a
+    // full save) and the number of points appended to it since
+    qint64 journalBasePointCount;
+    quint64 journalBaseFingerprint;
+    qint64 journalPointCount;
+    
+    // Out-of-core dataset, its preparation and the points currently shown
+    BucketedPointFile largeDataset;
+    DatasetScanner *datasetScanner;
+    qint64 datasetMemoryBudget;
+    qint64 datasetOutsideCount;
+    PointStore visibleDatasetPoints;
+    
+    // Outside flags of the last mark, valid while the marked store keeps the
+    // version it had then
+    QVector<quint8> outsideFlags;
+    const PointStore *outsideFlagsStore;
+    quint64 outsideFlagsVersion;
+    
+    // Sorted distances of the marked points, so thresholds can be moved
+    // without testing every point again
+    OutlierIndex outlierIndex;
+    double outlierThreshold;
+    
+    // Decimated copy of a large store for drawing, updated incrementally as
+    // points are appended
+    DisplaySubset displaySubset;
+    
+    // Background points load and the time since construction, for the
+    // startup timings
+    PointsLoader *pointsLoader;
+    QElapsedTimer startupTimer;
+    
+    // Jobs on the task pool that generate or append points, that sort the
+    // points for Mark Outside and that export images; a job stays listed
+    // until its result was applied on this thread. jobTimer polls their
+    // progress. Cancelled jobs wait in cancelledJobs until their last task
+    // returned, so the destructor can wait for them before this goes away.
+    QVector<TaskGraph> pointsJobs;
+    QVector<TaskGraph> markJobs;
+    QVector<TaskGraph> exportJobs;
+    QVector<TaskGraph> cancelledJobs;
+    QTimer jobTimer;
+    
+    // Recorded versions and the comparison view of the previous one
+    DatasetHistory history;
+    DrawingArea *comparisonArea;
+    PointStore comparisonPoints;
+    
+    // Points and statistics made by a generation job, for the areas with
+    // these numbers
+    struct GeneratedPoints {
+        PointStore points;
+        QVector<AreaStatistics> statistics;
+        QVector<int> areaNumbers;
+    };
+    
+    // Points file helpers
+    QString pointsFilePathFor(PointFileFormat format) const;
+    QString journalFilePath() const;
+    QString findPointsFile(PointFileFormat *format) const;
+    void replayJournal();
+    void finishLoadingPoints(PointFileFormat loadedFormat);
+    void cancelPointsLoad();
+    void waitForPointsLoad();
+    void onPointsChunkLoaded(const PointStore &chunk);
+    void onPointsLoadFinished();
+    bool writePointsFile(const QString &filePath, PointFileFormat format, QString *errorMessage);
+    bool readPointsFile(const QString &filePath, QString *errorMessage, CsvParseReport *report = nullptr);
+    void reportMalformedLines(const CsvParseReport &report);
+    void reportCompression(qint64 pointCount, const CompressionStats &stats);
+    void onPointsSaved(const QString &filePath, qint64 pointCount, qint64 milliseconds,
+                       const CompressionStats &stats);
     
     // Helper methods for point generation
-    double gaussProbability(double x, double center, double sigma) const;
-    bool generateCoordinate(double center, double sigma, int &coordinate);
     void generatePointsAccordingToSpecification();
+    TaskGraph generationJob(const QString &name, qsizetype count,
+                            const std::shared_ptr<GeneratedPoints> &generated) const;
+    void mergeStatistics(const GeneratedPoints &generated);
+    
+    // Start a job and apply its result on this thread once it finished,
+    // unless it was cancelled by then
+    void startJob(TaskGraph job, QVector<TaskGraph> *jobs, const std::function<void()> &apply);
+    void cancelJobs(QVector<TaskGraph> *jobs);
+    void reportJobs();
+    
+    // Show a store in the drawing area, which reads it in place
+    void showPoints(const PointStore &points);
+    void updateMemoryCounter();
+    static void areaStyles(const QVector<int> &areaNumbers, const QVector<AreaDefinition> &areas,
+                           QVector<QColor> *colors, QVector<SymbolType> *symbols);
+    
+    // Dataset versions
+    void recordVersion(const QString &label);
+    void restoreVersion(int index);
+    void updateComparison();
+    
+    // Outlier thresholds per area definition and the update of the marks
+    // after a threshold or an area changed
+    QVector<double> outlierThresholds() const;
+    void updateOutsideMarks();
+    void startMarkJob(const PointStore &points, const std::function<void(qint64)> &show);
+    void showOutsideMarks(const PointStore &points, qint64 outsideCount);
     
-    // Helper to redraw area circles
-    void redrawAreaCircles();
+    // Large dataset helpers
+    void onDatasetScanFinished();
+    void showDatasetViewport();
     
-    // Helper to check if a point is outside its area
-    bool isPointOutsideArea(const PointDataSave &point, const AreaDefinition &area) const;
+    // Helper to redraw area ellipses
+    void redrawAreaEllipses();
+    static double areaEllipseRadius(double sigma);
 };
 
 #endif // CONTROLLER_H 
\ No newline at end of file
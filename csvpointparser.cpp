@@ -0,0 +1,250 @@
+#include "csvpointparser.h"
+#include "parallel.h"
+#include "trace.h"
+#include <charconv>
+#include <cstring>
+
+namespace {
+
+// Aim for chunks of at least 1 MB so small files are parsed on one thread
+const qint64 MinChunkBytes = 1 << 20;
+
+struct Chunk {
+    const char *begin = nullptr;
+    const char *end = nullptr;
+    qint64 lines = 0;         // Lines in the chunk (pass 1)
+    qint64 firstLine = 0;     // Line number of the first line
+    qsizetype firstSlot = 0;  // First point slot reserved for the chunk
+    qsizetype parsed = 0;     // Points actually parsed (pass 2)
+    qint64 dataLines = 0;
+    qint64 malformedCount = 0;
+    QVector<int> areaNumbers; // Chunk-local area table
+    QVector<CsvMalformedLine> malformedLines;
+};
+
+inline const char *skipBlanks(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    return p;
+}
+
+// Parse one integer field followed by the separator (or the end of the line)
+inline bool parseField(const char *&p, const char *end, int &value, bool last)
+{
+    p = skipBlanks(p, end);
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc() || result.ptr == p) {
+        return false;
+    }
+    p = skipBlanks(result.ptr, end);
+
+    if (p == end) {
+        return last;
+    }
+    if (*p != ';') {
+        return false;
+    }
+    p++;
+    return true;
+}
+
+// Parse "x;y;area" in [p, end); anything after a third separator is ignored
+inline bool parseLine(const char *p, const char *end, int &x, int &y, int &area)
+{
+    return parseField(p, end, x, false)
+           && parseField(p, end, y, false)
+           && parseField(p, end, area, true)
+           && x >= -32768 && x <= 32767
+           && y >= -32768 && y <= 32767;
+}
+
+qint64 countLines(const char *begin, const char *end)
+{
+    qint64 lines = 0;
+    const char *p = begin;
+    while (p < end) {
+        const char *newline = static_cast<const char *>(std::memchr(p, '\n', end - p));
+        lines++;
+        if (!newline) {
+            break;
+        }
+        p = newline + 1;
+    }
+    return lines;
+}
+
+void parseChunk(Chunk &chunk, PointStore &points)
+{
+    qsizetype slot = chunk.firstSlot;
+    qint64 lineNumber = chunk.firstLine;
+    int lastArea = 0;
+    quint16 lastIndex = 0;
+    bool haveLast = false;
+
+    for (const char *p = chunk.begin; p < chunk.end; lineNumber++) {
+        const char *newline = static_cast<const char *>(std::memchr(p, '\n', chunk.end - p));
+        const char *lineEnd = newline ? newline : chunk.end;
+        const char *contentEnd = lineEnd;
+        if (contentEnd > p && contentEnd[-1] == '\r') {
+            contentEnd--;
+        }
+
+        if (contentEnd > p) {
+            chunk.dataLines++;
+
+            int x, y, area;
+            if (parseLine(p, contentEnd, x, y, area)) {
+                // Chunk-local area index, with the previous area cached since
+                // files are usually grouped by area
+                if (!haveLast || area != lastArea) {
+                    int index = chunk.areaNumbers.indexOf(area);
+                    if (index < 0) {
+                        index = chunk.areaNumbers.size();
+                        chunk.areaNumbers.append(area);
+                    }
+                    lastArea = area;
+                    lastIndex = static_cast<quint16>(index);
+                    haveLast = true;
+                }
+
+                points.set(slot, x, y, lastIndex);
+                slot++;
+            } else {
+                chunk.malformedCount++;
+                if (chunk.malformedLines.size() < CsvPointParser::MaxReportedLines) {
+                    chunk.malformedLines.append({lineNumber, QByteArray(p, static_cast<int>(contentEnd - p))});
+                }
+            }
+        }
+
+        p = lineEnd + 1;
+    }
+
+    chunk.parsed = slot - chunk.firstSlot;
+}
+
+} // namespace
+
+namespace CsvPointParser {
+
+void parse(const char *data, qint64 size, PointStore &points, CsvParseReport *report)
+{
+    const char *p = data;
+    const char *end = data + size;
+    qint64 firstLine = 1;
+
+    // Skip a UTF-8 byte order mark
+    if (end - p >= 3 && std::memcmp(p, "\xEF\xBB\xBF", 3) == 0) {
+        p += 3;
+    }
+
+    // Skip the header line unless it already holds a number
+    const char *first = skipBlanks(p, end);
+    if (first < end && *first != '-' && (*first < '0' || *first > '9')) {
+        const char *newline = static_cast<const char *>(std::memchr(p, '\n', end - p));
+        p = newline ? newline + 1 : end;
+        firstLine = 2;
+    }
+
+    parseSlice(p, end - p, firstLine, points, report);
+}
+
+void parseSlice(const char *data, qint64 size, qint64 firstLine, PointStore &points, CsvParseReport *report)
+{
+    TraceSpan span("CsvPointParser::parseSlice");
+
+    points.clear();
+
+    const char *p = data;
+    const char *end = data + size;
+
+    // Split the body into newline-aligned chunks
+    const qint64 bodySize = end - p;
+    const int taskCount = Parallel::rangeCount(bodySize, MinChunkBytes);
+    QVector<Chunk> chunks(taskCount);
+    for (int i = 0; i < taskCount; i++) {
+        const char *begin = (i == 0) ? p : chunks[i - 1].end;
+        const char *chunkEnd = end;
+        if (i + 1 < taskCount) {
+            chunkEnd = qMax(begin, p + bodySize * (i + 1) / taskCount);
+            const char *newline = static_cast<const char *>(std::memchr(chunkEnd, '\n', end - chunkEnd));
+            chunkEnd = newline ? newline + 1 : end;
+        }
+        chunks[i].begin = begin;
+        chunks[i].end = chunkEnd;
+    }
+
+    // Pass 1: count lines so every chunk knows where its points go
+    Parallel::run(taskCount, [&](int i) {
+        chunks[i].lines = countLines(chunks[i].begin, chunks[i].end);
+    });
+
+    qint64 totalLines = 0;
+    for (Chunk &chunk : chunks) {
+        chunk.firstLine = firstLine + totalLines;
+        chunk.firstSlot = static_cast<qsizetype>(totalLines);
+        totalLines += chunk.lines;
+    }
+    points.resize(static_cast<qsizetype>(totalLines));
+
+    // Pass 2: parse every chunk straight into its range of the columns
+    Parallel::run(taskCount, [&](int i) {
+        parseChunk(chunks[i], points);
+    });
+
+    // Merge the chunk-local area tables and remap the indices in parallel
+    QVector<QVector<quint16>> remaps(taskCount);
+    for (int i = 0; i < taskCount; i++) {
+        for (int areaNumber : chunks[i].areaNumbers) {
+            remaps[i].append(points.areaSlot(areaNumber));
+        }
+    }
+    Parallel::run(taskCount, [&](int i) {
+        const QVector<quint16> &remap = remaps[i];
+        points.forEachWritableRun(chunks[i].firstSlot, chunks[i].firstSlot + chunks[i].parsed,
+                                  [&](qsizetype, qsizetype length, qint16 *, qint16 *, quint16 *indices) {
+            for (qsizetype j = 0; j < length; j++) {
+                indices[j] = remap[indices[j]];
+            }
+        });
+    });
+
+    // Close the gaps left by empty or malformed lines
+    qsizetype count = 0;
+    for (const Chunk &chunk : chunks) {
+        if (count != chunk.firstSlot && chunk.parsed > 0) {
+            // The points only move down, so copying runs in order never
+            // overwrites a point before it is moved
+            points.forEachWritableRun(count, count + chunk.parsed, [&](qsizetype to, qsizetype length, qint16 *xs,
+                                                                       qint16 *ys, quint16 *areaIndices) {
+                const qsizetype from = chunk.firstSlot + (to - count);
+                points.forEachRun(from, from + length, [&](qsizetype source, qsizetype n, const qint16 *sourceXs,
+                                                           const qint16 *sourceYs, const quint16 *sourceIndices) {
+                    const qsizetype at = source - from;
+                    std::memmove(xs + at, sourceXs, n * sizeof(qint16));
+                    std::memmove(ys + at, sourceYs, n * sizeof(qint16));
+                    std::memmove(areaIndices + at, sourceIndices, n * sizeof(quint16));
+                });
+            });
+        }
+        count += chunk.parsed;
+    }
+    points.resize(count);
+
+    if (report) {
+        *report = CsvParseReport();
+        for (const Chunk &chunk : chunks) {
+            report->lineCount += chunk.dataLines;
+            report->malformedCount += chunk.malformedCount;
+            for (const CsvMalformedLine &line : chunk.malformedLines) {
+                if (report->malformedLines.size() < MaxReportedLines) {
+                    report->malformedLines.append(line);
+                }
+            }
+        }
+    }
+}
+
+} // namespace CsvPointParser
@@ -0,0 +1,44 @@
+#ifndef CSVPOINTPARSER_H
+#define CSVPOINTPARSER_H
+
+#include <QByteArray>
+#include <QVector>
+#include "pointstore.h"
+
+// A line of a points CSV file that could not be parsed
+struct CsvMalformedLine {
+    qint64 lineNumber;  // 1-based line number in the file
+    QByteArray text;
+};
+
+// Summary of a CSV parse
+struct CsvParseReport {
+    qint64 lineCount = 0;         // Data lines seen (excluding header and empty lines)
+    qint64 malformedCount = 0;    // Lines rejected as malformed
+    QVector<CsvMalformedLine> malformedLines;  // The first MaxReportedLines of them
+};
+
+// Parser for "x;y;AreaNumber" point files working directly on raw bytes.
+// The input is split into newline-aligned chunks that are parsed in parallel
+// with std::from_chars: a first pass counts the lines of each chunk, then
+// every chunk parses its lines straight into its own range of the point
+// columns, so no per-line strings are ever allocated.
+namespace CsvPointParser {
+
+const int MaxReportedLines = 100;
+
+// Parse size bytes at data into points (which is cleared first). A leading
+// UTF-8 BOM and a non-numeric header line are skipped; empty lines are
+// ignored; lines with missing, non-numeric or out-of-range fields are
+// skipped and reported.
+void parse(const char *data, qint64 size, PointStore &points, CsvParseReport *report = nullptr);
+
+// Parse a newline-aligned slice of a larger file whose first line is line
+// firstLine of the file, for readers that parse a file piecewise. Nothing is
+// skipped as a header and reported line numbers are those of the file.
+void parseSlice(const char *data, qint64 size, qint64 firstLine, PointStore &points,
+                CsvParseReport *report = nullptr);
+
+} // namespace CsvPointParser
+
+#endif // CSVPOINTPARSER_H
@@ -0,0 +1,82 @@
+#include "datasethistory.h"
+#include <QSet>
+#include "trace.h"
+
+void DatasetHistory::capture(const QString &label, const PointStore &points, const QVector<AreaDefinition> &areas)
+{
+    TraceSpan span("DatasetHistory::capture");
+
+    Version version;
+    version.label = label;
+    version.points = points;
+    version.areas = areas;
+
+    versions.resize(current + 1);
+    versions.append(version);
+    current = versions.size() - 1;
+    if (versions.size() > limit) {
+        const int dropped = versions.size() - limit;
+        versions.remove(0, dropped);
+        current -= dropped;
+    }
+}
+
+void DatasetHistory::clear()
+{
+    versions.clear();
+    current = -1;
+}
+
+void DatasetHistory::setLimit(int versionCount)
+{
+    limit = qMax(1, versionCount);
+    if (versions.size() > limit) {
+        const int dropped = versions.size() - limit;
+        versions.remove(0, dropped);
+        current = qMax(0, current - dropped);
+    }
+}
+
+int DatasetHistory::undo()
+{
+    if (canUndo()) {
+        current--;
+    }
+    return current;
+}
+
+int DatasetHistory::redo()
+{
+    if (canRedo()) {
+        current++;
+    }
+    return current;
+}
+
+PointStore DatasetHistory::points(int index) const
+{
+    if (index < 0 || index >= versions.size()) {
+        return PointStore();
+    }
+    return versions[index].points;
+}
+
+qint64 DatasetHistory::memoryBytes(const PointStore &live) const
+{
+    // Chunks are told apart by their x column, which no two chunks share
+    QSet<const void *> counted;
+    for (int chunk = 0; chunk < live.chunkCount(); chunk++) {
+        counted.insert(live.xData(chunk));
+    }
+    qint64 bytes = 0;
+    for (const Version &version : versions) {
+        const PointStore &points = version.points;
+        for (int chunk = 0; chunk < points.chunkCount(); chunk++) {
+            if (!counted.contains(points.xData(chunk))) {
+                counted.insert(points.xData(chunk));
+                bytes += points.chunkMemoryBytes(chunk);
+            }
+        }
+    }
+    return bytes;
+}
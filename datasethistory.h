@@ -0,0 +1,58 @@
+#ifndef DATASETHISTORY_H
+#define DATASETHISTORY_H
+
+#include <QString>
+#include <QVector>
+#include "areadefinition.h"
+#include "pointstore.h"
+
+// Versions of the dataset (the points and the area definitions) for undo,
+// redo and comparison. A version keeps a copy of the point store, which
+// shares the store's chunks, so taking a version costs a reference count
+// per chunk. Later writes to the live store copy only the chunks they touch:
+// after points were appended, a version and the live store share every
+// chunk but the one that was last when the version was taken, and
+// restoring a version shares its chunks again.
+class DatasetHistory
+{
+public:
+    struct Version {
+        QString label;
+        PointStore points;
+        QVector<AreaDefinition> areas;
+    };
+
+    // Versions kept by default; the oldest are dropped beyond it
+    static const int DefaultLimit = 32;
+
+    // Record the dataset as the version after the current one and make it
+    // current. Versions that could have been redone are dropped.
+    void capture(const QString &label, const PointStore &points, const QVector<AreaDefinition> &areas);
+    void clear();
+    void setLimit(int versions);
+
+    int count() const { return versions.size(); }
+    int currentIndex() const { return current; }
+    const Version &at(int index) const { return versions[index]; }
+
+    bool canUndo() const { return current > 0; }
+    bool canRedo() const { return current + 1 < versions.size(); }
+
+    // Make the previous / next version current and return its index
+    int undo();
+    int redo();
+
+    // Points of a version, sharing its chunks
+    PointStore points(int index) const;
+
+    // Heap memory of the points of all versions, counting shared chunks
+    // once and leaving out chunks still shared with the live store
+    qint64 memoryBytes(const PointStore &live) const;
+
+private:
+    QVector<Version> versions;
+    int current = -1;
+    int limit = DefaultLimit;
+};
+
+#endif // DATASETHISTORY_H
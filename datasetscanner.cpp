@@ -0,0 +1,135 @@
+#include "datasetscanner.h"
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include "bucketedpointfile.h"
+#include "parallel.h"
+#include "trace.h"
+
+DatasetScanner::DatasetScanner(QObject *parent)
+    : QThread(parent)
+    , cancelled(false)
+    , success(false)
+    , pointCount(0)
+    , outsideCount(0)
+    , milliseconds(0)
+{
+}
+
+void DatasetScanner::setSource(const QString &sourcePath)
+{
+    this->sourcePath = sourcePath;
+}
+
+void DatasetScanner::setAreas(const QVector<AreaDefinition> &areas, const OutsideTest &isOutside)
+{
+    this->areas = areas;
+    this->isOutside = isOutside;
+}
+
+void DatasetScanner::cancel()
+{
+    cancelled = true;
+}
+
+QString DatasetScanner::bucketedPathFor(const QString &sourcePath)
+{
+    if (BucketedPointFile::isBucketedFile(sourcePath)) {
+        return sourcePath;
+    }
+    return sourcePath + ".buckets";
+}
+
+void DatasetScanner::run()
+{
+    TraceSpan span("DatasetScanner::run");
+
+    QElapsedTimer timer;
+    timer.start();
+
+    cancelled = false;
+    success = false;
+    errorMessage.clear();
+    statistics.clear();
+    pointCount = 0;
+    outsideCount = 0;
+
+    // Convert the points file unless a bucketed copy newer than it exists
+    bucketedPath = bucketedPathFor(sourcePath);
+    if (bucketedPath != sourcePath) {
+        QFileInfo source(sourcePath);
+        QFileInfo bucketed(bucketedPath);
+        if (!bucketed.exists() || bucketed.lastModified() < source.lastModified()
+            || !BucketedPointFile::isBucketedFile(bucketedPath)) {
+            if (!BucketedPointFile::build(sourcePath, bucketedPath, BucketedPointFile::DefaultGridSize,
+                                          &errorMessage)) {
+                return;
+            }
+        }
+    }
+
+    BucketedPointFile file;
+    if (!file.open(bucketedPath, &errorMessage)) {
+        return;
+    }
+    pointCount = file.getPointCount();
+
+    // Area index of the file -> index of its definition (-1 if none)
+    const QVector<int> &areaNumbers = file.getAreaNumbers();
+    QVector<int> definitionForSlot(areaNumbers.size(), -1);
+    for (int slot = 0; slot < areaNumbers.size(); slot++) {
+        for (int i = 0; i < areas.size(); i++) {
+            if (areas[i].areaNumber == areaNumbers[slot]) {
+                definitionForSlot[slot] = i;
+                break;
+            }
+        }
+    }
+
+    // Per-thread accumulators, merged after the pass
+    const int tasks = Parallel::threadCount();
+    const int areaCount = areas.size();
+    QVector<QVector<AreaStatistics>> taskStatistics(tasks, QVector<AreaStatistics>(areaCount));
+    QVector<qint64> taskOutside(tasks, 0);
+    QVector<AreaStatistics> *statisticsData = taskStatistics.data();
+    qint64 *outsideData = taskOutside.data();
+    const int *definitions = definitionForSlot.constData();
+    const AreaDefinition *areaData = areas.constData();
+
+    bool ok = file.scan([&](int task, const qint16 *xs, const qint16 *ys, const quint16 *areaIndices, qsizetype count) {
+        AreaStatistics *stats = statisticsData[task].data();
+        qint64 outside = 0;
+        for (qsizetype i = 0; i < count; i++) {
+            const int definition = definitions[areaIndices[i]];
+            if (definition < 0) {
+                continue;
+            }
+            const AreaDefinition &area = areaData[definition];
+            if (xs[i] >= LogicalMin && xs[i] <= LogicalMax && ys[i] >= LogicalMin && ys[i] <= LogicalMax) {
+                stats[definition].add(xs[i], ys[i]);
+            }
+            if (isOutside({xs[i], ys[i], area.areaNumber}, area)) {
+                outside++;
+            }
+        }
+        outsideData[task] += outside;
+    }, &cancelled, &errorMessage);
+    if (!ok) {
+        return;
+    }
+
+    for (int areaIndex = 0; areaIndex < areaCount; areaIndex++) {
+        AreaStatistics merged;
+        for (int task = 0; task < tasks; task++) {
+            merged.merge(taskStatistics[task][areaIndex]);
+        }
+        if (merged.getCount() > 0) {
+            statistics.insert(areas[areaIndex].areaNumber, merged);
+        }
+    }
+    for (qint64 outside : taskOutside) {
+        outsideCount += outside;
+    }
+
+    milliseconds = timer.elapsed();
+    success = true;
+}
@@ -0,0 +1,65 @@
+#ifndef DATASETSCANNER_H
+#define DATASETSCANNER_H
+
+#include <QThread>
+#include <QHash>
+#include <QVector>
+#include <atomic>
+#include <functional>
+#include "areadefinition.h"
+#include "areastatistics.h"
+#include "pointstore.h"
+
+// Prepares an out-of-core dataset on a worker thread.
+// A binary points file is first converted into a BucketedPointFile next to
+// it (unless an up-to-date one exists); then one streaming pass over the
+// bucketed file computes the per-area statistics and the number of points
+// outside their area. Memory use is a few windows of the file, independent
+// of the dataset size. Results are read with the getters once the thread
+// has finished.
+class DatasetScanner : public QThread
+{
+    Q_OBJECT
+
+public:
+    // Test used for outlier counts; must be safe to call from worker threads
+    using OutsideTest = std::function<bool(const PointDataSave &point, const AreaDefinition &area)>;
+
+    explicit DatasetScanner(QObject *parent = nullptr);
+
+    void setSource(const QString &sourcePath);
+    void setAreas(const QVector<AreaDefinition> &areas, const OutsideTest &isOutside);
+    void cancel();
+
+    // Bucketed file for a points file (the file itself if it already is one)
+    static QString bucketedPathFor(const QString &sourcePath);
+
+    bool succeeded() const { return success; }
+    QString getErrorMessage() const { return errorMessage; }
+    QString getBucketedPath() const { return bucketedPath; }
+    qint64 getPointCount() const { return pointCount; }
+    qint64 getOutsideCount() const { return outsideCount; }
+    qint64 getMilliseconds() const { return milliseconds; }
+
+    // Keyed by area number, as Controller::getAreaStatistics()
+    const QHash<int, AreaStatistics> &getStatistics() const { return statistics; }
+
+protected:
+    void run() override;
+
+private:
+    QString sourcePath;
+    QString bucketedPath;
+    QVector<AreaDefinition> areas;
+    OutsideTest isOutside;
+    std::atomic<bool> cancelled;
+
+    bool success;
+    QString errorMessage;
+    qint64 pointCount;
+    qint64 outsideCount;
+    qint64 milliseconds;
+    QHash<int, AreaStatistics> statistics;
+};
+
+#endif // DATASETSCANNER_H
@@ -0,0 +1,227 @@
+#include "displaysubset.h"
+#include <algorithm>
+#include "areadefinition.h"
+#include "parallel.h"
+#include "trace.h"
+
+namespace {
+
+const qsizetype MinChunk = 1 << 16;
+
+// Smallest cell table, and the fewest points sampled between two checks of
+// its size
+const qsizetype MinCellCapacity = 1 << 16;
+const qsizetype MinRound = 1 << 16;
+
+// Cells per side and per area of the logical plane
+const int Side = (LogicalMax - LogicalMin) / DisplaySubset::CellSize + 1;
+const qsizetype CellsPerArea = qsizetype(Side) * Side;
+
+inline quint64 mix(quint64 z)
+{
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Random priority of a point (splitmix64 of its index)
+inline quint32 priority(quint64 index)
+{
+    return static_cast<quint32>(mix(index + 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+inline int cellCoordinate(int value)
+{
+    return (qBound(LogicalMin, value, LogicalMax) - LogicalMin) / DisplaySubset::CellSize;
+}
+
+} // namespace
+
+void DisplaySubset::reset()
+{
+    cells.reset();
+    cellCapacity = 0;
+    cellCount = 0;
+    representatives.clear();
+    sampled = 0;
+}
+
+// Grow the table so count occupied cells fill at most half of it
+void DisplaySubset::reserveCells(qsizetype count)
+{
+    if (2 * count <= cellCapacity) {
+        return;
+    }
+    qsizetype capacity = MinCellCapacity;
+    while (capacity < 2 * count) {
+        capacity *= 2;
+    }
+
+    // Cells are unique, so moving them needs no comparison of keys
+    std::unique_ptr<Cell[]> grown(new Cell[capacity]());
+    const quint64 mask = quint64(capacity) - 1;
+    for (qsizetype c = 0; c < cellCapacity; c++) {
+        const quint64 id = cells[c].id.load(std::memory_order_relaxed);
+        if (id == 0) {
+            continue;
+        }
+        quint64 slot = mix(id) & mask;
+        while (grown[slot].id.load(std::memory_order_relaxed) != 0) {
+            slot = (slot + 1) & mask;
+        }
+        grown[slot].id.store(id, std::memory_order_relaxed);
+        grown[slot].key.store(cells[c].key.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    cells = std::move(grown);
+    cellCapacity = capacity;
+}
+
+// Offer points [begin, end) to their cells; a cell keeps the largest
+// inverted key, which is the smallest priority. Points go in rounds of at
+// most as many as are occupied, so every round fits a table that was at
+// most half full after the last one.
+void DisplaySubset::sample(const PointStore &points, qsizetype begin, qsizetype end)
+{
+    for (qsizetype roundBegin = begin; roundBegin < end; ) {
+        const qsizetype roundEnd = roundBegin + qMin(end - roundBegin, qMax(MinRound, cellCount));
+        reserveCells(cellCount + (roundEnd - roundBegin));
+
+        Cell *cellData = cells.get();
+        const quint64 mask = quint64(cellCapacity) - 1;
+        QVector<qsizetype> claimed(Parallel::rangeCount(roundEnd - roundBegin, MinChunk), 0);
+        qsizetype *claimedData = claimed.data();
+        Parallel::forRange(roundEnd - roundBegin, MinChunk, [=, &points](int task, qsizetype first, qsizetype last) {
+            qsizetype claims = 0;
+            points.forEachRun(roundBegin + first, roundBegin + last, [&](qsizetype runBegin, qsizetype length,
+                                                                         const qint16 *xs, const qint16 *ys,
+                                                                         const quint16 *areaIndices) {
+                for (qsizetype k = 0; k < length; k++) {
+                    const qsizetype i = runBegin + k;
+                    const quint64 id = areaIndices[k] * quint64(CellsPerArea)
+                                       + quint64(cellCoordinate(ys[k])) * Side + cellCoordinate(xs[k]) + 1;
+                    const quint64 key = ~((quint64(priority(i)) << 32) | static_cast<quint32>(i));
+
+                    // Find the cell's entry or claim a free one
+                    quint64 slot = mix(id) & mask;
+                    for (;;) {
+                        quint64 current = cellData[slot].id.load(std::memory_order_relaxed);
+                        if (current == 0 && cellData[slot].id.compare_exchange_strong(current, id,
+                                                                                      std::memory_order_relaxed)) {
+                            claims++;
+                            break;
+                        }
+                        if (current == id) {
+                            break;
+                        }
+                        slot = (slot + 1) & mask;
+                    }
+
+                    quint64 kept = cellData[slot].key.load(std::memory_order_relaxed);
+                    while (key > kept
+                           && !cellData[slot].key.compare_exchange_weak(kept, key, std::memory_order_relaxed)) {
+                    }
+                }
+            });
+            claimedData[task] = claims;
+        });
+        for (qsizetype claims : claimed) {
+            cellCount += claims;
+        }
+        roundBegin = roundEnd;
+    }
+}
+
+void DisplaySubset::collectRepresentatives()
+{
+    representatives.clear();
+    representatives.reserve(cellCount);
+    for (qsizetype c = 0; c < cellCapacity; c++) {
+        if (cells[c].id.load(std::memory_order_relaxed) != 0) {
+            representatives.append(static_cast<quint32>(~cells[c].key.load(std::memory_order_relaxed)));
+        }
+    }
+    std::sort(representatives.begin(), representatives.end());
+}
+
+void DisplaySubset::update(const PointStore &points, const QVector<quint8> *outside)
+{
+    TraceSpan span("DisplaySubset::update");
+
+    Q_ASSERT(points.size() <= PointStore::MaxIndexedPoints);
+
+    // Points the cells have already seen stay valid while the store only
+    // grows; anything else starts over
+    if (source != &points || sourceBaseVersion != points.baseVersion() || sampled > points.size()) {
+        source = &points;
+        sourceBaseVersion = points.baseVersion();
+        reset();
+    }
+    if (sampled < points.size()) {
+        sample(points, sampled, points.size());
+        sampled = points.size();
+        collectRepresentatives();
+    }
+
+    // Outside points in store order, collected per range and concatenated
+    QVector<quint32> outsidePoints;
+    hasOutside = outside && outside->size() == points.size();
+    if (hasOutside) {
+        const quint8 *flags = outside->constData();
+        const qsizetype count = points.size();
+        QVector<QVector<quint32>> found(Parallel::rangeCount(count, MinChunk));
+        Parallel::forRange(count, MinChunk, [&found, flags](int task, qsizetype begin, qsizetype end) {
+            QVector<quint32> &indices = found[task];
+            for (qsizetype i = begin; i < end; i++) {
+                if (flags[i]) {
+                    indices.append(static_cast<quint32>(i));
+                }
+            }
+        });
+        for (const QVector<quint32> &indices : found) {
+            outsidePoints += indices;
+        }
+    }
+
+    QVector<quint32> indices(representatives.size() + outsidePoints.size());
+    indices.resize(std::set_union(representatives.constBegin(), representatives.constEnd(),
+                                  outsidePoints.constBegin(), outsidePoints.constEnd(), indices.begin())
+                   - indices.begin());
+
+    subset.clear();
+    subset.setAreaNumbers(points.getAreaNumbers());
+    subset.resize(indices.size());
+    subsetOutside.resize(hasOutside ? indices.size() : 0);
+    const quint8 *flags = hasOutside ? outside->constData() : nullptr;
+    const quint32 *indexData = indices.constData();
+    quint8 *subsetFlags = subsetOutside.data();
+    Parallel::forRange(indices.size(), MinChunk, [=, &points](int, qsizetype begin, qsizetype end) {
+        subset.forEachWritableRun(begin, end, [&](qsizetype first, qsizetype length, qint16 *subsetXs,
+                                                  qint16 *subsetYs, quint16 *subsetAreas) {
+            for (qsizetype k = 0; k < length; k++) {
+                const quint32 i = indexData[first + k];
+                subsetXs[k] = static_cast<qint16>(points.x(i));
+                subsetYs[k] = static_cast<qint16>(points.y(i));
+                subsetAreas[k] = points.areaIndex(i);
+                if (flags) {
+                    subsetFlags[first + k] = flags[i];
+                }
+            }
+        });
+    });
+}
+
+void DisplaySubset::clear()
+{
+    reset();
+    source = nullptr;
+    sourceBaseVersion = 0;
+    subset.clear();
+    subsetOutside.clear();
+    hasOutside = false;
+}
+
+qint64 DisplaySubset::memoryBytes() const
+{
+    return cellCapacity * qint64(sizeof(Cell)) + representatives.capacity() * qint64(sizeof(quint32))
+           + subset.memoryBytes() + subsetOutside.capacity();
+}
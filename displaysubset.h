@@ -0,0 +1,76 @@
+#ifndef DISPLAYSUBSET_H
+#define DISPLAYSUBSET_H
+
+#include <QVector>
+#include <atomic>
+#include <memory>
+#include "pointstore.h"
+
+// Decimated copy of a large point store for drawing. The points of each area
+// are binned into cells of the logical plane and every (area, cell) keeps one
+// point, so the subset is bounded by the number of cells instead of growing
+// with the store; every point flagged as outside is kept besides, so rare
+// outliers are never decimated away. The point of a cell is the one with the
+// smallest random priority, which is a uniform reservoir sample that does not
+// depend on the order the points are seen in: points are sampled in
+// parallel, and points appended to the store are merged in on the next
+// update without revisiting the others. Only the (area, cell) pairs that
+// hold points take memory, in a hash table, so many areas with few points
+// each cost no more than a few areas with many.
+// Points are kept by 32-bit index; update() takes stores of at most
+// PointStore::MaxIndexedPoints points.
+class DisplaySubset
+{
+public:
+    // Stores with fewer points are drawn whole
+    static const qsizetype MinPoints = qsizetype(1) << 21;
+    // Side of a cell in logical units; one unit is about a pixel at the
+    // default view and keeps every occupied pixel of an area lit
+    static const int CellSize = 1;
+
+    // Bring the subset up to date with the store and its outside flags (one
+    // per point, or null when no points are marked)
+    void update(const PointStore &points, const QVector<quint8> *outside);
+    void clear();
+
+    // The subset shares the area table of the store it was built from
+    const PointStore &getPoints() const { return subset; }
+    // Outside flags of the subset points, or null when none were given
+    const QVector<quint8> *getOutsideFlags() const { return hasOutside ? &subsetOutside : nullptr; }
+
+    // Points of the store sampled so far
+    qsizetype sampledCount() const { return sampled; }
+
+    // Heap memory of the cells and the subset
+    qint64 memoryBytes() const;
+
+private:
+    // Entry of the open-addressing table of the occupied cells: the cell's
+    // area slot and position plus one (0 is a free entry) and the inverted
+    // (priority, point index) key of the point it keeps
+    struct Cell {
+        std::atomic<quint64> id;
+        std::atomic<quint64> key;
+    };
+
+    void reset();
+    void reserveCells(qsizetype count);
+    void sample(const PointStore &points, qsizetype begin, qsizetype end);
+    void collectRepresentatives();
+
+    std::unique_ptr<Cell[]> cells;
+    qsizetype cellCapacity = 0;   // A power of two
+    qsizetype cellCount = 0;      // Occupied entries
+    // Indices of the kept points in store order
+    QVector<quint32> representatives;
+
+    const PointStore *source = nullptr;
+    quint64 sourceBaseVersion = 0;
+    qsizetype sampled = 0;
+
+    PointStore subset;
+    QVector<quint8> subsetOutside;
+    bool hasOutside = false;
+};
+
+#endif // DISPLAYSUBSET_H
@@ -1,9 +1,43 @@
 #include "drawingarea.h"
 #include <QResizeEvent>
+#include <QWheelEvent>
+#include <QMouseEvent>
+#include <QRandomGenerator>
+#include <QtMath>
+#include <algorithm>
+#include <numeric>
+#include "perfcounters.h"
+#include "trace.h"
+
+namespace {
+
+// Time each frame may spend drawing points
+const qint64 DefaultPaintBudget = 8 * 1000 * 1000;
+
+// Consecutive points per stratum of the refinement order; the first pass
+// draws one point in StratumSize
+const int StratumSize = 64;
+
+} // namespace
 
 DrawingArea::DrawingArea(QWidget *parent)
     : QWidget(parent)
+    , points(nullptr)
+    , outsideFlags(nullptr)
+    , pointsVersion(0)
+    , pointLayerValid(false)
+    , refinePosition(0)
+    , stratumOrder(StratumSize)
+    , paintBudget(DefaultPaintBudget)
     , symbolSize(10)  // Default symbol size
+    , viewport(LogicalMin, LogicalMin, LogicalMax - LogicalMin, LogicalMax - LogicalMin)
+    , dragging(false)
+    , overlayVisible(false)
+    , lastPaintNanoseconds(0)
+    , drawnPoints(0)
+    , culledPoints(0)
+    , framesInWindow(0)
+    , framesPerSecond(0.0)
 {
     // Set background to white
     setAutoFillBackground(true);
@@ -13,188 +47,434 @@ DrawingArea::DrawingArea(QWidget *parent)
     
     // Set minimum size
     setMinimumSize(400, 400);
+    
+    // The overlay refreshes the engine counters twice a second while shown
+    overlayTimer.setInterval(500);
+    connect(&overlayTimer, &QTimer::timeout, this, QOverload<>::of(&QWidget::update));
+    frameWindow.start();
+    
+    // Refinement frames are queued behind pending input events
+    refineTimer.setSingleShot(true);
+    refineTimer.setInterval(0);
+    connect(&refineTimer, &QTimer::timeout, this, QOverload<>::of(&QWidget::update));
+    
+    // Same order for every refinement, so the coarse picture does not
+    // change between restarts
+    std::iota(stratumOrder.begin(), stratumOrder.end(), 0);
+    QRandomGenerator rng(StratumSize);
+    std::shuffle(stratumOrder.begin(), stratumOrder.end(), rng);
 }
 
 void DrawingArea::clearCanvas()
 {
     clearPoints();
-    clearAreaCircles();
+    clearAreaEllipses();
     update();
 }
 
 void DrawingArea::clearPoints()
 {
-    points.clear();
+    setPoints(nullptr, QVector<QColor>(), QVector<SymbolType>());
+}
+
+void DrawingArea::clearAreaEllipses()
+{
+    areaEllipses.clear();
     update();
 }
 
-void DrawingArea::clearAreaCircles()
+void DrawingArea::setPoints(const PointStore *points, const QVector<QColor> &colors,
+                            const QVector<SymbolType> &symbols, const QVector<quint8> *outside)
 {
-    areaCircles.clear();
+    this->points = points;
+    pointColors = colors;
+    pointSymbols = symbols;
+    outsideFlags = outside;
+    pointsVersion++;
+    pointLayerValid = false;
     update();
 }
 
-void DrawingArea::addPoint(int logicalX, int logicalY, const QColor &color, SymbolType symbol)
+quint64 DrawingArea::getPointsVersion() const
 {
-    PointData point;
-    point.logicalPos = QPoint(logicalX, logicalY);
-    point.color = color;
-    point.symbolType = symbol;
-    point.hasCircle = false;
+    return pointsVersion;
+}
+
+void DrawingArea::addAreaEllipse(const QPointF &center, double radiusX, double radiusY, double rotation,
+                                 const QColor &color)
+{
+    AreaEllipse ellipse;
+    ellipse.center = center;
+    ellipse.radiusX = radiusX;
+    ellipse.radiusY = radiusY;
+    ellipse.rotation = rotation;
+    ellipse.color = color;
     
-    points.append(point);
+    areaEllipses.append(ellipse);
     update();
 }
 
-void DrawingArea::addPointWithCircle(int logicalX, int logicalY, const QColor &pointColor, 
-                                   SymbolType symbol, const QColor &circleColor)
+void DrawingArea::setAreaEllipse(int index, const QPointF &center, double radiusX, double radiusY,
+                                 double rotation, const QColor &color)
 {
-    PointData point;
-    point.logicalPos = QPoint(logicalX, logicalY);
-    point.color = pointColor;
-    point.symbolType = symbol;
-    point.hasCircle = true;
-    point.circleColor = circleColor;
+    if (index < 0 || index >= areaEllipses.size()) {
+        return;
+    }
     
-    points.append(point);
+    AreaEllipse &ellipse = areaEllipses[index];
+    ellipse.center = center;
+    ellipse.radiusX = radiusX;
+    ellipse.radiusY = radiusY;
+    ellipse.rotation = rotation;
+    ellipse.color = color;
     update();
 }
 
-void DrawingArea::addAreaCircle(int logicalX, int logicalY, int radius, const QColor &color)
+void DrawingArea::removeAreaEllipse(int index)
 {
-    AreaCircle circle;
-    circle.center = QPoint(logicalX, logicalY);
-    circle.radius = radius;
-    circle.color = color;
-    
-    areaCircles.append(circle);
+    if (index >= 0 && index < areaEllipses.size()) {
+        areaEllipses.removeAt(index);
+        update();
+    }
+}
+
+CanvasRenderer DrawingArea::renderer() const
+{
+    return CanvasRenderer(viewport, size(), symbolSize);
+}
+
+QPointF DrawingArea::widgetToLogicalF(const QPointF &widgetPos) const
+{
+    return renderer().toLogical(widgetPos);
+}
+
+CanvasScene DrawingArea::getScene() const
+{
+    CanvasScene scene;
+    scene.viewport = viewport;
+    scene.size = size();
+    scene.symbolSize = symbolSize;
+    scene.ellipses = areaEllipses;
+    if (points) {
+        scene.points = *points;
+        scene.colors = pointColors;
+        scene.symbols = pointSymbols;
+        if (outsideFlags && outsideFlags->size() == points->size()) {
+            scene.outside = *outsideFlags;
+        }
+    }
+    return scene;
+}
+
+QRectF DrawingArea::getViewport() const
+{
+    return viewport;
+}
+
+void DrawingArea::setViewport(const QRectF &rect)
+{
+    if (rect == viewport || rect.width() <= 0 || rect.height() <= 0) {
+        return;
+    }
+    viewport = rect;
+    pointLayerValid = false;
     update();
+    emit viewportChanged(viewport);
 }
 
-QPoint DrawingArea::logicalToWidget(const QPoint &logicalPos) const
+void DrawingArea::resetViewport()
 {
-    // Map from logical coordinates (-300,300) to widget coordinates
-    int centerX = width() / 2;
-    int centerY = height() / 2;
-    
-    double xScale = width() / 600.0;
-    double yScale = height() / 600.0;
-    
-    int widgetX = centerX + static_cast<int>(logicalPos.x() * xScale);
-    int widgetY = centerY - static_cast<int>(logicalPos.y() * yScale);  // Flip Y as Qt's Y is top-down
-    
-    return QPoint(widgetX, widgetY);
+    setViewport(QRectF(LogicalMin, LogicalMin, LogicalMax - LogicalMin, LogicalMax - LogicalMin));
 }
 
-QPoint DrawingArea::widgetToLogical(const QPoint &widgetPos) const
+void DrawingArea::wheelEvent(QWheelEvent *event)
 {
-    // Map from widget coordinates to logical coordinates (-300,300)
-    int centerX = width() / 2;
-    int centerY = height() / 2;
+    const int delta = event->angleDelta().y();
+    if (delta == 0) {
+        return;
+    }
     
-    double xScale = width() / 600.0;
-    double yScale = height() / 600.0;
+    // Zoom by 1.25x per wheel step, keeping the point under the cursor fixed;
+    // the visible width stays between 8 and 4 times the logical range
+    const double factor = qPow(0.8, delta / 120.0);
+    const double span = LogicalMax - LogicalMin;
+    const double newWidth = qBound(8.0, viewport.width() * factor, 4 * span);
+    const double scale = newWidth / viewport.width();
     
-    int logicalX = static_cast<int>((widgetPos.x() - centerX) / xScale);
-    int logicalY = static_cast<int>((centerY - widgetPos.y()) / yScale);  // Flip Y
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    const QPointF anchor = widgetToLogicalF(event->position());
+#else
+    const QPointF anchor = widgetToLogicalF(event->posF());
+#endif
+    setViewport(QRectF(anchor.x() - (anchor.x() - viewport.left()) * scale,
+                       anchor.y() - (anchor.y() - viewport.top()) * scale,
+                       viewport.width() * scale,
+                       viewport.height() * scale));
+    event->accept();
+}
+
+void DrawingArea::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton) {
+        dragging = true;
+        dragStart = event->pos();
+        dragStartViewport = viewport;
+        setCursor(Qt::ClosedHandCursor);
+    }
+}
+
+void DrawingArea::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!dragging) {
+        return;
+    }
     
-    return QPoint(logicalX, logicalY);
+    // Move the viewport against the drag so the content follows the cursor
+    const QPoint moved = event->pos() - dragStart;
+    const double dx = moved.x() * dragStartViewport.width() / width();
+    const double dy = moved.y() * dragStartViewport.height() / height();
+    setViewport(dragStartViewport.translated(-dx, dy));
 }
 
-int DrawingArea::logicalToWidgetSize(int logicalSize) const
+void DrawingArea::mouseReleaseEvent(QMouseEvent *event)
 {
-    // Convert a logical size to widget pixels
-    double scale = qMin(width(), height()) / 600.0;
-    return static_cast<int>(logicalSize * scale);
+    if (event->button() == Qt::LeftButton && dragging) {
+        dragging = false;
+        unsetCursor();
+    }
+}
+
+void DrawingArea::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    Q_UNUSED(event);
+    resetViewport();
 }
 
 void DrawingArea::paintEvent(QPaintEvent *event)
 {
+    TraceSpan span("DrawingArea::paintEvent");
+    
+    QElapsedTimer paintTimer;
+    paintTimer.start();
+    
     QPainter painter(this);
     painter.setRenderHint(QPainter::Antialiasing);
+    const CanvasRenderer canvas = renderer();
+    canvas.drawAxes(painter);
+    
+    // Draw area ellipses (draw first so they're in the background)
+    for (const AreaEllipse &ellipse : areaEllipses) {
+        canvas.drawAreaEllipse(painter, ellipse);
+    }
     
-    // Draw a grid (optional, for visualization purposes)
-    painter.setPen(QPen(QColor(220, 220, 220), 1));
+    // Draw the next points into the backing image within the budget, then
+    // show all points drawn so far
+    refinePoints();
+    painter.drawImage(QPoint(0, 0), pointLayer);
     
-    // Draw X and Y axes
-    QPoint origin = logicalToWidget(QPoint(0, 0));
-    painter.setPen(QPen(Qt::black, 2));
-    painter.drawLine(0, origin.y(), width(), origin.y());  // X-axis
-    painter.drawLine(origin.x(), 0, origin.x(), height()); // Y-axis
+    lastPaintNanoseconds = paintTimer.nsecsElapsed();
     
-    // Draw area circles (draw first so they're in the background)
-    for (const AreaCircle &circle : areaCircles) {
-        QPoint center = logicalToWidget(circle.center);
-        int radius = logicalToWidgetSize(circle.radius);
-        drawAreaCircle(painter, center, radius, circle.color);
+    // Frames per second over windows of at least one second
+    framesInWindow++;
+    if (frameWindow.elapsed() >= 1000) {
+        framesPerSecond = framesInWindow * 1000.0 / frameWindow.restart();
+        framesInWindow = 0;
     }
     
-    // Draw points and their circles
-    for (const PointData &point : points) {
-        QPoint pos = logicalToWidget(point.logicalPos);
+    // Show the refinement while it goes on and queue its next frame
+    if (isRefining()) {
+        drawRefinementState(painter);
+        refineTimer.start();
+    }
+    
+    if (overlayVisible) {
+        drawOverlay(painter);
+    }
+}
+
+qsizetype DrawingArea::refinementEnd() const
+{
+    const qsizetype count = points ? points->size() : 0;
+    return (count + StratumSize - 1) / StratumSize * StratumSize;
+}
+
+void DrawingArea::refinePoints()
+{
+    TraceSpan span("DrawingArea::refinePoints");
+    
+    // Start over on a clear image after a change
+    const qreal ratio = devicePixelRatioF();
+    const QSize layerSize = size() * ratio;
+    if (!pointLayerValid || pointLayer.size() != layerSize) {
+        if (pointLayer.size() != layerSize) {
+            pointLayer = QImage(layerSize, QImage::Format_ARGB32_Premultiplied);
+            pointLayer.setDevicePixelRatio(ratio);
+        }
+        pointLayer.fill(Qt::transparent);
+        pointLayerValid = true;
+        refinePosition = 0;
+        drawnPoints = 0;
+        culledPoints = 0;
+    }
+    
+    const qsizetype end = refinementEnd();
+    if (refinePosition >= end) {
+        return;
+    }
+    
+    QElapsedTimer budgetTimer;
+    budgetTimer.start();
+    QPainter painter(&pointLayer);
+    painter.setRenderHint(QPainter::Antialiasing);
+    
+    // Points whose symbol or circle cannot reach the widget are skipped
+    const CanvasRenderer canvas = renderer();
+    const int margin = canvas.pointMargin();
+    const QRect visible = rect().adjusted(-margin, -margin, margin, margin);
+    const qsizetype count = points->size();
+    const qsizetype strata = end / StratumSize;
+    const quint8 *outside = outsideFlags && outsideFlags->size() == count ? outsideFlags->constData() : nullptr;
+    qsizetype steps = 0;
+    while (refinePosition < end) {
+        // The clock is read every few points
+        if (paintBudget > 0 && ++steps % 64 == 0 && budgetTimer.nsecsElapsed() >= paintBudget) {
+            break;
+        }
+        
+        // The last stratum may be partial; its missing points are skipped
+        const qsizetype i = (refinePosition % strata) * StratumSize + stratumOrder[refinePosition / strata];
+        refinePosition++;
+        if (i >= count) {
+            continue;
+        }
         
-        // Draw circle around point if needed
-        if (point.hasCircle) {
-            drawPointCircle(painter, pos, point.circleColor);
+        QPoint pos = canvas.toPixel(QPoint(points->x(i), points->y(i)));
+        if (!visible.contains(pos)) {
+            culledPoints++;
+            continue;
         }
+        drawnPoints++;
         
-        // Draw the symbol
-        drawSymbol(painter, pos, point.color, point.symbolType, symbolSize);
+        // Area slots without a style are drawn as black crosses
+        const quint16 slot = points->areaIndex(i);
+        const QColor color = slot < pointColors.size() ? pointColors[slot] : QColor(Qt::black);
+        const SymbolType symbol = slot < pointSymbols.size() ? pointSymbols[slot] : SymbolType::Cross;
+        canvas.drawPoint(painter, pos, color, symbol, outside && outside[i]);
     }
 }
 
-void DrawingArea::resizeEvent(QResizeEvent *event)
+void DrawingArea::setPaintBudget(qint64 nanoseconds)
 {
-    QWidget::resizeEvent(event);
-    
-    // Adjust symbol size based on widget size
-    symbolSize = qMax(5, qMin(width(), height()) / 60);
+    paintBudget = qMax<qint64>(0, nanoseconds);
+    update();
+}
+
+bool DrawingArea::isRefining() const
+{
+    return !pointLayerValid || refinePosition < refinementEnd();
 }
 
-void DrawingArea::drawSymbol(QPainter &painter, const QPoint &pos, const QColor &color, SymbolType type, int size)
+double DrawingArea::getRefinementProgress() const
 {
-    painter.setPen(QPen(color, 2));
+    const qsizetype end = refinementEnd();
+    if (end == 0) {
+        return 1.0;
+    }
+    return pointLayerValid ? static_cast<double>(refinePosition) / end : 0.0;
+}
+
+// Thin bar along the bottom edge with the fraction of the points drawn
+void DrawingArea::drawRefinementState(QPainter &painter)
+{
+    const double progress = getRefinementProgress();
     
-    int halfSize = size / 2;
+    painter.save();
+    painter.setRenderHint(QPainter::Antialiasing, false);
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(QColor(0, 0, 0, 40));
+    painter.drawRect(0, height() - 4, width(), 4);
+    painter.setBrush(QColor(30, 120, 220));
+    painter.drawRect(0, height() - 4, qRound(width() * progress), 4);
     
-    switch (type) {
-        case SymbolType::Cross:
-            painter.drawLine(pos.x() - halfSize, pos.y() - halfSize, 
-                            pos.x() + halfSize, pos.y() + halfSize);
-            painter.drawLine(pos.x() + halfSize, pos.y() - halfSize, 
-                            pos.x() - halfSize, pos.y() + halfSize);
-            break;
-            
-        case SymbolType::Plus:
-            painter.drawLine(pos.x() - halfSize, pos.y(), pos.x() + halfSize, pos.y());
-            painter.drawLine(pos.x(), pos.y() - halfSize, pos.x(), pos.y() + halfSize);
-            break;
-            
-        case SymbolType::Star:
-            painter.drawLine(pos.x() - halfSize, pos.y(), pos.x() + halfSize, pos.y());
-            painter.drawLine(pos.x(), pos.y() - halfSize, pos.x(), pos.y() + halfSize);
-            painter.drawLine(pos.x() - halfSize, pos.y() - halfSize, 
-                            pos.x() + halfSize, pos.y() + halfSize);
-            painter.drawLine(pos.x() + halfSize, pos.y() - halfSize, 
-                            pos.x() - halfSize, pos.y() + halfSize);
-            break;
+    QFont font = painter.font();
+    font.setPointSize(8);
+    painter.setFont(font);
+    painter.setPen(QColor(80, 80, 80));
+    painter.drawText(QRect(0, 0, width() - 6, height() - 8), Qt::AlignRight | Qt::AlignBottom,
+                     tr("Refining %1%").arg(qFloor(progress * 100)));
+    painter.restore();
+}
+
+void DrawingArea::setPerformanceOverlayVisible(bool visible)
+{
+    if (visible == overlayVisible) {
+        return;
+    }
+    overlayVisible = visible;
+    if (visible) {
+        overlayTimer.start();
+    } else {
+        overlayTimer.stop();
     }
+    update();
 }
 
-void DrawingArea::drawPointCircle(QPainter &painter, const QPoint &pos, const QColor &color)
+bool DrawingArea::isPerformanceOverlayVisible() const
 {
-    painter.setPen(QPen(color, 1));
-    painter.setBrush(Qt::NoBrush);
-    int circleSize = symbolSize + 4;  // Just a bit larger than the symbol
-    painter.drawEllipse(pos, circleSize, circleSize);
+    return overlayVisible;
 }
 
-void DrawingArea::drawAreaCircle(QPainter &painter, const QPoint &center, int radius, const QColor &color)
+// Numbers of the previous frame (this one is still being painted) and the
+// counters the engine keeps up to date
+void DrawingArea::drawOverlay(QPainter &painter)
 {
-    QColor fillColor = color;
-    fillColor.setAlpha(40);  // Make the fill semi-transparent
+    const PerfCounters::Snapshot counters = PerfCounters::snapshot();
+    auto duration = [](qint64 milliseconds) {
+        return milliseconds < 0 ? QString("-") : QString("%1 ms").arg(milliseconds);
+    };
     
-    painter.setPen(QPen(color, 2));
-    painter.setBrush(fillColor);
-    painter.drawEllipse(center, radius, radius);
-} 
\ No newline at end of file
+    const QStringList lines = {
+        QString("Paint: %1 ms, %2 fps").arg(lastPaintNanoseconds / 1e6, 0, 'f', 2).arg(framesPerSecond, 0, 'f', 1),
+        QString("Points: %1 drawn, %2 culled, %3% refined")
+            .arg(drawnPoints).arg(culledPoints).arg(getRefinementProgress() * 100.0, 0, 'f', 1),
+        QString("Generation: %1 Mpoints/s (%2 points)")
+            .arg(counters.generationPointsPerSecond() / 1e6, 0, 'f', 2).arg(counters.generatedPoints),
+        QString("Memory: %1 MB points").arg(counters.pointStoreBytes / 1048576.0, 0, 'f', 1),
+        QString("Last load: %1, last save: %2")
+            .arg(duration(counters.lastLoadMilliseconds), duration(counters.lastSaveMilliseconds)),
+    };
+    
+    painter.save();
+    painter.setRenderHint(QPainter::Antialiasing, false);
+    QFont font("Monospace");
+    font.setStyleHint(QFont::TypeWriter);
+    font.setPointSize(9);
+    painter.setFont(font);
+    
+    const QFontMetrics metrics(font);
+    int textWidth = 0;
+    for (const QString &line : lines) {
+        textWidth = qMax(textWidth, metrics.horizontalAdvance(line));
+    }
+    const int padding = 6;
+    const QRect box(8, 8, textWidth + 2 * padding, lines.size() * metrics.height() + 2 * padding);
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(QColor(0, 0, 0, 170));
+    painter.drawRect(box);
+    
+    painter.setPen(Qt::white);
+    int y = box.top() + padding + metrics.ascent();
+    for (const QString &line : lines) {
+        painter.drawText(box.left() + padding, y, line);
+        y += metrics.height();
+    }
+    painter.restore();
+}
+
+void DrawingArea::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    
+    // Adjust symbol size based on widget size
+    symbolSize = CanvasRenderer::defaultSymbolSize(size());
+}
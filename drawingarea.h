@@ -6,30 +6,14 @@
 #include <QPaintEvent>
 #include <QVector>
 #include <QPoint>
+#include <QRectF>
 #include <QColor>
-
-// Symbol types that can be drawn
-enum class SymbolType {
-    Cross,  // X
-    Plus,   // +
-    Star    // *
-};
-
-// Structure to store point data
-struct PointData {
-    QPoint logicalPos;  // Position in logical coordinates (-300 to 300)
-    QColor color;
-    SymbolType symbolType;
-    bool hasCircle;     // Whether to draw a small circle around the point
-    QColor circleColor;
-};
-
-// Structure to store area circle data
-struct AreaCircle {
-    QPoint center;      // Center in logical coordinates
-    int radius;         // Radius in logical units
-    QColor color;
-};
+#include <QImage>
+#include <QElapsedTimer>
+#include <QTimer>
+#include "areadefinition.h"
+#include "canvasrenderer.h"
+#include "pointstore.h"
 
 class DrawingArea : public QWidget
 {
@@ -41,43 +25,124 @@ public:
     // Clear all drawings
     void clearCanvas();
     
-    // Add a point with a symbol
-    void addPoint(int logicalX, int logicalY, const QColor &color, SymbolType symbol);
+    // Show the points of a store owned by the caller, without copying them.
+    // colors and symbols are indexed by the store's area slots; points with
+    // a non-zero outside flag get a circle in their color. The store and the
+    // flags must outlive the view; after changing them the owner calls
+    // setPoints() again, which bumps the view version and repaints.
+    void setPoints(const PointStore *points, const QVector<QColor> &colors,
+                   const QVector<SymbolType> &symbols, const QVector<quint8> *outside = nullptr);
+    
+    // Version of the shown points, their styles and flags
+    quint64 getPointsVersion() const;
     
-    // Add a point with a symbol and a circle around it
-    void addPointWithCircle(int logicalX, int logicalY, const QColor &pointColor, 
-                           SymbolType symbol, const QColor &circleColor);
+    // Add an area ellipse
+    void addAreaEllipse(const QPointF &center, double radiusX, double radiusY, double rotation,
+                        const QColor &color);
     
-    // Add an area circle
-    void addAreaCircle(int logicalX, int logicalY, int radius, const QColor &color);
+    // Replace / remove the area ellipse at index (in the order they were added)
+    void setAreaEllipse(int index, const QPointF &center, double radiusX, double radiusY, double rotation,
+                        const QColor &color);
+    void removeAreaEllipse(int index);
     
-    // Remove all points
+    // Stop showing points
     void clearPoints();
     
-    // Remove all area circles
-    void clearAreaCircles();
+    // Remove all area ellipses
+    void clearAreaEllipses();
+    
+    // Visible part of the logical plane; the wheel zooms around the cursor,
+    // dragging pans and a double click returns to the full logical range
+    QRectF getViewport() const;
+    void setViewport(const QRectF &rect);
+    void resetViewport();
+    
+    // Points are drawn progressively into a backing image: each frame draws
+    // for at most the paint budget, starting with a coarse subset spread
+    // evenly over the points and refining it on the following frames. New
+    // points, a new viewport or a new size restart the refinement. A budget
+    // of 0 draws all points in one frame.
+    void setPaintBudget(qint64 nanoseconds);
+    
+    // Whether the points are still being refined, and the fraction drawn
+    bool isRefining() const;
+    double getRefinementProgress() const;
+    
+    // Overlay with the paint time, frame rate, drawn and culled points and
+    // the engine's counters (generation rate, point memory, load/save time)
+    void setPerformanceOverlayVisible(bool visible);
+    bool isPerformanceOverlayVisible() const;
+    
+    // What the canvas shows, sharing the points, for drawing it elsewhere;
+    // the performance overlay and the refinement state are left out
+    CanvasScene getScene() const;
+
+signals:
+    void viewportChanged(const QRectF &viewport);
 
 protected:
     void paintEvent(QPaintEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
 
 private:
-    // Conversion between logical coordinates and widget coordinates
-    QPoint logicalToWidget(const QPoint &logicalPos) const;
-    QPoint widgetToLogical(const QPoint &widgetPos) const;
-    int logicalToWidgetSize(int logicalSize) const;
+    // Drawing of the content for the current viewport and size, and the
+    // conversion from widget coordinates to logical ones
+    CanvasRenderer renderer() const;
+    QPointF widgetToLogicalF(const QPointF &widgetPos) const;
     
     // Drawing functions
-    void drawSymbol(QPainter &painter, const QPoint &pos, const QColor &color, SymbolType type, int size);
-    void drawPointCircle(QPainter &painter, const QPoint &pos, const QColor &color);
-    void drawAreaCircle(QPainter &painter, const QPoint &center, int radius, const QColor &color);
+    void drawOverlay(QPainter &painter);
+    void drawRefinementState(QPainter &painter);
+    
+    // Progressive drawing: length of the refinement order of the current
+    // points, and drawing the next points of it for at most the budget
+    qsizetype refinementEnd() const;
+    void refinePoints();
     
-    // Data storage
-    QVector<PointData> points;
-    QVector<AreaCircle> areaCircles;
+    // Read-only view of the engine's points: the store, the style of each
+    // area slot and the outside flags (ignored unless one per point)
+    const PointStore *points;
+    QVector<QColor> pointColors;
+    QVector<SymbolType> pointSymbols;
+    const QVector<quint8> *outsideFlags;
+    quint64 pointsVersion;
+    
+    QVector<AreaEllipse> areaEllipses;
+    
+    // Backing image of the points drawn so far (invalid after a change) and
+    // the position in the refinement order: the points are cut into strata
+    // of consecutive points and pass p draws point stratumOrder[p] of every
+    // stratum, so each pass is a random sample spread over all areas
+    QImage pointLayer;
+    bool pointLayerValid;
+    qsizetype refinePosition;
+    QVector<int> stratumOrder;
+    qint64 paintBudget;
+    QTimer refineTimer;
     
     // Drawing properties
     int symbolSize;  // Size of symbols in widget pixels
+    
+    // Visible logical rectangle (y grows upwards) and drag state
+    QRectF viewport;
+    bool dragging;
+    QPoint dragStart;
+    QRectF dragStartViewport;
+    
+    // Performance overlay and the measurements of the last frame
+    bool overlayVisible;
+    QTimer overlayTimer;
+    qint64 lastPaintNanoseconds;
+    qint64 drawnPoints;     // Since the refinement started
+    qint64 culledPoints;
+    QElapsedTimer frameWindow;
+    int framesInWindow;
+    double framesPerSecond;
 };
 
 #endif // DRAWINGAREA_H 
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "gemm.h"
+#include <algorithm>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define GEMM_RESTRICT __restrict__
+#elif defined(_MSC_VER)
+#define GEMM_RESTRICT __restrict
+#else
+#define GEMM_RESTRICT
+#endif
+
+namespace {
+
+// Block sizes chosen so a KC x NC panel of B (64 KB) stays in L2 and a row
+// of it stays in L1 while it is reused across the rows of A
+const int BlockK = 128;
+const int BlockN = 128;
+
+// c[0..n) += alpha * b[0..n)
+inline void axpy(int n, float alpha, const float *GEMM_RESTRICT b, float *GEMM_RESTRICT c)
+{
+    for (int j = 0; j < n; j++) {
+        c[j] += alpha * b[j];
+    }
+}
+
+// Dot product with four independent accumulators so the reduction vectorizes
+inline float dot(int n, const float *GEMM_RESTRICT a, const float *GEMM_RESTRICT b)
+{
+    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    for (; i < n; i++) {
+        s0 += a[i] * b[i];
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+} // namespace
+
+namespace Gemm {
+
+void multiplyNN(int m, int n, int k, const float *a, const float *b, float *c)
+{
+    for (int k0 = 0; k0 < k; k0 += BlockK) {
+        const int kEnd = std::min(k, k0 + BlockK);
+        for (int n0 = 0; n0 < n; n0 += BlockN) {
+            const int width = std::min(n, n0 + BlockN) - n0;
+            for (int i = 0; i < m; i++) {
+                const float *aRow = a + static_cast<long>(i) * k;
+                float *cRow = c + static_cast<long>(i) * n + n0;
+                for (int p = k0; p < kEnd; p++) {
+                    axpy(width, aRow[p], b + static_cast<long>(p) * n + n0, cRow);
+                }
+            }
+        }
+    }
+}
+
+void multiplyTN(int m, int n, int k, const float *a, const float *b, float *c)
+{
+    // Row p of A holds column p of A^T, so walk K in the outer loop and
+    // scatter each row of B into every row of C
+    for (int k0 = 0; k0 < k; k0 += BlockK) {
+        const int kEnd = std::min(k, k0 + BlockK);
+        for (int n0 = 0; n0 < n; n0 += BlockN) {
+            const int width = std::min(n, n0 + BlockN) - n0;
+            for (int p = k0; p < kEnd; p++) {
+                const float *aRow = a + static_cast<long>(p) * m;
+                const float *bRow = b + static_cast<long>(p) * n + n0;
+                for (int i = 0; i < m; i++) {
+                    axpy(width, aRow[i], bRow, c + static_cast<long>(i) * n + n0);
+                }
+            }
+        }
+    }
+}
+
+void multiplyNT(int m, int n, int k, const float *a, const float *b, float *c)
+{
+    for (int k0 = 0; k0 < k; k0 += BlockK) {
+        const int depth = std::min(k, k0 + BlockK) - k0;
+        for (int n0 = 0; n0 < n; n0 += BlockN) {
+            const int nEnd = std::min(n, n0 + BlockN);
+            for (int i = 0; i < m; i++) {
+                const float *aRow = a + static_cast<long>(i) * k + k0;
+                float *cRow = c + static_cast<long>(i) * n;
+                for (int j = n0; j < nEnd; j++) {
+                    cRow[j] += dot(depth, aRow, b + static_cast<long>(j) * k + k0);
+                }
+            }
+        }
+    }
+}
+
+} // namespace Gemm
@@ -0,0 +1,25 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+// Small single-precision matrix kernels used by the neural network.
+// All matrices are dense and row-major; the leading dimension is the number
+// of columns. Each kernel accumulates into C (C += op(A) * op(B)), so callers
+// zero C first when they want a plain product.
+//
+// The loops are cache-blocked over K and N and keep the innermost loop on
+// contiguous memory with no aliasing, which lets the compiler vectorize it.
+
+namespace Gemm {
+
+// C[M x N] += A[M x K] * B[K x N]
+void multiplyNN(int m, int n, int k, const float *a, const float *b, float *c);
+
+// C[M x N] += A[K x M]^T * B[K x N]
+void multiplyTN(int m, int n, int k, const float *a, const float *b, float *c);
+
+// C[M x N] += A[M x K] * B[N x K]^T
+void multiplyNT(int m, int n, int k, const float *a, const float *b, float *c);
+
+} // namespace Gemm
+
+#endif // GEMM_H
@@ -0,0 +1,521 @@
+#include "imageexport.h"
+#include <QFileInfo>
+#include <QImage>
+#include <QObject>
+#include <QRect>
+#include <QSaveFile>
+#include <QtEndian>
+#include <memory>
+#include <zlib.h>
+#include "parallel.h"
+#include "taskscheduler.h"
+#include "trace.h"
+
+namespace {
+
+// Side of the square tiles in pixels; TIFF tiles are a multiple of 16
+const int TileSize = 256;
+
+const qsizetype MinChunk = 1 << 16;
+
+void setError(QString *errorMessage, const QString &message)
+{
+    if (errorMessage) {
+        *errorMessage = message;
+    }
+}
+
+template<typename T>
+void appendLittleEndian(QByteArray &bytes, T value)
+{
+    uchar out[sizeof(T)];
+    qToLittleEndian<T>(value, out);
+    bytes.append(reinterpret_cast<const char *>(out), sizeof(T));
+}
+
+template<typename T>
+void appendBigEndian(QByteArray &bytes, T value)
+{
+    uchar out[sizeof(T)];
+    qToBigEndian<T>(value, out);
+    bytes.append(reinterpret_cast<const char *>(out), sizeof(T));
+}
+
+bool writeBytes(QSaveFile &file, const QByteArray &bytes, QString *errorMessage)
+{
+    if (file.write(bytes) != bytes.size()) {
+        setError(errorMessage, file.errorString());
+        return false;
+    }
+    return true;
+}
+
+// Pixels [0, width) of a row of a tile as RGB bytes
+void copyRgb(const QImage &tile, int row, int width, uchar *out)
+{
+    const QRgb *pixels = reinterpret_cast<const QRgb *>(tile.constScanLine(row));
+    for (int x = 0; x < width; x++) {
+        out[3 * x] = static_cast<uchar>(qRed(pixels[x]));
+        out[3 * x + 1] = static_cast<uchar>(qGreen(pixels[x]));
+        out[3 * x + 2] = static_cast<uchar>(qBlue(pixels[x]));
+    }
+}
+
+// Point indices sorted into the tiles their symbol or circle reaches: the
+// tiles in row-major order, each with its points in store order, so points
+// on a tile border overlap the same way on both sides of it
+struct TileBins {
+    QVector<qsizetype> begin;   // Per tile, plus the end of the last one
+    QVector<quint32> indices;   // See PointStore::MaxIndexedPoints
+};
+
+TileBins binPoints(const CanvasScene &scene, const CanvasRenderer &canvas, const QSize &size,
+                   int tilesX, int tilesY)
+{
+    TraceSpan span("ImageExport::binPoints");
+
+    const qsizetype count = scene.points.size();
+    const int tileCount = tilesX * tilesY;
+    const int margin = canvas.pointMargin();
+    const PointStore &points = scene.points;
+
+    // Tiles a point reaches, false for points off the image
+    auto tilesOf = [=, &canvas, &points](qsizetype i, QRect *tiles) {
+        const QPoint pos = canvas.toPixel(QPoint(points.x(i), points.y(i)));
+        const int left = qMax(0, pos.x() - margin);
+        const int top = qMax(0, pos.y() - margin);
+        const int right = qMin(size.width() - 1, pos.x() + margin);
+        const int bottom = qMin(size.height() - 1, pos.y() + margin);
+        if (left > right || top > bottom) {
+            return false;
+        }
+        *tiles = QRect(QPoint(left / TileSize, top / TileSize), QPoint(right / TileSize, bottom / TileSize));
+        return true;
+    };
+
+    // Count per range and tile, turn the counts into each range's first
+    // slot in every tile, then let each range fill its slots
+    const int ranges = Parallel::rangeCount(count, MinChunk);
+    QVector<qsizetype> slots(qsizetype(ranges) * tileCount, 0);
+    qsizetype *slotData = slots.data();
+    Parallel::forRange(count, MinChunk, [=](int task, qsizetype first, qsizetype last) {
+        qsizetype *rangeSlots = slotData + qsizetype(task) * tileCount;
+        QRect tiles;
+        for (qsizetype i = first; i < last; i++) {
+            if (tilesOf(i, &tiles)) {
+                for (int tileY = tiles.top(); tileY <= tiles.bottom(); tileY++) {
+                    for (int tileX = tiles.left(); tileX <= tiles.right(); tileX++) {
+                        rangeSlots[tileY * tilesX + tileX]++;
+                    }
+                }
+            }
+        }
+    });
+
+    TileBins bins;
+    bins.begin.resize(tileCount + 1);
+    qsizetype total = 0;
+    for (int tile = 0; tile < tileCount; tile++) {
+        bins.begin[tile] = total;
+        for (int task = 0; task < ranges; task++) {
+            const qsizetype rangeCount = slotData[qsizetype(task) * tileCount + tile];
+            slotData[qsizetype(task) * tileCount + tile] = total;
+            total += rangeCount;
+        }
+    }
+    bins.begin[tileCount] = total;
+
+    bins.indices.resize(total);
+    quint32 *indexData = bins.indices.data();
+    Parallel::forRange(count, MinChunk, [=](int task, qsizetype first, qsizetype last) {
+        qsizetype *rangeSlots = slotData + qsizetype(task) * tileCount;
+        QRect tiles;
+        for (qsizetype i = first; i < last; i++) {
+            if (tilesOf(i, &tiles)) {
+                for (int tileY = tiles.top(); tileY <= tiles.bottom(); tileY++) {
+                    for (int tileX = tiles.left(); tileX <= tiles.right(); tileX++) {
+                        indexData[rangeSlots[tileY * tilesX + tileX]++] = static_cast<quint32>(i);
+                    }
+                }
+            }
+        }
+    });
+    return bins;
+}
+
+// Draw one tile of the image, as the canvas would draw that part of it
+void drawTile(QImage &tile, const CanvasScene &scene, const CanvasRenderer &canvas, const TileBins &bins,
+              int tileX, int tileY, int tilesX)
+{
+    tile.fill(Qt::white);
+    QPainter painter(&tile);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.translate(-tileX * TileSize, -tileY * TileSize);
+
+    canvas.drawAxes(painter);
+    for (const AreaEllipse &ellipse : scene.ellipses) {
+        canvas.drawAreaEllipse(painter, ellipse);
+    }
+
+    // Area slots without a style are drawn as black crosses
+    const PointStore &points = scene.points;
+    const quint8 *outside = scene.outside.size() == points.size() ? scene.outside.constData() : nullptr;
+    const int tileIndex = tileY * tilesX + tileX;
+    for (qsizetype k = bins.begin[tileIndex]; k < bins.begin[tileIndex + 1]; k++) {
+        const quint32 i = bins.indices[k];
+        const quint16 slot = points.areaIndex(i);
+        const QColor color = slot < scene.colors.size() ? scene.colors[slot] : QColor(Qt::black);
+        const SymbolType symbol = slot < scene.symbols.size() ? scene.symbols[slot] : SymbolType::Cross;
+        canvas.drawPoint(painter, canvas.toPixel(QPoint(points.x(i), points.y(i))), color, symbol,
+                         outside && outside[i]);
+    }
+}
+
+// Writes an image band by band: addTile() receives the tiles of a band in
+// parallel, writeBand() then writes the band
+class BandEncoder
+{
+public:
+    virtual ~BandEncoder() = default;
+
+    virtual bool begin(QSaveFile &file, QString *errorMessage) = 0;
+
+    // rows of the tile lie inside the image
+    virtual void addTile(int tileX, int rows, const QImage &tile) = 0;
+    virtual bool writeBand(QSaveFile &file, int rows, QString *errorMessage) = 0;
+    virtual bool finish(QSaveFile &file, QString *errorMessage) = 0;
+};
+
+// Tiled RGB TIFF (little-endian) with Deflate compression. Tiles follow
+// the header in row-major order, the directory comes last and the header
+// is patched to point to it.
+class TiffEncoder : public BandEncoder
+{
+public:
+    explicit TiffEncoder(const QSize &size)
+        : size(size)
+        , tilesX((size.width() + TileSize - 1) / TileSize)
+        , bandTiles(tilesX)
+        , bandTileData(bandTiles.data())
+    {
+    }
+
+    bool begin(QSaveFile &file, QString *errorMessage) override
+    {
+        QByteArray header("II");
+        appendLittleEndian<quint16>(header, 42);
+        appendLittleEndian<quint32>(header, 0);  // Directory offset, patched by finish()
+        return writeBytes(file, header, errorMessage);
+    }
+
+    // Every tile is whole; rows below the image are padding
+    void addTile(int tileX, int, const QImage &tile) override
+    {
+        QByteArray pixels(TileSize * TileSize * 3, Qt::Uninitialized);
+        uchar *out = reinterpret_cast<uchar *>(pixels.data());
+        for (int row = 0; row < TileSize; row++) {
+            copyRgb(tile, row, TileSize, out + row * TileSize * 3);
+        }
+        // qCompress() puts the uncompressed size before the zlib stream
+        bandTileData[tileX] = qCompress(pixels, 6).mid(4);
+    }
+
+    bool writeBand(QSaveFile &file, int, QString *errorMessage) override
+    {
+        for (QByteArray &tile : bandTiles) {
+            if (file.pos() + tile.size() > MaxOffset) {
+                setError(errorMessage, QObject::tr("The image is too large for a TIFF file; export it as PNG"));
+                return false;
+            }
+            tileOffsets.append(static_cast<quint32>(file.pos()));
+            tileByteCounts.append(static_cast<quint32>(tile.size()));
+            if (!writeBytes(file, tile, errorMessage)) {
+                return false;
+            }
+            tile.clear();
+        }
+        return true;
+    }
+
+    bool finish(QSaveFile &file, QString *errorMessage) override
+    {
+        // Values that do not fit in a directory entry, word aligned
+        QByteArray values;
+        if (file.pos() % 2 != 0) {
+            values.append('\0');
+        }
+        const qint64 valuesStart = file.pos();
+        const quint32 bitsOffset = static_cast<quint32>(valuesStart + values.size());
+        for (int sample = 0; sample < 3; sample++) {
+            appendLittleEndian<quint16>(values, 8);
+        }
+        const int tileCount = tileOffsets.size();
+        const quint32 offsetsOffset = static_cast<quint32>(valuesStart + values.size());
+        for (quint32 offset : tileOffsets) {
+            appendLittleEndian<quint32>(values, offset);
+        }
+        const quint32 byteCountsOffset = static_cast<quint32>(valuesStart + values.size());
+        for (quint32 byteCount : tileByteCounts) {
+            appendLittleEndian<quint32>(values, byteCount);
+        }
+        const qint64 directoryOffset = valuesStart + values.size();
+        if (directoryOffset + 2 + 11 * 12 + 4 > MaxOffset) {
+            setError(errorMessage, QObject::tr("The image is too large for a TIFF file; export it as PNG"));
+            return false;
+        }
+
+        // Directory entries in ascending tag order; a single tile's offset
+        // and byte count are stored in the entry itself
+        QByteArray directory;
+        auto entry = [&directory](quint16 tag, quint16 type, quint32 count, quint32 value) {
+            appendLittleEndian<quint16>(directory, tag);
+            appendLittleEndian<quint16>(directory, type);
+            appendLittleEndian<quint32>(directory, count);
+            appendLittleEndian<quint32>(directory, value);
+        };
+        const quint16 Short = 3;
+        const quint16 Long = 4;
+        appendLittleEndian<quint16>(directory, 11);
+        entry(256, Long, 1, size.width());                   // ImageWidth
+        entry(257, Long, 1, size.height());                  // ImageLength
+        entry(258, Short, 3, bitsOffset);                    // BitsPerSample
+        entry(259, Short, 1, 8);                             // Compression: Deflate
+        entry(262, Short, 1, 2);                             // PhotometricInterpretation: RGB
+        entry(277, Short, 1, 3);                             // SamplesPerPixel
+        entry(284, Short, 1, 1);                             // PlanarConfiguration: interleaved
+        entry(322, Long, 1, TileSize);                       // TileWidth
+        entry(323, Long, 1, TileSize);                       // TileLength
+        entry(324, Long, tileCount, tileCount == 1 ? tileOffsets.first() : offsetsOffset);  // TileOffsets
+        entry(325, Long, tileCount, tileCount == 1 ? tileByteCounts.first() : byteCountsOffset);  // TileByteCounts
+        appendLittleEndian<quint32>(directory, 0);           // No further directory
+
+        if (!writeBytes(file, values, errorMessage) || !writeBytes(file, directory, errorMessage)) {
+            return false;
+        }
+        QByteArray patch;
+        appendLittleEndian<quint32>(patch, static_cast<quint32>(directoryOffset));
+        if (!file.seek(4)) {
+            setError(errorMessage, file.errorString());
+            return false;
+        }
+        return writeBytes(file, patch, errorMessage);
+    }
+
+private:
+    // Classic TIFF addresses its data with 32-bit offsets
+    static constexpr qint64 MaxOffset = Q_INT64_C(0xFFFFFFFF);
+
+    QSize size;
+    int tilesX;
+    QVector<QByteArray> bandTiles;
+    QByteArray *bandTileData;
+    QVector<quint32> tileOffsets;
+    QVector<quint32> tileByteCounts;
+};
+
+// 8-bit RGB PNG with one zlib stream for the whole image. Each band is
+// deflated into the running stream and flushed to a byte boundary, so it
+// can be written as its own IDAT chunk; every row starts with filter type 0.
+class PngEncoder : public BandEncoder
+{
+public:
+    explicit PngEncoder(const QSize &size)
+        : size(size)
+        , rowBytes(1 + 3 * qsizetype(size.width()))
+        , band(TileSize * rowBytes, '\0')
+        , bandData(reinterpret_cast<uchar *>(band.data()))
+    {
+        stream.zalloc = Z_NULL;
+        stream.zfree = Z_NULL;
+        stream.opaque = Z_NULL;
+        streamReady = deflateInit(&stream, 6) == Z_OK;
+    }
+
+    ~PngEncoder() override
+    {
+        if (streamReady) {
+            deflateEnd(&stream);
+        }
+    }
+
+    bool begin(QSaveFile &file, QString *errorMessage) override
+    {
+        if (!streamReady) {
+            setError(errorMessage, QObject::tr("Could not start the PNG compression"));
+            return false;
+        }
+        QByteArray header("\x89PNG\r\n\x1a\n", 8);
+        QByteArray imageHeader;
+        appendBigEndian<quint32>(imageHeader, size.width());
+        appendBigEndian<quint32>(imageHeader, size.height());
+        imageHeader.append(char(8));  // Bit depth
+        imageHeader.append(char(2));  // Color type: RGB
+        imageHeader.append(char(0));  // Compression
+        imageHeader.append(char(0));  // Filter method
+        imageHeader.append(char(0));  // No interlace
+        appendChunk(header, "IHDR", imageHeader);
+        return writeBytes(file, header, errorMessage);
+    }
+
+    void addTile(int tileX, int rows, const QImage &tile) override
+    {
+        const int columns = qMin(TileSize, size.width() - tileX * TileSize);
+        for (int row = 0; row < rows; row++) {
+            copyRgb(tile, row, columns, bandData + row * rowBytes + 1 + 3 * qsizetype(tileX) * TileSize);
+        }
+    }
+
+    // A band is at most 256 rows of 1 + 3 * 65536 bytes, well within the
+    // 32-bit lengths of zlib and of PNG chunks
+    bool writeBand(QSaveFile &file, int rows, QString *errorMessage) override
+    {
+        stream.next_in = bandData;
+        stream.avail_in = static_cast<uInt>(rows * rowBytes);
+        return writeDeflated(file, Z_SYNC_FLUSH, errorMessage);
+    }
+
+    bool finish(QSaveFile &file, QString *errorMessage) override
+    {
+        // The end of the stream and its Adler-32, then the end of the image
+        stream.next_in = Z_NULL;
+        stream.avail_in = 0;
+        if (!writeDeflated(file, Z_FINISH, errorMessage)) {
+            return false;
+        }
+        QByteArray trailer;
+        appendChunk(trailer, "IEND", QByteArray());
+        return writeBytes(file, trailer, errorMessage);
+    }
+
+private:
+    static constexpr qsizetype OutputStep = 1 << 20;
+
+    static void appendChunk(QByteArray &out, const char *type, const QByteArray &data)
+    {
+        appendBigEndian<quint32>(out, static_cast<quint32>(data.size()));
+        const qsizetype typeStart = out.size();
+        out.append(type, 4);
+        out.append(data);
+        const Bytef *checked = reinterpret_cast<const Bytef *>(out.constData()) + typeStart;
+        appendBigEndian<quint32>(out, static_cast<quint32>(crc32(0, checked, static_cast<uInt>(4 + data.size()))));
+    }
+
+    // Deflate the pending input with flush and write the output as one
+    // IDAT chunk; deflate() is done once it leaves output space unused
+    bool writeDeflated(QSaveFile &file, int flush, QString *errorMessage)
+    {
+        QByteArray compressed;
+        do {
+            const qsizetype start = compressed.size();
+            compressed.resize(start + OutputStep);
+            stream.next_out = reinterpret_cast<Bytef *>(compressed.data()) + start;
+            stream.avail_out = static_cast<uInt>(OutputStep);
+            if (deflate(&stream, flush) == Z_STREAM_ERROR) {
+                setError(errorMessage, QObject::tr("PNG compression failed"));
+                return false;
+            }
+            compressed.resize(start + OutputStep - stream.avail_out);
+        } while (stream.avail_out == 0);
+
+        QByteArray chunk;
+        appendChunk(chunk, "IDAT", compressed);
+        return writeBytes(file, chunk, errorMessage);
+    }
+
+    QSize size;
+    qsizetype rowBytes;
+    QByteArray band;
+    uchar *bandData;
+    z_stream stream;
+    bool streamReady;
+};
+
+} // namespace
+
+namespace ImageExport {
+
+ImageFormat formatFor(const QString &filePath)
+{
+    const QString suffix = QFileInfo(filePath).suffix().toLower();
+    return suffix == "tif" || suffix == "tiff" ? ImageFormat::Tiff : ImageFormat::Png;
+}
+
+bool write(const QString &filePath, ImageFormat format, const CanvasScene &scene, const QSize &size,
+           TaskContext *context, QString *errorMessage)
+{
+    TraceSpan span("ImageExport::write");
+
+    if (size.width() < 1 || size.height() < 1 || size.width() > MaxSide || size.height() > MaxSide) {
+        setError(errorMessage, QObject::tr("Images are 1 to %1 pixels wide and high").arg(MaxSide));
+        return false;
+    }
+
+    // The tiles keep 32-bit point indices
+    if (scene.points.size() > PointStore::MaxIndexedPoints) {
+        setError(errorMessage, QObject::tr("%1 points are too many to export; at most %2 can be drawn")
+                               .arg(scene.points.size()).arg(PointStore::MaxIndexedPoints));
+        return false;
+    }
+
+    // Symbols and lines keep their size relative to the canvas
+    double scale = 1.0;
+    if (!scene.size.isEmpty()) {
+        scale = qMin(double(size.width()) / scene.size.width(), double(size.height()) / scene.size.height());
+    }
+    const CanvasRenderer canvas(scene.viewport, size, qMax(1, qRound(scene.symbolSize * scale)), scale);
+
+    const int tilesX = (size.width() + TileSize - 1) / TileSize;
+    const int tilesY = (size.height() + TileSize - 1) / TileSize;
+    const TileBins bins = binPoints(scene, canvas, size, tilesX, tilesY);
+
+    std::unique_ptr<BandEncoder> encoder;
+    if (format == ImageFormat::Tiff) {
+        encoder.reset(new TiffEncoder(size));
+    } else {
+        encoder.reset(new PngEncoder(size));
+    }
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        setError(errorMessage, file.errorString());
+        return false;
+    }
+    if (!encoder->begin(file, errorMessage)) {
+        return false;
+    }
+
+    // One band of tiles at a time; an uncommitted file is discarded
+    for (int tileY = 0; tileY < tilesY; tileY++) {
+        if (context && context->isCancelled()) {
+            setError(errorMessage, QObject::tr("Cancelled"));
+            return false;
+        }
+        const int rows = qMin(TileSize, size.height() - tileY * TileSize);
+        {
+            TraceSpan bandSpan("ImageExport::drawBand");
+            Parallel::run(tilesX, [&](int tileX) {
+                QImage tile(TileSize, TileSize, QImage::Format_RGB32);
+                drawTile(tile, scene, canvas, bins, tileX, tileY, tilesX);
+                encoder->addTile(tileX, rows, tile);
+            });
+        }
+        TraceSpan writeSpan("ImageExport::writeBand");
+        if (!encoder->writeBand(file, rows, errorMessage)) {
+            return false;
+        }
+        if (context) {
+            context->setProgress(double(tileY + 1) / tilesY);
+        }
+    }
+
+    if (!encoder->finish(file, errorMessage)) {
+        return false;
+    }
+    if (!file.commit()) {
+        setError(errorMessage, file.errorString());
+        return false;
+    }
+    return true;
+}
+
+} // namespace ImageExport
@@ -0,0 +1,45 @@
+#ifndef IMAGEEXPORT_H
+#define IMAGEEXPORT_H
+
+#include <QSize>
+#include <QString>
+#include "canvasrenderer.h"
+
+class TaskContext;
+
+// Image formats the export writes
+enum class ImageFormat {
+    Png,
+    Tiff
+};
+
+// Export of the canvas as an image of any size, e.g. 16384 x 16384 pixels.
+// The image is drawn by CanvasRenderer in square tiles: the points are first
+// sorted into the tiles their symbols reach, keeping their order, then the
+// tiles of one row band are drawn in parallel and the band is handed to the
+// encoder before the next one is drawn. Memory is the sorted point indices
+// plus one band, however large the image.
+//
+// TIFF files are tiled and every tile is deflate-compressed on the thread
+// that drew it. PNG needs one deflate stream for the whole image; zlib
+// compresses each band into it and flushes it at the end of the band. Both
+// are RGB without alpha on a white background, like the canvas.
+namespace ImageExport {
+
+// Largest width and height written
+const int MaxSide = 65536;
+
+// Format for a file name: TIFF for *.tif and *.tiff, PNG otherwise
+ImageFormat formatFor(const QString &filePath);
+
+// Draw scene at size and write it to filePath. Symbols and lines grow with
+// the image relative to the size the scene was shown at, so the image looks
+// like the canvas enlarged. context, when given, receives the progress and
+// stops the export once cancelled; the file is only replaced once the
+// export completed. Stores beyond PointStore::MaxIndexedPoints are refused.
+bool write(const QString &filePath, ImageFormat format, const CanvasScene &scene, const QSize &size,
+           TaskContext *context = nullptr, QString *errorMessage = nullptr);
+
+} // namespace ImageExport
+
+#endif // IMAGEEXPORT_H
@@ -1,9 +1,13 @@
 #include "mainwindow.h"
 
 #include <QApplication>
+#include "trace.h"
 
 int main(int argc, char *argv[])
 {
+    // MLDEMO_TRACE=1 records a trace from the start, including startup
+    Trace::setEnabled(qEnvironmentVariableIsSet("MLDEMO_TRACE"));
+    
     QApplication a(argc, argv);
     MainWindow w;
     w.show();
@@ -3,7 +3,6 @@
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QItemDelegate>
-#include <QTableWidgetItem>
 #include <QHeaderView>
 #include <QSpinBox>
 #include <QDoubleSpinBox>
@@ -12,6 +11,15 @@
 #include <QStandardPaths>
 #include <QDir>
 #include <QCoreApplication>
+#include <QFileDialog>
+#include <QInputDialog>
+#include <QTimer>
+#include <QMenuBar>
+#include <QMessageBox>
+#include "imageexport.h"
+#include "outlierdetector.h"
+#include "pointgenerator.h"
+#include "trace.h"
 
 // Custom delegate for color column
 class ColorDelegate : public QItemDelegate
@@ -74,8 +82,7 @@ public:
                      const QModelIndex &index) const override {
         QComboBox *comboBox = static_cast<QComboBox*>(editor);
         int value = comboBox->currentData().toInt();
-        model->setData(index, comboBox->currentText(), Qt::DisplayRole);
-        model->setData(index, value, Qt::UserRole);
+        model->setData(index, value, Qt::EditRole);
     }
     
     void paint(QPainter *painter, const QStyleOptionViewItem &option,
@@ -110,11 +117,14 @@ MainWindow::MainWindow(QWidget *parent)
     controller->setDrawingArea(drawingArea);
     createConnections();
     
-    // Update the area table with existing areas from the controller
-    updateAreaTable();
+    // Show the statistics columns for the existing areas
+    refreshStatistics();
     
     // Load application settings
     loadSettings();
+    
+    // Points are loaded only after the first frame is on screen
+    drawingArea->installEventFilter(this);
 }
 
 MainWindow::~MainWindow()
@@ -124,6 +134,15 @@ MainWindow::~MainWindow()
     delete ui;
 }
 
+bool MainWindow::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == drawingArea && event->type() == QEvent::Paint) {
+        drawingArea->removeEventFilter(this);
+        QTimer::singleShot(0, controller, &Controller::onFirstFrame);
+    }
+    return QMainWindow::eventFilter(watched, event);
+}
+
 void MainWindow::setupUi()
 {
     // Create central widget
@@ -138,9 +157,18 @@ void MainWindow::setupUi()
     mainSplitter = new QSplitter(Qt::Horizontal, centralWidget);
     layout->addWidget(mainSplitter);
     
-    // Add drawing area (left side)
-    mainSplitter->addWidget(drawingArea);
+    // Add drawing area (left side), with the comparison view of the
+    // previous version beside it while comparing
+    canvasSplitter = new QSplitter(Qt::Horizontal, mainSplitter);
+    canvasSplitter->addWidget(drawingArea);
     drawingArea->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+    comparisonArea = new DrawingArea(canvasSplitter);
+    comparisonArea->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+    comparisonArea->hide();
+    canvasSplitter->addWidget(comparisonArea);
+    canvasSplitter->setHandleWidth(5);
+    canvasSplitter->setChildrenCollapsible(false);
+    mainSplitter->addWidget(canvasSplitter);
     
     // Create controls group (right side)
     controlsGroup = new QGroupBox(tr("Controls"), centralWidget);
@@ -161,13 +189,15 @@ void MainWindow::setupUi()
     QLabel *areaLabel = new QLabel(tr("Area Definitions:"), controlsGroup);
     controlsLayout->addWidget(areaLabel);
     
-    areaTable = new QTableWidget(0, 7, controlsGroup);
-    areaTable->setHorizontalHeaderLabels(QStringList() << "Area #" << "Center X" << "Center Y" 
-                                       << "Sigma X" << "Sigma Y" << "Symbol" << "Color");
+    // The view reads the areas straight from the controller through the model
+    areaTableModel = new AreaTableModel(controller, this);
+    areaTable = new QTableView(controlsGroup);
+    areaTable->setModel(areaTableModel);
     areaTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
     areaTable->verticalHeader()->setVisible(false);
-    areaTable->setItemDelegateForColumn(5, new SymbolDelegate(this));
-    areaTable->setItemDelegateForColumn(6, new ColorDelegate(this));
+    areaTable->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    areaTable->setItemDelegateForColumn(AreaTableModel::SymbolColumn, new SymbolDelegate(this));
+    areaTable->setItemDelegateForColumn(AreaTableModel::ColorColumn, new ColorDelegate(this));
     areaTable->setEditTriggers(QAbstractItemView::DoubleClicked | QAbstractItemView::SelectedClicked);
     areaTable->setSelectionBehavior(QAbstractItemView::SelectRows);
     areaTable->setSelectionMode(QAbstractItemView::SingleSelection);
@@ -193,6 +223,40 @@ void MainWindow::setupUi()
     generatePointsButton = new QPushButton(tr("Generate Points"), controlsGroup);
     controlsLayout->addWidget(generatePointsButton);
     
+    // How the generated points are shared among the areas
+    QHBoxLayout *samplingLayout = new QHBoxLayout();
+    samplingLayout->addWidget(new QLabel(tr("Sampling:"), controlsGroup));
+    samplingCombo = new QComboBox(controlsGroup);
+    samplingCombo->addItem(tr("Grouped by area"), static_cast<int>(PointGenerator::Sampling::Grouped));
+    samplingCombo->addItem(tr("Mixture"), static_cast<int>(PointGenerator::Sampling::Mixture));
+    samplingCombo->setToolTip(tr("Grouped: each area gets its share of the points, one area after the other. "
+                                 "Mixture: the area of every point is drawn from the weights, so the areas "
+                                 "are interleaved"));
+    samplingLayout->addWidget(samplingCombo);
+    controlsLayout->addLayout(samplingLayout);
+    
+    // Where the coordinates come from
+    QHBoxLayout *sequenceLayout = new QHBoxLayout();
+    sequenceLayout->addWidget(new QLabel(tr("Sequence:"), controlsGroup));
+    sequenceCombo = new QComboBox(controlsGroup);
+    sequenceCombo->addItem(tr("Pseudo-random"), static_cast<int>(PointGenerator::Sequence::Random));
+    sequenceCombo->addItem(tr("Sobol (quasi-random)"), static_cast<int>(PointGenerator::Sequence::Sobol));
+    sequenceCombo->setToolTip(tr("Sobol points are a low-discrepancy set: they cover the areas evenly, "
+                                 "so fewer points give a smooth picture"));
+    sequenceLayout->addWidget(sequenceCombo);
+    controlsLayout->addLayout(sequenceLayout);
+    
+    // Append more points to the current ones; only the new points are written
+    QHBoxLayout *appendLayout = new QHBoxLayout();
+    appendCountSpinBox = new QSpinBox(controlsGroup);
+    appendCountSpinBox->setRange(1, 100000000);
+    appendCountSpinBox->setSingleStep(10000);
+    appendCountSpinBox->setValue(10000);
+    appendPointsButton = new QPushButton(tr("Append Points"), controlsGroup);
+    appendLayout->addWidget(appendCountSpinBox);
+    appendLayout->addWidget(appendPointsButton);
+    controlsLayout->addLayout(appendLayout);
+    
     clearPointsButton = new QPushButton(tr("Clear Points"), controlsGroup);
     controlsLayout->addWidget(clearPointsButton);
     
@@ -200,6 +264,22 @@ void MainWindow::setupUi()
     markOutsideButton = new QPushButton(tr("Mark Outside"), controlsGroup);
     controlsLayout->addWidget(markOutsideButton);
     
+    // Outlier threshold in tenths of a percent of the maximum probability;
+    // while outside points are marked the marks follow the slider
+    QHBoxLayout *thresholdLayout = new QHBoxLayout();
+    thresholdLayout->addWidget(new QLabel(tr("Outlier threshold:"), controlsGroup));
+    outlierThresholdSlider = new QSlider(Qt::Horizontal, controlsGroup);
+    outlierThresholdSlider->setRange(1, 500);
+    outlierThresholdSlider->setValue(qRound(OutlierDetector::DefaultThreshold * 1000));
+    outlierThresholdSlider->setToolTip(tr("Points below this fraction of the maximum probability of their "
+                                          "area are outside; the Outlier % column overrides it per area"));
+    outlierThresholdLabel = new QLabel(controlsGroup);
+    outlierThresholdLabel->setMinimumWidth(outlierThresholdLabel->fontMetrics().horizontalAdvance("50.0%"));
+    thresholdLayout->addWidget(outlierThresholdSlider);
+    thresholdLayout->addWidget(outlierThresholdLabel);
+    controlsLayout->addLayout(thresholdLayout);
+    outlierThresholdLabel->setText(QString("%1%").arg(outlierThresholdSlider->value() / 10.0, 0, 'f', 1));
+    
     // Clear button
     clearButton = new QPushButton(tr("Clear Canvas"), controlsGroup);
     controlsLayout->addWidget(clearButton);
@@ -208,6 +288,65 @@ void MainWindow::setupUi()
     loadButton = new QPushButton(tr("Load Points"), controlsGroup);
     controlsLayout->addWidget(loadButton);
     
+    // Import/export buttons
+    QHBoxLayout *fileButtonLayout = new QHBoxLayout();
+    importPointsButton = new QPushButton(tr("Import Points..."), controlsGroup);
+    exportPointsButton = new QPushButton(tr("Export Points..."), controlsGroup);
+    fileButtonLayout->addWidget(importPointsButton);
+    fileButtonLayout->addWidget(exportPointsButton);
+    controlsLayout->addLayout(fileButtonLayout);
+    
+    // Format of the points file kept between sessions
+    QHBoxLayout *formatLayout = new QHBoxLayout();
+    formatLayout->addWidget(new QLabel(tr("Points file format:"), controlsGroup));
+    pointsFormatCombo = new QComboBox(controlsGroup);
+    pointsFormatCombo->addItem(tr("Binary"), static_cast<int>(PointFileFormat::Binary));
+    pointsFormatCombo->addItem(tr("Compressed"), static_cast<int>(PointFileFormat::Compressed));
+    formatLayout->addWidget(pointsFormatCombo);
+    controlsLayout->addLayout(formatLayout);
+    
+    // Out-of-core datasets and the memory they may use
+    QHBoxLayout *largeDatasetLayout = new QHBoxLayout();
+    openLargeDatasetButton = new QPushButton(tr("Open Large Dataset..."), controlsGroup);
+    memoryBudgetSpinBox = new QSpinBox(controlsGroup);
+    memoryBudgetSpinBox->setRange(16, 65536);
+    memoryBudgetSpinBox->setSingleStep(64);
+    memoryBudgetSpinBox->setValue(256);
+    memoryBudgetSpinBox->setSuffix(tr(" MB"));
+    memoryBudgetSpinBox->setToolTip(tr("Memory budget for the points of a large dataset"));
+    largeDatasetLayout->addWidget(openLargeDatasetButton);
+    largeDatasetLayout->addWidget(memoryBudgetSpinBox);
+    controlsLayout->addLayout(largeDatasetLayout);
+    
+    // Statistics of the generated points
+    QLabel *statisticsLabel = new QLabel(tr("Area Statistics (empirical vs requested):"), controlsGroup);
+    controlsLayout->addWidget(statisticsLabel);
+    statisticsModel = new StatisticsTableModel(controller, this);
+    statisticsPanel = new StatisticsPanel(statisticsModel, controlsGroup);
+    controlsLayout->addWidget(statisticsPanel);
+    
+    // Classifier training section
+    QFrame *trainingLine = new QFrame(controlsGroup);
+    trainingLine->setFrameShape(QFrame::HLine);
+    trainingLine->setFrameShadow(QFrame::Sunken);
+    controlsLayout->addWidget(trainingLine);
+    
+    QHBoxLayout *trainingButtonLayout = new QHBoxLayout();
+    optimizerCombo = new QComboBox(controlsGroup);
+    optimizerCombo->addItem(tr("Adam"), static_cast<int>(Optimizer::Adam));
+    optimizerCombo->addItem(tr("SGD"), static_cast<int>(Optimizer::Sgd));
+    trainButton = new QPushButton(tr("Train Classifier"), controlsGroup);
+    stopTrainingButton = new QPushButton(tr("Stop"), controlsGroup);
+    stopTrainingButton->setEnabled(false);
+    
+    trainingButtonLayout->addWidget(optimizerCombo);
+    trainingButtonLayout->addWidget(trainButton);
+    trainingButtonLayout->addWidget(stopTrainingButton);
+    controlsLayout->addLayout(trainingButtonLayout);
+    
+    trainingChart = new TrainingChart(controlsGroup);
+    controlsLayout->addWidget(trainingChart);
+    
     // Add a spacer to separate control sections
     controlsLayout->addSpacing(20);
     
@@ -221,15 +360,54 @@ void MainWindow::setupUi()
         "For each area, define:\n"
         "- Center X and Y (center coordinates)\n"
         "- Sigma X and Y (dispersion parameters)\n"
+        "- Weight (share of the generated points)\n"
         "- Symbol for visualization (+ by default)\n"
         "- Color for visualization\n\n"
-        "When generating points, 10,000 points will be distributed equally among all defined areas."
+        "When generating points, 10,000 points will be distributed among all defined areas by their weights."
     ), controlsGroup);
     infoLabel->setWordWrap(true);
     controlsLayout->addWidget(infoLabel);
     
     // Add stretch to push controls to the top
     controlsLayout->addStretch();
+    
+    // Edit menu: undo and redo of the points and areas, and the comparison
+    // of the current dataset with the version undo would restore
+    QMenu *editMenu = ui->menubar->addMenu(tr("&Edit"));
+    undoAction = editMenu->addAction(tr("Undo"));
+    undoAction->setShortcut(QKeySequence::Undo);
+    redoAction = editMenu->addAction(tr("Redo"));
+    redoAction->setShortcut(QKeySequence::Redo);
+    editMenu->addSeparator();
+    compareAction = editMenu->addAction(tr("Compare With Previous Version"));
+    compareAction->setCheckable(true);
+    
+    // Tools menu: record trace spans and save them for a trace viewer, the
+    // performance overlay and the export of the canvas as a large image
+    QMenu *toolsMenu = ui->menubar->addMenu(tr("&Tools"));
+    recordTraceAction = toolsMenu->addAction(tr("Record Trace"));
+    recordTraceAction->setCheckable(true);
+    recordTraceAction->setChecked(Trace::isEnabled());
+    saveTraceAction = toolsMenu->addAction(tr("Save Trace..."));
+    toolsMenu->addSeparator();
+    performanceOverlayAction = toolsMenu->addAction(tr("Performance Overlay"));
+    performanceOverlayAction->setCheckable(true);
+    performanceOverlayAction->setShortcut(Qt::Key_F3);
+    toolsMenu->addSeparator();
+    exportImageAction = toolsMenu->addAction(tr("Export Image..."));
+    
+    // Progress of the background jobs, shown in the status bar while any runs
+    jobLabel = new QLabel(ui->statusbar);
+    jobProgressBar = new QProgressBar(ui->statusbar);
+    jobProgressBar->setRange(0, 100);
+    jobProgressBar->setMaximumWidth(160);
+    cancelJobsButton = new QPushButton(tr("Cancel"), ui->statusbar);
+    ui->statusbar->addPermanentWidget(jobLabel);
+    ui->statusbar->addPermanentWidget(jobProgressBar);
+    ui->statusbar->addPermanentWidget(cancelJobsButton);
+    jobLabel->hide();
+    jobProgressBar->hide();
+    cancelJobsButton->hide();
 }
 
 void MainWindow::createConnections()
@@ -237,18 +415,112 @@ void MainWindow::createConnections()
     // Connect area buttons
     connect(addAreaButton, &QPushButton::clicked, this, &MainWindow::onAddAreaClicked);
     connect(removeAreaButton, &QPushButton::clicked, this, &MainWindow::onRemoveAreaClicked);
-    connect(areaTable, &QTableWidget::itemSelectionChanged, this, &MainWindow::onAreaSelectionChanged);
-    connect(areaTable, &QTableWidget::itemChanged, this, &MainWindow::onAreaDataChanged);
+    connect(areaTable->selectionModel(), &QItemSelectionModel::selectionChanged,
+            this, &MainWindow::onAreaSelectionChanged);
+    
+    // Area edits change the requested columns of the statistics of the
+    // rows they touch
+    connect(areaTableModel, &QAbstractItemModel::dataChanged, this,
+            [this](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+        statisticsModel->refreshAreas(topLeft.row(), bottomRight.row());
+    });
+    connect(areaTableModel, &QAbstractItemModel::rowsInserted, this,
+            [this](const QModelIndex &, int first, int last) {
+        statisticsModel->insertAreas(first, last);
+    });
+    connect(areaTableModel, &QAbstractItemModel::rowsRemoved, this,
+            [this](const QModelIndex &, int first, int last) {
+        statisticsModel->removeAreas(first, last);
+    });
     
     // Connect UI controls to controller slots
     connect(clearButton, &QPushButton::clicked, controller, &Controller::onClearCanvas);
     connect(loadButton, &QPushButton::clicked, controller, &Controller::onLoadDrawing);
     connect(generatePointsButton, &QPushButton::clicked, controller, &Controller::onGeneratePoints);
+    connect(appendPointsButton, &QPushButton::clicked, this, [this]() {
+        controller->onAppendPoints(appendCountSpinBox->value());
+    });
     connect(clearPointsButton, &QPushButton::clicked, controller, &Controller::onClearPoints);
     connect(markOutsideButton, &QPushButton::clicked, controller, &Controller::onMarkOutsidePoints);
+    connect(outlierThresholdSlider, &QSlider::valueChanged, this, &MainWindow::onOutlierThresholdChanged);
+    connect(outlierThresholdSlider, &QSlider::sliderReleased, this, &MainWindow::saveSettings);
+    connect(importPointsButton, &QPushButton::clicked, this, &MainWindow::onImportPointsClicked);
+    connect(exportPointsButton, &QPushButton::clicked, this, &MainWindow::onExportPointsClicked);
+    connect(pointsFormatCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::onPointsFormatChanged);
+    connect(samplingCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::onSamplingChanged);
+    connect(sequenceCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::onSequenceChanged);
+    connect(openLargeDatasetButton, &QPushButton::clicked, this, &MainWindow::onOpenLargeDatasetClicked);
+    connect(memoryBudgetSpinBox, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &MainWindow::onMemoryBudgetChanged);
+    
+    // Non-modal messages from the controller
+    connect(controller, &Controller::statusMessage, ui->statusbar, [this](const QString &message) {
+        ui->statusbar->showMessage(message);
+    });
+    
+    // Background jobs report their progress next to the messages
+    connect(controller, &Controller::jobProgress, this, [this](const QString &name, int percent) {
+        jobLabel->setText(name);
+        jobProgressBar->setValue(percent);
+        jobLabel->show();
+        jobProgressBar->show();
+        cancelJobsButton->show();
+    });
+    connect(controller, &Controller::jobsFinished, this, [this]() {
+        jobLabel->hide();
+        jobProgressBar->hide();
+        cancelJobsButton->hide();
+    });
+    connect(cancelJobsButton, &QPushButton::clicked, controller, &Controller::onCancelJobs);
+    
+    // Dataset versions
+    connect(undoAction, &QAction::triggered, controller, &Controller::undo);
+    connect(redoAction, &QAction::triggered, controller, &Controller::redo);
+    connect(compareAction, &QAction::toggled, this, &MainWindow::onCompareToggled);
+    connect(controller, &Controller::historyChanged, this, &MainWindow::onHistoryChanged);
+    connect(controller, &Controller::areaDefinitionsRestored, this, [this]() {
+        areaTableModel->reload();
+        refreshStatistics();
+    });
+    connect(drawingArea, &DrawingArea::viewportChanged, comparisonArea, &DrawingArea::setViewport);
+    onHistoryChanged();
+    
+    // Connect classifier training
+    connect(trainButton, &QPushButton::clicked, this, &MainWindow::onTrainClicked);
+    connect(stopTrainingButton, &QPushButton::clicked, controller, &Controller::onStopTraining);
+    connect(controller, &Controller::trainingEpochFinished, this, &MainWindow::onTrainingEpochFinished);
+    connect(controller, &Controller::trainingStopped, this, &MainWindow::onTrainingStopped);
+    
+    // Refresh the statistics panel whenever the controller recomputes them
+    connect(controller, &Controller::statisticsChanged, this, &MainWindow::refreshStatistics);
     
     // Connect splitter movement
     connect(mainSplitter, &QSplitter::splitterMoved, this, &MainWindow::onSplitterMoved);
+    
+    // Connect tracing
+    connect(recordTraceAction, &QAction::toggled, this, &MainWindow::onRecordTraceToggled);
+    connect(saveTraceAction, &QAction::triggered, this, &MainWindow::onSaveTraceClicked);
+    
+    // Connect the performance overlay
+    connect(performanceOverlayAction, &QAction::toggled, this, [this](bool checked) {
+        drawingArea->setPerformanceOverlayVisible(checked);
+        saveSettings();
+    });
+    connect(exportImageAction, &QAction::triggered, this, &MainWindow::onExportImageClicked);
+}
+
+void MainWindow::onOutlierThresholdChanged(int value)
+{
+    outlierThresholdLabel->setText(QString("%1%").arg(value / 10.0, 0, 'f', 1));
+    controller->setOutlierThreshold(value / 1000.0);
+    
+    // Dragging saves once, on release
+    if (!outlierThresholdSlider->isSliderDown()) {
+        saveSettings();
+    }
 }
 
 void MainWindow::onSplitterMoved(int pos, int index)
@@ -257,6 +529,188 @@ void MainWindow::onSplitterMoved(int pos, int index)
     saveSettings();
 }
 
+void MainWindow::onTrainClicked()
+{
+    Optimizer optimizer = static_cast<Optimizer>(optimizerCombo->currentData().toInt());
+    
+    trainingChart->clear();
+    controller->onTrainClassifier(optimizer);
+    
+    if (controller->isTraining()) {
+        trainButton->setEnabled(false);
+        stopTrainingButton->setEnabled(true);
+        ui->statusbar->showMessage(tr("Training started..."));
+    }
+}
+
+void MainWindow::onTrainingEpochFinished(int epoch, int totalEpochs, double loss, double accuracy,
+                                         double epochsPerSecond, int sampleCount)
+{
+    trainingChart->addEpoch(loss, accuracy);
+    
+    ui->statusbar->showMessage(tr("Epoch %1/%2 - loss %3, accuracy %4% - %5 epochs/s on %6 points")
+                               .arg(epoch)
+                               .arg(totalEpochs)
+                               .arg(loss, 0, 'f', 4)
+                               .arg(accuracy * 100.0, 0, 'f', 1)
+                               .arg(epochsPerSecond, 0, 'f', 2)
+                               .arg(sampleCount));
+}
+
+void MainWindow::onTrainingStopped()
+{
+    trainButton->setEnabled(true);
+    stopTrainingButton->setEnabled(false);
+}
+
+void MainWindow::refreshStatistics()
+{
+    statisticsModel->reload();
+}
+
+void MainWindow::onImportPointsClicked()
+{
+    QString filePath = QFileDialog::getOpenFileName(this, tr("Import Points"), QString(),
+                                                    tr("Points files (*.bin *.mlpz *.csv);;All files (*)"));
+    if (filePath.isEmpty()) {
+        return;
+    }
+    
+    controller->importPoints(filePath);
+}
+
+void MainWindow::onExportPointsClicked()
+{
+    const QString binaryFilter = tr("Binary points (*.bin)");
+    const QString compressedFilter = tr("Compressed points (*.mlpz)");
+    const QString csvFilter = tr("CSV files (*.csv)");
+    
+    QString selectedFilter = csvFilter;
+    QString filePath = QFileDialog::getSaveFileName(this, tr("Export Points"), "points.csv",
+                                                    QStringList({csvFilter, binaryFilter, compressedFilter}).join(";;"),
+                                                    &selectedFilter);
+    if (filePath.isEmpty()) {
+        return;
+    }
+    
+    PointFileFormat format = PointFileFormat::Csv;
+    if (selectedFilter == binaryFilter) {
+        format = PointFileFormat::Binary;
+    } else if (selectedFilter == compressedFilter) {
+        format = PointFileFormat::Compressed;
+    }
+    
+    if (controller->exportPoints(filePath, format)) {
+        ui->statusbar->showMessage(tr("Exported %1 in %2 ms")
+                                   .arg(filePath)
+                                   .arg(controller->getLastSaveMilliseconds()));
+    }
+}
+
+void MainWindow::onPointsFormatChanged(int index)
+{
+    controller->setPointsFileFormat(static_cast<PointFileFormat>(pointsFormatCombo->itemData(index).toInt()));
+    saveSettings();
+}
+
+void MainWindow::onSamplingChanged(int index)
+{
+    controller->setSampling(static_cast<PointGenerator::Sampling>(samplingCombo->itemData(index).toInt()));
+    saveSettings();
+}
+
+void MainWindow::onSequenceChanged(int index)
+{
+    controller->setSequence(static_cast<PointGenerator::Sequence>(sequenceCombo->itemData(index).toInt()));
+    saveSettings();
+}
+
+void MainWindow::onOpenLargeDatasetClicked()
+{
+    QString filePath = QFileDialog::getOpenFileName(this, tr("Open Large Dataset"), QString(),
+                                                    tr("Points files (*.bin *.buckets);;All files (*)"));
+    if (filePath.isEmpty()) {
+        return;
+    }
+    
+    controller->openLargeDataset(filePath);
+}
+
+void MainWindow::onMemoryBudgetChanged(int megabytes)
+{
+    controller->setDatasetMemoryBudget(static_cast<qint64>(megabytes) << 20);
+    saveSettings();
+}
+
+void MainWindow::onHistoryChanged()
+{
+    const DatasetHistory &history = controller->getHistory();
+    undoAction->setEnabled(history.canUndo());
+    redoAction->setEnabled(history.canRedo());
+    undoAction->setText(history.canUndo()
+                        ? tr("Undo %1").arg(history.at(history.currentIndex()).label) : tr("Undo"));
+    redoAction->setText(history.canRedo()
+                        ? tr("Redo %1").arg(history.at(history.currentIndex() + 1).label) : tr("Redo"));
+}
+
+void MainWindow::onCompareToggled(bool checked)
+{
+    comparisonArea->setVisible(checked);
+    controller->setComparisonArea(checked ? comparisonArea : nullptr);
+    if (checked) {
+        comparisonArea->setViewport(drawingArea->getViewport());
+    }
+}
+
+void MainWindow::onRecordTraceToggled(bool checked)
+{
+    // A new recording starts with empty buffers
+    if (checked) {
+        Trace::clear();
+    }
+    Trace::setEnabled(checked);
+    ui->statusbar->showMessage(checked ? tr("Recording trace") : tr("Trace recording stopped"));
+}
+
+void MainWindow::onSaveTraceClicked()
+{
+    QString filePath = QFileDialog::getSaveFileName(this, tr("Save Trace"), "trace.json",
+                                                    tr("Trace files (*.json);;All files (*)"));
+    if (filePath.isEmpty()) {
+        return;
+    }
+    
+    QString error;
+    if (!Trace::writeChromeJson(filePath, &error)) {
+        QMessageBox::warning(this, tr("Save Trace"), tr("Could not write %1:\n%2").arg(filePath, error));
+        return;
+    }
+    ui->statusbar->showMessage(tr("Saved trace to %1; open it in chrome://tracing or ui.perfetto.dev").arg(filePath));
+}
+
+void MainWindow::onExportImageClicked()
+{
+    const QString tiffFilter = tr("TIFF images (*.tif *.tiff)");
+    const QString pngFilter = tr("PNG images (*.png)");
+    QString filePath = QFileDialog::getSaveFileName(this, tr("Export Image"), "canvas.tif",
+                                                    QStringList({tiffFilter, pngFilter}).join(";;"));
+    if (filePath.isEmpty()) {
+        return;
+    }
+    
+    // The image keeps the canvas' aspect ratio
+    bool ok = false;
+    const int width = QInputDialog::getInt(this, tr("Export Image"), tr("Width in pixels:"),
+                                           qMin(ImageExport::MaxSide, drawingArea->width() * 8), 1,
+                                           ImageExport::MaxSide, 1, &ok);
+    if (!ok) {
+        return;
+    }
+    const int height = qBound(1, qRound(double(width) * drawingArea->height() / drawingArea->width()),
+                              ImageExport::MaxSide);
+    controller->exportImage(filePath, QSize(width, height));
+}
+
 void MainWindow::saveSettings()
 {
     QSettings settings(settingsFilePath, QSettings::IniFormat);
@@ -266,6 +720,22 @@ void MainWindow::saveSettings()
     
     // Save window geometry
     settings.setValue("WindowGeometry", saveGeometry());
+    
+    // Save points file format
+    settings.setValue("PointsFileFormat", pointsFormatCombo->currentData().toInt());
+    
+    // Save the sampling mode and sequence
+    settings.setValue("Sampling", samplingCombo->currentData().toInt());
+    settings.setValue("Sequence", sequenceCombo->currentData().toInt());
+    
+    // Save the memory budget for large datasets
+    settings.setValue("DatasetMemoryBudgetMB", memoryBudgetSpinBox->value());
+    
+    // Save the performance overlay state
+    settings.setValue("PerformanceOverlay", performanceOverlayAction->isChecked());
+    
+    // Save the global outlier threshold
+    settings.setValue("OutlierThreshold", outlierThresholdSlider->value() / 1000.0);
 }
 
 void MainWindow::loadSettings()
@@ -281,70 +751,41 @@ void MainWindow::loadSettings()
     if (settings.contains("WindowGeometry")) {
         restoreGeometry(settings.value("WindowGeometry").toByteArray());
     }
-}
-
-void MainWindow::updateAreaTable()
-{
-    // Disconnect to prevent signals during update
-    disconnect(areaTable, &QTableWidget::itemChanged, this, &MainWindow::onAreaDataChanged);
     
-    // Clear existing rows
-    areaTable->clearContents();
-    areaTable->setRowCount(0);
+    // Restore points file format
+    if (settings.contains("PointsFileFormat")) {
+        int index = pointsFormatCombo->findData(settings.value("PointsFileFormat").toInt());
+        if (index >= 0) {
+            pointsFormatCombo->setCurrentIndex(index);
+        }
+    }
     
-    // Add rows for each area definition
-    for (int i = 0; i < controller->getAreaDefinitionsCount(); i++) {
-        AreaDefinition area = controller->getAreaDefinition(i);
-        
-        int row = areaTable->rowCount();
-        areaTable->insertRow(row);
-        
-        // Area number
-        QTableWidgetItem *areaNumItem = new QTableWidgetItem(QString::number(area.areaNumber));
-        areaNumItem->setTextAlignment(Qt::AlignCenter);
-        areaTable->setItem(row, 0, areaNumItem);
-        
-        // Center X
-        QTableWidgetItem *centerXItem = new QTableWidgetItem(QString::number(area.centerX));
-        centerXItem->setTextAlignment(Qt::AlignCenter);
-        areaTable->setItem(row, 1, centerXItem);
-        
-        // Center Y
-        QTableWidgetItem *centerYItem = new QTableWidgetItem(QString::number(area.centerY));
-        centerYItem->setTextAlignment(Qt::AlignCenter);
-        areaTable->setItem(row, 2, centerYItem);
-        
-        // Sigma X
-        QTableWidgetItem *sigmaXItem = new QTableWidgetItem(QString::number(area.sigmaX));
-        sigmaXItem->setTextAlignment(Qt::AlignCenter);
-        areaTable->setItem(row, 3, sigmaXItem);
-        
-        // Sigma Y
-        QTableWidgetItem *sigmaYItem = new QTableWidgetItem(QString::number(area.sigmaY));
-        sigmaYItem->setTextAlignment(Qt::AlignCenter);
-        areaTable->setItem(row, 4, sigmaYItem);
-        
-        // Symbol Type
-        QString symbolText;
-        switch (area.symbolType) {
-            case SymbolType::Cross: symbolText = "Cross (x)"; break;
-            case SymbolType::Plus: symbolText = "Plus (+)"; break;
-            case SymbolType::Star: symbolText = "Star (*)"; break;
+    // Restore the sampling mode and sequence
+    if (settings.contains("Sampling")) {
+        int index = samplingCombo->findData(settings.value("Sampling").toInt());
+        if (index >= 0) {
+            samplingCombo->setCurrentIndex(index);
+        }
+    }
+    if (settings.contains("Sequence")) {
+        int index = sequenceCombo->findData(settings.value("Sequence").toInt());
+        if (index >= 0) {
+            sequenceCombo->setCurrentIndex(index);
         }
-        QTableWidgetItem *symbolItem = new QTableWidgetItem(symbolText);
-        symbolItem->setTextAlignment(Qt::AlignCenter);
-        symbolItem->setData(Qt::UserRole, static_cast<int>(area.symbolType));
-        areaTable->setItem(row, 5, symbolItem);
-        
-        // Color
-        QTableWidgetItem *colorItem = new QTableWidgetItem("");
-        colorItem->setBackground(area.color);
-        colorItem->setData(Qt::BackgroundRole, area.color);
-        areaTable->setItem(row, 6, colorItem);
     }
     
-    // Reconnect signals
-    connect(areaTable, &QTableWidget::itemChanged, this, &MainWindow::onAreaDataChanged);
+    // Restore the memory budget for large datasets
+    if (settings.contains("DatasetMemoryBudgetMB")) {
+        memoryBudgetSpinBox->setValue(settings.value("DatasetMemoryBudgetMB").toInt());
+    }
+    
+    // Restore the performance overlay state
+    performanceOverlayAction->setChecked(settings.value("PerformanceOverlay", false).toBool());
+    
+    // Restore the global outlier threshold
+    if (settings.contains("OutlierThreshold")) {
+        outlierThresholdSlider->setValue(qRound(settings.value("OutlierThreshold").toDouble() * 1000));
+    }
 }
 
 QColor MainWindow::getCurrentColor() const
@@ -364,23 +805,19 @@ void MainWindow::onAddAreaClicked()
     newArea.symbolType = SymbolType::Plus; // Default to Plus symbol
     newArea.color = currentColor;
     
-    // Add to controller
-    controller->addAreaDefinition(newArea);
-    
-    // Update table
-    updateAreaTable();
+    // Add through the model, which inserts just the new row
+    areaTableModel->appendArea(newArea);
     
     // Select the newly added row
-    areaTable->selectRow(areaTable->rowCount() - 1);
+    areaTable->selectRow(areaTableModel->rowCount() - 1);
+    areaTable->scrollToBottom();
 }
 
 void MainWindow::onRemoveAreaClicked()
 {
-    QList<QTableWidgetItem*> selectedItems = areaTable->selectedItems();
-    if (!selectedItems.isEmpty()) {
-        int row = selectedItems.first()->row();
-        controller->removeAreaDefinition(row);
-        updateAreaTable();
+    QModelIndexList selectedRows = areaTable->selectionModel()->selectedRows();
+    if (!selectedRows.isEmpty()) {
+        areaTableModel->removeArea(selectedRows.first().row());
     }
 }
 
@@ -393,22 +830,10 @@ void MainWindow::onColorButtonClicked()
         currentColor = color;
         
         // Update the color for the selected row
-        QList<QTableWidgetItem*> selectedItems = areaTable->selectedItems();
-        if (!selectedItems.isEmpty()) {
-            int row = selectedItems.first()->row();
-            
-            // Get the current area definition
-            AreaDefinition area = controller->getAreaDefinition(row);
-            area.color = color;
-            
-            // Update in controller
-            controller->updateAreaDefinition(row, area);
-            
-            // Update table
-            updateAreaTable();
-            
-            // Reselect the row
-            areaTable->selectRow(row);
+        QModelIndexList selectedRows = areaTable->selectionModel()->selectedRows();
+        if (!selectedRows.isEmpty()) {
+            int row = selectedRows.first().row();
+            areaTableModel->setData(areaTableModel->index(row, AreaTableModel::ColorColumn), color);
         }
     }
 }
@@ -416,18 +841,18 @@ void MainWindow::onColorButtonClicked()
 void MainWindow::onAreaSelectionChanged()
 {
     // Enable/disable remove button based on selection
-    removeAreaButton->setEnabled(!areaTable->selectedItems().isEmpty());
+    QModelIndexList selectedRows = areaTable->selectionModel()->selectedRows();
+    removeAreaButton->setEnabled(!selectedRows.isEmpty());
     
     // If a row is selected and the color column is clicked, show color dialog
-    QList<QTableWidgetItem*> selectedItems = areaTable->selectedItems();
-    if (!selectedItems.isEmpty()) {
-        int row = selectedItems.first()->row();
-        int column = areaTable->currentColumn();
+    if (!selectedRows.isEmpty()) {
+        int row = selectedRows.first().row();
+        int column = areaTable->currentIndex().column();
         
-        // Check if the selected cell is the color cell (column 6)
-        if (column == 6) {
-            // Get the current color from the table
-            QColor color = areaTable->item(row, column)->background().color();
+        // Check if the selected cell is the color cell
+        if (column == AreaTableModel::ColorColumn) {
+            // Get the current color from the model
+            QColor color = areaTableModel->index(row, column).data(Qt::BackgroundRole).value<QColor>();
             if (color.isValid()) {
                 currentColor = color;
             }
@@ -437,28 +862,3 @@ void MainWindow::onAreaSelectionChanged()
         }
     }
 }
-
-void MainWindow::onAreaDataChanged()
-{
-    // Get the changed row
-    int row = areaTable->currentRow();
-    if (row >= 0) {
-        // Get data from table
-        AreaDefinition area;
-        area.areaNumber = areaTable->item(row, 0)->text().toInt();
-        area.centerX = areaTable->item(row, 1)->text().toDouble();
-        area.centerY = areaTable->item(row, 2)->text().toDouble();
-        area.sigmaX = areaTable->item(row, 3)->text().toDouble();
-        area.sigmaY = areaTable->item(row, 4)->text().toDouble();
-        
-        // Get symbol type from the item
-        area.symbolType = static_cast<SymbolType>(areaTable->item(row, 5)->data(Qt::UserRole).toInt());
-        
-        // Get color from the color item
-        QColor color = areaTable->item(row, 6)->background().color();
-        area.color = color;
-        
-        // Update the area definition in the controller
-        controller->updateAreaDefinition(row, area);
-    }
-}
@@ -9,14 +9,20 @@
 #include <QLabel>
 #include <QGroupBox>
 #include <QVBoxLayout>
-#include <QTableWidget>
+#include <QTableView>
 #include <QSpinBox>
 #include <QDoubleSpinBox>
 #include <QHeaderView>
 #include <QSplitter>
+#include <QComboBox>
+#include <QAction>
+#include <QProgressBar>
 
+#include "areatablemodel.h"
 #include "drawingarea.h"
 #include "controller.h"
+#include "trainingchart.h"
+#include "statisticspanel.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -32,18 +38,38 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+protected:
+    // Watches for the first paint of the drawing area
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
 private slots:
     void onAddAreaClicked();
     void onRemoveAreaClicked();
     void onColorButtonClicked();
     void onAreaSelectionChanged();
-    void onAreaDataChanged();
     void onSplitterMoved(int pos, int index);
+    void onTrainClicked();
+    void onTrainingEpochFinished(int epoch, int totalEpochs, double loss, double accuracy,
+                                 double epochsPerSecond, int sampleCount);
+    void onTrainingStopped();
+    void refreshStatistics();
+    void onImportPointsClicked();
+    void onExportPointsClicked();
+    void onPointsFormatChanged(int index);
+    void onSamplingChanged(int index);
+    void onSequenceChanged(int index);
+    void onOpenLargeDatasetClicked();
+    void onMemoryBudgetChanged(int megabytes);
+    void onOutlierThresholdChanged(int value);
+    void onHistoryChanged();
+    void onCompareToggled(bool checked);
+    void onRecordTraceToggled(bool checked);
+    void onSaveTraceClicked();
+    void onExportImageClicked();
 
 private:
     void setupUi();
     void createConnections();
-    void updateAreaTable();
     QColor getCurrentColor() const;
     void saveSettings();
     void loadSettings();
@@ -55,11 +81,14 @@ private:
     // UI components for controls
     QWidget *centralWidget;
     QSplitter *mainSplitter;
+    QSplitter *canvasSplitter;
+    DrawingArea *comparisonArea;
     QGroupBox *controlsGroup;
     QVBoxLayout *controlsLayout;
     
     // Area definition table
-    QTableWidget *areaTable;
+    AreaTableModel *areaTableModel;
+    QTableView *areaTable;
     QPushButton *addAreaButton;
     QPushButton *removeAreaButton;
     QColor currentColor;
@@ -70,8 +99,45 @@ private:
     QPushButton *saveButton;
     QPushButton *loadButton;
     QPushButton *generatePointsButton;
+    QComboBox *samplingCombo;
+    QComboBox *sequenceCombo;
+    QPushButton *appendPointsButton;
+    QSpinBox *appendCountSpinBox;
     QPushButton *clearPointsButton;
     QPushButton *markOutsideButton;
+    QSlider *outlierThresholdSlider;
+    QLabel *outlierThresholdLabel;
+    QPushButton *importPointsButton;
+    QPushButton *exportPointsButton;
+    QComboBox *pointsFormatCombo;
+    QPushButton *openLargeDatasetButton;
+    QSpinBox *memoryBudgetSpinBox;
+    
+    // Classifier training
+    QComboBox *optimizerCombo;
+    QPushButton *trainButton;
+    QPushButton *stopTrainingButton;
+    TrainingChart *trainingChart;
+    
+    // Per-area statistics of the generated points
+    StatisticsTableModel *statisticsModel;
+    StatisticsPanel *statisticsPanel;
+    
+    // Edit menu
+    QAction *undoAction;
+    QAction *redoAction;
+    QAction *compareAction;
+    
+    // Tools menu
+    QAction *recordTraceAction;
+    QAction *saveTraceAction;
+    QAction *performanceOverlayAction;
+    QAction *exportImageAction;
+    
+    // Status bar progress of the background jobs
+    QLabel *jobLabel;
+    QProgressBar *jobProgressBar;
+    QPushButton *cancelJobsButton;
     
     // Settings
     QString settingsFilePath;
@@ -0,0 +1,203 @@
+#include "neuralnetwork.h"
+#include "gemm.h"
+#include <QRandomGenerator>
+#include <QtMath>
+#include <algorithm>
+#include <random>
+
+NeuralNetwork::NeuralNetwork(const QVector<int> &layerSizes, quint32 seed)
+    : sizes(layerSizes)
+    , step(0)
+{
+    // Lay out W0, b0, W1, b1, ... in one flat array
+    int offset = 0;
+    for (int l = 0; l < layerCount(); l++) {
+        weightOffsets.append(offset);
+        offset += sizes[l] * sizes[l + 1];
+        biasOffsets.append(offset);
+        offset += sizes[l + 1];
+    }
+    parameters.fill(0.0f, offset);
+    moment1.fill(0.0f, offset);
+    moment2.fill(0.0f, offset);
+
+    // He initialization for ReLU layers, biases start at zero
+    QRandomGenerator rng(seed);
+    for (int l = 0; l < layerCount(); l++) {
+        std::normal_distribution<float> dist(0.0f, qSqrt(2.0f / sizes[l]));
+        float *weights = parameters.data() + weightOffsets[l];
+        for (int i = 0; i < sizes[l] * sizes[l + 1]; i++) {
+            weights[i] = dist(rng);
+        }
+    }
+}
+
+NeuralNetwork::Workspace NeuralNetwork::createWorkspace(int maxRows) const
+{
+    Workspace ws;
+    ws.maxRows = maxRows;
+    ws.activations.resize(sizes.size());
+    ws.deltas.resize(sizes.size());
+    for (int l = 1; l < sizes.size(); l++) {
+        ws.activations[l].fill(0.0f, maxRows * sizes[l]);
+        ws.deltas[l].fill(0.0f, maxRows * sizes[l]);
+    }
+    ws.gradients.fill(0.0f, parameters.size());
+    ws.inputs.fill(0.0f, maxRows * inputSize());
+    ws.labels.fill(0, maxRows);
+    return ws;
+}
+
+void NeuralNetwork::forward(int rows, Workspace &ws) const
+{
+    const float *input = ws.inputs.constData();
+
+    for (int l = 0; l < layerCount(); l++) {
+        const int inSize = sizes[l];
+        const int outSize = sizes[l + 1];
+        float *output = ws.activations[l + 1].data();
+        const float *bias = parameters.constData() + biasOffsets[l];
+
+        // Start from the bias and accumulate input * W
+        for (int r = 0; r < rows; r++) {
+            std::copy(bias, bias + outSize, output + r * outSize);
+        }
+        Gemm::multiplyNN(rows, outSize, inSize, input,
+                         parameters.constData() + weightOffsets[l], output);
+
+        if (l + 1 < layerCount()) {
+            // ReLU on hidden layers
+            for (int i = 0; i < rows * outSize; i++) {
+                output[i] = qMax(0.0f, output[i]);
+            }
+        } else {
+            // Numerically stable softmax on the output layer
+            for (int r = 0; r < rows; r++) {
+                float *row = output + r * outSize;
+                float maxLogit = *std::max_element(row, row + outSize);
+                float sum = 0.0f;
+                for (int j = 0; j < outSize; j++) {
+                    row[j] = qExp(row[j] - maxLogit);
+                    sum += row[j];
+                }
+                for (int j = 0; j < outSize; j++) {
+                    row[j] /= sum;
+                }
+            }
+        }
+
+        input = output;
+    }
+}
+
+void NeuralNetwork::accumulateGradients(int rows, float gradientScale, Workspace &ws,
+                                        double &loss, int &correct) const
+{
+    if (rows <= 0) {
+        return;
+    }
+
+    forward(rows, ws);
+
+    const int last = layerCount();
+    const int classes = outputSize();
+    const float *probabilities = ws.activations[last].constData();
+    float *delta = ws.deltas[last].data();
+
+    // Cross-entropy loss; the softmax + cross-entropy gradient is (p - onehot)
+    for (int r = 0; r < rows; r++) {
+        const float *p = probabilities + r * classes;
+        float *d = delta + r * classes;
+        const int label = ws.labels[r];
+
+        loss -= qLn(qMax(p[label], 1e-7f));
+        if (std::max_element(p, p + classes) - p == label) {
+            correct++;
+        }
+
+        for (int j = 0; j < classes; j++) {
+            d[j] = gradientScale * (p[j] - (j == label ? 1.0f : 0.0f));
+        }
+    }
+
+    // Back-propagate through the layers
+    for (int l = last - 1; l >= 0; l--) {
+        const int inSize = sizes[l];
+        const int outSize = sizes[l + 1];
+        const float *input = (l == 0) ? ws.inputs.constData() : ws.activations[l].constData();
+        const float *layerDelta = ws.deltas[l + 1].constData();
+
+        Gemm::multiplyTN(inSize, outSize, rows, input, layerDelta,
+                         ws.gradients.data() + weightOffsets[l]);
+
+        float *biasGradient = ws.gradients.data() + biasOffsets[l];
+        for (int r = 0; r < rows; r++) {
+            const float *d = layerDelta + r * outSize;
+            for (int j = 0; j < outSize; j++) {
+                biasGradient[j] += d[j];
+            }
+        }
+
+        if (l == 0) {
+            break;
+        }
+
+        // delta(l) = delta(l+1) * W^T, masked by the ReLU derivative
+        float *previousDelta = ws.deltas[l].data();
+        std::fill(previousDelta, previousDelta + rows * inSize, 0.0f);
+        Gemm::multiplyNT(rows, inSize, outSize, layerDelta,
+                         parameters.constData() + weightOffsets[l], previousDelta);
+
+        const float *activation = ws.activations[l].constData();
+        for (int i = 0; i < rows * inSize; i++) {
+            if (activation[i] <= 0.0f) {
+                previousDelta[i] = 0.0f;
+            }
+        }
+    }
+}
+
+void NeuralNetwork::predict(int rows, Workspace &ws, int *classes) const
+{
+    forward(rows, ws);
+
+    const int outSize = outputSize();
+    const float *probabilities = ws.activations[layerCount()].constData();
+    for (int r = 0; r < rows; r++) {
+        const float *p = probabilities + r * outSize;
+        classes[r] = static_cast<int>(std::max_element(p, p + outSize) - p);
+    }
+}
+
+void NeuralNetwork::applyGradients(const QVector<float> &gradients, Optimizer optimizer, float learningRate)
+{
+    const int count = parameters.size();
+    float *params = parameters.data();
+    float *m1 = moment1.data();
+    float *m2 = moment2.data();
+    const float *g = gradients.constData();
+
+    step++;
+
+    if (optimizer == Optimizer::Sgd) {
+        const float momentum = 0.9f;
+        for (int i = 0; i < count; i++) {
+            m1[i] = momentum * m1[i] + g[i];
+            params[i] -= learningRate * m1[i];
+        }
+        return;
+    }
+
+    const float beta1 = 0.9f;
+    const float beta2 = 0.999f;
+    const float epsilon = 1e-8f;
+    const float correction1 = 1.0f - qPow(beta1, step);
+    const float correction2 = 1.0f - qPow(beta2, step);
+    const float stepSize = learningRate * qSqrt(correction2) / correction1;
+
+    for (int i = 0; i < count; i++) {
+        m1[i] = beta1 * m1[i] + (1.0f - beta1) * g[i];
+        m2[i] = beta2 * m2[i] + (1.0f - beta2) * g[i] * g[i];
+        params[i] -= stepSize * m1[i] / (qSqrt(m2[i]) + epsilon);
+    }
+}
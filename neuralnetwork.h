@@ -0,0 +1,67 @@
+#ifndef NEURALNETWORK_H
+#define NEURALNETWORK_H
+
+#include <QVector>
+
+// Optimizers supported by NeuralNetwork::applyGradients
+enum class Optimizer {
+    Sgd,    // Mini-batch SGD with momentum
+    Adam
+};
+
+// Small fully connected classifier: ReLU hidden layers and a softmax output
+// trained with cross-entropy loss. Parameters live in one flat array
+// (W0, b0, W1, b1, ...) so gradients from several threads can be summed with
+// a single loop.
+class NeuralNetwork
+{
+public:
+    // Scratch buffers for one forward/backward pass over up to maxRows samples.
+    // Each worker thread owns one, including its own gradient accumulator.
+    struct Workspace {
+        int maxRows = 0;
+        QVector<QVector<float>> activations;  // Per layer, rows x layer size
+        QVector<QVector<float>> deltas;       // Per layer, rows x layer size
+        QVector<float> gradients;             // Same layout as the parameters
+        QVector<float> inputs;                // Gathered input rows
+        QVector<int> labels;                  // Gathered labels
+    };
+
+    // layerSizes = {inputs, hidden..., outputs}
+    NeuralNetwork(const QVector<int> &layerSizes, quint32 seed);
+
+    int inputSize() const { return sizes.first(); }
+    int outputSize() const { return sizes.last(); }
+    int parameterCount() const { return parameters.size(); }
+
+    Workspace createWorkspace(int maxRows) const;
+
+    // Forward and backward pass over `rows` samples taken from ws.inputs and
+    // ws.labels. Gradients scaled by gradientScale are added to ws.gradients;
+    // the summed loss and the number of correct predictions are added to
+    // loss and correct.
+    void accumulateGradients(int rows, float gradientScale, Workspace &ws,
+                             double &loss, int &correct) const;
+
+    // Predicted class for each of `rows` samples in ws.inputs
+    void predict(int rows, Workspace &ws, int *classes) const;
+
+    // One optimizer step using the summed gradients
+    void applyGradients(const QVector<float> &gradients, Optimizer optimizer, float learningRate);
+
+private:
+    int layerCount() const { return sizes.size() - 1; }
+    void forward(int rows, Workspace &ws) const;
+
+    QVector<int> sizes;
+    QVector<float> parameters;
+    QVector<int> weightOffsets;
+    QVector<int> biasOffsets;
+
+    // Optimizer state (momentum for SGD, first/second moments for Adam)
+    QVector<float> moment1;
+    QVector<float> moment2;
+    int step;
+};
+
+#endif // NEURALNETWORK_H
@@ -0,0 +1,98 @@
+#include "outlierdetector.h"
+#include <QtMath>
+#include <limits>
+#include "parallel.h"
+#include "trace.h"
+
+namespace OutlierDetector {
+
+AreaDistance::AreaDistance(const AreaDefinition &area)
+    : centerX(area.centerX)
+    , centerY(area.centerY)
+{
+    // Inverse of the covariance matrix
+    const AreaCovariance covariance = areaCovariance(area);
+    const double determinant = covariance.xx * covariance.yy - covariance.xy * covariance.xy;
+    inverseXX = covariance.yy / determinant;
+    inverseXY = -covariance.xy / determinant;
+    inverseYY = covariance.xx / determinant;
+}
+
+bool isOutside(const PointDataSave &point, const AreaDefinition &area, double threshold)
+{
+    return isBeyond(AreaDistance(area).squared(point.x, point.y), distanceCutoff(threshold));
+}
+
+// exp(-d^2 / 2) < threshold  <=>  d^2 > -2 ln(threshold)
+double distanceCutoff(double threshold)
+{
+    if (threshold <= 0) {
+        return std::numeric_limits<double>::infinity();
+    }
+    return -2.0 * qLn(threshold);
+}
+
+float distanceKey(double squared)
+{
+    const double largest = std::numeric_limits<float>::max();
+    return static_cast<float>(qBound(-largest, squared, largest));
+}
+
+qint64 markOutside(const PointStore &points, const QVector<AreaDefinition> &areas,
+                   QVector<quint8> *flags, double threshold)
+{
+    TraceSpan span("OutlierDetector::markOutside");
+
+    // Definition of each area slot of the store (-1 if none)
+    const QVector<int> &areaNumbers = points.getAreaNumbers();
+    QVector<int> definitionForSlot(areaNumbers.size(), -1);
+    for (int slot = 0; slot < areaNumbers.size(); slot++) {
+        for (int i = 0; i < areas.size(); i++) {
+            if (areas[i].areaNumber == areaNumbers[slot]) {
+                definitionForSlot[slot] = i;
+                break;
+            }
+        }
+    }
+
+    if (flags) {
+        flags->resize(points.size());
+    }
+    quint8 *flagData = flags ? flags->data() : nullptr;
+
+    const qsizetype minChunk = 4096;
+    QVector<qint64> taskCounts(Parallel::rangeCount(points.size(), minChunk), 0);
+    qint64 *countData = taskCounts.data();
+    const int *definitions = definitionForSlot.constData();
+    QVector<AreaDistance> distances;
+    for (const AreaDefinition &area : areas) {
+        distances.append(AreaDistance(area));
+    }
+    const AreaDistance *distanceData = distances.constData();
+    const float cutoff = distanceKey(distanceCutoff(threshold));
+
+    Parallel::forRange(points.size(), minChunk, [&](int task, qsizetype begin, qsizetype end) {
+        qint64 count = 0;
+        points.forEachRun(begin, end, [&](qsizetype first, qsizetype length, const qint16 *xs, const qint16 *ys,
+                                          const quint16 *areaIndices) {
+            for (qsizetype k = 0; k < length; k++) {
+                const int definition = definitions[areaIndices[k]];
+                const bool outside = definition >= 0
+                                     && distanceKey(distanceData[definition].squared(xs[k], ys[k])) > cutoff;
+                if (flagData) {
+                    flagData[first + k] = outside ? 1 : 0;
+                }
+                count += outside ? 1 : 0;
+            }
+        });
+        countData[task] = count;
+    });
+
+    qint64 total = 0;
+    for (qint64 count : taskCounts) {
+        total += count;
+    }
+    return total;
+}
+
+} // namespace OutlierDetector
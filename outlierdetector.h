@@ -0,0 +1,66 @@
+#ifndef OUTLIERDETECTOR_H
+#define OUTLIERDETECTOR_H
+
+#include <QVector>
+#include "areadefinition.h"
+#include "pointstore.h"
+
+// Outlier test of the "Mark Outside" feature: a point is outside its area
+// if the Gaussian of its area at the point is below a fraction of the
+// maximum at the center, i.e. if its Mahalanobis distance from the center
+// is beyond a cutoff.
+namespace OutlierDetector {
+
+// Default fraction of the maximum probability
+const double DefaultThreshold = 0.05;
+
+// Squared Mahalanobis distance from the center of an area, with the inverse
+// covariance computed once for testing many points. For an area that is
+// not rotated this is ((x - cx) / sx)^2 + ((y - cy) / sy)^2.
+class AreaDistance
+{
+public:
+    explicit AreaDistance(const AreaDefinition &area);
+
+    double squared(double x, double y) const
+    {
+        const double dx = x - centerX;
+        const double dy = y - centerY;
+        return inverseXX * dx * dx + 2.0 * inverseXY * dx * dy + inverseYY * dy * dy;
+    }
+
+private:
+    double centerX;
+    double centerY;
+    double inverseXX;
+    double inverseXY;
+    double inverseYY;
+};
+
+bool isOutside(const PointDataSave &point, const AreaDefinition &area,
+               double threshold = DefaultThreshold);
+
+// Squared Mahalanobis distance from the center beyond which a point is
+// outside at threshold
+double distanceCutoff(double threshold);
+
+// Single-precision value of a squared distance or cutoff, clamped to the
+// float range. Distances are compared with cutoffs in this precision, the
+// precision of OutlierIndex's sort keys, so the detector and the index agree
+// on points that land on the cutoff.
+float distanceKey(double squared);
+
+inline bool isBeyond(double squared, double cutoff)
+{
+    return distanceKey(squared) > distanceKey(cutoff);
+}
+
+// Test every point of the store in parallel. flags (resized to the store)
+// receives 1 for points outside their area and 0 otherwise; points of areas
+// without a definition are never outside. Returns the number of outliers.
+qint64 markOutside(const PointStore &points, const QVector<AreaDefinition> &areas,
+                   QVector<quint8> *flags = nullptr, double threshold = DefaultThreshold);
+
+} // namespace OutlierDetector
+
+#endif // OUTLIERDETECTOR_H
@@ -0,0 +1,245 @@
+#include "outlierindex.h"
+#include <algorithm>
+#include <cstring>
+#include "outlierdetector.h"
+#include "parallel.h"
+#include "trace.h"
+
+namespace {
+
+const qsizetype MinChunk = 1 << 16;
+
+// Sort runs of the array in parallel, then merge neighbouring runs pairwise
+void parallelSort(quint64 *data, qsizetype count)
+{
+    const int tasks = Parallel::rangeCount(count, MinChunk);
+    if (tasks <= 1) {
+        std::sort(data, data + count);
+        return;
+    }
+
+    // forRange splits the array into the same runs
+    const qsizetype run = (count + tasks - 1) / tasks;
+    Parallel::forRange(count, MinChunk, [data](int, qsizetype begin, qsizetype end) {
+        std::sort(data + begin, data + end);
+    });
+    for (qsizetype width = run; width < count; width *= 2) {
+        const int pairs = static_cast<int>((count + 2 * width - 1) / (2 * width));
+        Parallel::run(pairs, [data, count, width](int pair) {
+            const qsizetype begin = pair * 2 * width;
+            const qsizetype middle = qMin(count, begin + width);
+            const qsizetype end = qMin(count, begin + 2 * width);
+            std::inplace_merge(data + begin, data + middle, data + end);
+        });
+    }
+}
+
+// Set flags of the points of keys [begin, end) to value
+void setFlags(const QVector<quint64> &keys, qsizetype begin, qsizetype end, quint8 value, quint8 *flags)
+{
+    const quint64 *keyData = keys.constData() + begin;
+    Parallel::forRange(end - begin, MinChunk, [keyData, value, flags](int, qsizetype first, qsizetype last) {
+        for (qsizetype i = first; i < last; i++) {
+            flags[static_cast<quint32>(keyData[i])] = value;
+        }
+    });
+}
+
+bool sameShape(const AreaDefinition &a, const AreaDefinition &b)
+{
+    return a.areaNumber == b.areaNumber && a.centerX == b.centerX && a.centerY == b.centerY
+           && a.sigmaX == b.sigmaX && a.sigmaY == b.sigmaY && a.rotation == b.rotation;
+}
+
+} // namespace
+
+void OutlierIndex::build(const PointStore &points, const QVector<AreaDefinition> &definitions)
+{
+    TraceSpan span("OutlierIndex::build");
+    Q_ASSERT(points.size() <= PointStore::MaxIndexedPoints);
+
+    areas.clear();
+    for (const AreaDefinition &definition : definitions) {
+        Area area;
+        area.definition = definition;
+        areas.append(area);
+    }
+    pointCount = points.size();
+    storeVersion = points.version();
+    built = true;
+
+    // Definition of each area slot of the store (-1 if none)
+    const QVector<int> &areaNumbers = points.getAreaNumbers();
+    QVector<int> definitionForSlot(areaNumbers.size(), -1);
+    for (int slot = 0; slot < areaNumbers.size(); slot++) {
+        for (int i = 0; i < definitions.size(); i++) {
+            if (definitions[i].areaNumber == areaNumbers[slot]) {
+                definitionForSlot[slot] = i;
+                break;
+            }
+        }
+    }
+
+    const int areaCount = definitions.size();
+    const int *definitionData = definitionForSlot.constData();
+    QVector<OutlierDetector::AreaDistance> distances;
+    for (const AreaDefinition &definition : definitions) {
+        distances.append(OutlierDetector::AreaDistance(definition));
+    }
+
+    // Count the points of each area per range, so every range knows where
+    // its keys go and the keys can be written in parallel
+    const int tasks = Parallel::rangeCount(pointCount, MinChunk);
+    QVector<qsizetype> offsets(tasks * areaCount, 0);
+    qsizetype *offsetData = offsets.data();
+    Parallel::forRange(pointCount, MinChunk, [&](int task, qsizetype begin, qsizetype end) {
+        qsizetype *counts = offsetData + task * areaCount;
+        points.forEachRun(begin, end, [&](qsizetype, qsizetype length, const qint16 *, const qint16 *,
+                                          const quint16 *areaIndices) {
+            for (qsizetype k = 0; k < length; k++) {
+                const int definition = definitionData[areaIndices[k]];
+                if (definition >= 0) {
+                    counts[definition]++;
+                }
+            }
+        });
+    });
+    for (int a = 0; a < areaCount; a++) {
+        qsizetype total = 0;
+        for (int task = 0; task < tasks; task++) {
+            const qsizetype count = offsetData[task * areaCount + a];
+            offsetData[task * areaCount + a] = total;
+            total += count;
+        }
+        areas[a].keys.resize(total);
+    }
+
+    QVector<quint64 *> keyData(areaCount);
+    for (int a = 0; a < areaCount; a++) {
+        keyData[a] = areas[a].keys.data();
+    }
+    Parallel::forRange(pointCount, MinChunk, [&](int task, qsizetype begin, qsizetype end) {
+        qsizetype *next = offsetData + task * areaCount;
+        points.forEachRun(begin, end, [&](qsizetype first, qsizetype length, const qint16 *xs, const qint16 *ys,
+                                          const quint16 *areaIndices) {
+            for (qsizetype k = 0; k < length; k++) {
+                const int definition = definitionData[areaIndices[k]];
+                if (definition < 0) {
+                    continue;
+                }
+                // Rounding can make the distance of a point at the center slightly
+                // negative, and negative float bits do not sort like the numbers
+                const float distance =
+                    qMax(0.0f, OutlierDetector::distanceKey(distances[definition].squared(xs[k], ys[k])));
+                quint32 bits;
+                std::memcpy(&bits, &distance, sizeof(bits));
+                keyData[definition][next[definition]++] = (quint64(bits) << 32) | static_cast<quint32>(first + k);
+            }
+        });
+    });
+
+    for (Area &area : areas) {
+        parallelSort(area.keys.data(), area.keys.size());
+        area.outsideBegin = area.keys.size();
+    }
+}
+
+void OutlierIndex::clear()
+{
+    areas.clear();
+    pointCount = 0;
+    storeVersion = 0;
+    built = false;
+}
+
+bool OutlierIndex::isBuiltFor(const PointStore &points, const QVector<AreaDefinition> &definitions) const
+{
+    if (!built || pointCount != points.size() || storeVersion != points.version()
+        || areas.size() != definitions.size()) {
+        return false;
+    }
+    for (int a = 0; a < areas.size(); a++) {
+        if (!sameShape(areas[a].definition, definitions[a])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Index of the first key whose distance is beyond the cutoff of threshold
+qsizetype OutlierIndex::cutoffIndex(const Area &area, double threshold)
+{
+    // Keys and cutoff are compared in the same single precision as in
+    // OutlierDetector::markOutside
+    const float cutoff = OutlierDetector::distanceKey(OutlierDetector::distanceCutoff(threshold));
+    if (cutoff < 0) {
+        return 0;
+    }
+    const float limit = qMax(0.0f, cutoff);
+    quint32 bits;
+    std::memcpy(&bits, &limit, sizeof(bits));
+    const quint64 bound = (quint64(bits) << 32) | 0xFFFFFFFFu;
+    return std::upper_bound(area.keys.constBegin(), area.keys.constEnd(), bound) - area.keys.constBegin();
+}
+
+qint64 OutlierIndex::markOutside(const QVector<double> &thresholds, QVector<quint8> *flags)
+{
+    TraceSpan span("OutlierIndex::markOutside");
+
+    flags->fill(0, pointCount);
+    quint8 *flagData = flags->data();
+    for (int a = 0; a < areas.size(); a++) {
+        Area &area = areas[a];
+        area.outsideBegin = cutoffIndex(area, thresholds.value(a, OutlierDetector::DefaultThreshold));
+        setFlags(area.keys, area.outsideBegin, area.keys.size(), 1, flagData);
+    }
+    return totalOutsideCount();
+}
+
+qint64 OutlierIndex::updateThresholds(const QVector<double> &thresholds, QVector<quint8> *flags)
+{
+    TraceSpan span("OutlierIndex::updateThresholds");
+
+    if (flags->size() != pointCount) {
+        return markOutside(thresholds, flags);
+    }
+
+    quint8 *flagData = flags->data();
+    for (int a = 0; a < areas.size(); a++) {
+        Area &area = areas[a];
+        const qsizetype begin = cutoffIndex(area, thresholds.value(a, OutlierDetector::DefaultThreshold));
+        if (begin < area.outsideBegin) {
+            setFlags(area.keys, begin, area.outsideBegin, 1, flagData);
+        } else if (begin > area.outsideBegin) {
+            setFlags(area.keys, area.outsideBegin, begin, 0, flagData);
+        }
+        area.outsideBegin = begin;
+    }
+    return totalOutsideCount();
+}
+
+qint64 OutlierIndex::outsideCount(int area) const
+{
+    if (area < 0 || area >= areas.size()) {
+        return 0;
+    }
+    return areas[area].keys.size() - areas[area].outsideBegin;
+}
+
+qint64 OutlierIndex::totalOutsideCount() const
+{
+    qint64 total = 0;
+    for (int a = 0; a < areas.size(); a++) {
+        total += outsideCount(a);
+    }
+    return total;
+}
+
+qint64 OutlierIndex::memoryBytes() const
+{
+    qint64 bytes = 0;
+    for (const Area &area : areas) {
+        bytes += area.keys.capacity() * qint64(sizeof(quint64));
+    }
+    return bytes;
+}
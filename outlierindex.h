@@ -0,0 +1,62 @@
+#ifndef OUTLIERINDEX_H
+#define OUTLIERINDEX_H
+
+#include <QVector>
+#include "areadefinition.h"
+#include "pointstore.h"
+
+// The points of each area sorted by their squared Mahalanobis distance from
+// the area center (OutlierDetector::AreaDistance). A threshold on the
+// probability is a cutoff on this distance, so the outliers of an area are a
+// suffix of its sorted points: after one parallel sort, the outlier count
+// for any threshold is a binary search, and moving a threshold only touches
+// the points between the old and the new cutoff.
+class OutlierIndex
+{
+public:
+    // Compute and sort the distances of every point of the store; points of
+    // areas without a definition are never outside and are left out. The
+    // sort keys hold 32-bit point indices, so the store must have at most
+    // PointStore::MaxIndexedPoints points.
+    void build(const PointStore &points, const QVector<AreaDefinition> &areas);
+    void clear();
+
+    // Whether the index was built from this version of the store and from
+    // areas with the same numbers, centers, sigmas and rotations
+    bool isBuiltFor(const PointStore &points, const QVector<AreaDefinition> &areas) const;
+
+    // Write all flags (resized to the store) for per-area thresholds, given
+    // as fractions of the maximum probability in the order of the areas the
+    // index was built from. Returns the number of outliers.
+    qint64 markOutside(const QVector<double> &thresholds, QVector<quint8> *flags);
+
+    // Move the thresholds of flags written by markOutside(); only the points
+    // that change state are written. Returns the number of outliers.
+    qint64 updateThresholds(const QVector<double> &thresholds, QVector<quint8> *flags);
+
+    // Outliers of one area / of all areas at the current thresholds
+    qint64 outsideCount(int area) const;
+    qint64 totalOutsideCount() const;
+
+    // Heap memory of the sorted keys
+    qint64 memoryBytes() const;
+
+private:
+    struct Area {
+        AreaDefinition definition;
+        // Float bits of the distance in the high word, point index in the low
+        // word; the float bits of non-negative numbers sort like the numbers
+        QVector<quint64> keys;
+        // First key of the outliers at the current threshold
+        qsizetype outsideBegin = 0;
+    };
+
+    static qsizetype cutoffIndex(const Area &area, double threshold);
+
+    QVector<Area> areas;
+    qsizetype pointCount = 0;
+    quint64 storeVersion = 0;
+    bool built = false;
+};
+
+#endif // OUTLIERINDEX_H
@@ -0,0 +1,177 @@
+#include "parallel.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Set on pool workers and on a thread while it runs a job, so nested calls
+// run inline instead of deadlocking on the pool
+thread_local bool insideParallelJob = false;
+
+// Pool size requested with setThreadCount() (0 = hardware concurrency)
+std::atomic<int> requestedThreads{0};
+
+// Persistent worker pool shared by all Parallel::run() callers.
+// Jobs are serialized: one job at a time occupies every worker.
+class WorkerPool
+{
+public:
+    WorkerPool()
+    {
+        int size = requestedThreads.load();
+        if (size <= 0) {
+            size = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        }
+        int workers = size - 1;
+        for (int i = 0; i < workers; i++) {
+            threads.emplace_back([this, i] {
+                Trace::setThreadName(QString("Parallel worker %1").arg(i + 1));
+                workerLoop();
+            });
+        }
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            stopping = true;
+        }
+        wakeCondition.notify_all();
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
+
+    int size() const
+    {
+        return static_cast<int>(threads.size()) + 1;
+    }
+
+    void run(int taskCount, const std::function<void(int)> &fn)
+    {
+        std::lock_guard<std::mutex> jobLock(jobMutex);
+
+        {
+            std::lock_guard<std::mutex> lock(stateMutex);
+            job = &fn;
+            jobTasks = taskCount;
+            nextTask.store(0);
+            busyWorkers = static_cast<int>(threads.size());
+            generation++;
+        }
+        wakeCondition.notify_all();
+
+        // The caller works too
+        insideParallelJob = true;
+        runTasks(fn, taskCount);
+        insideParallelJob = false;
+
+        std::unique_lock<std::mutex> lock(stateMutex);
+        doneCondition.wait(lock, [this] { return busyWorkers == 0; });
+        job = nullptr;
+    }
+
+private:
+    void runTasks(const std::function<void(int)> &fn, int taskCount)
+    {
+        for (int task = nextTask.fetch_add(1); task < taskCount; task = nextTask.fetch_add(1)) {
+            TraceSpan span("Parallel task");
+            fn(task);
+        }
+    }
+
+    void workerLoop()
+    {
+        insideParallelJob = true;
+        quint64 seenGeneration = 0;
+
+        for (;;) {
+            const std::function<void(int)> *currentJob;
+            int taskCount;
+            {
+                std::unique_lock<std::mutex> lock(stateMutex);
+                wakeCondition.wait(lock, [&] { return stopping || generation != seenGeneration; });
+                if (stopping) {
+                    return;
+                }
+                seenGeneration = generation;
+                currentJob = job;
+                taskCount = jobTasks;
+            }
+
+            runTasks(*currentJob, taskCount);
+
+            {
+                std::lock_guard<std::mutex> lock(stateMutex);
+                busyWorkers--;
+            }
+            doneCondition.notify_one();
+        }
+    }
+
+    std::vector<std::thread> threads;
+    std::mutex jobMutex;
+    std::mutex stateMutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+    const std::function<void(int)> *job = nullptr;
+    int jobTasks = 0;
+    std::atomic<int> nextTask{0};
+    int busyWorkers = 0;
+    quint64 generation = 0;
+    bool stopping = false;
+};
+
+WorkerPool &pool()
+{
+    static WorkerPool instance;
+    return instance;
+}
+
+} // namespace
+
+namespace Parallel {
+
+int threadCount()
+{
+    return pool().size();
+}
+
+void setThreadCount(int count)
+{
+    requestedThreads = count;
+}
+
+void run(int taskCount, const std::function<void(int task)> &fn)
+{
+    if (taskCount <= 0) {
+        return;
+    }
+
+    if (taskCount == 1 || insideParallelJob) {
+        for (int task = 0; task < taskCount; task++) {
+            fn(task);
+        }
+        return;
+    }
+
+    pool().run(taskCount, fn);
+}
+
+int rangeCount(qsizetype count, qsizetype minChunk)
+{
+    if (count <= 0) {
+        return 0;
+    }
+
+    qsizetype byChunk = count / qMax<qsizetype>(1, minChunk);
+    return static_cast<int>(qBound<qsizetype>(1, byChunk, threadCount()));
+}
+
+} // namespace Parallel
@@ -0,0 +1,49 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <QtGlobal>
+#include <functional>
+
+namespace Parallel {
+
+// Number of worker threads used by the parallel helpers (hardware concurrency
+// unless set with setThreadCount)
+int threadCount();
+
+// Size of the worker pool, including the calling thread; 0 selects the
+// hardware concurrency. Only takes effect before the first parallel call.
+void setThreadCount(int count);
+
+// Run fn(task) for task in [0, taskCount) on the shared worker pool.
+// The calling thread takes part in the work and the call blocks until every
+// task has finished. Nested calls from inside a task run serially.
+void run(int taskCount, const std::function<void(int task)> &fn);
+
+// Split [0, count) into at most threadCount() contiguous ranges of at least
+// minChunk elements and run fn(task, begin, end) for each range in parallel.
+// Returns the number of ranges (tasks) used, so callers can size per-thread
+// accumulators up front with rangeCount().
+int rangeCount(qsizetype count, qsizetype minChunk = 1);
+
+template<typename Fn>
+int forRange(qsizetype count, qsizetype minChunk, Fn fn)
+{
+    const int tasks = rangeCount(count, minChunk);
+    if (tasks == 0) {
+        return 0;
+    }
+
+    const qsizetype chunk = (count + tasks - 1) / tasks;
+    run(tasks, [&](int task) {
+        qsizetype begin = task * chunk;
+        qsizetype end = qMin(count, begin + chunk);
+        if (begin < end) {
+            fn(task, begin, end);
+        }
+    });
+    return tasks;
+}
+
+} // namespace Parallel
+
+#endif // PARALLEL_H
@@ -0,0 +1,48 @@
+#include "perfcounters.h"
+#include <atomic>
+
+namespace {
+
+std::atomic<qint64> generatedPoints{0};
+std::atomic<qint64> generationNanoseconds{0};
+std::atomic<qint64> pointStoreBytes{0};
+std::atomic<qint64> lastLoadMilliseconds{-1};
+std::atomic<qint64> lastSaveMilliseconds{-1};
+
+} // namespace
+
+namespace PerfCounters {
+
+void recordGeneration(qint64 points, qint64 nanoseconds)
+{
+    generatedPoints.store(points, std::memory_order_relaxed);
+    generationNanoseconds.store(nanoseconds, std::memory_order_relaxed);
+}
+
+void recordLoad(qint64 milliseconds)
+{
+    lastLoadMilliseconds.store(milliseconds, std::memory_order_relaxed);
+}
+
+void recordSave(qint64 milliseconds)
+{
+    lastSaveMilliseconds.store(milliseconds, std::memory_order_relaxed);
+}
+
+void setPointStoreBytes(qint64 bytes)
+{
+    pointStoreBytes.store(bytes, std::memory_order_relaxed);
+}
+
+Snapshot snapshot()
+{
+    Snapshot result;
+    result.generatedPoints = generatedPoints.load(std::memory_order_relaxed);
+    result.generationNanoseconds = generationNanoseconds.load(std::memory_order_relaxed);
+    result.pointStoreBytes = pointStoreBytes.load(std::memory_order_relaxed);
+    result.lastLoadMilliseconds = lastLoadMilliseconds.load(std::memory_order_relaxed);
+    result.lastSaveMilliseconds = lastSaveMilliseconds.load(std::memory_order_relaxed);
+    return result;
+}
+
+} // namespace PerfCounters
@@ -0,0 +1,33 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <QtGlobal>
+
+// Counters the engine updates as it works, read by the performance overlay.
+// They are relaxed atomics, so updating one costs about as much as a plain
+// store; readers get recent values, not a consistent snapshot.
+namespace PerfCounters {
+
+struct Snapshot {
+    qint64 generatedPoints = 0;        // Points of the last generation
+    qint64 generationNanoseconds = 0;  // and the time it took
+    qint64 pointStoreBytes = 0;        // Memory of the points held by the application
+    qint64 lastLoadMilliseconds = -1;  // -1 until the first load/save
+    qint64 lastSaveMilliseconds = -1;
+
+    double generationPointsPerSecond() const
+    {
+        return generationNanoseconds > 0 ? generatedPoints / (generationNanoseconds / 1e9) : 0.0;
+    }
+};
+
+void recordGeneration(qint64 points, qint64 nanoseconds);
+void recordLoad(qint64 milliseconds);
+void recordSave(qint64 milliseconds);
+void setPointStoreBytes(qint64 bytes);
+
+Snapshot snapshot();
+
+} // namespace PerfCounters
+
+#endif // PERFCOUNTERS_H
@@ -0,0 +1,172 @@
+#include "persistenceworker.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include "areasettings.h"
+#include "perfcounters.h"
+#include "pointjournal.h"
+#include "trace.h"
+
+PersistenceWorker::PersistenceWorker(QObject *parent)
+    : QObject(parent)
+    , writer(new QObject)
+    , settingsPending(false)
+    , pointsPending(false)
+{
+    thread.setObjectName("PersistenceWorker");
+    writer->moveToThread(&thread);
+    thread.start(QThread::LowPriority);
+
+    debounce.setSingleShot(true);
+    debounce.setInterval(500);
+    connect(&debounce, &QTimer::timeout, this, &PersistenceWorker::dispatch);
+}
+
+PersistenceWorker::~PersistenceWorker()
+{
+    flush();
+    thread.quit();
+    thread.wait();
+    delete writer;
+}
+
+void PersistenceWorker::setDebounceInterval(int milliseconds)
+{
+    debounce.setInterval(milliseconds);
+}
+
+void PersistenceWorker::saveSettings(const QString &filePath, const QVector<AreaDefinition> &areas)
+{
+    pendingSettings = {filePath, areas};
+    settingsPending = true;
+    debounce.start();
+}
+
+void PersistenceWorker::savePoints(const QString &filePath, PointFileFormat format, const PointStore &points,
+                                   const QVector<AreaDefinition> &areas, const QStringList &obsoleteFiles)
+{
+    pendingPoints = {filePath, format, points, areas, obsoleteFiles};
+    pointsPending = true;
+    debounce.start();
+}
+
+void PersistenceWorker::appendPoints(const QString &journalPath, quint64 basePointCount, quint64 baseFingerprint,
+                                     const PointStore &block)
+{
+    QMetaObject::invokeMethod(writer, [this, journalPath, basePointCount, baseFingerprint, block]() {
+        QElapsedTimer timer;
+        timer.start();
+
+        QString error;
+        if (!PointJournal::append(journalPath, basePointCount, baseFingerprint, block, 0, block.size(), &error)) {
+            QMetaObject::invokeMethod(this, [this, journalPath, error]() {
+                emit saveFailed(journalPath, error);
+            }, Qt::QueuedConnection);
+            return;
+        }
+
+        const qint64 pointCount = block.size();
+        const qint64 milliseconds = timer.elapsed();
+        QMetaObject::invokeMethod(this, [this, journalPath, pointCount, milliseconds]() {
+            emit pointsAppended(journalPath, pointCount, milliseconds);
+        }, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+}
+
+bool PersistenceWorker::hasPendingPoints() const
+{
+    return pointsPending;
+}
+
+void PersistenceWorker::removePoints(const QStringList &files)
+{
+    // A pending write would bring the files back
+    pointsPending = false;
+    pendingPoints = PointsSnapshot();
+
+    QMetaObject::invokeMethod(writer, [files]() {
+        for (const QString &file : files) {
+            QFile::remove(file);
+        }
+    }, Qt::QueuedConnection);
+}
+
+void PersistenceWorker::flush()
+{
+    debounce.stop();
+    dispatch();
+
+    // Jobs run in order, so an empty blocking job returns once all are done
+    QMetaObject::invokeMethod(writer, []() {}, Qt::BlockingQueuedConnection);
+}
+
+// Hand the pending snapshots to the writer thread
+void PersistenceWorker::dispatch()
+{
+    if (settingsPending) {
+        SettingsSnapshot snapshot = pendingSettings;
+        settingsPending = false;
+        pendingSettings = SettingsSnapshot();
+        QMetaObject::invokeMethod(writer, [this, snapshot]() {
+            writeSettings(snapshot);
+        }, Qt::QueuedConnection);
+    }
+
+    if (pointsPending) {
+        PointsSnapshot snapshot = pendingPoints;
+        pointsPending = false;
+        pendingPoints = PointsSnapshot();
+        QMetaObject::invokeMethod(writer, [this, snapshot]() {
+            writePoints(snapshot);
+        }, Qt::QueuedConnection);
+    }
+}
+
+// Runs on the writer thread
+void PersistenceWorker::writeSettings(const SettingsSnapshot &snapshot)
+{
+    TraceSpan span("PersistenceWorker::writeSettings");
+
+    if (!AreaSettings::save(snapshot.filePath, snapshot.areas)) {
+        const QString filePath = snapshot.filePath;
+        QMetaObject::invokeMethod(this, [this, filePath]() {
+            emit saveFailed(filePath, tr("Could not write the settings file"));
+        }, Qt::QueuedConnection);
+    }
+}
+
+// Runs on the writer thread
+void PersistenceWorker::writePoints(const PointsSnapshot &snapshot)
+{
+    TraceSpan span("PersistenceWorker::writePoints");
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QString error;
+    CompressionStats stats;
+    bool ok;
+    if (snapshot.format == PointFileFormat::Compressed) {
+        ok = PointFile::saveCompressed(snapshot.filePath, snapshot.points, snapshot.areas, &error, &stats);
+    } else {
+        ok = PointFile::save(snapshot.filePath, snapshot.format, snapshot.points, snapshot.areas, &error);
+    }
+
+    const QString filePath = snapshot.filePath;
+    if (!ok) {
+        QMetaObject::invokeMethod(this, [this, filePath, error]() {
+            emit saveFailed(filePath, error);
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    for (const QString &file : snapshot.obsoleteFiles) {
+        QFile::remove(file);
+    }
+
+    const qint64 pointCount = snapshot.points.size();
+    const qint64 milliseconds = timer.elapsed();
+    PerfCounters::recordSave(milliseconds);
+    QMetaObject::invokeMethod(this, [this, filePath, pointCount, milliseconds, stats]() {
+        emit pointsSaved(filePath, pointCount, milliseconds, stats);
+    }, Qt::QueuedConnection);
+}
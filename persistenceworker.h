@@ -0,0 +1,91 @@
+#ifndef PERSISTENCEWORKER_H
+#define PERSISTENCEWORKER_H
+
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <QStringList>
+#include <QVector>
+#include "areadefinition.h"
+#include "pointstore.h"
+#include "pointfile.h"
+
+// Write-behind persistence of the area definitions and the points.
+// Save requests only store a snapshot of the data; PointStore and QVector are
+// implicitly shared, so a snapshot costs a reference count until the caller
+// modifies its copy. Requests arriving within the debounce interval replace
+// the pending snapshot, and the last one is written on a dedicated thread.
+// Points files are written through QSaveFile and the settings through
+// QSettings (which also replaces the file atomically). flush() writes
+// whatever is pending and waits for the writer; call it before exit or
+// before reading the files back.
+class PersistenceWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PersistenceWorker(QObject *parent = nullptr);
+    ~PersistenceWorker();
+
+    void setDebounceInterval(int milliseconds);
+
+    // Schedule a write of the area definitions to an INI file
+    void saveSettings(const QString &filePath, const QVector<AreaDefinition> &areas);
+
+    // Schedule a write of the points; obsoleteFiles are removed once the
+    // new file is in place
+    void savePoints(const QString &filePath, PointFileFormat format, const PointStore &points,
+                    const QVector<AreaDefinition> &areas, const QStringList &obsoleteFiles = QStringList());
+
+    // Append a block of new points to the journal at journalPath. The block
+    // is queued right away (appends are not coalesced); it is written after
+    // any full save already handed to the writer.
+    void appendPoints(const QString &journalPath, quint64 basePointCount, quint64 baseFingerprint,
+                      const PointStore &block);
+
+    // A full points save is waiting for the debounce interval
+    bool hasPendingPoints() const;
+
+    // Drop any pending points write and delete the files in write order
+    void removePoints(const QStringList &files);
+
+    // Write pending snapshots now and block until the writer is idle
+    void flush();
+
+signals:
+    // Emitted on the thread that owns the worker after a points write
+    void pointsSaved(const QString &filePath, qint64 pointCount, qint64 milliseconds,
+                     const CompressionStats &stats);
+    void pointsAppended(const QString &journalPath, qint64 pointCount, qint64 milliseconds);
+    void saveFailed(const QString &filePath, const QString &errorMessage);
+
+private:
+    struct SettingsSnapshot {
+        QString filePath;
+        QVector<AreaDefinition> areas;
+    };
+
+    struct PointsSnapshot {
+        QString filePath;
+        PointFileFormat format;
+        PointStore points;
+        QVector<AreaDefinition> areas;
+        QStringList obsoleteFiles;
+    };
+
+    QThread thread;
+    QObject *writer;     // Lives on thread; queued jobs run in its context
+    QTimer debounce;
+
+    // Pending snapshots, only touched on the owning thread
+    bool settingsPending;
+    bool pointsPending;
+    SettingsSnapshot pendingSettings;
+    PointsSnapshot pendingPoints;
+
+    void dispatch();
+    void writeSettings(const SettingsSnapshot &snapshot);
+    void writePoints(const PointsSnapshot &snapshot);
+};
+
+#endif // PERSISTENCEWORKER_H
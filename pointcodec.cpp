@@ -0,0 +1,82 @@
+#include "pointcodec.h"
+
+namespace {
+
+inline quint32 zigzagEncode(qint32 value)
+{
+    return (static_cast<quint32>(value) << 1) ^ static_cast<quint32>(value >> 31);
+}
+
+inline qint32 zigzagDecode(quint32 value)
+{
+    return static_cast<qint32>(value >> 1) ^ -static_cast<qint32>(value & 1);
+}
+
+inline char *writeVarint(char *out, quint32 value)
+{
+    while (value >= 0x80) {
+        *out++ = static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<char>(value);
+    return out;
+}
+
+inline bool readVarint(const uchar *&in, const uchar *end, quint32 &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 35 && in < end; shift += 7) {
+        const uchar byte = *in++;
+        value |= static_cast<quint32>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+namespace PointCodec {
+
+QByteArray encodeBlock(const qint16 *xs, const qint16 *ys, int count)
+{
+    // A 17-bit zigzag delta needs at most 3 varint bytes per coordinate
+    QByteArray raw(count * 6, Qt::Uninitialized);
+    char *out = raw.data();
+
+    qint32 previousX = 0;
+    qint32 previousY = 0;
+    for (int i = 0; i < count; i++) {
+        out = writeVarint(out, zigzagEncode(xs[i] - previousX));
+        out = writeVarint(out, zigzagEncode(ys[i] - previousY));
+        previousX = xs[i];
+        previousY = ys[i];
+    }
+    raw.truncate(static_cast<int>(out - raw.constData()));
+
+    return qCompress(raw);
+}
+
+bool decodeBlock(const uchar *data, int size, int count, qint16 *xs, qint16 *ys)
+{
+    const QByteArray raw = qUncompress(data, size);
+    const uchar *in = reinterpret_cast<const uchar *>(raw.constData());
+    const uchar *end = in + raw.size();
+
+    qint32 x = 0;
+    qint32 y = 0;
+    for (int i = 0; i < count; i++) {
+        quint32 dx, dy;
+        if (!readVarint(in, end, dx) || !readVarint(in, end, dy)) {
+            return false;
+        }
+        x += zigzagDecode(dx);
+        y += zigzagDecode(dy);
+        xs[i] = static_cast<qint16>(x);
+        ys[i] = static_cast<qint16>(y);
+    }
+    return in == end;
+}
+
+} // namespace PointCodec
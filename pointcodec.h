@@ -0,0 +1,38 @@
+#ifndef POINTCODEC_H
+#define POINTCODEC_H
+
+#include <QByteArray>
+#include <QtGlobal>
+
+// Block codec for the compressed points format.
+// A block holds points of a single area sorted in Morton (Z-order) order, so
+// consecutive points are spatial neighbours. Coordinates are stored as
+// differences to the previous point, zigzag-mapped to unsigned and written
+// as LEB128 varints (small deltas take one byte), then the byte stream is
+// deflated with qCompress. Blocks are independent and can be decoded in
+// parallel.
+namespace PointCodec {
+
+// Interleave the bits of x and y (offset to unsigned) into a Z-order key
+inline quint32 mortonCode(qint16 x, qint16 y)
+{
+    auto spread = [](quint32 v) {
+        v &= 0xFFFF;
+        v = (v | (v << 8)) & 0x00FF00FF;
+        v = (v | (v << 4)) & 0x0F0F0F0F;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+    };
+    return spread(static_cast<quint16>(x + 32768)) | (spread(static_cast<quint16>(y + 32768)) << 1);
+}
+
+// Encode count points into a compressed block
+QByteArray encodeBlock(const qint16 *xs, const qint16 *ys, int count);
+
+// Decode a block of count points; returns false if the data is corrupt
+bool decodeBlock(const uchar *data, int size, int count, qint16 *xs, qint16 *ys);
+
+} // namespace PointCodec
+
+#endif // POINTCODEC_H
@@ -0,0 +1,758 @@
+#include "pointfile.h"
+#include <QDataStream>
+#include <QFile>
+#include <QSaveFile>
+#include <QObject>
+#include <QTextStream>
+#include <QtEndian>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include "parallel.h"
+#include "pointcodec.h"
+#include "trace.h"
+
+namespace {
+
+const char Magic[8] = {'M', 'L', 'D', 'P', 'O', 'I', 'N', 'T'};
+const char CompressedMagic[8] = {'M', 'L', 'D', 'P', 'O', 'I', 'N', 'Z'};
+const quint32 FormatVersion = 1;
+const int FixedHeaderSize = 24;
+const int CompressedFixedHeaderSize = 32;
+const int AreaRecordSize = 48;
+const int BlockRecordSize = 24;
+
+// Points per compressed block; small enough to give every thread several
+// blocks, large enough for deflate to find repetition
+const int CompressedBlockPoints = 65536;
+
+// Saving packs point indices into 32 bits of the sort key
+const quint64 MaxCompressedPoints = quint64(1) << 32;
+
+void setError(QString *errorMessage, const QString &message)
+{
+    if (errorMessage) {
+        *errorMessage = message;
+    }
+}
+
+// One record per area index, filled from the matching definition
+void writeAreaTable(QDataStream &out, const QVector<int> &areaNumbers, const QVector<AreaDefinition> &areas)
+{
+    for (int areaNumber : areaNumbers) {
+        AreaDefinition area = {areaNumber, 0.0, 0.0, 0.0, 0.0, SymbolType::Cross, QColor(Qt::black)};
+        for (const AreaDefinition &candidate : areas) {
+            if (candidate.areaNumber == areaNumber) {
+                area = candidate;
+                break;
+            }
+        }
+        out << static_cast<qint32>(area.areaNumber) << static_cast<qint32>(area.symbolType)
+            << area.centerX << area.centerY << area.sigmaX << area.sigmaY
+            << static_cast<quint32>(area.color.rgba()) << quint32(0);
+    }
+}
+
+void readAreaTable(const uchar *data, quint32 areaCount, QVector<int> &areaNumbers,
+                   QVector<AreaDefinition> *areas)
+{
+    QDataStream in(QByteArray::fromRawData(reinterpret_cast<const char *>(data),
+                                           static_cast<int>(areaCount * AreaRecordSize)));
+    in.setByteOrder(QDataStream::LittleEndian);
+    for (quint32 i = 0; i < areaCount; i++) {
+        qint32 areaNumber, symbolType;
+        quint32 rgba, reserved;
+        AreaDefinition area;
+        in >> areaNumber >> symbolType >> area.centerX >> area.centerY >> area.sigmaX >> area.sigmaY
+           >> rgba >> reserved;
+        area.areaNumber = areaNumber;
+        area.symbolType = static_cast<SymbolType>(symbolType);
+        area.color = QColor::fromRgba(rgba);
+        areaNumbers.append(areaNumber);
+        if (areas) {
+            areas->append(area);
+        }
+    }
+}
+
+QByteArray buildHeader(const QVector<int> &areaNumbers, quint64 count, const QVector<AreaDefinition> &areas)
+{
+    QByteArray header;
+    QDataStream out(&header, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+
+    out.writeRawData(Magic, sizeof(Magic));
+    out << FormatVersion << static_cast<quint32>(areaNumbers.size()) << count;
+    writeAreaTable(out, areaNumbers, areas);
+    return header;
+}
+
+// A run of points of one area in the compressed format
+struct CompressedBlock {
+    quint64 offset = 0;
+    quint32 bytes = 0;
+    quint32 count = 0;
+    quint32 areaIndex = 0;
+    qsizetype first = 0;  // First point of the block in the sorted order
+    QByteArray payload;
+};
+
+// Write one column as a single block, converting to little-endian if needed
+template<typename T>
+bool writeColumn(QIODevice &file, const T *data, qsizetype count)
+{
+    const qint64 bytes = static_cast<qint64>(count) * sizeof(T);
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    return file.write(reinterpret_cast<const char *>(data), bytes) == bytes;
+#else
+    QByteArray buffer(bytes, Qt::Uninitialized);
+    qToLittleEndian<T>(data, count, buffer.data());
+    return file.write(buffer) == bytes;
+#endif
+}
+
+// Write one column of a store, a chunk at a time
+template<typename T>
+bool writeColumn(QIODevice &file, const PointStore &points, const T *(PointStore::*column)(int) const)
+{
+    for (int chunk = 0; chunk < points.chunkCount(); chunk++) {
+        if (!writeColumn(file, (points.*column)(chunk), points.chunkLength(chunk))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+namespace PointFile {
+
+bool saveBinary(const QString &filePath, const PointStore &points,
+                const QVector<AreaDefinition> &areas, QString *errorMessage)
+{
+    TraceSpan span("PointFile::saveBinary");
+
+    // Written to a temporary file that replaces the target on commit, so a
+    // crash or full disk never leaves a truncated points file behind
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        setError(errorMessage, file.errorString());
+        return false;
+    }
+
+    // Header first, then each column in one write
+    const QByteArray header = buildHeader(points.getAreaNumbers(), static_cast<quint64>(points.size()), areas);
+    bool ok = file.write(header) == header.size()
+              && writeColumn(file, points, &PointStore::xData)
+              && writeColumn(file, points, &PointStore::yData)
+              && writeColumn(file, points, &PointStore::areaIndexData)
+              && file.commit();
+
+    if (!ok) {
+        setError(errorMessage, file.errorString());
+    }
+    return ok;
+}
+
+bool loadBinary(const QString &filePath, PointStore &points,
+                QVector<AreaDefinition> *areas, QString *errorMessage)
+{
+    TraceSpan span("PointFile::loadBinary");
+
+    points.clear();
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        setError(errorMessage, file.errorString());
+        return false;
+    }
+
+    const qint64 fileSize = file.size();
+    if (fileSize < FixedHeaderSize) {
+        setError(errorMessage, QObject::tr("File is too small to be a points file"));
+        return false;
+    }
+
+    const uchar *data = file.map(0, fileSize);
+    if (!data) {
+        setError(errorMessage, file.errorString());
+        return false;
+    }
+
+    // Fixed header
+    if (std::memcmp(data, Magic, sizeof(Magic)) != 0) {
+        setError(errorMessage, QObject::tr("Not a binary points file"));
+        return false;
+    }
+    const quint32 version = qFromLittleEndian<quint32>(data + 8);
+    const quint32 areaCount = qFromLittleEndian<quint32>(data + 12);
+    const quint64 count = qFromLittleEndian<quint64>(data + 16);
+    const qint64 headerSize = FixedHeaderSize + static_cast<qint64>(areaCount) * AreaRecordSize;
+
+    if (version != FormatVersion) {
+        setError(errorMessage, QObject::tr("Unsupported points file version %1").arg(version));
+        return false;
+    }
+    // The count is checked against the file size before it is multiplied,
+    // so a corrupt count cannot overflow past the check
+    if (areaCount > 65536 || fileSize < headerSize
+        || count > static_cast<quint64>(fileSize - headerSize) / 6) {
+        setError(errorMessage, QObject::tr("Points file is truncated or corrupt"));
+        return false;
+    }
+
+    // Area table
+    QVector<int> areaNumbers;
+    readAreaTable(data + FixedHeaderSize, areaCount, areaNumbers, areas);
+
+    // Columns are copied straight out of the mapping
+    const uchar *columns = data + headerSize;
+    points.resize(static_cast<qsizetype>(count));
+    points.setAreaNumbers(areaNumbers);
+    bool invalid = false;
+    points.forEachWritableRun(0, points.size(), [&](qsizetype first, qsizetype length, qint16 *xs, qint16 *ys,
+                                                    quint16 *areaIndices) {
+        qFromLittleEndian<qint16>(columns + 2 * first, length, xs);
+        qFromLittleEndian<qint16>(columns + 2 * (count + first), length, ys);
+        qFromLittleEndian<quint16>(columns + 2 * (2 * count + first), length, areaIndices);
+
+        // Reject indices outside the area table
+        for (qsizetype i = 0; i < length; i++) {
+            invalid = invalid || areaIndices[i] >= areaCount;
+        }
+    });
+    if (invalid) {
+        points.clear();
+        setError(errorMessage, QObject::tr("Points file has an invalid area index"));
+        return false;
+    }
+
+    file.unmap(const_cast<uchar *>(data));
+    return true;
+}
+
+bool readBinaryLayout(const QString &filePath, BinaryLayout &layout, QString *errorMessage)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        setError(errorMessage, file.errorString());
+        return false;
+    }
+
+    const QByteArray fixed = file.read(FixedHeaderSize);
+    if (fixed.size() < FixedHeaderSize || std::memcmp(fixed.constData(), Magic, sizeof(Magic)) != 0) {
+        setError(errorMessage, QObject::tr("Not a binary points file"));
+        return false;
+    }
+    const uchar *data = reinterpret_cast<const uchar *>(fixed.constData());
+    const quint32 version = qFromLittleEndian<quint32>(data + 8);
+    const quint32 areaCount = qFromLittleEndian<quint32>(data + 12);
+    const quint64 count = qFromLittleEndian<quint64>(data + 16);
+    const qint64 headerSize = FixedHeaderSize + static_cast<qint64>(areaCount) * AreaRecordSize;
+
+    if (version != FormatVersion) {
+        setError(errorMessage, QObject::tr("Unsupported points file version %1").arg(version));
+        return false;
+    }
+    if (areaCount > 65536 || file.size() < headerSize
+        || count > static_cast<quint64>(file.size() - headerSize) / 6) {
+        setError(errorMessage, QObject::tr("Points file is truncated or corrupt"));
+        return false;
+    }
+
+    const QByteArray table = file.read(static_cast<qint64>(areaCount) * AreaRecordSize);
+    layout = BinaryLayout();
+    readAreaTable(reinterpret_cast<const uchar *>(table.constData()), areaCount, layout.areaNumbers, nullptr);
+    layout.pointCount = count;
+    layout.xOffset = headerSize;
+    layout.yOffset = headerSize + 2 * static_cast<qint64>(count);
+    layout.areaIndexOffset = headerSize + 4 * static_cast<qint64>(count);
+    return true;
+}
+
+bool saveCompressed(const QString &filePath, const PointStore &points,
+                    const QVector<AreaDefinition> &areas, QString *errorMessage,
+                    CompressionStats *stats)
+{
+    TraceSpan span("PointFile::saveCompressed");
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const qsizetype count = points.size();
+    const int areaCount = points.getAreaNumbers().size();
+
+    // Group the points by area (counting sort) with Morton key and point index
+    // packed in one 64-bit sort key, which leaves 32 bits for the index
+    if (static_cast<quint64>(count) > MaxCompressedPoints) {
+        setError(errorMessage, QObject::tr("Compressed points files hold at most %1 points")
+                                   .arg(MaxCompressedPoints));
+        return false;
+    }
+    QVector<qsizetype> groupStart(areaCount + 1, 0);
+    for (qsizetype i = 0; i < count; i++) {
+        groupStart[points.areaIndex(i) + 1]++;
+    }
+    for (int a = 0; a < areaCount; a++) {
+        groupStart[a + 1] += groupStart[a];
+    }
+    QVector<quint64> keys(count);
+    QVector<qsizetype> fill = groupStart;
+    points.forEachRun(0, count, [&](qsizetype first, qsizetype length, const qint16 *xs, const qint16 *ys,
+                                    const quint16 *areaIndices) {
+        for (qsizetype k = 0; k < length; k++) {
+            const quint64 morton = PointCodec::mortonCode(xs[k], ys[k]);
+            keys[fill[areaIndices[k]]++] = (morton << 32) | static_cast<quint64>(first + k);
+        }
+    });
+
+    // Sort every group spatially, one area per task
+    quint64 *keyData = keys.data();
+    Parallel::run(areaCount, [&](int a) {
+        std::sort(keyData + groupStart[a], keyData + groupStart[a + 1]);
+    });
+
+    // Cut the groups into blocks
+    QVector<CompressedBlock> blocks;
+    for (int a = 0; a < areaCount; a++) {
+        for (qsizetype first = groupStart[a]; first < groupStart[a + 1]; first += CompressedBlockPoints) {
+            CompressedBlock block;
+            block.first = first;
+            block.count = static_cast<quint32>(qMin<qsizetype>(CompressedBlockPoints, groupStart[a + 1] - first));
+            block.areaIndex = static_cast<quint32>(a);
+            blocks.append(block);
+        }
+    }
+
+    // Encode the blocks in parallel
+    CompressedBlock *blockData = blocks.data();
+    Parallel::run(blocks.size(), [&](int b) {
+        CompressedBlock &block = blockData[b];
+        QVector<qint16> blockX(block.count);
+        QVector<qint16> blockY(block.count);
+        for (quint32 i = 0; i < block.count; i++) {
+            const qsizetype point = static_cast<qsizetype>(keyData[block.first + i] & 0xFFFFFFFFu);
+            blockX[i] = static_cast<qint16>(points.x(point));
+            blockY[i] = static_cast<qint16>(points.y(point));
+        }
+        block.payload = PointCodec::encodeBlock(blockX.constData(), blockY.constData(), block.count);
+        block.bytes = static_cast<quint32>(block.payload.size());
+    });
+
+    // Header, area table and block directory
+    QByteArray header;
+    QDataStream out(&header, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out.writeRawData(CompressedMagic, sizeof(CompressedMagic));
+    out << FormatVersion << static_cast<quint32>(areaCount) << static_cast<quint64>(count)
+        << static_cast<quint32>(blocks.size()) << quint32(0);
+    writeAreaTable(out, points.getAreaNumbers(), areas);
+
+    quint64 offset = CompressedFixedHeaderSize + static_cast<quint64>(areaCount) * AreaRecordSize
+                     + static_cast<quint64>(blocks.size()) * BlockRecordSize;
+    for (CompressedBlock &block : blocks) {
+        block.offset = offset;
+        offset += block.bytes;
+        out << block.offset << block.bytes << block.count << block.areaIndex << quint32(0);
+    }
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        setError(errorMessage, file.errorString());
+        return false;
+    }
+    bool ok = file.write(header) == header.size();
+    for (int b = 0; ok && b < blocks.size(); b++) {
+        ok = file.write(blocks[b].payload) == blocks[b].payload.size();
+    }
+    ok = ok && file.commit();
+    if (!ok) {
+        setError(errorMessage, file.errorString());
+    }
+
+    if (stats) {
+        stats->rawBytes = static_cast<qint64>(count) * 6;
+        stats->compressedBytes = static_cast<qint64>(offset);
+        stats->milliseconds = timer.elapsed();
+    }
+    return ok;
+}
+
+bool loadCompressed(const QString &filePath, PointStore &points,
+                    QVector<AreaDefinition> *areas, QString *errorMessage,
+                    CompressionStats *stats)
+{
+    TraceSpan span("PointFile::loadCompressed");
+
+    QElapsedTimer timer;
+    timer.start();
+
+    points.clear();
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        setError(errorMessage, file.errorString());
+        return false;
+    }
+
+    const qint64 fileSize = file.size();
+    const uchar *data = fileSize >= CompressedFixedHeaderSize ? file.map(0, fileSize) : nullptr;
+    if (!data || std::memcmp(data, CompressedMagic, sizeof(CompressedMagic)) != 0) {
+        setError(errorMessage, QObject::tr("Not a compressed points file"));
+        return false;
+    }
+
+    const quint32 version = qFromLittleEndian<quint32>(data + 8);
+    const quint32 areaCount = qFromLittleEndian<quint32>(data + 12);
+    const quint64 count = qFromLittleEndian<quint64>(data + 16);
+    const quint32 blockCount = qFromLittleEndian<quint32>(data + 24);
+    const qint64 directoryOffset = CompressedFixedHeaderSize + static_cast<qint64>(areaCount) * AreaRecordSize;
+    const qint64 blocksOffset = directoryOffset + static_cast<qint64>(blockCount) * BlockRecordSize;
+
+    if (version != FormatVersion) {
+        setError(errorMessage, QObject::tr("Unsupported points file version %1").arg(version));
+        return false;
+    }
+    if (areaCount > 65536 || fileSize < blocksOffset) {
+        setError(errorMessage, QObject::tr("Points file is truncated or corrupt"));
+        return false;
+    }
+
+    QVector<int> areaNumbers;
+    readAreaTable(data + CompressedFixedHeaderSize, areaCount, areaNumbers, areas);
+
+    // Block directory; every block decodes into its own range of the columns
+    QVector<CompressedBlock> blocks(blockCount);
+    quint64 total = 0;
+    for (quint32 b = 0; b < blockCount; b++) {
+        const uchar *record = data + directoryOffset + static_cast<qint64>(b) * BlockRecordSize;
+        CompressedBlock &block = blocks[b];
+        block.offset = qFromLittleEndian<quint64>(record);
+        block.bytes = qFromLittleEndian<quint32>(record + 8);
+        block.count = qFromLittleEndian<quint32>(record + 12);
+        block.areaIndex = qFromLittleEndian<quint32>(record + 16);
+        block.first = static_cast<qsizetype>(total);
+        total += block.count;
+
+        // Offsets are untrusted; compare without adding so a huge offset cannot wrap around
+        if (block.offset < static_cast<quint64>(blocksOffset) || block.offset > static_cast<quint64>(fileSize)
+            || block.bytes > static_cast<quint64>(fileSize) - block.offset || block.areaIndex >= areaCount
+            || block.count > static_cast<quint32>(CompressedBlockPoints)) {
+            setError(errorMessage, QObject::tr("Points file is truncated or corrupt"));
+            return false;
+        }
+    }
+    if (total != count) {
+        setError(errorMessage, QObject::tr("Points file is truncated or corrupt"));
+        return false;
+    }
+
+    points.resize(static_cast<qsizetype>(count));
+    points.setAreaNumbers(areaNumbers);
+
+    // Blocks may straddle two chunks of the store, so each is decoded aside
+    // and copied a run at a time
+    std::atomic<bool> corrupt(false);
+    Parallel::run(blocks.size(), [&](int b) {
+        const CompressedBlock &block = blocks[b];
+        QVector<qint16> blockX(block.count);
+        QVector<qint16> blockY(block.count);
+        if (!PointCodec::decodeBlock(data + block.offset, static_cast<int>(block.bytes), block.count,
+                                     blockX.data(), blockY.data())) {
+            corrupt = true;
+        }
+        points.forEachWritableRun(block.first, block.first + block.count, [&](qsizetype first, qsizetype length,
+                                                                              qint16 *xs, qint16 *ys,
+                                                                              quint16 *areaIndices) {
+            const qsizetype at = first - block.first;
+            std::copy(blockX.constData() + at, blockX.constData() + at + length, xs);
+            std::copy(blockY.constData() + at, blockY.constData() + at + length, ys);
+            std::fill(areaIndices, areaIndices + length, static_cast<quint16>(block.areaIndex));
+        });
+    });
+
+    if (corrupt) {
+        points.clear();
+        setError(errorMessage, QObject::tr("Points file has a corrupt block"));
+        return false;
+    }
+
+    if (stats) {
+        stats->rawBytes = static_cast<qint64>(count) * 6;
+        stats->compressedBytes = fileSize;
+        stats->milliseconds = timer.elapsed();
+    }
+    return true;
+}
+
+PointFileFormat detectFormat(const QString &filePath)
+{
+    QFile file(filePath);
+    if (file.open(QIODevice::ReadOnly)) {
+        const QByteArray magic = file.read(sizeof(Magic));
+        if (magic == QByteArray(Magic, sizeof(Magic))) {
+            return PointFileFormat::Binary;
+        }
+        if (magic == QByteArray(CompressedMagic, sizeof(CompressedMagic))) {
+            return PointFileFormat::Compressed;
+        }
+    }
+    return PointFileFormat::Csv;
+}
+
+bool save(const QString &filePath, PointFileFormat format, const PointStore &points,
+          const QVector<AreaDefinition> &areas, QString *errorMessage)
+{
+    switch (format) {
+        case PointFileFormat::Binary:
+            return saveBinary(filePath, points, areas, errorMessage);
+        case PointFileFormat::Compressed:
+            return saveCompressed(filePath, points, areas, errorMessage);
+        case PointFileFormat::Csv:
+            return saveCsv(filePath, points, errorMessage);
+    }
+    return false;
+}
+
+bool load(const QString &filePath, PointStore &points, QString *errorMessage)
+{
+    switch (detectFormat(filePath)) {
+        case PointFileFormat::Binary:
+            return loadBinary(filePath, points, nullptr, errorMessage);
+        case PointFileFormat::Compressed:
+            return loadCompressed(filePath, points, nullptr, errorMessage);
+        case PointFileFormat::Csv:
+            return loadCsv(filePath, points, errorMessage);
+    }
+    return false;
+}
+
+bool saveCsv(const QString &filePath, const PointStore &points, QString *errorMessage)
+{
+    TraceSpan span("PointFile::saveCsv");
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        setError(errorMessage, file.errorString());
+        return false;
+    }
+
+    QTextStream out(&file);
+
+    // Write header
+    out << "x;y;AreaNumber\n";
+
+    // Write points
+    for (qsizetype i = 0; i < points.size(); i++) {
+        out << points.x(i) << ";" << points.y(i) << ";" << points.areaNumber(i) << "\n";
+    }
+
+    out.flush();
+    if (!file.commit()) {
+        setError(errorMessage, file.errorString());
+        return false;
+    }
+    return true;
+}
+
+bool loadCsv(const QString &filePath, PointStore &points, QString *errorMessage,
+             CsvParseReport *report)
+{
+    TraceSpan span("PointFile::loadCsv");
+
+    points.clear();
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        setError(errorMessage, file.errorString());
+        return false;
+    }
+
+    const qint64 fileSize = file.size();
+    if (fileSize == 0) {
+        if (report) {
+            *report = CsvParseReport();
+        }
+        return true;
+    }
+
+    const uchar *data = file.map(0, fileSize);
+    if (!data) {
+        setError(errorMessage, file.errorString());
+        return false;
+    }
+
+    CsvPointParser::parse(reinterpret_cast<const char *>(data), fileSize, points, report);
+
+    file.unmap(const_cast<uchar *>(data));
+    return true;
+}
+
+} // namespace PointFile
+
+PointFileWriter::PointFileWriter()
+    : format(PointFileFormat::Binary)
+    , extraColumns(0)
+    , pointCount(0)
+    , written(0)
+    , columnsOffset(0)
+{
+}
+
+// Out of line, where QSaveFile is complete; an uncommitted file is discarded
+PointFileWriter::~PointFileWriter()
+{
+}
+
+bool PointFileWriter::open(const QString &filePath, PointFileFormat format, qint64 pointCount,
+                           const QVector<AreaDefinition> &areas, int extraColumns,
+                           QString *errorMessage)
+{
+    if (format == PointFileFormat::Compressed) {
+        setError(errorMessage, QObject::tr("Compressed points files cannot be written block by block"));
+        return false;
+    }
+
+    this->format = format;
+    this->extraColumns = extraColumns;
+    this->pointCount = pointCount;
+    written = 0;
+    areaNumbers.clear();
+    for (const AreaDefinition &area : areas) {
+        areaNumbers.append(area.areaNumber);
+    }
+
+    file.reset(new QSaveFile(filePath));
+    if (!file->open(QIODevice::WriteOnly)) {
+        setError(errorMessage, file->errorString());
+        file.reset();
+        return false;
+    }
+
+    QByteArray header;
+    if (format == PointFileFormat::Binary) {
+        header = buildHeader(areaNumbers, static_cast<quint64>(pointCount), areas);
+        columnsOffset = header.size();
+    } else {
+        header = "x;y;AreaNumber";
+        if (extraColumns & OutsideColumn) {
+            header += ";Outside";
+        }
+        if (extraColumns & PredictedAreaColumn) {
+            header += ";PredictedArea";
+        }
+        header += "\n";
+    }
+    if (file->write(header) != header.size()) {
+        setError(errorMessage, file->errorString());
+        file.reset();
+        return false;
+    }
+    return true;
+}
+
+bool PointFileWriter::write(const PointStore &block, const quint8 *outside, const int *predictedAreas,
+                            QString *errorMessage)
+{
+    TraceSpan span("PointFileWriter::write");
+
+    const qsizetype count = block.size();
+    if (!file) {
+        setError(errorMessage, QObject::tr("Points file is not open"));
+        return false;
+    }
+
+    if (format == PointFileFormat::Binary) {
+        if (written + count > pointCount) {
+            setError(errorMessage, QObject::tr("More points than announced in the header"));
+            return false;
+        }
+
+        // Block area slots -> slots of the file's area table
+        QVector<quint16> remap;
+        for (int areaNumber : block.getAreaNumbers()) {
+            const int slot = areaNumbers.indexOf(areaNumber);
+            if (slot < 0) {
+                setError(errorMessage, QObject::tr("Area %1 has no definition").arg(areaNumber));
+                return false;
+            }
+            remap.append(static_cast<quint16>(slot));
+        }
+        QVector<quint16> areaIndices(count);
+        for (qsizetype i = 0; i < count; i++) {
+            areaIndices[i] = remap[block.areaIndex(i)];
+        }
+
+        const qint64 x = columnsOffset + 2 * written;
+        const qint64 y = columnsOffset + 2 * (pointCount + written);
+        const qint64 area = columnsOffset + 2 * (2 * pointCount + written);
+        bool ok = file->seek(x) && writeColumn(*file, block, &PointStore::xData)
+                  && file->seek(y) && writeColumn(*file, block, &PointStore::yData)
+                  && file->seek(area) && writeColumn(*file, areaIndices.constData(), count);
+        if (!ok) {
+            setError(errorMessage, file->errorString());
+            return false;
+        }
+        written += count;
+        return true;
+    }
+
+    // CSV lines are formatted in parallel, one buffer per range, and
+    // written in order
+    const int columns = 3 + ((extraColumns & OutsideColumn) ? 1 : 0) + ((extraColumns & PredictedAreaColumn) ? 1 : 0);
+    const qsizetype minChunk = 16384;
+    QVector<QByteArray> buffers(Parallel::rangeCount(count, minChunk));
+    QByteArray *bufferData = buffers.data();
+    Parallel::forRange(count, minChunk, [&](int task, qsizetype begin, qsizetype end) {
+        QByteArray &buffer = bufferData[task];
+        buffer.resize(static_cast<int>((end - begin) * columns * 12));
+        char *out = buffer.data();
+        for (qsizetype i = begin; i < end; i++) {
+            int fields[5] = {block.x(i), block.y(i), block.areaNumber(i), 0, 0};
+            int fieldCount = 3;
+            if (extraColumns & OutsideColumn) {
+                fields[fieldCount++] = outside ? outside[i] : 0;
+            }
+            if (extraColumns & PredictedAreaColumn) {
+                fields[fieldCount++] = predictedAreas ? predictedAreas[i] : 0;
+            }
+            for (int f = 0; f < fieldCount; f++) {
+                out = std::to_chars(out, out + 12, fields[f]).ptr;
+                *out++ = (f + 1 < fieldCount) ? ';' : '\n';
+            }
+        }
+        buffer.resize(static_cast<int>(out - buffer.data()));
+    });
+
+    for (const QByteArray &buffer : buffers) {
+        if (file->write(buffer) != buffer.size()) {
+            setError(errorMessage, file->errorString());
+            return false;
+        }
+    }
+    written += count;
+    return true;
+}
+
+bool PointFileWriter::close(QString *errorMessage)
+{
+    if (!file) {
+        setError(errorMessage, QObject::tr("Points file is not open"));
+        return false;
+    }
+
+    if (format == PointFileFormat::Binary && written != pointCount) {
+        setError(errorMessage, QObject::tr("Expected %1 points, got %2").arg(pointCount).arg(written));
+        file.reset();
+        return false;
+    }
+
+    const bool ok = file->commit();
+    if (!ok) {
+        setError(errorMessage, file->errorString());
+    }
+    file.reset();
+    return ok;
+}
@@ -0,0 +1,150 @@
+#ifndef POINTFILE_H
+#define POINTFILE_H
+
+#include <QString>
+#include <QVector>
+#include <memory>
+#include "areadefinition.h"
+#include "pointstore.h"
+#include "csvpointparser.h"
+
+// Readers and writers for point files. Writers go through QSaveFile, so an
+// existing file is only replaced once the new one is completely written.
+//
+// Binary format (little-endian):
+//   char[8]  magic "MLDPOINT"
+//   quint32  format version
+//   quint32  area count
+//   quint64  point count
+//   area table, one 48-byte record per area index:
+//     qint32 areaNumber, qint32 symbolType, double centerX, centerY,
+//     sigmaX, sigmaY, quint32 rgba, quint32 reserved
+//   qint16[count]  x column
+//   qint16[count]  y column
+//   quint16[count] area index column
+//
+// Compressed format (little-endian):
+//   char[8]  magic "MLDPOINZ"
+//   quint32  format version, quint32 area count, quint64 point count,
+//   quint32  block count, quint32 reserved
+//   area table as in the binary format
+//   block directory, one 24-byte record per block:
+//     quint64 offset, quint32 bytes, quint32 points, quint32 areaIndex,
+//     quint32 reserved
+//   block payloads (see PointCodec)
+// Points are grouped by area and sorted in Morton order, so the point order
+// of the store is not preserved.
+//
+// CSV format: "x;y;AreaNumber" header followed by one point per line.
+
+// On-disk formats for points
+enum class PointFileFormat {
+    Binary,
+    Compressed,
+    Csv
+};
+
+// Size and timing of a compressed save or load
+struct CompressionStats {
+    qint64 rawBytes = 0;         // Size of the uncompressed columns (6 bytes per point)
+    qint64 compressedBytes = 0;  // Size of the file
+    qint64 milliseconds = 0;     // Encode or decode time
+};
+
+namespace PointFile {
+
+// Save the points in the binary format. The area table holds one record per
+// entry of points.getAreaNumbers(), filled from the matching definition in
+// areas when there is one.
+bool saveBinary(const QString &filePath, const PointStore &points,
+                const QVector<AreaDefinition> &areas, QString *errorMessage = nullptr);
+
+// Load a binary points file by memory-mapping it and copying the columns.
+// If areas is given it receives the area table stored in the file.
+bool loadBinary(const QString &filePath, PointStore &points,
+                QVector<AreaDefinition> *areas = nullptr, QString *errorMessage = nullptr);
+
+// Location of the columns in a binary points file, for readers that map
+// them piecewise instead of loading the whole file
+struct BinaryLayout {
+    quint64 pointCount = 0;
+    qint64 xOffset = 0;       // Byte offsets of the three columns
+    qint64 yOffset = 0;
+    qint64 areaIndexOffset = 0;
+    QVector<int> areaNumbers;
+};
+bool readBinaryLayout(const QString &filePath, BinaryLayout &layout, QString *errorMessage = nullptr);
+
+// Save/load the compressed format; blocks are encoded and decoded in parallel.
+// Saving sorts 32-bit point indices, so stores of more than 2^32 points are
+// refused.
+bool saveCompressed(const QString &filePath, const PointStore &points,
+                    const QVector<AreaDefinition> &areas, QString *errorMessage = nullptr,
+                    CompressionStats *stats = nullptr);
+bool loadCompressed(const QString &filePath, PointStore &points,
+                    QVector<AreaDefinition> *areas = nullptr, QString *errorMessage = nullptr,
+                    CompressionStats *stats = nullptr);
+
+// Format of an existing file, from its magic bytes (anything else is CSV)
+PointFileFormat detectFormat(const QString &filePath);
+
+// Save in the given format / load in whatever format the file has
+bool save(const QString &filePath, PointFileFormat format, const PointStore &points,
+          const QVector<AreaDefinition> &areas, QString *errorMessage = nullptr);
+bool load(const QString &filePath, PointStore &points, QString *errorMessage = nullptr);
+
+// CSV import/export
+bool saveCsv(const QString &filePath, const PointStore &points, QString *errorMessage = nullptr);
+
+// Memory-maps the file and parses it with CsvPointParser; malformed lines
+// are skipped and listed in report
+bool loadCsv(const QString &filePath, PointStore &points, QString *errorMessage = nullptr,
+             CsvParseReport *report = nullptr);
+
+} // namespace PointFile
+
+class QSaveFile;
+
+// Writes a points file block by block, for producers that never hold all the
+// points. The binary format needs the point count and the area table (one
+// record per definition) up front; every block's columns are then written at
+// their offsets. CSV lines can carry extra columns after the area number,
+// which readers ignore. The file only replaces the target once close()
+// succeeds. The compressed format cannot be streamed.
+class PointFileWriter
+{
+public:
+    // Extra CSV columns, or'ed together
+    enum ExtraColumn {
+        OutsideColumn = 1,        // 1 if the point is outside its area
+        PredictedAreaColumn = 2   // Area number predicted by a classifier
+    };
+
+    PointFileWriter();
+    ~PointFileWriter();
+
+    bool open(const QString &filePath, PointFileFormat format, qint64 pointCount,
+              const QVector<AreaDefinition> &areas, int extraColumns = 0,
+              QString *errorMessage = nullptr);
+
+    // Append the points of block; outside and predictedAreas hold one entry
+    // per point for the extra columns selected in open()
+    bool write(const PointStore &block, const quint8 *outside = nullptr,
+               const int *predictedAreas = nullptr, QString *errorMessage = nullptr);
+
+    // Commit the file; a binary file must have received all its points
+    bool close(QString *errorMessage = nullptr);
+
+    qint64 getWrittenCount() const { return written; }
+
+private:
+    std::unique_ptr<QSaveFile> file;
+    PointFileFormat format;
+    int extraColumns;
+    qint64 pointCount;
+    qint64 written;
+    qint64 columnsOffset;
+    QVector<int> areaNumbers;
+};
+
+#endif // POINTFILE_H
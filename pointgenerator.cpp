@@ -0,0 +1,598 @@
+#include "pointgenerator.h"
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+#include "parallel.h"
+#include "perfcounters.h"
+#include "sobol.h"
+#include "trace.h"
+
+namespace {
+
+// Gaussian normalized to 1 at the center:
+// f(x) = e^(-(x-center)^2 / (2*sigma^2))
+inline double gaussProbability(double x, double center, double sigma)
+{
+    double exponent = -((x - center) * (x - center)) / (2 * sigma * sigma);
+    return qExp(exponent);
+}
+
+// Draw a coordinate in the logical range and accept it with the Gaussian
+// probability at that coordinate
+inline bool generateCoordinate(QRandomGenerator &rng, double center, double sigma, int &coordinate)
+{
+    coordinate = rng.bounded(LogicalMin, LogicalMax + 1);
+    double probability = gaussProbability(coordinate, center, sigma);
+    return probability > rng.generateDouble();
+}
+
+// Points per batch of the correlated sampler
+const int SampleBatch = 64;
+
+// Append n points center + L z to xs/ys, z standard normal, keeping the
+// points whose rounded coordinates are in the logical range. Every stage
+// runs over a whole batch in a loop of its own: the random words are drawn
+// in one call, and the affine transform and rounding can vectorize. The
+// std::log, std::sqrt, std::cos and std::sin calls of the Box-Muller stage
+// stay scalar library calls with the default compiler flags, so the batch
+// layout saves loop and call overhead there, not arithmetic.
+void sampleCorrelated(QRandomGenerator &rng, const AreaDefinition &area,
+                      const PointGenerator::CholeskyFactor &factor, qsizetype n, qint16 *xs, qint16 *ys)
+{
+    quint64 words[2 * SampleBatch];
+    double radius[SampleBatch];
+    double angle[SampleBatch];
+    double px[SampleBatch];
+    double py[SampleBatch];
+
+    qsizetype done = 0;
+    while (done < n) {
+        rng.fillRange(words);
+
+        // Box-Muller: a pair of uniforms gives two independent standard
+        // normals, radius * cos(angle) and radius * sin(angle); 1 - u keeps
+        // the logarithm finite
+        for (int j = 0; j < SampleBatch; j++) {
+            const double u1 = 1.0 - (words[2 * j] >> 11) * 0x1.0p-53;
+            const double u2 = (words[2 * j + 1] >> 11) * 0x1.0p-53;
+            radius[j] = std::sqrt(-2.0 * std::log(u1));
+            angle[j] = 2.0 * M_PI * u2;
+        }
+        for (int j = 0; j < SampleBatch; j++) {
+            const double z1 = radius[j] * std::cos(angle[j]);
+            const double z2 = radius[j] * std::sin(angle[j]);
+            px[j] = std::floor(area.centerX + factor.l11 * z1 + 0.5);
+            py[j] = std::floor(area.centerY + factor.l21 * z1 + factor.l22 * z2 + 0.5);
+        }
+
+        for (int j = 0; j < SampleBatch && done < n; j++) {
+            if (px[j] >= LogicalMin && px[j] <= LogicalMax && py[j] >= LogicalMin && py[j] <= LogicalMax) {
+                xs[done] = static_cast<qint16>(px[j]);
+                ys[done] = static_cast<qint16>(py[j]);
+                done++;
+            }
+        }
+    }
+}
+
+// Standard normal distribution function
+inline double normalCdf(double x)
+{
+    return 0.5 * std::erfc(-x * M_SQRT1_2);
+}
+
+// Inverse of normalCdf for p in (0, 1), after Acklam: a rational function
+// of p - 1/2 in the center and of sqrt(-2 ln p) in the tails, with a
+// relative error below 1.2e-9. Both are computed and one is selected, so
+// loops over the function have no branches.
+inline double inverseNormalCdf(double p)
+{
+    const double central = p - 0.5;
+    const double r = central * central;
+    const double centralValue =
+        (((((-3.969683028665376e+01 * r + 2.209460984245205e+02) * r - 2.759285104469687e+02) * r
+           + 1.383577518672690e+02) * r - 3.066479806614716e+01) * r + 2.506628277459239e+00) * central
+        / (((((-5.447609879822406e+01 * r + 1.615858368580409e+02) * r - 1.556989798598866e+02) * r
+             + 6.680131188771972e+01) * r - 1.328068155288572e+01) * r + 1.0);
+
+    const double tailP = std::fmin(p, 1.0 - p);
+    const double q = std::sqrt(-2.0 * std::log(tailP));
+    const double tailValue =
+        (((((-7.784894002430293e-03 * q - 3.223964580411365e-01) * q - 2.400758277161838e+00) * q
+           - 2.549671010366690e+00) * q + 4.374664141464968e+00) * q + 2.938163982698783e+00)
+        / ((((7.784695709041462e-03 * q + 3.224671290700398e-01) * q + 2.445134137142996e+00) * q
+            + 3.754408661907416e+00) * q + 1.0);
+
+    const double tail = p < 0.5 ? tailValue : -tailValue;
+    return std::fabs(central) <= 0.5 - 0.02425 ? centralValue : tail;
+}
+
+// Map n pairs of quasi-random fractions (u1, u2) to points of an area.
+// z1 comes from u1 through the inverse distribution function restricted to
+// the z1 that keep x in the logical range, then z2 from u2 restricted to
+// the z2 that keep y in the range given z1 (the GHK construction), so no
+// point has to be redrawn and the low discrepancy carries over. For areas
+// that are not rotated this is exactly the Gaussian truncated to the range.
+// For a rotated area near the edge of the range, z1 must also favour the
+// values that leave y room; marginal then holds that distribution and z1
+// comes from it, so the points follow the same law as the random sampler.
+void mapQuasiRandom(const AreaDefinition &area, const PointGenerator::CholeskyFactor &factor,
+                    const PointGenerator::MarginalTable &marginal,
+                    const quint32 *u1, const quint32 *u2, qsizetype n, qint16 *xs, qint16 *ys)
+{
+    const double lowX = normalCdf((LogicalMin - 0.5 - area.centerX) / factor.l11);
+    const double widthX = normalCdf((LogicalMax + 0.5 - area.centerX) / factor.l11) - lowX;
+    const bool correlated = factor.l21 != 0;
+    const double lowY0 = normalCdf((LogicalMin - 0.5 - area.centerY) / factor.l22);
+    const double widthY0 = normalCdf((LogicalMax + 0.5 - area.centerY) / factor.l22) - lowY0;
+
+    double z1[SampleBatch];
+    double lowY[SampleBatch];
+    double widthY[SampleBatch];
+
+    for (qsizetype batch = 0; batch < n; batch += SampleBatch) {
+        const int count = static_cast<int>(qMin<qsizetype>(SampleBatch, n - batch));
+        const quint32 *v1 = u1 + batch;
+        const quint32 *v2 = u2 + batch;
+        qint16 *x = xs + batch;
+        qint16 *y = ys + batch;
+
+        // Fractions are taken at the middle of their 2^-32 interval, so
+        // they are never 0 or 1
+        if (marginal.cumulative.isEmpty()) {
+            for (int j = 0; j < count; j++) {
+                z1[j] = inverseNormalCdf(lowX + widthX * ((v1[j] + 0.5) * 0x1.0p-32));
+            }
+        } else {
+            // Pick the unit of x by the table, then z1 within it from the
+            // normal distribution restricted to the unit
+            const double *cumulative = marginal.cumulative.constData();
+            const double *edgeCdf = marginal.edgeCdf.constData();
+            const int units = marginal.cumulative.size() - 1;
+            for (int j = 0; j < count; j++) {
+                const double p = cumulative[units] * ((v1[j] + 0.5) * 0x1.0p-32);
+                const int unit = qBound(0, static_cast<int>(std::upper_bound(cumulative, cumulative + units + 1, p)
+                                                            - cumulative) - 1, units - 1);
+                const double mass = cumulative[unit + 1] - cumulative[unit];
+                const double t = mass > 0 ? qBound(0.0, (p - cumulative[unit]) / mass, 1.0) : 0.5;
+                z1[j] = inverseNormalCdf(edgeCdf[unit] + t * (edgeCdf[unit + 1] - edgeCdf[unit]));
+            }
+        }
+        if (correlated) {
+            for (int j = 0; j < count; j++) {
+                const double shift = area.centerY + factor.l21 * z1[j];
+                lowY[j] = normalCdf((LogicalMin - 0.5 - shift) / factor.l22);
+                widthY[j] = normalCdf((LogicalMax + 0.5 - shift) / factor.l22) - lowY[j];
+            }
+        } else {
+            for (int j = 0; j < count; j++) {
+                lowY[j] = lowY0;
+                widthY[j] = widthY0;
+            }
+        }
+        for (int j = 0; j < count; j++) {
+            const double z2 = inverseNormalCdf(lowY[j] + widthY[j] * ((v2[j] + 0.5) * 0x1.0p-32));
+            const double px = std::floor(area.centerX + factor.l11 * z1[j] + 0.5);
+            const double py = std::floor(area.centerY + factor.l21 * z1[j] + factor.l22 * z2 + 0.5);
+            x[j] = static_cast<qint16>(qBound<double>(LogicalMin, px, LogicalMax));
+            y[j] = static_cast<qint16>(qBound<double>(LogicalMin, py, LogicalMax));
+        }
+    }
+}
+
+// Shares of the areas' weights, summing to 1; negative weights count as 0
+// and if no area has a positive weight all areas share equally
+QVector<double> normalizedWeights(const QVector<AreaDefinition> &areas)
+{
+    QVector<double> weights;
+    double sum = 0;
+    for (const AreaDefinition &area : areas) {
+        const double weight = area.weight > 0 && qIsFinite(area.weight) ? area.weight : 0.0;
+        weights.append(weight);
+        sum += weight;
+    }
+    for (double &weight : weights) {
+        weight = sum > 0 ? weight / sum : 1.0 / weights.size();
+    }
+    return weights;
+}
+
+// Seed of block b of a sequence (splitmix64 of the pair)
+inline quint64 blockSeed(quint64 seed, quint64 block)
+{
+    quint64 z = seed + (block + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Scramble seed of one dimension of a Sobol sequence; stream is the area of
+// a grouped sequence, or the area count for the shared mixture sequence
+inline quint32 sobolSeed(quint64 seed, int stream, int dimension)
+{
+    return static_cast<quint32>(blockSeed(~seed, static_cast<quint64>(stream) * Sobol::Dimensions + dimension));
+}
+
+} // namespace
+
+PointGenerator::PointGenerator(const QVector<AreaDefinition> &areas, qsizetype total, quint64 seed,
+                               Sampling sampling, Sequence sequence)
+    : areas(areas)
+    , factors(areas.size())
+    , areaOffsets(areas.size() + 1, 0)
+    , total(total)
+    , seed(seed)
+    , sampling(sampling)
+    , sequence(sequence)
+{
+    // Cholesky factor of each area's covariance
+    for (int areaIndex = 0; areaIndex < areas.size(); areaIndex++) {
+        const AreaCovariance covariance = areaCovariance(areas[areaIndex]);
+        CholeskyFactor &factor = factors[areaIndex];
+        factor.l11 = qSqrt(covariance.xx);
+        factor.l21 = covariance.xy / factor.l11;
+        factor.l22 = qSqrt(qMax(0.0, covariance.yy - factor.l21 * factor.l21));
+    }
+
+    // Quasi-random rotated areas: mass of every unit of x once the points
+    // whose y leaves the range are removed, i.e. the normal mass of the unit
+    // times the chance that y stays in range given its middle. Areas where
+    // that chance is 1 up to rounding keep no table.
+    marginals.resize(areas.size());
+    for (int areaIndex = 0; sequence == Sequence::Sobol && areaIndex < areas.size(); areaIndex++) {
+        const AreaDefinition &area = areas[areaIndex];
+        const CholeskyFactor &factor = factors[areaIndex];
+        if (factor.l21 == 0) {
+            continue;
+        }
+        const int units = LogicalMax - LogicalMin + 1;
+        MarginalTable &marginal = marginals[areaIndex];
+        marginal.edgeCdf.resize(units + 1);
+        marginal.cumulative.resize(units + 1);
+        for (int unit = 0; unit <= units; unit++) {
+            marginal.edgeCdf[unit] = normalCdf((LogicalMin - 0.5 + unit - area.centerX) / factor.l11);
+        }
+        double lost = 0;
+        marginal.cumulative[0] = 0;
+        for (int unit = 0; unit < units; unit++) {
+            const double shift = area.centerY + factor.l21 * (LogicalMin + unit - area.centerX) / factor.l11;
+            double inRange;
+            if (factor.l22 > 0) {
+                inRange = normalCdf((LogicalMax + 0.5 - shift) / factor.l22)
+                          - normalCdf((LogicalMin - 0.5 - shift) / factor.l22);
+            } else {
+                inRange = shift >= LogicalMin - 0.5 && shift < LogicalMax + 0.5 ? 1.0 : 0.0;
+            }
+            const double unitMass = marginal.edgeCdf[unit + 1] - marginal.edgeCdf[unit];
+            marginal.cumulative[unit + 1] = marginal.cumulative[unit] + unitMass * inRange;
+            lost += unitMass * (1.0 - inRange);
+        }
+        if (lost <= 1e-12 * (marginal.edgeCdf[units] - marginal.edgeCdf[0]) || marginal.cumulative[units] <= 0) {
+            marginal = MarginalTable();
+        }
+    }
+    
+    const int areaCount = areas.size();
+    if (areaCount == 0) {
+        return;
+    }
+    const QVector<double> weights = normalizedWeights(areas);
+
+    // Grouped: each area gets the integer part of its share, then the
+    // remaining points go one each to the largest fractional parts (the
+    // first areas on ties, so equal weights split as evenly as possible)
+    QVector<qsizetype> counts(areaCount);
+    QVector<int> byFraction(areaCount);
+    QVector<double> fractions(areaCount);
+    qsizetype assigned = 0;
+    for (int areaIndex = 0; areaIndex < areaCount; areaIndex++) {
+        const double share = weights[areaIndex] * total;
+        counts[areaIndex] = qMin<qsizetype>(total, static_cast<qsizetype>(share));
+        fractions[areaIndex] = share - counts[areaIndex];
+        byFraction[areaIndex] = areaIndex;
+        assigned += counts[areaIndex];
+    }
+    std::stable_sort(byFraction.begin(), byFraction.end(), [&fractions](int a, int b) {
+        return fractions[a] > fractions[b];
+    });
+    for (int i = 0; assigned < total; i = (i + 1) % areaCount) {
+        counts[byFraction[i]]++;
+        assigned++;
+    }
+    for (int areaIndex = 0; areaIndex < areaCount; areaIndex++) {
+        areaOffsets[areaIndex + 1] = areaOffsets[areaIndex] + counts[areaIndex];
+    }
+
+    // Mixture: Vose's alias table. Columns are scaled to an average of 1;
+    // each column below 1 is topped up by a column above 1, which becomes
+    // its alias, until every column holds exactly 1.
+    aliasProbability.resize(areaCount);
+    alias.resize(areaCount);
+    QVector<double> scaled(areaCount);
+    QVector<int> small;
+    QVector<int> large;
+    for (int areaIndex = 0; areaIndex < areaCount; areaIndex++) {
+        scaled[areaIndex] = weights[areaIndex] * areaCount;
+        alias[areaIndex] = areaIndex;
+        (scaled[areaIndex] < 1.0 ? small : large).append(areaIndex);
+    }
+    while (!small.isEmpty() && !large.isEmpty()) {
+        const int less = small.takeLast();
+        const int more = large.last();
+        aliasProbability[less] = scaled[less];
+        alias[less] = more;
+        scaled[more] -= 1.0 - scaled[less];
+        if (scaled[more] < 1.0) {
+            large.removeLast();
+            small.append(more);
+        }
+    }
+    // Whatever is left holds 1 up to rounding
+    for (int areaIndex : large) {
+        aliasProbability[areaIndex] = 1.0;
+    }
+    for (int areaIndex : small) {
+        aliasProbability[areaIndex] = 1.0;
+    }
+}
+
+int PointGenerator::areaIndexOf(qsizetype i) const
+{
+    return static_cast<int>(std::upper_bound(areaOffsets.cbegin(), areaOffsets.cend(), i)
+                            - areaOffsets.cbegin()) - 1;
+}
+
+void PointGenerator::sampleArea(QRandomGenerator &rng, int areaIndex, qsizetype n, qint16 *xs, qint16 *ys) const
+{
+    const AreaDefinition &area = areas[areaIndex];
+    if (area.rotation != 0) {
+        sampleCorrelated(rng, area, factors[areaIndex], n, xs, ys);
+        return;
+    }
+    for (qsizetype i = 0; i < n; i++) {
+        int x;
+        while (!generateCoordinate(rng, area.centerX, area.sigmaX, x)) {
+            // Keep trying until we get a successful x coordinate
+        }
+        int y;
+        while (!generateCoordinate(rng, area.centerY, area.sigmaY, y)) {
+            // Keep trying until we get a successful y coordinate
+        }
+        xs[i] = static_cast<qint16>(x);
+        ys[i] = static_cast<qint16>(y);
+    }
+}
+
+int PointGenerator::pickArea(quint32 column, double side) const
+{
+    const int index = static_cast<int>((quint64(column) * static_cast<quint64>(areas.size())) >> 32);
+    return side < aliasProbability[index] ? index : alias[index];
+}
+
+void PointGenerator::generateBlock(qsizetype block, qsizetype pointBegin, qsizetype pointEnd,
+                                   qint16 *xs, qint16 *ys, int *areaIndices) const
+{
+    const int areaCount = areas.size();
+    const int n = static_cast<int>(pointEnd - pointBegin);
+
+    if (sequence == Sequence::Sobol && sampling == Sampling::Grouped) {
+        // Point i of an area is point i of the area's own sequence
+        quint32 u1[BlockSize];
+        quint32 u2[BlockSize];
+        int areaIndex = areaIndexOf(pointBegin);
+        for (qsizetype segmentBegin = pointBegin; segmentBegin < pointEnd; ) {
+            while (segmentBegin >= areaOffsets[areaIndex + 1]) {
+                areaIndex++;
+            }
+            const qsizetype segmentEnd = qMin(pointEnd, areaOffsets[areaIndex + 1]);
+            const int count = static_cast<int>(segmentEnd - segmentBegin);
+            const quint64 first = segmentBegin - areaOffsets[areaIndex];
+            Sobol::fill(0, sobolSeed(seed, areaIndex, 0), first, count, u1);
+            Sobol::fill(1, sobolSeed(seed, areaIndex, 1), first, count, u2);
+            const qsizetype offset = segmentBegin - pointBegin;
+            mapQuasiRandom(areas[areaIndex], factors[areaIndex], marginals[areaIndex], u1, u2, count, xs + offset, ys + offset);
+            std::fill(areaIndices + offset, areaIndices + offset + count, areaIndex);
+            segmentBegin = segmentEnd;
+        }
+        return;
+    }
+
+    if (sequence == Sequence::Sobol) {
+        // Mixture: the first dimension of one shared sequence picks the
+        // area and the other two place the point, so the points of each
+        // area are a well spread subset of a low-discrepancy sequence.
+        // Points are mapped area by area and put back in sequence order.
+        quint32 u0[BlockSize];
+        quint32 u1[BlockSize];
+        quint32 u2[BlockSize];
+        quint32 sorted1[BlockSize];
+        quint32 sorted2[BlockSize];
+        int order[BlockSize];
+        qint16 sampledX[BlockSize];
+        qint16 sampledY[BlockSize];
+        Sobol::fill(0, sobolSeed(seed, areaCount, 0), pointBegin, n, u0);
+        Sobol::fill(1, sobolSeed(seed, areaCount, 1), pointBegin, n, u1);
+        Sobol::fill(2, sobolSeed(seed, areaCount, 2), pointBegin, n, u2);
+        const quint64 columns = static_cast<quint64>(areaCount);
+        for (int j = 0; j < n; j++) {
+            // The fraction of u0 within its column picks the side
+            const double side = static_cast<quint32>(quint64(u0[j]) * columns) * 0x1.0p-32;
+            areaIndices[j] = pickArea(u0[j], side);
+            order[j] = j;
+        }
+        std::stable_sort(order, order + n, [areaIndices](int a, int b) {
+            return areaIndices[a] < areaIndices[b];
+        });
+        for (int k = 0; k < n; k++) {
+            sorted1[k] = u1[order[k]];
+            sorted2[k] = u2[order[k]];
+        }
+        for (int runBegin = 0; runBegin < n; ) {
+            const int areaIndex = areaIndices[order[runBegin]];
+            int runEnd = runBegin + 1;
+            while (runEnd < n && areaIndices[order[runEnd]] == areaIndex) {
+                runEnd++;
+            }
+            mapQuasiRandom(areas[areaIndex], factors[areaIndex], marginals[areaIndex], sorted1 + runBegin, sorted2 + runBegin,
+                           runEnd - runBegin, sampledX + runBegin, sampledY + runBegin);
+            runBegin = runEnd;
+        }
+        for (int k = 0; k < n; k++) {
+            xs[order[k]] = sampledX[k];
+            ys[order[k]] = sampledY[k];
+        }
+        return;
+    }
+
+    const quint64 value = blockSeed(seed, static_cast<quint64>(block));
+    const quint32 seedWords[2] = {static_cast<quint32>(value), static_cast<quint32>(value >> 32)};
+    QRandomGenerator rng(seedWords, 2);
+
+    if (sampling == Sampling::Mixture) {
+        // Pick the area of every point of the whole block, also when only
+        // part of it is asked for, so the points do not depend on where a
+        // range ends
+        const qsizetype first = block * BlockSize;
+        const int blockCount = static_cast<int>(qMin(qMax(total, pointEnd), first + BlockSize) - first);
+        quint64 words[BlockSize];
+        int picks[BlockSize];
+        int order[BlockSize];
+        qint16 sampledX[BlockSize];
+        qint16 sampledY[BlockSize];
+        rng.fillRange(words);
+        for (int j = 0; j < blockCount; j++) {
+            // High word picks the column, low word the side
+            picks[j] = pickArea(static_cast<quint32>(words[j] >> 32), static_cast<quint32>(words[j]) * 0x1.0p-32);
+            order[j] = j;
+        }
+
+        // Sample the points of each area together, then put them back at
+        // the positions that picked the area
+        std::stable_sort(order, order + blockCount, [&picks](int a, int b) {
+            return picks[a] < picks[b];
+        });
+        for (int runBegin = 0; runBegin < blockCount; ) {
+            const int areaIndex = picks[order[runBegin]];
+            int runEnd = runBegin + 1;
+            while (runEnd < blockCount && picks[order[runEnd]] == areaIndex) {
+                runEnd++;
+            }
+            sampleArea(rng, areaIndex, runEnd - runBegin, sampledX + runBegin, sampledY + runBegin);
+            runBegin = runEnd;
+        }
+        for (int k = 0; k < blockCount; k++) {
+            const qsizetype i = first + order[k];
+            if (i >= pointBegin && i < pointEnd) {
+                xs[i - pointBegin] = sampledX[k];
+                ys[i - pointBegin] = sampledY[k];
+                areaIndices[i - pointBegin] = picks[order[k]];
+            }
+        }
+        return;
+    }
+
+    // The block's points of one area at a time
+    int areaIndex = areaIndexOf(pointBegin);
+    for (qsizetype segmentBegin = pointBegin; segmentBegin < pointEnd; ) {
+        while (segmentBegin >= areaOffsets[areaIndex + 1]) {
+            areaIndex++;
+        }
+        const qsizetype segmentEnd = qMin(pointEnd, areaOffsets[areaIndex + 1]);
+        const qsizetype offset = segmentBegin - pointBegin;
+        sampleArea(rng, areaIndex, segmentEnd - segmentBegin, xs + offset, ys + offset);
+        std::fill(areaIndices + offset, areaIndices + offset + (segmentEnd - segmentBegin), areaIndex);
+        segmentBegin = segmentEnd;
+    }
+}
+
+void PointGenerator::generate(qsizetype begin, qsizetype end, PointStore &points,
+                              QVector<AreaStatistics> *statistics) const
+{
+    TraceSpan span("PointGenerator::generate");
+
+    const int areaCount = areas.size();
+    const qsizetype count = end - begin;
+    if (areaCount == 0 || count <= 0) {
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Area table slot of each area in the point store
+    QVector<quint16> areaSlots;
+    for (const AreaDefinition &area : areas) {
+        areaSlots.append(points.areaSlot(area.areaNumber));
+    }
+
+    // Point i of the sequence goes to slot offset + i of the store
+    const qsizetype offset = points.extend(count) - begin;
+
+    // Work is split by blocks of the sequence, each with its own random
+    // stream
+    const qsizetype firstBlock = begin / BlockSize;
+    const qsizetype blockCount = (end - 1) / BlockSize - firstBlock + 1;
+
+    Parallel::forRange(blockCount, 1, [&](int, qsizetype blockBegin, qsizetype blockEnd) {
+        qint16 blockX[BlockSize];
+        qint16 blockY[BlockSize];
+        int blockAreas[BlockSize];
+
+        // A block may straddle two chunks of the store, so it is generated
+        // aside and copied a run at a time
+        for (qsizetype block = firstBlock + blockBegin; block < firstBlock + blockEnd; block++) {
+            const qsizetype pointBegin = qMax(begin, block * BlockSize);
+            const qsizetype pointEnd = qMin(end, (block + 1) * BlockSize);
+            generateBlock(block, pointBegin, pointEnd, blockX, blockY, blockAreas);
+
+            points.forEachWritableRun(offset + pointBegin, offset + pointEnd, [&](qsizetype first, qsizetype length,
+                                                                                qint16 *xs, qint16 *ys,
+                                                                                quint16 *areaIndices) {
+                const qsizetype at = first - offset - pointBegin;
+                std::copy(blockX + at, blockX + at + length, xs);
+                std::copy(blockY + at, blockY + at + length, ys);
+                for (qsizetype k = 0; k < length; k++) {
+                    areaIndices[k] = areaSlots[blockAreas[at + k]];
+                }
+            });
+        }
+    });
+
+    // Statistics in a pass of their own, sorted by area, so they take no
+    // per-thread copy of every area
+    if (statistics) {
+        QVector<int> areaOfSlot(points.getAreaNumbers().size(), -1);
+        for (int areaIndex = areaCount - 1; areaIndex >= 0; areaIndex--) {
+            areaOfSlot[areaSlots[areaIndex]] = areaIndex;
+        }
+        statistics->resize(areaCount);
+        points.forEachRun(offset + begin, offset + end, [&](qsizetype, qsizetype length, const qint16 *xs,
+                                                            const qint16 *ys, const quint16 *areaIndices) {
+            addGroupedStatistics(xs, ys, areaIndices, length, areaOfSlot, *statistics);
+        });
+    }
+    PerfCounters::recordGeneration(count, timer.nsecsElapsed());
+}
+
+bool PointGenerator::generateBlocks(qsizetype begin, qsizetype end, qsizetype blockPoints,
+                                    const std::function<bool(const PointStore &block)> &sink,
+                                    QVector<AreaStatistics> *statistics) const
+{
+    // Blocks start at multiples of BlockSize, so the points do not depend
+    // on the block size
+    blockPoints = (qMax<qsizetype>(1, blockPoints) + BlockSize - 1) / BlockSize * BlockSize;
+    for (qsizetype blockBegin = begin; blockBegin < end; blockBegin += blockPoints) {
+        const qsizetype blockEnd = qMin(end, blockBegin + blockPoints);
+        PointStore block;
+        for (const AreaDefinition &area : areas) {
+            block.areaSlot(area.areaNumber);
+        }
+        generate(blockBegin, blockEnd, block, statistics);
+        if (!sink(block)) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,112 @@
+#ifndef POINTGENERATOR_H
+#define POINTGENERATOR_H
+
+#include <QVector>
+#include <functional>
+#include "areadefinition.h"
+#include "areastatistics.h"
+#include "pointstore.h"
+
+class QRandomGenerator;
+
+// Sampler for the Gaussian areas: acceptance-rejection per axis for areas
+// that are not rotated, and center + L z for rotated ones, where L is the
+// Cholesky factor of the area's covariance and z a batch of standard
+// normals; points outside the logical range are redrawn.
+// A generator describes one sequence of `total` points shared among the
+// areas by their weights. Grouped sampling gives every area its share
+// exactly (the remaining points go to the areas with the largest fractions)
+// and keeps each area's points contiguous; mixture sampling draws the area
+// of every point from the weights with an alias table, so the areas are
+// interleaved as in a shuffled training set.
+// Coordinates come from a pseudo-random stream, or from a scrambled Sobol
+// sequence mapped through the inverse Gaussian distribution function; the
+// quasi-random points cover each area far more evenly, so fewer of them
+// give a smooth picture.
+// Every block of BlockSize points has its own random stream derived from
+// the seed, so a sequence is the same whatever the thread count and however
+// it is cut into ranges, as long as ranges start at multiples of BlockSize.
+// That lets callers stream a huge sequence in pieces.
+class PointGenerator
+{
+public:
+    static const qsizetype BlockSize = 1024;
+
+    enum class Sampling {
+        Grouped,
+        Mixture
+    };
+
+    enum class Sequence {
+        Random,
+        Sobol
+    };
+
+    PointGenerator(const QVector<AreaDefinition> &areas, qsizetype total, quint64 seed,
+                   Sampling sampling = Sampling::Grouped, Sequence sequence = Sequence::Random);
+
+    qsizetype getTotal() const { return total; }
+    Sampling getSampling() const { return sampling; }
+    Sequence getSequence() const { return sequence; }
+
+    // Index into the areas of point i of a grouped sequence
+    int areaIndexOf(qsizetype i) const;
+
+    // Append points [begin, end) of the sequence to points, in parallel.
+    // If statistics is given (one entry per area) the points are added to it;
+    // areas with the same number share an area slot, so their points count
+    // for the first of them.
+    void generate(qsizetype begin, qsizetype end, PointStore &points,
+                  QVector<AreaStatistics> *statistics = nullptr) const;
+
+    // Generate points [begin, end) as a series of stores of blockPoints
+    // points (rounded up to a multiple of BlockSize) and hand each to sink
+    // in order, so a sequence larger than memory can go straight to a file
+    // writer or the renderer. The area table of every block follows the
+    // areas. Stops and returns false as soon as sink returns false.
+    bool generateBlocks(qsizetype begin, qsizetype end, qsizetype blockPoints,
+                        const std::function<bool(const PointStore &block)> &sink,
+                        QVector<AreaStatistics> *statistics = nullptr) const;
+
+    // Lower triangular L with L L^T = covariance of the area
+    struct CholeskyFactor {
+        double l11;
+        double l21;
+        double l22;
+    };
+
+    // Distribution of the first normal of a quasi-random rotated area over
+    // the units of x, for areas where the range cuts into it
+    struct MarginalTable {
+        QVector<double> edgeCdf;      // Normal distribution function at the unit edges
+        QVector<double> cumulative;   // Kept mass below each edge; empty if none is lost
+    };
+
+private:
+    // Draw n points of one area into xs/ys
+    void sampleArea(QRandomGenerator &rng, int areaIndex, qsizetype n, qint16 *xs, qint16 *ys) const;
+
+    // Area of a mixture point from 32 bits that pick the alias table column
+    // and a fraction that picks its side
+    int pickArea(quint32 column, double side) const;
+
+    // Points [pointBegin, pointEnd) of one block of the sequence; element i
+    // of the arrays is point pointBegin + i
+    void generateBlock(qsizetype block, qsizetype pointBegin, qsizetype pointEnd,
+                       qint16 *xs, qint16 *ys, int *areaIndices) const;
+
+    QVector<AreaDefinition> areas;
+    QVector<CholeskyFactor> factors;
+    QVector<MarginalTable> marginals;
+    QVector<qsizetype> areaOffsets;
+    // Alias table of the mixture: column j stands for area j with
+    // probability aliasProbability[j] and for area alias[j] otherwise
+    QVector<double> aliasProbability;
+    QVector<int> alias;
+    qsizetype total;
+    quint64 seed;
+    Sampling sampling;
+    Sequence sequence;
+};
+
+#endif // POINTGENERATOR_H
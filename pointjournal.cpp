@@ -0,0 +1,280 @@
+#include "pointjournal.h"
+#include <QFile>
+#include <QObject>
+#include <QVector>
+#include <QtEndian>
+#include <cstring>
+#include "parallel.h"
+#include "trace.h"
+
+namespace {
+
+const char Magic[8] = {'M', 'L', 'D', 'J', 'O', 'U', 'R', 'N'};
+const char BlockMagic[4] = {'P', 'B', 'L', 'K'};
+const quint32 FormatVersion = 1;
+const int HeaderSize = 32;
+const int BlockHeaderSize = 24;
+
+void setError(QString *errorMessage, const QString &message)
+{
+    if (errorMessage) {
+        *errorMessage = message;
+    }
+}
+
+// FNV-1a over the block payload
+quint64 checksum(const uchar *data, qint64 size)
+{
+    quint64 hash = 14695981039346656037ULL;
+    for (qint64 i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// splitmix64 finalizer, spreads a packed point over all 64 bits
+inline quint64 mix(quint64 value)
+{
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
+
+QByteArray buildHeader(quint64 basePointCount, quint64 baseFingerprint)
+{
+    QByteArray header(HeaderSize, Qt::Uninitialized);
+    uchar *out = reinterpret_cast<uchar *>(header.data());
+    std::memcpy(out, Magic, sizeof(Magic));
+    qToLittleEndian<quint32>(FormatVersion, out + 8);
+    qToLittleEndian<quint32>(0, out + 12);
+    qToLittleEndian<quint64>(basePointCount, out + 16);
+    qToLittleEndian<quint64>(baseFingerprint, out + 24);
+    return header;
+}
+
+// A complete, verified block found while replaying
+struct BlockRef {
+    const uchar *payload = nullptr;
+    quint32 count = 0;
+    quint32 areaCount = 0;
+    qsizetype first = 0;       // Index of the block's first point in the store
+    QVector<quint16> remap;    // Block area index -> store area slot
+};
+
+} // namespace
+
+namespace PointJournal {
+
+quint64 fingerprint(const PointStore &points)
+{
+    const QVector<int> &areaNumbers = points.getAreaNumbers();
+
+    const qsizetype minChunk = 1 << 16;
+    QVector<quint64> sums(Parallel::rangeCount(points.size(), minChunk), 0);
+    quint64 *sumData = sums.data();
+    Parallel::forRange(points.size(), minChunk, [&](int task, qsizetype begin, qsizetype end) {
+        quint64 sum = 0;
+        points.forEachRun(begin, end, [&](qsizetype, qsizetype length, const qint16 *xs, const qint16 *ys,
+                                          const quint16 *areaIndices) {
+            for (qsizetype k = 0; k < length; k++) {
+                const quint32 areaNumber = static_cast<quint32>(areaNumbers[areaIndices[k]]);
+                const quint64 packed = static_cast<quint16>(xs[k])
+                                       | (static_cast<quint64>(static_cast<quint16>(ys[k])) << 16)
+                                       | (static_cast<quint64>(areaNumber) << 32);
+                sum += mix(packed);
+            }
+        });
+        sumData[task] = sum;
+    });
+
+    quint64 result = mix(static_cast<quint64>(points.size()));
+    for (quint64 sum : sums) {
+        result += sum;
+    }
+    return result;
+}
+
+bool append(const QString &filePath, quint64 basePointCount, quint64 baseFingerprint,
+            const PointStore &points, qsizetype first, qsizetype count,
+            QString *errorMessage)
+{
+    TraceSpan span("PointJournal::append");
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadWrite)) {
+        setError(errorMessage, file.errorString());
+        return false;
+    }
+
+    // Start over unless the journal already extends the same base
+    const QByteArray header = buildHeader(basePointCount, baseFingerprint);
+    if (file.size() < HeaderSize || file.read(HeaderSize) != header) {
+        if (!file.resize(0) || !file.seek(0) || file.write(header) != header.size()) {
+            setError(errorMessage, file.errorString());
+            return false;
+        }
+    }
+
+    // Area table of the block: only the areas its points use
+    const QVector<int> &storeAreas = points.getAreaNumbers();
+    QVector<int> blockAreas;
+    QVector<int> blockSlot(storeAreas.size(), -1);
+    for (qsizetype i = first; i < first + count; i++) {
+        const quint16 slot = points.areaIndex(i);
+        if (blockSlot[slot] < 0) {
+            blockSlot[slot] = blockAreas.size();
+            blockAreas.append(storeAreas[slot]);
+        }
+    }
+
+    // Build the whole block in memory and write it with one call
+    const qint64 payloadSize = 4 * static_cast<qint64>(blockAreas.size()) + 6 * static_cast<qint64>(count);
+    QByteArray block(BlockHeaderSize + payloadSize, Qt::Uninitialized);
+    uchar *out = reinterpret_cast<uchar *>(block.data());
+    uchar *payload = out + BlockHeaderSize;
+
+    uchar *p = payload;
+    for (int areaNumber : blockAreas) {
+        qToLittleEndian<qint32>(areaNumber, p);
+        p += 4;
+    }
+    points.forEachRun(first, first + count, [&](qsizetype begin, qsizetype length, const qint16 *xs,
+                                                const qint16 *ys, const quint16 *areaIndices) {
+        const qsizetype at = 2 * (begin - first);
+        qToLittleEndian<qint16>(xs, length, p + at);
+        qToLittleEndian<qint16>(ys, length, p + 2 * count + at);
+        for (qsizetype i = 0; i < length; i++) {
+            qToLittleEndian<quint16>(static_cast<quint16>(blockSlot[areaIndices[i]]), p + 4 * count + at + 2 * i);
+        }
+    });
+
+    std::memcpy(out, BlockMagic, sizeof(BlockMagic));
+    qToLittleEndian<quint32>(static_cast<quint32>(count), out + 4);
+    qToLittleEndian<quint32>(static_cast<quint32>(blockAreas.size()), out + 8);
+    qToLittleEndian<quint32>(0, out + 12);
+    qToLittleEndian<quint64>(checksum(payload, payloadSize), out + 16);
+
+    if (!file.seek(file.size()) || file.write(block) != block.size() || !file.flush()) {
+        setError(errorMessage, file.errorString());
+        return false;
+    }
+    return true;
+}
+
+bool replay(const QString &filePath, PointStore &points, ReplayResult *result,
+            QString *errorMessage)
+{
+    TraceSpan span("PointJournal::replay");
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadWrite)) {
+        setError(errorMessage, file.errorString());
+        return false;
+    }
+
+    const qint64 fileSize = file.size();
+    if (fileSize < HeaderSize) {
+        setError(errorMessage, QObject::tr("Journal is too small"));
+        return false;
+    }
+
+    const uchar *data = file.map(0, fileSize);
+    if (!data) {
+        setError(errorMessage, file.errorString());
+        return false;
+    }
+
+    ReplayResult replayed;
+    replayed.basePointCount = qFromLittleEndian<quint64>(data + 16);
+    replayed.baseFingerprint = qFromLittleEndian<quint64>(data + 24);
+    if (std::memcmp(data, Magic, sizeof(Magic)) != 0
+        || qFromLittleEndian<quint32>(data + 8) != FormatVersion) {
+        file.unmap(const_cast<uchar *>(data));
+        setError(errorMessage, QObject::tr("Not a points journal"));
+        return false;
+    }
+    if (replayed.basePointCount != static_cast<quint64>(points.size())
+        || replayed.baseFingerprint != fingerprint(points)) {
+        file.unmap(const_cast<uchar *>(data));
+        setError(errorMessage, QObject::tr("Journal belongs to other points"));
+        return false;
+    }
+
+    // Walk the blocks and stop at the first incomplete or damaged one
+    QVector<BlockRef> blocks;
+    qint64 offset = HeaderSize;
+    qsizetype first = points.size();
+    while (offset < fileSize) {
+        const uchar *block = data + offset;
+        if (fileSize - offset < BlockHeaderSize || std::memcmp(block, BlockMagic, sizeof(BlockMagic)) != 0) {
+            break;
+        }
+        BlockRef ref;
+        ref.payload = block + BlockHeaderSize;
+        ref.count = qFromLittleEndian<quint32>(block + 4);
+        ref.areaCount = qFromLittleEndian<quint32>(block + 8);
+        const qint64 payloadSize = 4 * static_cast<qint64>(ref.areaCount) + 6 * static_cast<qint64>(ref.count);
+        if (ref.areaCount > 65536 || fileSize - offset - BlockHeaderSize < payloadSize
+            || checksum(ref.payload, payloadSize) != qFromLittleEndian<quint64>(block + 16)) {
+            break;
+        }
+
+        // Reject indices outside the block's area table
+        const uchar *indices = ref.payload + 4 * ref.areaCount + 4 * static_cast<qint64>(ref.count);
+        bool valid = true;
+        for (quint32 i = 0; valid && i < ref.count; i++) {
+            valid = qFromLittleEndian<quint16>(indices + 2 * i) < ref.areaCount;
+        }
+        if (!valid) {
+            break;
+        }
+
+        ref.first = first;
+        first += ref.count;
+        blocks.append(ref);
+        replayed.blockCount++;
+        replayed.pointCount += ref.count;
+        offset += BlockHeaderSize + payloadSize;
+    }
+    replayed.truncated = offset < fileSize;
+
+    // Map each block's areas to store slots, then copy the blocks in parallel
+    for (BlockRef &ref : blocks) {
+        for (quint32 a = 0; a < ref.areaCount; a++) {
+            ref.remap.append(points.areaSlot(qFromLittleEndian<qint32>(ref.payload + 4 * a)));
+        }
+    }
+    points.extend(replayed.pointCount);
+    const BlockRef *blockData = blocks.constData();
+    Parallel::run(blocks.size(), [&](int b) {
+        const BlockRef &ref = blockData[b];
+        const uchar *columns = ref.payload + 4 * ref.areaCount;
+        const uchar *indices = columns + 4 * ref.count;
+        points.forEachWritableRun(ref.first, ref.first + ref.count, [&](qsizetype begin, qsizetype length,
+                                                                      qint16 *xs, qint16 *ys,
+                                                                      quint16 *areaIndices) {
+            const qsizetype at = 2 * (begin - ref.first);
+            qFromLittleEndian<qint16>(columns + at, length, xs);
+            qFromLittleEndian<qint16>(columns + 2 * ref.count + at, length, ys);
+            for (qsizetype i = 0; i < length; i++) {
+                areaIndices[i] = ref.remap[qFromLittleEndian<quint16>(indices + at + 2 * i)];
+            }
+        });
+    });
+
+    file.unmap(const_cast<uchar *>(data));
+
+    // Cut off the damaged tail so later blocks follow the last good one
+    if (replayed.truncated && !file.resize(offset)) {
+        setError(errorMessage, file.errorString());
+    }
+
+    if (result) {
+        *result = replayed;
+    }
+    return true;
+}
+
+} // namespace PointJournal
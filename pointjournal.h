@@ -0,0 +1,57 @@
+#ifndef POINTJOURNAL_H
+#define POINTJOURNAL_H
+
+#include <QString>
+#include "pointstore.h"
+
+// Append-only journal of point blocks written on top of a points file.
+// Adding points to a large dataset appends one block to the journal instead
+// of rewriting the points file; the journal is folded into the points file
+// (compacted) by a regular full save, which then deletes it.
+//
+// Journal format (little-endian):
+//   char[8]  magic "MLDJOURN"
+//   quint32  format version, quint32 reserved
+//   quint64  point count of the base points file
+//   quint64  fingerprint of the base points (see fingerprint())
+//   blocks, each:
+//     quint32 magic "PBLK", quint32 point count, quint32 area count,
+//     quint32 reserved, quint64 checksum of the payload
+//     payload: qint32[area count] area numbers, qint16[count] x,
+//              qint16[count] y, quint16[count] area index
+//
+// A block is only replayed when it is complete and its checksum matches, so
+// a crash while appending loses at most the block being written. The base
+// fields tie the journal to one points file: a journal left behind by a
+// compaction that was interrupted before deleting it no longer matches and
+// is discarded.
+namespace PointJournal {
+
+// Order-independent hash of the points (coordinates and area numbers), so
+// it survives formats that reorder points
+quint64 fingerprint(const PointStore &points);
+
+// Append points [first, first + count) as one block. A missing journal, or
+// one written for a different base, is started over with a fresh header.
+bool append(const QString &filePath, quint64 basePointCount, quint64 baseFingerprint,
+            const PointStore &points, qsizetype first, qsizetype count,
+            QString *errorMessage = nullptr);
+
+struct ReplayResult {
+    quint64 basePointCount = 0;
+    quint64 baseFingerprint = 0;
+    qint64 blockCount = 0;
+    qint64 pointCount = 0;
+    bool truncated = false;   // An incomplete or corrupt tail was cut off
+};
+
+// Append the journal's blocks to points, which must hold the base it was
+// written for. Returns false (leaving points unchanged) if the file is not
+// a journal or belongs to another base. A damaged tail is truncated so new
+// blocks follow the last good one.
+bool replay(const QString &filePath, PointStore &points, ReplayResult *result = nullptr,
+            QString *errorMessage = nullptr);
+
+} // namespace PointJournal
+
+#endif // POINTJOURNAL_H
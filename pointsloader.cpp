@@ -0,0 +1,212 @@
+#include "pointsloader.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+#include "perfcounters.h"
+#include "trace.h"
+
+namespace {
+
+// The first chunk is small so it is drawn quickly; later ones grow up to the
+// maximum to keep the per-chunk overhead low
+const qint64 FirstChunkPoints = 1 << 16;
+const qint64 MaxChunkPoints = 1 << 22;
+const qint64 FirstSliceBytes = 1 << 20;
+const qint64 MaxSliceBytes = 1 << 25;
+
+} // namespace
+
+PointsLoader::PointsLoader(QObject *parent)
+    : QThread(parent)
+    , format(PointFileFormat::Binary)
+    , cancelled(false)
+    , success(false)
+    , pointCount(0)
+    , milliseconds(0)
+{
+    qRegisterMetaType<PointStore>();
+}
+
+void PointsLoader::setSource(const QString &filePath)
+{
+    this->filePath = filePath;
+}
+
+void PointsLoader::cancel()
+{
+    cancelled = true;
+}
+
+void PointsLoader::run()
+{
+    TraceSpan span("PointsLoader::run");
+
+    QElapsedTimer timer;
+    timer.start();
+
+    success = false;
+    errorMessage.clear();
+    pointCount = 0;
+    csvReport = CsvParseReport();
+    compressionStats = CompressionStats();
+
+    format = PointFile::detectFormat(filePath);
+    bool ok;
+    if (format == PointFileFormat::Compressed) {
+        ok = loadCompressed();
+    } else if (format == PointFileFormat::Csv) {
+        ok = loadCsv();
+    } else {
+        ok = loadBinary();
+    }
+
+    milliseconds = timer.elapsed();
+    success = ok && !cancelled;
+    if (success) {
+        PerfCounters::recordLoad(milliseconds);
+    }
+}
+
+void PointsLoader::deliver(const PointStore &chunk)
+{
+    TraceSpan span("PointsLoader::deliver");
+
+    pointCount += chunk.size();
+    emit chunkLoaded(chunk);
+}
+
+bool PointsLoader::loadBinary()
+{
+    PointFile::BinaryLayout layout;
+    if (!PointFile::readBinaryLayout(filePath, layout, &errorMessage)) {
+        return false;
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        errorMessage = file.errorString();
+        return false;
+    }
+
+    const qint64 count = static_cast<qint64>(layout.pointCount);
+    const quint16 areaCount = static_cast<quint16>(layout.areaNumbers.size());
+    qint64 start = 0;
+    qint64 chunkPoints = FirstChunkPoints;
+    while (start < count && !cancelled) {
+        const qint64 n = qMin(chunkPoints, count - start);
+        const uchar *xs = file.map(layout.xOffset + 2 * start, 2 * n);
+        const uchar *ys = file.map(layout.yOffset + 2 * start, 2 * n);
+        const uchar *areaIndices = file.map(layout.areaIndexOffset + 2 * start, 2 * n);
+
+        PointStore chunk;
+        const bool mapped = xs && ys && areaIndices;
+        if (mapped) {
+            chunk.setAreaNumbers(layout.areaNumbers);
+            chunk.resize(n);
+            chunk.forEachWritableRun(0, n, [&](qsizetype first, qsizetype length, qint16 *chunkXs, qint16 *chunkYs,
+                                               quint16 *chunkAreaIndices) {
+                qFromLittleEndian<qint16>(xs + 2 * first, length, chunkXs);
+                qFromLittleEndian<qint16>(ys + 2 * first, length, chunkYs);
+                qFromLittleEndian<quint16>(areaIndices + 2 * first, length, chunkAreaIndices);
+            });
+        }
+        for (const uchar *data : {xs, ys, areaIndices}) {
+            if (data) {
+                file.unmap(const_cast<uchar *>(data));
+            }
+        }
+        if (!mapped) {
+            errorMessage = file.errorString();
+            return false;
+        }
+
+        // Reject indices outside the area table
+        bool invalid = false;
+        chunk.forEachRun(0, n, [&](qsizetype, qsizetype length, const qint16 *, const qint16 *,
+                                   const quint16 *indices) {
+            invalid = invalid || std::any_of(indices, indices + length,
+                                             [areaCount](quint16 index) { return index >= areaCount; });
+        });
+        if (invalid) {
+            errorMessage = QObject::tr("Points file has an invalid area index");
+            return false;
+        }
+
+        deliver(chunk);
+        start += n;
+        chunkPoints = qMin(2 * chunkPoints, MaxChunkPoints);
+    }
+    return true;
+}
+
+bool PointsLoader::loadCsv()
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        errorMessage = file.errorString();
+        return false;
+    }
+
+    const qint64 fileSize = file.size();
+    if (fileSize == 0) {
+        return true;
+    }
+
+    const uchar *mapping = file.map(0, fileSize);
+    if (!mapping) {
+        errorMessage = file.errorString();
+        return false;
+    }
+    const char *data = reinterpret_cast<const char *>(mapping);
+    const char *end = data + fileSize;
+
+    // Newline-aligned slices; the first one also skips the BOM and header
+    const char *p = data;
+    qint64 sliceBytes = FirstSliceBytes;
+    qint64 firstLine = 1;
+    while (p < end && !cancelled) {
+        const char *sliceEnd = end;
+        if (end - p > sliceBytes) {
+            const char *newline = static_cast<const char *>(std::memchr(p + sliceBytes, '\n', end - p - sliceBytes));
+            sliceEnd = newline ? newline + 1 : end;
+        }
+
+        PointStore chunk;
+        CsvParseReport report;
+        if (p == data) {
+            CsvPointParser::parse(p, sliceEnd - p, chunk, &report);
+        } else {
+            CsvPointParser::parseSlice(p, sliceEnd - p, firstLine, chunk, &report);
+        }
+
+        csvReport.lineCount += report.lineCount;
+        csvReport.malformedCount += report.malformedCount;
+        for (const CsvMalformedLine &line : report.malformedLines) {
+            if (csvReport.malformedLines.size() < CsvPointParser::MaxReportedLines) {
+                csvReport.malformedLines.append(line);
+            }
+        }
+
+        firstLine += std::count(p, sliceEnd, '\n');
+        p = sliceEnd;
+        sliceBytes = qMin(2 * sliceBytes, MaxSliceBytes);
+        if (!chunk.isEmpty()) {
+            deliver(chunk);
+        }
+    }
+
+    file.unmap(const_cast<uchar *>(mapping));
+    return true;
+}
+
+bool PointsLoader::loadCompressed()
+{
+    PointStore points;
+    if (!PointFile::loadCompressed(filePath, points, nullptr, &errorMessage, &compressionStats)) {
+        return false;
+    }
+    deliver(points);
+    return true;
+}
@@ -0,0 +1,65 @@
+#ifndef POINTSLOADER_H
+#define POINTSLOADER_H
+
+#include <QThread>
+#include <QMetaType>
+#include <atomic>
+#include "pointfile.h"
+#include "pointstore.h"
+
+Q_DECLARE_METATYPE(PointStore)
+
+// Loads a points file on a worker thread and hands the points over in
+// chunks, so they can be drawn while the rest of the file is read.
+// Binary files are read in windows of the mapped columns and CSV files are
+// parsed in newline-aligned slices of the mapping; both start with a small
+// chunk that grows geometrically, so the first points arrive within a few
+// milliseconds. Compressed files arrive as one chunk. Results are read with
+// the getters once the thread has finished.
+class PointsLoader : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit PointsLoader(QObject *parent = nullptr);
+
+    void setSource(const QString &filePath);
+    void cancel();
+
+    QString getFilePath() const { return filePath; }
+    PointFileFormat getFormat() const { return format; }
+    bool succeeded() const { return success; }
+    QString getErrorMessage() const { return errorMessage; }
+    qint64 getPointCount() const { return pointCount; }
+    qint64 getMilliseconds() const { return milliseconds; }
+
+    // Filled for CSV and compressed files respectively
+    const CsvParseReport &getCsvReport() const { return csvReport; }
+    const CompressionStats &getCompressionStats() const { return compressionStats; }
+
+signals:
+    // A chunk with its own area table; chunks arrive in file order
+    void chunkLoaded(const PointStore &chunk);
+
+protected:
+    void run() override;
+
+private:
+    QString filePath;
+    PointFileFormat format;
+    std::atomic<bool> cancelled;
+
+    bool success;
+    QString errorMessage;
+    qint64 pointCount;
+    qint64 milliseconds;
+    CsvParseReport csvReport;
+    CompressionStats compressionStats;
+
+    bool loadBinary();
+    bool loadCsv();
+    bool loadCompressed();
+    void deliver(const PointStore &chunk);
+};
+
+#endif // POINTSLOADER_H
@@ -0,0 +1,171 @@
+#include "pointstore.h"
+#include <atomic>
+#include <cstring>
+
+namespace {
+
+std::atomic<quint64> lastVersion{0};
+
+} // namespace
+
+void PointStore::touch()
+{
+    currentVersion = lastVersion.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+void PointStore::rebase()
+{
+    touch();
+    currentBaseVersion = currentVersion;
+}
+
+void PointStore::clear()
+{
+    chunks.clear();
+    count = 0;
+    areaNumbers.clear();
+    rebase();
+}
+
+void PointStore::resize(qsizetype newCount)
+{
+    // Growing keeps the points already there; filling an empty store starts
+    // a new base so it is never mistaken for another store that grew
+    const bool keepsPoints = count > 0 && newCount >= count;
+
+    // Only the chunks from the one holding the old or the new end onwards
+    // change length; resizing their columns detaches them
+    const int firstChanged = static_cast<int>(qMin(count, newCount) >> ChunkShift);
+    chunks.resize(static_cast<int>((newCount + ChunkSize - 1) >> ChunkShift));
+    for (int c = firstChanged; c < chunks.size(); c++) {
+        const int length = static_cast<int>(qMin(ChunkSize, newCount - (qsizetype(c) << ChunkShift)));
+        Chunk &chunk = chunks[c];
+        if (chunk.xs.size() != length) {
+            chunk.xs.resize(length);
+            chunk.ys.resize(length);
+            chunk.areaIndices.resize(length);
+        }
+    }
+    count = newCount;
+
+    if (keepsPoints) {
+        touch();
+    } else {
+        rebase();
+    }
+}
+
+qsizetype PointStore::extend(qsizetype added)
+{
+    const qsizetype first = count;
+    resize(count + added);
+    return first;
+}
+
+quint16 PointStore::areaSlot(int areaNumber)
+{
+    int slot = areaNumbers.indexOf(areaNumber);
+    if (slot < 0) {
+        slot = areaNumbers.size();
+        areaNumbers.append(areaNumber);
+        touch();
+    }
+    return static_cast<quint16>(slot);
+}
+
+void PointStore::setAreaNumbers(const QVector<int> &numbers)
+{
+    areaNumbers = numbers;
+    rebase();
+}
+
+void PointStore::set(qsizetype i, int x, int y, quint16 areaIndex)
+{
+    Chunk &chunk = chunks[i >> ChunkShift];
+    chunk.xs[i & ChunkMask] = static_cast<qint16>(x);
+    chunk.ys[i & ChunkMask] = static_cast<qint16>(y);
+    chunk.areaIndices[i & ChunkMask] = areaIndex;
+}
+
+void PointStore::append(int x, int y, int areaNumber)
+{
+    quint16 slot = areaSlot(areaNumber);
+    if ((count & ChunkMask) == 0) {
+        chunks.append(Chunk());
+    }
+    Chunk &chunk = chunks.last();
+    chunk.xs.append(static_cast<qint16>(x));
+    chunk.ys.append(static_cast<qint16>(y));
+    chunk.areaIndices.append(slot);
+    count++;
+    if (count == 1) {
+        rebase();
+    } else {
+        touch();
+    }
+}
+
+void PointStore::append(const PointStore &other)
+{
+    QVector<quint16> remap;
+    for (int areaNumber : other.areaNumbers) {
+        remap.append(areaSlot(areaNumber));
+    }
+
+    const qsizetype added = other.size();
+    if (added == 0) {
+        return;
+    }
+    const qsizetype first = extend(added);
+    forEachWritableRun(first, first + added, [&](qsizetype begin, qsizetype length, qint16 *xs, qint16 *ys,
+                                                 quint16 *areaIndices) {
+        const qsizetype source = begin - first;
+        other.forEachRun(source, source + length, [&](qsizetype from, qsizetype n, const qint16 *otherXs,
+                                                      const qint16 *otherYs, const quint16 *otherIndices) {
+            const qsizetype to = from - source;
+            std::memcpy(xs + to, otherXs, n * sizeof(qint16));
+            std::memcpy(ys + to, otherYs, n * sizeof(qint16));
+            for (qsizetype i = 0; i < n; i++) {
+                areaIndices[to + i] = remap[otherIndices[i]];
+            }
+        });
+    });
+}
+
+PointStore PointStore::mid(qsizetype first, qsizetype length) const
+{
+    PointStore result;
+    result.areaNumbers = areaNumbers;
+    if ((first & ChunkMask) == 0 && length > 0) {
+        // Share the whole chunks; resize() cuts the last one to length
+        const int firstChunk = static_cast<int>(first >> ChunkShift);
+        const int chunkTotal = static_cast<int>((length + ChunkSize - 1) >> ChunkShift);
+        result.chunks = chunks.mid(firstChunk, chunkTotal);
+        result.count = (qsizetype(chunkTotal - 1) << ChunkShift) + result.chunks.last().xs.size();
+        result.resize(length);
+    } else {
+        result.resize(length);
+        result.forEachWritableRun(0, length, [&](qsizetype begin, qsizetype n, qint16 *xs, qint16 *ys,
+                                                 quint16 *areaIndices) {
+            forEachRun(first + begin, first + begin + n, [&](qsizetype from, qsizetype runLength,
+                                                             const qint16 *sourceXs, const qint16 *sourceYs,
+                                                             const quint16 *sourceIndices) {
+                const qsizetype to = from - first - begin;
+                std::memcpy(xs + to, sourceXs, runLength * sizeof(qint16));
+                std::memcpy(ys + to, sourceYs, runLength * sizeof(qint16));
+                std::memcpy(areaIndices + to, sourceIndices, runLength * sizeof(quint16));
+            });
+        });
+    }
+    result.rebase();
+    return result;
+}
+
+qint64 PointStore::memoryBytes() const
+{
+    qint64 bytes = chunks.capacity() * qint64(sizeof(Chunk)) + areaNumbers.capacity() * qint64(sizeof(int));
+    for (int c = 0; c < chunks.size(); c++) {
+        bytes += chunkMemoryBytes(c);
+    }
+    return bytes;
+}
@@ -0,0 +1,152 @@
+#ifndef POINTSTORE_H
+#define POINTSTORE_H
+
+#include <QVector>
+
+// Structure for point data to save
+struct PointDataSave {
+    int x;
+    int y;
+    int areaNumber;
+};
+
+// Columnar storage of generated points.
+// Coordinates fit the logical range and are kept as int16 columns; the area
+// of each point is a uint16 index into a small table of area numbers, as in
+// the binary points file.
+// The columns are cut into chunks of ChunkSize points, each implicitly
+// shared, and only the last chunk may be shorter. Copies of a store share
+// its chunks and a write detaches just the chunks it touches, so a copy
+// kept for undo costs a reference count per chunk, and appending to a store
+// that shares its chunks copies at most its last one. Bulk readers and
+// writers go through the chunks' raw columns a run at a time (forEachRun()).
+// Every change gives the store a new version, unique across all stores, so
+// a reader holding a pointer to the store can tell whether it changed since
+// it last looked; copies share the version of their source.
+class PointStore
+{
+public:
+    // Most points whose indices fit 32 bits. Indexes that keep an index per
+    // point in 32 bits to halve their memory (the outlier index, the display
+    // subset and the image export) take stores of at most this size.
+    static constexpr qint64 MaxIndexedPoints = qint64(1) << 32;
+
+    // Points per chunk (6 MB of columns); a power of two so the chunk of a
+    // point is a shift
+    static constexpr int ChunkShift = 20;
+    static constexpr qsizetype ChunkSize = qsizetype(1) << ChunkShift;
+
+    qsizetype size() const { return count; }
+    bool isEmpty() const { return count == 0; }
+
+    void clear();
+    void resize(qsizetype count);
+
+    // Add count uninitialized points at the end and return the index of the
+    // first one
+    qsizetype extend(qsizetype count);
+
+    // Index of an area number in the area table, adding it if needed
+    quint16 areaSlot(int areaNumber);
+
+    void append(int x, int y, int areaNumber);
+
+    // Append all points of another store, mapping its area table onto ours
+    void append(const PointStore &other);
+
+    // Points [first, first + count) with the same area table; whole chunks
+    // are shared when first is at the start of a chunk
+    PointStore mid(qsizetype first, qsizetype count) const;
+
+    int x(qsizetype i) const { return chunks[i >> ChunkShift].xs[i & ChunkMask]; }
+    int y(qsizetype i) const { return chunks[i >> ChunkShift].ys[i & ChunkMask]; }
+    quint16 areaIndex(qsizetype i) const { return chunks[i >> ChunkShift].areaIndices[i & ChunkMask]; }
+    int areaNumber(qsizetype i) const { return areaNumbers[areaIndex(i)]; }
+    PointDataSave at(qsizetype i) const { return {x(i), y(i), areaNumber(i)}; }
+
+    // Write point i, for writers that do not go a run at a time
+    void set(qsizetype i, int x, int y, quint16 areaIndex);
+
+    // Version of the contents; writes to the points made room for by
+    // resize() or extend() belong to that change
+    quint64 version() const { return currentVersion; }
+
+    // Version of the points already in the store: appending points or area
+    // numbers keeps it, while clear(), shrinking, filling an empty store and
+    // a new area table renew it. A reader that has seen the first n points at this base version
+    // only needs to look at the points after them.
+    quint64 baseVersion() const { return currentBaseVersion; }
+
+    // Raw columns of one chunk
+    int chunkCount() const { return chunks.size(); }
+    qsizetype chunkLength(int chunk) const { return chunks[chunk].xs.size(); }
+    const qint16 *xData(int chunk) const { return chunks[chunk].xs.constData(); }
+    const qint16 *yData(int chunk) const { return chunks[chunk].ys.constData(); }
+    const quint16 *areaIndexData(int chunk) const { return chunks[chunk].areaIndices.constData(); }
+
+    // Call function(first, count, xs, ys, areaIndices) for every run of the
+    // points [begin, end) that lies in one chunk, with the columns starting
+    // at point first of the store
+    template<typename Function>
+    void forEachRun(qsizetype begin, qsizetype end, Function function) const
+    {
+        while (begin < end) {
+            const Chunk &chunk = chunks[begin >> ChunkShift];
+            const qsizetype offset = begin & ChunkMask;
+            const qsizetype length = qMin(end - begin, chunk.xs.size() - offset);
+            function(begin, length, chunk.xs.constData() + offset, chunk.ys.constData() + offset,
+                     chunk.areaIndices.constData() + offset);
+            begin += length;
+        }
+    }
+
+    // The same with writable columns. Writing detaches the chunks from the
+    // stores that share them; resize() and extend() already did that for
+    // the points they add, so threads may fill different parts of those
+    // at the same time.
+    template<typename Function>
+    void forEachWritableRun(qsizetype begin, qsizetype end, Function function)
+    {
+        while (begin < end) {
+            Chunk &chunk = chunks[begin >> ChunkShift];
+            const qsizetype offset = begin & ChunkMask;
+            const qsizetype length = qMin(end - begin, chunk.xs.size() - offset);
+            function(begin, length, chunk.xs.data() + offset, chunk.ys.data() + offset,
+                     chunk.areaIndices.data() + offset);
+            begin += length;
+        }
+    }
+
+    // Heap memory of the columns and the area table
+    qint64 memoryBytes() const;
+    // Heap memory of one chunk's columns
+    qint64 chunkMemoryBytes(int chunk) const
+    {
+        return (chunks[chunk].xs.capacity() + chunks[chunk].ys.capacity() + chunks[chunk].areaIndices.capacity())
+               * qint64(sizeof(qint16));
+    }
+
+    // Area number for each area index
+    const QVector<int> &getAreaNumbers() const { return areaNumbers; }
+    void setAreaNumbers(const QVector<int> &numbers);
+
+private:
+    static constexpr qsizetype ChunkMask = ChunkSize - 1;
+
+    struct Chunk {
+        QVector<qint16> xs;
+        QVector<qint16> ys;
+        QVector<quint16> areaIndices;
+    };
+
+    void touch();
+    void rebase();
+
+    QVector<Chunk> chunks;
+    qsizetype count = 0;
+    QVector<int> areaNumbers;
+    quint64 currentVersion = 0;
+    quint64 currentBaseVersion = 0;
+};
+
+#endif // POINTSTORE_H
@@ -0,0 +1,98 @@
+#include "sobol.h"
+
+namespace {
+
+// Direction numbers from Joe and Kuo's table: dimension 0 is the van der
+// Corput sequence, dimension 1 uses the polynomial x + 1 and dimension 2
+// x^2 + x + 1 with initial numbers m = 1, 3
+struct Directions {
+    quint32 v[Sobol::Dimensions][32];
+
+    Directions()
+    {
+        for (int k = 0; k < 32; k++) {
+            v[0][k] = 1u << (31 - k);
+        }
+
+        v[1][0] = 1u << 31;
+        for (int k = 1; k < 32; k++) {
+            v[1][k] = v[1][k - 1] ^ (v[1][k - 1] >> 1);
+        }
+
+        v[2][0] = 1u << 31;
+        v[2][1] = 3u << 30;
+        for (int k = 2; k < 32; k++) {
+            v[2][k] = v[2][k - 1] ^ v[2][k - 2] ^ (v[2][k - 2] >> 2);
+        }
+    }
+};
+
+const Directions directions;
+
+inline quint32 reverseBits(quint32 x)
+{
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+    x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// Nested uniform (Owen) scramble: the hash of the bit-reversed value only
+// lets each bit depend on the bits above it in the original order
+inline quint32 scramble(quint32 x, quint32 seed)
+{
+    x = reverseBits(x);
+    x += seed;
+    x ^= x * 0x6C50B47Cu;
+    x ^= x * 0xB82F1E52u;
+    x ^= x * 0xC7AFE638u;
+    x ^= x * 0x8D22F6E6u;
+    return reverseBits(x);
+}
+
+// Scramble seed of the period-th run of 2^32 points; the first run keeps
+// the seed itself
+inline quint32 periodSeed(quint32 seed, quint64 period)
+{
+    if (period == 0) {
+        return seed;
+    }
+    quint64 z = (static_cast<quint64>(seed) << 32 | seed) + period * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return static_cast<quint32>(z ^ (z >> 31));
+}
+
+} // namespace
+
+namespace Sobol {
+
+void fill(int dimension, quint32 seed, quint64 first, int count, quint32 *out)
+{
+    const quint32 *v = directions.v[dimension];
+
+    while (count > 0) {
+        // Points up to the end of the current run of 2^32
+        const quint64 period = first >> 32;
+        const quint32 start = static_cast<quint32>(first);
+        const int n = static_cast<int>(qMin<quint64>(count, (quint64(1) << 32) - start));
+        const quint32 scrambleSeed = periodSeed(seed, period);
+
+        // Each point is the XOR of the direction numbers of its index's set
+        // bits; the masks keep the loop free of branches so it vectorizes
+        for (int j = 0; j < n; j++) {
+            const quint32 index = start + static_cast<quint32>(j);
+            quint32 bits = 0;
+            for (int k = 0; k < 32; k++) {
+                bits ^= v[k] & (0u - ((index >> k) & 1u));
+            }
+            out[j] = scramble(bits, scrambleSeed);
+        }
+        first += n;
+        out += n;
+        count -= n;
+    }
+}
+
+} // namespace Sobol
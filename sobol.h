@@ -0,0 +1,25 @@
+#ifndef SOBOL_H
+#define SOBOL_H
+
+#include <QtGlobal>
+
+// Sobol low-discrepancy sequence in the first few dimensions, Owen-scrambled
+// with Burley's hash-based nested uniform scramble. Points are computed from
+// their index rather than from the previous point, so any range of the
+// sequence can be produced on its own: splitting a sequence into ranges
+// gives the same points as producing it in one go.
+namespace Sobol {
+
+// Number of dimensions with direction numbers
+const int Dimensions = 3;
+
+// Write coordinate `dimension` of points [first, first + count) to out, as
+// 32-bit fractions of 1. Points with the same seed form one scrambled
+// sequence. The Sobol sequence itself repeats after 2^32 points, so every
+// further 2^32 points take a scramble of their own and never repeat earlier
+// ones; the first 2^32 points do not change with that.
+void fill(int dimension, quint32 seed, quint64 first, int count, quint32 *out);
+
+} // namespace Sobol
+
+#endif // SOBOL_H
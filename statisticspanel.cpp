@@ -0,0 +1,24 @@
+#include "statisticspanel.h"
+#include <QVBoxLayout>
+#include <QHeaderView>
+
+StatisticsPanel::StatisticsPanel(StatisticsTableModel *model, QWidget *parent)
+    : QWidget(parent)
+{
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+
+    table = new QTableView(this);
+    table->setModel(model);
+    // Size the columns from the rows in view only, so a change does not
+    // format every row of a long table
+    table->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    table->horizontalHeader()->setResizeContentsPrecision(0);
+    table->verticalHeader()->setVisible(false);
+    table->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setSelectionMode(QAbstractItemView::NoSelection);
+    table->setToolTip(tr("Empirical value (requested value) for each area.\n"
+                         "p-values test the points against the truncated Gaussian the generator samples from."));
+    layout->addWidget(table);
+}
@@ -0,0 +1,21 @@
+#ifndef STATISTICSPANEL_H
+#define STATISTICSPANEL_H
+
+#include <QWidget>
+#include <QTableView>
+#include "statisticstablemodel.h"
+
+// Table comparing the empirical statistics of each area's points with the
+// requested parameters, plus chi-square and Kolmogorov-Smirnov p-values
+class StatisticsPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit StatisticsPanel(StatisticsTableModel *model, QWidget *parent = nullptr);
+
+private:
+    QTableView *table;
+};
+
+#endif // STATISTICSPANEL_H
@@ -0,0 +1,139 @@
+#include "statisticstablemodel.h"
+#include "controller.h"
+
+StatisticsTableModel::StatisticsTableModel(Controller *controller, QObject *parent)
+    : QAbstractTableModel(parent)
+    , controller(controller)
+    , rows(controller->getAreaDefinitionsCount())
+    , fits(rows)
+{
+}
+
+int StatisticsTableModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : rows;
+}
+
+int StatisticsTableModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+const AreaFit &StatisticsTableModel::fit(int row, const AreaStatistics &stats) const
+{
+    RowFit &rowFit = fits[row];
+    if (!rowFit.evaluated) {
+        rowFit.fit = evaluateFit(stats, controller->getAreaDefinitions()[row]);
+        rowFit.evaluated = true;
+    }
+    return rowFit.fit;
+}
+
+QVariant StatisticsTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= rows || index.row() >= controller->getAreaDefinitionsCount()) {
+        return QVariant();
+    }
+    if (role == Qt::TextAlignmentRole) {
+        return static_cast<int>(Qt::AlignCenter);
+    }
+    if (role != Qt::DisplayRole) {
+        return QVariant();
+    }
+
+    const AreaDefinition &area = controller->getAreaDefinitions()[index.row()];
+    if (index.column() == AreaNumberColumn) {
+        return area.areaNumber;
+    }
+
+    const QHash<int, AreaStatistics> &statistics = controller->getAreaStatistics();
+    auto it = statistics.constFind(area.areaNumber);
+    if (it == statistics.constEnd()) {
+        return index.column() == PointsColumn ? QVariant(0) : QVariant();
+    }
+
+    const AreaStatistics &stats = it.value();
+    const AreaCovariance covariance = areaCovariance(area);
+    auto compare = [](double empirical, double requested) {
+        return QString("%1 (%2)").arg(empirical, 0, 'f', 1).arg(requested);
+    };
+
+    switch (index.column()) {
+        case PointsColumn:
+            return stats.getCount();
+        case CenterXColumn:
+            return compare(stats.meanX(), area.centerX);
+        case CenterYColumn:
+            return compare(stats.meanY(), area.centerY);
+        case SigmaXColumn:
+            return compare(stats.sigmaX(), covariance.marginalSigmaX());
+        case SigmaYColumn:
+            return compare(stats.sigmaY(), covariance.marginalSigmaY());
+        case CorrelationColumn:
+            return QString("%1 (%2)").arg(stats.correlation(), 0, 'f', 3)
+                                     .arg(covariance.correlation(), 0, 'f', 3);
+        case ChiSquareColumn: {
+            const AreaFit &areaFit = fit(index.row(), stats);
+            return QString("%1 / %2").arg(areaFit.x.chiSquarePValue, 0, 'g', 3)
+                                     .arg(areaFit.y.chiSquarePValue, 0, 'g', 3);
+        }
+        case KolmogorovSmirnovColumn: {
+            const AreaFit &areaFit = fit(index.row(), stats);
+            return QString("%1 / %2").arg(areaFit.x.ksPValue, 0, 'g', 3)
+                                     .arg(areaFit.y.ksPValue, 0, 'g', 3);
+        }
+    }
+    return QVariant();
+}
+
+QVariant StatisticsTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+
+    switch (section) {
+        case AreaNumberColumn: return tr("Area #");
+        case PointsColumn: return tr("Points");
+        case CenterXColumn: return tr("Center X");
+        case CenterYColumn: return tr("Center Y");
+        case SigmaXColumn: return tr("Sigma X");
+        case SigmaYColumn: return tr("Sigma Y");
+        case CorrelationColumn: return tr("Corr");
+        case ChiSquareColumn: return tr("Chi² p (x/y)");
+        case KolmogorovSmirnovColumn: return tr("KS p (x/y)");
+    }
+    return QVariant();
+}
+
+void StatisticsTableModel::refreshAreas(int first, int last)
+{
+    for (int row = first; row <= last && row < rows; row++) {
+        fits[row].evaluated = false;
+    }
+    emit dataChanged(index(first, 0), index(last, ColumnCount - 1));
+}
+
+void StatisticsTableModel::insertAreas(int first, int last)
+{
+    beginInsertRows(QModelIndex(), first, last);
+    rows += last - first + 1;
+    fits.insert(first, last - first + 1, RowFit());
+    endInsertRows();
+}
+
+void StatisticsTableModel::removeAreas(int first, int last)
+{
+    beginRemoveRows(QModelIndex(), first, last);
+    rows -= last - first + 1;
+    fits.remove(first, last - first + 1);
+    endRemoveRows();
+}
+
+void StatisticsTableModel::reload()
+{
+    beginResetModel();
+    rows = controller->getAreaDefinitionsCount();
+    fits.fill(RowFit(), rows);
+    endResetModel();
+}
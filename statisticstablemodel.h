@@ -0,0 +1,62 @@
+#ifndef STATISTICSTABLEMODEL_H
+#define STATISTICSTABLEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QVector>
+#include "areastatistics.h"
+
+class Controller;
+
+// Table model comparing the empirical statistics of each area's points with
+// the requested parameters, one row per area of the controller. Cells are
+// formatted when a view asks for them and the goodness-of-fit tests of a row
+// run when it is first shown, so editing an area refreshes one row and a
+// view of ten thousand areas only formats the rows it shows.
+class StatisticsTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        AreaNumberColumn,
+        PointsColumn,
+        CenterXColumn,
+        CenterYColumn,
+        SigmaXColumn,
+        SigmaYColumn,
+        CorrelationColumn,
+        ChiSquareColumn,
+        KolmogorovSmirnovColumn,
+        ColumnCount
+    };
+
+    explicit StatisticsTableModel(Controller *controller, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    // The controller changed, added or removed the areas of rows [first, last]
+    void refreshAreas(int first, int last);
+    void insertAreas(int first, int last);
+    void removeAreas(int first, int last);
+
+    // The controller recomputed its statistics or replaced all of its areas
+    void reload();
+
+private:
+    // Goodness-of-fit of a row, evaluated when the row is first shown
+    struct RowFit {
+        bool evaluated = false;
+        AreaFit fit;
+    };
+
+    const AreaFit &fit(int row, const AreaStatistics &stats) const;
+
+    Controller *controller;
+    int rows = 0;
+    mutable QVector<RowFit> fits;
+};
+
+#endif // STATISTICSTABLEMODEL_H
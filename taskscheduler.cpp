@@ -0,0 +1,325 @@
+#include "taskscheduler.h"
+#include "parallel.h"
+#include "trace.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct TaskGraph::State {
+    struct Task {
+        const char *name;
+        std::function<void(TaskContext &)> fn;
+        QVector<int> dependents;
+        std::atomic<int> remainingDependencies{0};
+        std::atomic<double> progress{0};
+        double weight = 1;
+    };
+
+    QString name;
+    Priority priority = Priority::Normal;
+    CancellationToken token;
+    // Tasks never move once added, their atomics are shared with the pool
+    std::vector<std::unique_ptr<Task>> tasks;
+    double totalWeight = 0;
+    std::function<void(bool)> finishedCallback;
+    bool started = false;
+
+    std::atomic<int> unfinishedTasks{0};
+    std::mutex doneMutex;
+    std::condition_variable doneCondition;
+    bool done = false;
+};
+
+namespace {
+
+const int PriorityCount = 3;
+
+struct Item {
+    std::shared_ptr<TaskGraph::State> state;
+    int task;
+};
+
+// Index of the pool worker running on this thread, -1 elsewhere
+thread_local int workerIndex = -1;
+
+// Work-stealing pool shared by all task graphs. Each worker owns one deque
+// per priority: it pushes and pops its own tasks at the back and others
+// steal from the front. Tasks queued from other threads (the GUI thread
+// starting a job) go to a shared injection queue.
+class TaskPool
+{
+public:
+    TaskPool()
+    {
+        const int size = Parallel::threadCount();
+        for (int i = 0; i < size; i++) {
+            queues.emplace_back(new Queues);
+        }
+        for (int i = 0; i < size; i++) {
+            threads.emplace_back([this, i] {
+                Trace::setThreadName(QString("Task worker %1").arg(i + 1));
+                workerIndex = i;
+                workerLoop(i);
+            });
+        }
+    }
+
+    ~TaskPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wakeCondition.notify_all();
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
+
+    void push(Item item)
+    {
+        Queues &target = workerIndex >= 0 ? *queues[workerIndex] : injection;
+        const int priority = static_cast<int>(item.state->priority);
+        {
+            std::lock_guard<std::mutex> lock(target.mutex);
+            target.items[priority].push_back(std::move(item));
+        }
+        queuedItems.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wakeCondition.notify_one();
+    }
+
+private:
+    struct Queues {
+        std::mutex mutex;
+        std::deque<Item> items[PriorityCount];
+    };
+
+    static bool take(Queues &queues, int priority, bool newest, Item *item)
+    {
+        std::lock_guard<std::mutex> lock(queues.mutex);
+        std::deque<Item> &items = queues.items[priority];
+        if (items.empty()) {
+            return false;
+        }
+        if (newest) {
+            *item = std::move(items.back());
+            items.pop_back();
+        } else {
+            *item = std::move(items.front());
+            items.pop_front();
+        }
+        return true;
+    }
+
+    // Highest priority first: own tasks, then injected ones, then stolen
+    bool pop(int self, Item *item)
+    {
+        const int size = static_cast<int>(queues.size());
+        for (int priority = PriorityCount - 1; priority >= 0; priority--) {
+            if (take(*queues[self], priority, true, item) || take(injection, priority, false, item)) {
+                return true;
+            }
+            for (int k = 1; k < size; k++) {
+                if (take(*queues[(self + k) % size], priority, false, item)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(int self)
+    {
+        for (;;) {
+            Item item;
+            if (pop(self, &item)) {
+                queuedItems.fetch_sub(1);
+                execute(item);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wakeCondition.wait(lock, [this] { return stopping || queuedItems.load() > 0; });
+            if (stopping) {
+                return;
+            }
+        }
+    }
+
+    void execute(const Item &item);
+
+    std::vector<std::unique_ptr<Queues>> queues;
+    Queues injection;
+    std::vector<std::thread> threads;
+    std::atomic<int> queuedItems{0};
+    std::mutex sleepMutex;
+    std::condition_variable wakeCondition;
+    bool stopping = false;
+};
+
+TaskPool &pool()
+{
+    static TaskPool instance;
+    return instance;
+}
+
+// Run a task (or skip it once the job is cancelled), then queue the
+// dependents it was the last dependency of and finish the job after its
+// last task
+void TaskPool::execute(const Item &item)
+{
+    TaskGraph::State &state = *item.state;
+    TaskGraph::State::Task &task = *state.tasks[item.task];
+    if (!state.token.isCancelled()) {
+        TraceSpan span(task.name ? task.name : "Task");
+        TaskContext context(state.token, &task.progress);
+        task.fn(context);
+    }
+    task.progress.store(1, std::memory_order_relaxed);
+
+    for (int dependent : task.dependents) {
+        if (state.tasks[dependent]->remainingDependencies.fetch_sub(1) == 1) {
+            push({item.state, dependent});
+        }
+    }
+
+    if (state.unfinishedTasks.fetch_sub(1) == 1) {
+        // Released once it ran, so it may hold a handle of its own job
+        const std::function<void(bool)> callback = std::move(state.finishedCallback);
+        state.finishedCallback = nullptr;
+        if (callback) {
+            callback(state.token.isCancelled());
+        }
+        {
+            std::lock_guard<std::mutex> lock(state.doneMutex);
+            state.done = true;
+        }
+        state.doneCondition.notify_all();
+    }
+}
+
+} // namespace
+
+TaskGraph::TaskGraph(const QString &name, Priority priority)
+    : state(std::make_shared<State>())
+{
+    state->name = name;
+    state->priority = priority;
+}
+
+int TaskGraph::addTask(const char *name, const std::function<void(TaskContext &)> &fn,
+                       const QVector<int> &dependencies, double weight)
+{
+    if (state->started) {
+        return -1;
+    }
+    const int id = static_cast<int>(state->tasks.size());
+    std::unique_ptr<State::Task> task(new State::Task);
+    task->name = name;
+    task->fn = fn;
+    task->weight = qMax(0.0, weight);
+    for (int dependency : dependencies) {
+        if (dependency >= 0 && dependency < id) {
+            state->tasks[dependency]->dependents.append(id);
+            task->remainingDependencies++;
+        }
+    }
+    state->totalWeight += task->weight;
+    state->tasks.push_back(std::move(task));
+    return id;
+}
+
+void TaskGraph::setFinishedCallback(const std::function<void(bool)> &callback)
+{
+    state->finishedCallback = callback;
+}
+
+void TaskGraph::start()
+{
+    if (state->started) {
+        return;
+    }
+    state->started = true;
+
+    const int count = static_cast<int>(state->tasks.size());
+    if (count == 0) {
+        const std::function<void(bool)> callback = std::move(state->finishedCallback);
+        state->finishedCallback = nullptr;
+        if (callback) {
+            callback(state->token.isCancelled());
+        }
+        std::lock_guard<std::mutex> lock(state->doneMutex);
+        state->done = true;
+        return;
+    }
+
+    // Dependencies may only point backwards, so the graph has no cycles
+    // and every task is reached from the ones queued here
+    state->unfinishedTasks = count;
+    QVector<int> ready;
+    for (int task = 0; task < count; task++) {
+        if (state->tasks[task]->remainingDependencies.load() == 0) {
+            ready.append(task);
+        }
+    }
+    for (int task : ready) {
+        pool().push({state, task});
+    }
+}
+
+void TaskGraph::cancel()
+{
+    state->token.cancel();
+}
+
+QString TaskGraph::getName() const
+{
+    return state->name;
+}
+
+TaskGraph::Priority TaskGraph::getPriority() const
+{
+    return state->priority;
+}
+
+CancellationToken TaskGraph::getToken() const
+{
+    return state->token;
+}
+
+bool TaskGraph::isCancelled() const
+{
+    return state->token.isCancelled();
+}
+
+bool TaskGraph::isFinished() const
+{
+    std::lock_guard<std::mutex> lock(state->doneMutex);
+    return state->done;
+}
+
+double TaskGraph::progress() const
+{
+    if (state->totalWeight <= 0) {
+        return isFinished() ? 1 : 0;
+    }
+    double done = 0;
+    for (const std::unique_ptr<State::Task> &task : state->tasks) {
+        done += task->weight * task->progress.load(std::memory_order_relaxed);
+    }
+    return done / state->totalWeight;
+}
+
+void TaskGraph::wait() const
+{
+    if (!state->started) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(state->doneMutex);
+    state->doneCondition.wait(lock, [this] { return state->done; });
+}
@@ -0,0 +1,98 @@
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+// Cancellation flag of a job, shared by its tasks and whoever started it;
+// copies share the flag. Cancelling is cooperative: tasks that have not
+// started are skipped, running ones poll isCancelled() and return early.
+class CancellationToken
+{
+public:
+    CancellationToken() : flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() { flag->store(true, std::memory_order_relaxed); }
+    bool isCancelled() const { return flag->load(std::memory_order_relaxed); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> flag;
+};
+
+// What a running task sees of its job
+class TaskContext
+{
+public:
+    TaskContext(const CancellationToken &token, std::atomic<double> *progress) : token(token), progress(progress) {}
+
+    bool isCancelled() const { return token.isCancelled(); }
+
+    // Fraction of the task done so far, in [0, 1]
+    void setProgress(double fraction) { progress->store(qBound(0.0, fraction, 1.0), std::memory_order_relaxed); }
+
+private:
+    CancellationToken token;
+    std::atomic<double> *progress;
+};
+
+// A job made of tasks with dependencies, run on a shared work-stealing pool
+// of worker threads. Every worker keeps its own queue per priority and
+// takes its newest task first, which keeps a task's dependents on the
+// thread that has its data in cache; idle workers steal the oldest tasks
+// of the others. Tasks of higher priority jobs always go first. Tasks may
+// use Parallel::run() for their data-parallel loops.
+// TaskGraph is a handle: copies refer to the same job, and the job stays
+// alive until its last task has finished, even if every handle is gone.
+class TaskGraph
+{
+public:
+    enum class Priority {
+        Low,
+        Normal,
+        High
+    };
+
+    explicit TaskGraph(const QString &name = QString(), Priority priority = Priority::Normal);
+
+    // Add a task that runs once the tasks in dependencies have finished and
+    // return its id. name is a string literal that also names the task's
+    // trace span; weight is the task's share of the job's progress. Tasks
+    // are added before start() (-1 after it) and after the tasks they
+    // depend on.
+    int addTask(const char *name, const std::function<void(TaskContext &context)> &fn,
+                const QVector<int> &dependencies = QVector<int>(), double weight = 1);
+
+    // Called once, on the thread that finished the last task, when every
+    // task has run or was skipped after cancel(). The callback is released
+    // after it ran, so it may hold a handle of its own job.
+    void setFinishedCallback(const std::function<void(bool cancelled)> &callback);
+
+    // Queue the tasks without dependencies
+    void start();
+    void cancel();
+
+    QString getName() const;
+    Priority getPriority() const;
+    CancellationToken getToken() const;
+    bool isCancelled() const;
+    bool isFinished() const;
+
+    // Weighted fraction of the tasks done, in [0, 1]
+    double progress() const;
+
+    // Block until the job has finished; not from one of its own tasks
+    void wait() const;
+
+    // Handles of the same job
+    bool operator==(const TaskGraph &other) const { return state == other.state; }
+
+    struct State;
+
+private:
+    std::shared_ptr<State> state;
+};
+
+#endif // TASKSCHEDULER_H
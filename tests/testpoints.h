@@ -0,0 +1,89 @@
+#ifndef TESTPOINTS_H
+#define TESTPOINTS_H
+
+#include <QFile>
+#include <QRandomGenerator>
+#include <QString>
+#include <QVector>
+#include <algorithm>
+#include "areadefinition.h"
+#include "pointstore.h"
+
+// Points, area definitions and file helpers shared by the test cases
+namespace TestPoints {
+
+// count points spread over the areas 3, 7 and 11, the first ones at the
+// corners of the coordinate range; the same seed gives the same points
+inline PointStore make(qsizetype count, quint32 seed = 1)
+{
+    const int areaNumbers[] = {3, 7, 11};
+    const int corners[][2] = {{-32768, -32768}, {32767, 32767}, {-32768, 32767}, {32767, -32768}, {0, 0}};
+    QRandomGenerator random(seed);
+    PointStore points;
+    for (qsizetype i = 0; i < count; i++) {
+        const int area = areaNumbers[random.bounded(3)];
+        if (i < 5) {
+            points.append(corners[i][0], corners[i][1], area);
+        } else {
+            points.append(random.bounded(LogicalMin, LogicalMax + 1), random.bounded(LogicalMin, LogicalMax + 1), area);
+        }
+    }
+    return points;
+}
+
+inline QVector<AreaDefinition> areas()
+{
+    return {
+        {3, -100.0, 50.0, 20.0, 10.0, SymbolType::Cross, QColor(255, 0, 0)},
+        {7, 0.0, 0.0, 40.0, 40.0, SymbolType::Plus, QColor(0, 128, 0)},
+        {11, 150.0, -120.0, 5.0, 30.0, SymbolType::Star, QColor(0, 0, 255)},
+    };
+}
+
+// Same points with the same area numbers in the same order
+inline bool sameOrder(const PointStore &a, const PointStore &b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (qsizetype i = 0; i < a.size(); i++) {
+        if (a.x(i) != b.x(i) || a.y(i) != b.y(i) || a.areaNumber(i) != b.areaNumber(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The points as sorted keys, for formats that do not keep the point order
+inline QVector<quint64> sortedKeys(const PointStore &points)
+{
+    QVector<quint64> keys;
+    keys.reserve(points.size());
+    for (qsizetype i = 0; i < points.size(); i++) {
+        keys.append((quint64(quint32(points.areaNumber(i))) << 32) | (quint64(quint16(points.x(i))) << 16)
+                    | quint16(points.y(i)));
+    }
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
+inline bool patch(const QString &filePath, qint64 offset, const QByteArray &bytes)
+{
+    QFile file(filePath);
+    return file.open(QIODevice::ReadWrite) && file.seek(offset) && file.write(bytes) == bytes.size();
+}
+
+inline bool write(const QString &filePath, const QByteArray &bytes)
+{
+    QFile file(filePath);
+    return file.open(QIODevice::WriteOnly) && file.write(bytes) == bytes.size();
+}
+
+inline qint64 fileSize(const QString &filePath)
+{
+    return QFile(filePath).size();
+}
+
+} // namespace TestPoints
+
+#endif // TESTPOINTS_H
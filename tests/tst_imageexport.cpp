@@ -0,0 +1,166 @@
+#include <QImage>
+#include <QImageReader>
+#include <QTemporaryDir>
+#include <QtTest>
+#include "imageexport.h"
+#include "taskscheduler.h"
+#include "testpoints.h"
+
+// Images written by the export decode to the scene, in both formats and
+// across tile and band borders
+class TestImageExport : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void formatFor();
+    void pngDecodes();
+    void pngIsCompressed();
+    void pngMatchesTiff();
+    void rejectsSize();
+    void cancelledKeepsFile();
+
+private:
+    QString path(const QString &name) const { return dir.filePath(name); }
+
+    // The whole logical range at size, with the points of TestPoints::make()
+    static CanvasScene scene(const QSize &size, qsizetype pointCount);
+
+    QTemporaryDir dir;
+};
+
+void TestImageExport::initTestCase()
+{
+    QVERIFY(dir.isValid());
+}
+
+CanvasScene TestImageExport::scene(const QSize &size, qsizetype pointCount)
+{
+    CanvasScene scene;
+    scene.viewport = QRectF(LogicalMin, LogicalMin, LogicalMax - LogicalMin, LogicalMax - LogicalMin);
+    scene.size = size;
+    scene.symbolSize = CanvasRenderer::defaultSymbolSize(size);
+    scene.points = TestPoints::make(pointCount);
+    for (const AreaDefinition &area : TestPoints::areas()) {
+        scene.ellipses.append({QPointF(area.centerX, area.centerY), area.sigmaX * CanvasRenderer::EllipseSigmas,
+                               area.sigmaY * CanvasRenderer::EllipseSigmas, 30, area.color});
+    }
+    for (int areaNumber : scene.points.getAreaNumbers()) {
+        for (const AreaDefinition &area : TestPoints::areas()) {
+            if (area.areaNumber == areaNumber) {
+                scene.colors.append(area.color);
+                scene.symbols.append(area.symbolType);
+            }
+        }
+    }
+    scene.outside.resize(scene.points.size());
+    for (qsizetype i = 0; i < scene.points.size(); i++) {
+        scene.outside[i] = i % 10 == 0;
+    }
+    return scene;
+}
+
+void TestImageExport::formatFor()
+{
+    QCOMPARE(ImageExport::formatFor("canvas.tif"), ImageFormat::Tiff);
+    QCOMPARE(ImageExport::formatFor("canvas.TIFF"), ImageFormat::Tiff);
+    QCOMPARE(ImageExport::formatFor("canvas.png"), ImageFormat::Png);
+    QCOMPARE(ImageExport::formatFor("canvas"), ImageFormat::Png);
+}
+
+// A single point on a white image, off the axes, drawn where the canvas
+// would draw it; the image has three bands and three tiles per band
+void TestImageExport::pngDecodes()
+{
+    const QSize size(700, 600);
+    CanvasScene single = scene(size, 0);
+    single.ellipses.clear();
+    single.points.append(150, -150, 3);
+    single.colors = {QColor(255, 0, 0)};
+    single.symbols = {SymbolType::Plus};
+    single.outside.clear();
+
+    CancellationToken token;
+    std::atomic<double> progress(0);
+    TaskContext context(token, &progress);
+    QString error;
+    QVERIFY2(ImageExport::write(path("single.png"), ImageFormat::Png, single, size, &context, &error),
+             qPrintable(error));
+    QCOMPARE(progress.load(), 1.0);
+
+    const QImage image(path("single.png"));
+    QVERIFY(!image.isNull());
+    QCOMPARE(image.size(), size);
+    QVERIFY(!image.hasAlphaChannel());
+
+    const CanvasRenderer canvas(single.viewport, size, single.symbolSize);
+    const QPoint point = canvas.toPixel(QPoint(150, -150));
+    const QColor drawn = image.pixelColor(point);
+    QVERIFY(drawn.red() > 200 && drawn.green() < 100 && drawn.blue() < 100);
+    QCOMPARE(image.pixelColor(5, 5), QColor(Qt::white));
+    QCOMPARE(image.pixelColor(size.width() - 5, size.height() - 5), QColor(Qt::white));
+}
+
+void TestImageExport::pngIsCompressed()
+{
+    const QSize size(1500, 1000);
+    QVERIFY(ImageExport::write(path("compressed.png"), ImageFormat::Png, scene(size, 1000), size));
+    QVERIFY(TestPoints::fileSize(path("compressed.png")) < qint64(size.width()) * size.height());
+    QVERIFY(!QImage(path("compressed.png")).isNull());
+}
+
+// Both formats hold the same lossless pixels of the same tiles
+void TestImageExport::pngMatchesTiff()
+{
+    if (!QImageReader::supportedImageFormats().contains("tiff")) {
+        QSKIP("No TIFF image reader");
+    }
+    const QSize size(700, 600);
+    const CanvasScene points = scene(size, 5000);
+    QString error;
+    QVERIFY2(ImageExport::write(path("points.png"), ImageFormat::Png, points, size, nullptr, &error),
+             qPrintable(error));
+    QVERIFY2(ImageExport::write(path("points.tif"), ImageFormat::Tiff, points, size, nullptr, &error),
+             qPrintable(error));
+
+    const QImage png = QImage(path("points.png")).convertToFormat(QImage::Format_RGB32);
+    const QImage tiff = QImage(path("points.tif")).convertToFormat(QImage::Format_RGB32);
+    QVERIFY(!png.isNull());
+    QVERIFY(!tiff.isNull());
+    QCOMPARE(png, tiff);
+}
+
+void TestImageExport::rejectsSize()
+{
+    const CanvasScene points = scene(QSize(100, 100), 100);
+    QString error;
+    QVERIFY(!ImageExport::write(path("empty.png"), ImageFormat::Png, points, QSize(0, 100), nullptr, &error));
+    QVERIFY(!error.isEmpty());
+    QVERIFY(!ImageExport::write(path("wide.png"), ImageFormat::Png, points, QSize(ImageExport::MaxSide + 1, 10)));
+    QVERIFY(!QFile::exists(path("empty.png")));
+    QVERIFY(!QFile::exists(path("wide.png")));
+}
+
+// The file is only replaced once the export completed
+void TestImageExport::cancelledKeepsFile()
+{
+    QVERIFY(TestPoints::write(path("kept.png"), "previous"));
+
+    CancellationToken token;
+    token.cancel();
+    std::atomic<double> progress(0);
+    TaskContext context(token, &progress);
+    const QSize size(700, 600);
+    QString error;
+    QVERIFY(!ImageExport::write(path("kept.png"), ImageFormat::Png, scene(size, 1000), size, &context, &error));
+    QVERIFY(!error.isEmpty());
+
+    QFile file(path("kept.png"));
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QCOMPARE(file.readAll(), QByteArray("previous"));
+}
+
+QTEST_MAIN(TestImageExport)
+#include "tst_imageexport.moc"
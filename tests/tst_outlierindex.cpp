@@ -0,0 +1,147 @@
+#include <QtMath>
+#include <QtTest>
+#include <algorithm>
+#include "outlierdetector.h"
+#include "outlierindex.h"
+#include "testpoints.h"
+
+// The outlier index against a fresh OutlierDetector::markOutside at the same
+// thresholds, after series of threshold moves
+class TestOutlierIndex : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void sliderMoves();
+    void perAreaThresholds();
+    void pointsOnCutoff();
+    void unknownArea();
+
+private:
+    // Flags and count of the detector run once per area at its own threshold
+    static qint64 detectorFlags(const PointStore &points, const QVector<AreaDefinition> &areas,
+                                const QVector<double> &thresholds, QVector<quint8> *flags);
+    static void compare(OutlierIndex &index, const PointStore &points, const QVector<AreaDefinition> &areas,
+                        const QVector<QVector<double>> &moves);
+};
+
+qint64 TestOutlierIndex::detectorFlags(const PointStore &points, const QVector<AreaDefinition> &areas,
+                                       const QVector<double> &thresholds, QVector<quint8> *flags)
+{
+    flags->fill(0, points.size());
+    qint64 total = 0;
+    for (int a = 0; a < areas.size(); a++) {
+        QVector<quint8> areaFlags;
+        total += OutlierDetector::markOutside(points, {areas[a]}, &areaFlags, thresholds[a]);
+        for (qsizetype i = 0; i < points.size(); i++) {
+            (*flags)[i] |= areaFlags[i];
+        }
+    }
+    return total;
+}
+
+// The first move writes all flags, every later one only moves them
+void TestOutlierIndex::compare(OutlierIndex &index, const PointStore &points, const QVector<AreaDefinition> &areas,
+                               const QVector<QVector<double>> &moves)
+{
+    index.build(points, areas);
+    QVERIFY(index.isBuiltFor(points, areas));
+
+    QVector<quint8> flags;
+    for (int m = 0; m < moves.size(); m++) {
+        const QVector<double> &thresholds = moves[m];
+        const qint64 count = m == 0 ? index.markOutside(thresholds, &flags)
+                                    : index.updateThresholds(thresholds, &flags);
+
+        QVector<quint8> expected;
+        const qint64 expectedCount = detectorFlags(points, areas, thresholds, &expected);
+        QCOMPARE(count, expectedCount);
+        QCOMPARE(index.totalOutsideCount(), expectedCount);
+        QVERIFY(flags == expected);
+        for (int a = 0; a < areas.size(); a++) {
+            QVector<quint8> areaFlags;
+            QCOMPARE(index.outsideCount(a),
+                     OutlierDetector::markOutside(points, {areas[a]}, &areaFlags, thresholds[a]));
+        }
+    }
+}
+
+void TestOutlierIndex::sliderMoves()
+{
+    const PointStore points = TestPoints::make(200000);
+    const QVector<AreaDefinition> areas = TestPoints::areas();
+    QVector<QVector<double>> moves;
+    for (double threshold : {0.05, 0.1, 0.3, 0.2, 0.01, 0.5, 0.001, 0.05, 1.0, 0.0, 0.05}) {
+        moves.append(QVector<double>(areas.size(), threshold));
+    }
+    OutlierIndex index;
+    compare(index, points, areas, moves);
+}
+
+// Areas with their own threshold move apart from the global one
+void TestOutlierIndex::perAreaThresholds()
+{
+    const PointStore points = TestPoints::make(200000, 5);
+    QVector<AreaDefinition> areas = TestPoints::areas();
+    areas[2].rotation = 35.0;
+    const QVector<QVector<double>> moves = {
+        {0.05, 0.05, 0.05},
+        {0.05, 0.2, 0.05},
+        {0.4, 0.2, 0.001},
+        {0.4, 0.01, 0.3},
+        {0.05, 0.01, 0.3},
+        {0.05, 0.05, 0.05},
+    };
+    OutlierIndex index;
+    compare(index, points, areas, moves);
+}
+
+// Points at whole multiples of sigma from the center, with thresholds whose
+// cutoffs land on them
+void TestOutlierIndex::pointsOnCutoff()
+{
+    PointStore points;
+    for (int k = 0; k <= 6; k++) {
+        for (int repeat = 0; repeat < 3; repeat++) {
+            points.append(10 * k, 0, 1);
+            points.append(0, -10 * k, 1);
+            points.append(-6 * k, 8 * k, 1);
+            points.append(20 + 10 * k, 20, 2);
+        }
+    }
+    const QVector<AreaDefinition> areas = {
+        {1, 0.0, 0.0, 10.0, 10.0, SymbolType::Cross, QColor(255, 0, 0)},
+        {2, 20.0, 20.0, 10.0, 30.0, SymbolType::Plus, QColor(0, 128, 0)},
+    };
+
+    QVector<QVector<double>> moves;
+    for (int k = 1; k <= 6; k++) {
+        const double onCutoff = qExp(-0.5 * k * k);
+        moves.append(QVector<double>{onCutoff, onCutoff});
+        moves.append(QVector<double>{onCutoff, qExp(-0.5 * (k - 1) * (k - 1))});
+    }
+    for (int k = 5; k >= 0; k--) {
+        moves.append(QVector<double>{qExp(-0.5 * k * k), 0.05});
+    }
+    OutlierIndex index;
+    compare(index, points, areas, moves);
+}
+
+// Points of areas without a definition are never outside
+void TestOutlierIndex::unknownArea()
+{
+    PointStore points = TestPoints::make(10000);
+    for (int i = 0; i < 100; i++) {
+        points.append(LogicalMax, LogicalMax, 99);
+    }
+    const QVector<AreaDefinition> areas = TestPoints::areas();
+    OutlierIndex index;
+    compare(index, points, areas, {QVector<double>(areas.size(), 0.5), QVector<double>(areas.size(), 0.9)});
+
+    QVector<quint8> flags;
+    index.markOutside(QVector<double>(areas.size(), 0.9), &flags);
+    QCOMPARE(int(std::count(flags.constEnd() - 100, flags.constEnd(), quint8(1))), 0);
+}
+
+QTEST_GUILESS_MAIN(TestOutlierIndex)
+#include "tst_outlierindex.moc"
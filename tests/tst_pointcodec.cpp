@@ -0,0 +1,117 @@
+#include <QRandomGenerator>
+#include <QtTest>
+#include <algorithm>
+#include "pointcodec.h"
+
+// Round trips and damaged blocks of the compressed points block codec
+class TestPointCodec : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void mortonOrder();
+    void roundTrip();
+    void extremeDeltas();
+    void corruptChecksum();
+    void truncated();
+    void wrongCount();
+
+private:
+    // A block of Morton-sorted points around an area center
+    static void makeBlock(int count, QVector<qint16> *xs, QVector<qint16> *ys);
+};
+
+void TestPointCodec::makeBlock(int count, QVector<qint16> *xs, QVector<qint16> *ys)
+{
+    QRandomGenerator random(7);
+    QVector<QPair<quint32, QPair<qint16, qint16>>> keyed;
+    for (int i = 0; i < count; i++) {
+        const qint16 x = static_cast<qint16>(random.bounded(-120, 121));
+        const qint16 y = static_cast<qint16>(random.bounded(-80, 81));
+        keyed.append(qMakePair(PointCodec::mortonCode(x, y), qMakePair(x, y)));
+    }
+    std::sort(keyed.begin(), keyed.end());
+    xs->clear();
+    ys->clear();
+    for (const auto &point : keyed) {
+        xs->append(point.second.first);
+        ys->append(point.second.second);
+    }
+}
+
+// x takes the even bits and y the odd ones, both offset to unsigned
+void TestPointCodec::mortonOrder()
+{
+    QCOMPARE(PointCodec::mortonCode(-32768, -32768), quint32(0));
+    QCOMPARE(PointCodec::mortonCode(-32767, -32768), quint32(1));
+    QCOMPARE(PointCodec::mortonCode(-32768, -32767), quint32(2));
+    QCOMPARE(PointCodec::mortonCode(32767, 32767), quint32(0xFFFFFFFFu));
+}
+
+void TestPointCodec::roundTrip()
+{
+    QVector<qint16> xs, ys;
+    makeBlock(65536, &xs, &ys);
+    const QByteArray block = PointCodec::encodeBlock(xs.constData(), ys.constData(), xs.size());
+    QVERIFY(block.size() < 6 * xs.size());
+
+    QVector<qint16> decodedX(xs.size()), decodedY(ys.size());
+    QVERIFY(PointCodec::decodeBlock(reinterpret_cast<const uchar *>(block.constData()), block.size(), xs.size(),
+                                    decodedX.data(), decodedY.data()));
+    QCOMPARE(decodedX, xs);
+    QCOMPARE(decodedY, ys);
+}
+
+// Deltas between the ends of the coordinate range need 17 bits
+void TestPointCodec::extremeDeltas()
+{
+    const QVector<qint16> xs = {-32768, 32767, -32768, 0};
+    const QVector<qint16> ys = {32767, -32768, 32767, -1};
+    const QByteArray block = PointCodec::encodeBlock(xs.constData(), ys.constData(), xs.size());
+
+    QVector<qint16> decodedX(xs.size()), decodedY(ys.size());
+    QVERIFY(PointCodec::decodeBlock(reinterpret_cast<const uchar *>(block.constData()), block.size(), xs.size(),
+                                    decodedX.data(), decodedY.data()));
+    QCOMPARE(decodedX, xs);
+    QCOMPARE(decodedY, ys);
+}
+
+// The last bytes of a block are the zlib checksum of its varints
+void TestPointCodec::corruptChecksum()
+{
+    QVector<qint16> xs, ys;
+    makeBlock(1000, &xs, &ys);
+    QByteArray block = PointCodec::encodeBlock(xs.constData(), ys.constData(), xs.size());
+    block[block.size() - 1] = char(block.at(block.size() - 1) ^ 0x5A);
+
+    QVector<qint16> decodedX(xs.size()), decodedY(ys.size());
+    QVERIFY(!PointCodec::decodeBlock(reinterpret_cast<const uchar *>(block.constData()), block.size(), xs.size(),
+                                     decodedX.data(), decodedY.data()));
+}
+
+void TestPointCodec::truncated()
+{
+    QVector<qint16> xs, ys;
+    makeBlock(1000, &xs, &ys);
+    const QByteArray block = PointCodec::encodeBlock(xs.constData(), ys.constData(), xs.size());
+
+    QVector<qint16> decodedX(xs.size()), decodedY(ys.size());
+    QVERIFY(!PointCodec::decodeBlock(reinterpret_cast<const uchar *>(block.constData()), block.size() / 2,
+                                     xs.size(), decodedX.data(), decodedY.data()));
+}
+
+// A block decodes only as the number of points it was encoded with
+void TestPointCodec::wrongCount()
+{
+    QVector<qint16> xs, ys;
+    makeBlock(1000, &xs, &ys);
+    const QByteArray block = PointCodec::encodeBlock(xs.constData(), ys.constData(), xs.size());
+    const uchar *data = reinterpret_cast<const uchar *>(block.constData());
+
+    QVector<qint16> decodedX(xs.size() + 1), decodedY(ys.size() + 1);
+    QVERIFY(!PointCodec::decodeBlock(data, block.size(), xs.size() + 1, decodedX.data(), decodedY.data()));
+    QVERIFY(!PointCodec::decodeBlock(data, block.size(), xs.size() - 1, decodedX.data(), decodedY.data()));
+}
+
+QTEST_GUILESS_MAIN(TestPointCodec)
+#include "tst_pointcodec.moc"
@@ -0,0 +1,367 @@
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <QtTest>
+#include "pointfile.h"
+#include "testpoints.h"
+
+// Round trips and damaged files of the points file formats
+class TestPointFile : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void binaryRoundTrip();
+    void binaryEmpty();
+    void binaryAreaTable();
+    void binaryLayout();
+    void binaryNotPoints();
+    void binaryTruncated();
+    void binaryHugeCount();
+    void binaryInvalidAreaIndex();
+
+    void csvRoundTrip();
+    void csvMalformedLines();
+    void csvWithoutHeader();
+    void csvEmpty();
+
+    void compressedRoundTrip();
+    void compressedCorruptBlock();
+    void compressedTruncated();
+    void compressedOversizedBlock();
+    void compressedBlockOffset();
+    void compressedNotPoints();
+    void loadDetectsFormat();
+    void acrossChunks();
+
+private:
+    QString path(const QString &name) const { return dir.filePath(name); }
+
+    QTemporaryDir dir;
+};
+
+// Binary header: magic, version, area count, point count, then one 48-byte
+// record per area
+static const qint64 BinaryHeaderSize = 24 + 3 * 48;
+
+// Compressed header: magic, version, area count, point count, block count,
+// reserved, then the area records and one 24-byte record per block
+static const qint64 CompressedDirectoryOffset = 32 + 3 * 48;
+
+void TestPointFile::initTestCase()
+{
+    QVERIFY(dir.isValid());
+}
+
+void TestPointFile::binaryRoundTrip()
+{
+    const PointStore points = TestPoints::make(100000);
+    QString error;
+    QVERIFY2(PointFile::saveBinary(path("round.bin"), points, TestPoints::areas(), &error), qPrintable(error));
+    QCOMPARE(TestPoints::fileSize(path("round.bin")), BinaryHeaderSize + 6 * qint64(points.size()));
+    QCOMPARE(PointFile::detectFormat(path("round.bin")), PointFileFormat::Binary);
+
+    PointStore loaded;
+    QVERIFY2(PointFile::loadBinary(path("round.bin"), loaded, nullptr, &error), qPrintable(error));
+    QVERIFY(TestPoints::sameOrder(loaded, points));
+}
+
+void TestPointFile::binaryEmpty()
+{
+    QVERIFY(PointFile::saveBinary(path("empty.bin"), PointStore(), TestPoints::areas()));
+    PointStore loaded = TestPoints::make(10);
+    QVERIFY(PointFile::loadBinary(path("empty.bin"), loaded));
+    QVERIFY(loaded.isEmpty());
+}
+
+void TestPointFile::binaryAreaTable()
+{
+    const PointStore points = TestPoints::make(1000);
+    QVERIFY(PointFile::saveBinary(path("areas.bin"), points, TestPoints::areas()));
+
+    PointStore loaded;
+    QVector<AreaDefinition> areas;
+    QVERIFY(PointFile::loadBinary(path("areas.bin"), loaded, &areas));
+    QCOMPARE(areas.size(), points.getAreaNumbers().size());
+    for (const AreaDefinition &area : areas) {
+        AreaDefinition saved = {};
+        for (const AreaDefinition &candidate : TestPoints::areas()) {
+            if (candidate.areaNumber == area.areaNumber) {
+                saved = candidate;
+            }
+        }
+        QCOMPARE(area.areaNumber, saved.areaNumber);
+        QCOMPARE(area.centerX, saved.centerX);
+        QCOMPARE(area.centerY, saved.centerY);
+        QCOMPARE(area.sigmaX, saved.sigmaX);
+        QCOMPARE(area.sigmaY, saved.sigmaY);
+        QCOMPARE(int(area.symbolType), int(saved.symbolType));
+        QCOMPARE(area.color, saved.color);
+    }
+}
+
+void TestPointFile::binaryLayout()
+{
+    const PointStore points = TestPoints::make(5000);
+    QVERIFY(PointFile::saveBinary(path("layout.bin"), points, TestPoints::areas()));
+
+    PointFile::BinaryLayout layout;
+    QVERIFY(PointFile::readBinaryLayout(path("layout.bin"), layout));
+    QCOMPARE(layout.pointCount, quint64(points.size()));
+    QCOMPARE(layout.areaNumbers, points.getAreaNumbers());
+    QCOMPARE(layout.xOffset, BinaryHeaderSize);
+    QCOMPARE(layout.yOffset, BinaryHeaderSize + 2 * qint64(points.size()));
+    QCOMPARE(layout.areaIndexOffset, BinaryHeaderSize + 4 * qint64(points.size()));
+}
+
+void TestPointFile::binaryNotPoints()
+{
+    QVERIFY(TestPoints::write(path("text.bin"), QByteArray(200, 'x')));
+
+    PointStore loaded;
+    QString error;
+    QVERIFY(!PointFile::loadBinary(path("text.bin"), loaded, nullptr, &error));
+    QVERIFY(!error.isEmpty());
+    PointFile::BinaryLayout layout;
+    QVERIFY(!PointFile::readBinaryLayout(path("text.bin"), layout));
+}
+
+void TestPointFile::binaryTruncated()
+{
+    const PointStore points = TestPoints::make(1000);
+    QVERIFY(PointFile::saveBinary(path("truncated.bin"), points, TestPoints::areas()));
+    QVERIFY(QFile::resize(path("truncated.bin"), TestPoints::fileSize(path("truncated.bin")) - 1));
+
+    PointStore loaded;
+    QVERIFY(!PointFile::loadBinary(path("truncated.bin"), loaded));
+    QVERIFY(loaded.isEmpty());
+    PointFile::BinaryLayout layout;
+    QVERIFY(!PointFile::readBinaryLayout(path("truncated.bin"), layout));
+}
+
+// A count whose byte size overflows must not pass the size check
+void TestPointFile::binaryHugeCount()
+{
+    const PointStore points = TestPoints::make(1000);
+    QVERIFY(PointFile::saveBinary(path("huge.bin"), points, TestPoints::areas()));
+    QByteArray count(8, Qt::Uninitialized);
+    qToLittleEndian<quint64>(Q_UINT64_C(0x2AAAAAAAAAAAAAAB), count.data());
+    QVERIFY(TestPoints::patch(path("huge.bin"), 16, count));
+
+    PointStore loaded;
+    QVERIFY(!PointFile::loadBinary(path("huge.bin"), loaded));
+    PointFile::BinaryLayout layout;
+    QVERIFY(!PointFile::readBinaryLayout(path("huge.bin"), layout));
+}
+
+void TestPointFile::binaryInvalidAreaIndex()
+{
+    const PointStore points = TestPoints::make(1000);
+    QVERIFY(PointFile::saveBinary(path("index.bin"), points, TestPoints::areas()));
+    QVERIFY(TestPoints::patch(path("index.bin"), TestPoints::fileSize(path("index.bin")) - 2, QByteArray(2, '\xff')));
+
+    PointStore loaded;
+    QString error;
+    QVERIFY(!PointFile::loadBinary(path("index.bin"), loaded, nullptr, &error));
+    QVERIFY(!error.isEmpty());
+    QVERIFY(loaded.isEmpty());
+}
+
+void TestPointFile::csvRoundTrip()
+{
+    const PointStore points = TestPoints::make(100000);
+    QString error;
+    QVERIFY2(PointFile::saveCsv(path("round.csv"), points, &error), qPrintable(error));
+    QCOMPARE(PointFile::detectFormat(path("round.csv")), PointFileFormat::Csv);
+
+    PointStore loaded;
+    CsvParseReport report;
+    QVERIFY2(PointFile::loadCsv(path("round.csv"), loaded, &error, &report), qPrintable(error));
+    QVERIFY(TestPoints::sameOrder(loaded, points));
+    QCOMPARE(report.lineCount, qint64(points.size()));
+    QCOMPARE(report.malformedCount, qint64(0));
+}
+
+// Malformed lines are skipped and reported with their line numbers in the
+// file; empty lines are neither points nor malformed
+void TestPointFile::csvMalformedLines()
+{
+    QVERIFY(TestPoints::write(path("malformed.csv"),
+                              "x;y;AreaNumber\n"
+                              "1;2;3\n"
+                              "text\n"
+                              "4;5\n"
+                              "\n"
+                              "-6;7;8\r\n"
+                              "99999;0;1\n"
+                              "9;10;3"));
+
+    PointStore loaded;
+    CsvParseReport report;
+    QVERIFY(PointFile::loadCsv(path("malformed.csv"), loaded, nullptr, &report));
+    QCOMPARE(loaded.size(), qsizetype(3));
+    QCOMPARE(loaded.at(0).x, 1);
+    QCOMPARE(loaded.at(1).x, -6);
+    QCOMPARE(loaded.at(1).areaNumber, 8);
+    QCOMPARE(loaded.at(2).y, 10);
+    QCOMPARE(loaded.at(2).areaNumber, 3);
+
+    QCOMPARE(report.lineCount, qint64(6));
+    QCOMPARE(report.malformedCount, qint64(3));
+    QCOMPARE(int(report.malformedLines.size()), 3);
+    QCOMPARE(report.malformedLines[0].lineNumber, qint64(3));
+    QCOMPARE(report.malformedLines[0].text, QByteArray("text"));
+    QCOMPARE(report.malformedLines[1].lineNumber, qint64(4));
+    QCOMPARE(report.malformedLines[2].lineNumber, qint64(7));
+}
+
+// A byte order mark is skipped, and a first line holding a point is a point
+void TestPointFile::csvWithoutHeader()
+{
+    QVERIFY(TestPoints::write(path("noheader.csv"), "\xEF\xBB\xBF-1;-2;5\n3;4;5\n"));
+
+    PointStore loaded;
+    CsvParseReport report;
+    QVERIFY(PointFile::loadCsv(path("noheader.csv"), loaded, nullptr, &report));
+    QCOMPARE(loaded.size(), qsizetype(2));
+    QCOMPARE(loaded.at(0).x, -1);
+    QCOMPARE(loaded.at(0).y, -2);
+    QCOMPARE(report.malformedCount, qint64(0));
+}
+
+void TestPointFile::csvEmpty()
+{
+    QVERIFY(TestPoints::write(path("empty.csv"), QByteArray()));
+    PointStore loaded = TestPoints::make(10);
+    QVERIFY(PointFile::loadCsv(path("empty.csv"), loaded));
+    QVERIFY(loaded.isEmpty());
+}
+
+// Enough points for several blocks per area; the point order is not kept
+void TestPointFile::compressedRoundTrip()
+{
+    const PointStore points = TestPoints::make(300000);
+    QString error;
+    CompressionStats stats;
+    QVERIFY2(PointFile::saveCompressed(path("round.mlpz"), points, TestPoints::areas(), &error, &stats),
+             qPrintable(error));
+    QCOMPARE(PointFile::detectFormat(path("round.mlpz")), PointFileFormat::Compressed);
+    QCOMPARE(stats.rawBytes, 6 * qint64(points.size()));
+    QCOMPARE(stats.compressedBytes, TestPoints::fileSize(path("round.mlpz")));
+    QVERIFY(stats.compressedBytes < stats.rawBytes);
+
+    PointStore loaded;
+    QVector<AreaDefinition> areas;
+    QVERIFY2(PointFile::loadCompressed(path("round.mlpz"), loaded, &areas, &error), qPrintable(error));
+    QCOMPARE(TestPoints::sortedKeys(loaded), TestPoints::sortedKeys(points));
+    QCOMPARE(int(areas.size()), 3);
+}
+
+// The last bytes of the file are the zlib checksum of the last block
+void TestPointFile::compressedCorruptBlock()
+{
+    QVERIFY(PointFile::saveCompressed(path("corrupt.mlpz"), TestPoints::make(100000), TestPoints::areas()));
+    const qint64 size = TestPoints::fileSize(path("corrupt.mlpz"));
+    QFile file(path("corrupt.mlpz"));
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QVERIFY(file.seek(size - 1));
+    const char last = file.read(1).at(0);
+    file.close();
+    QVERIFY(TestPoints::patch(path("corrupt.mlpz"), size - 1, QByteArray(1, char(last ^ 0x5A))));
+
+    PointStore loaded;
+    QString error;
+    QVERIFY(!PointFile::loadCompressed(path("corrupt.mlpz"), loaded, nullptr, &error));
+    QVERIFY(!error.isEmpty());
+    QVERIFY(loaded.isEmpty());
+}
+
+void TestPointFile::compressedTruncated()
+{
+    QVERIFY(PointFile::saveCompressed(path("truncated.mlpz"), TestPoints::make(100000), TestPoints::areas()));
+    QVERIFY(QFile::resize(path("truncated.mlpz"), TestPoints::fileSize(path("truncated.mlpz")) - 10));
+
+    PointStore loaded;
+    QVERIFY(!PointFile::loadCompressed(path("truncated.mlpz"), loaded));
+    QVERIFY(loaded.isEmpty());
+}
+
+// A block never holds more than 65536 points, whatever its directory says
+void TestPointFile::compressedOversizedBlock()
+{
+    QVERIFY(PointFile::saveCompressed(path("oversized.mlpz"), TestPoints::make(1000), TestPoints::areas()));
+    QByteArray count(4, Qt::Uninitialized);
+    qToLittleEndian<quint32>(65537, count.data());
+    QVERIFY(TestPoints::patch(path("oversized.mlpz"), CompressedDirectoryOffset + 12, count));
+
+    PointStore loaded;
+    QVERIFY(!PointFile::loadCompressed(path("oversized.mlpz"), loaded));
+}
+
+// Block offsets must point past the directory and stay inside the file, even
+// when adding the block size to them would wrap around
+void TestPointFile::compressedBlockOffset()
+{
+    QVERIFY(PointFile::saveCompressed(path("offset.mlpz"), TestPoints::make(1000), TestPoints::areas()));
+    QFile file(path("offset.mlpz"));
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QByteArray original = file.readAll();
+    file.close();
+
+    QByteArray offset(8, Qt::Uninitialized);
+    qToLittleEndian<quint64>(~quint64(0) - 15, offset.data());
+    QVERIFY(TestPoints::patch(path("offset.mlpz"), CompressedDirectoryOffset, offset));
+    PointStore loaded;
+    QVERIFY(!PointFile::loadCompressed(path("offset.mlpz"), loaded));
+    QVERIFY(loaded.isEmpty());
+
+    QVERIFY(TestPoints::write(path("offset.mlpz"), original));
+    qToLittleEndian<quint64>(0, offset.data());
+    QVERIFY(TestPoints::patch(path("offset.mlpz"), CompressedDirectoryOffset, offset));
+    QVERIFY(!PointFile::loadCompressed(path("offset.mlpz"), loaded));
+    QVERIFY(loaded.isEmpty());
+}
+
+void TestPointFile::compressedNotPoints()
+{
+    QVERIFY(PointFile::saveBinary(path("binary.mlpz"), TestPoints::make(1000), TestPoints::areas()));
+    PointStore loaded;
+    QVERIFY(!PointFile::loadCompressed(path("binary.mlpz"), loaded));
+    QVERIFY(TestPoints::write(path("short.mlpz"), "MLDPOINZ"));
+    QVERIFY(!PointFile::loadCompressed(path("short.mlpz"), loaded));
+}
+
+void TestPointFile::loadDetectsFormat()
+{
+    const PointStore points = TestPoints::make(20000);
+    const PointFileFormat formats[] = {PointFileFormat::Binary, PointFileFormat::Compressed, PointFileFormat::Csv};
+    for (PointFileFormat format : formats) {
+        const QString filePath = path(QString("detect%1").arg(int(format)));
+        QVERIFY(PointFile::save(filePath, format, points, TestPoints::areas()));
+        QCOMPARE(PointFile::detectFormat(filePath), format);
+        PointStore loaded;
+        QVERIFY(PointFile::load(filePath, loaded));
+        QCOMPARE(TestPoints::sortedKeys(loaded), TestPoints::sortedKeys(points));
+    }
+}
+
+// Columns of a store longer than one chunk are written and read a chunk at
+// a time, and compressed blocks may straddle two chunks
+void TestPointFile::acrossChunks()
+{
+    const PointStore points = TestPoints::make(PointStore::ChunkSize + 70000);
+    QCOMPARE(points.chunkCount(), 2);
+
+    QVERIFY(PointFile::saveBinary(path("chunks.bin"), points, TestPoints::areas()));
+    PointStore loaded;
+    QVERIFY(PointFile::loadBinary(path("chunks.bin"), loaded));
+    QVERIFY(TestPoints::sameOrder(loaded, points));
+
+    QVERIFY(PointFile::saveCompressed(path("chunks.mlpz"), points, TestPoints::areas()));
+    QVERIFY(PointFile::loadCompressed(path("chunks.mlpz"), loaded));
+    QCOMPARE(TestPoints::sortedKeys(loaded), TestPoints::sortedKeys(points));
+}
+
+QTEST_GUILESS_MAIN(TestPointFile)
+#include "tst_pointfile.moc"
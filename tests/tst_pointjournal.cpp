@@ -0,0 +1,197 @@
+#include <QDebug>
+#include <QTemporaryDir>
+#include <QtTest>
+#include "pointfile.h"
+#include "pointjournal.h"
+#include "testpoints.h"
+
+// Appending to and replaying the points journal, damaged journals and the
+// fingerprint that ties a journal to its points file
+class TestPointJournal : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+
+    void appendAndReplay();
+    void otherBase();
+    void startsOverForNewBase();
+    void damagedTail();
+    void corruptPayload();
+    void notJournal();
+
+    void fingerprintIgnoresOrder();
+    void fingerprintSeesChanges();
+    void fingerprintSurvivesCompressedFile();
+
+private:
+    // Append points [first, first + count) of points to a journal of onto
+    bool append(const PointStore &onto, const PointStore &points, qsizetype first, qsizetype count);
+
+    QTemporaryDir dir;
+    QString journalPath;
+    PointStore base;
+    PointStore extended;
+};
+
+void TestPointJournal::initTestCase()
+{
+    QVERIFY(dir.isValid());
+    journalPath = dir.filePath("points.journal");
+
+    // Two blocks' worth of points, the second with an area the base lacks
+    base = TestPoints::make(50000, 1);
+    extended = base;
+    extended.append(TestPoints::make(20000, 2));
+    extended.append(99, -99, 42);
+}
+
+void TestPointJournal::init()
+{
+    QFile::remove(journalPath);
+}
+
+bool TestPointJournal::append(const PointStore &onto, const PointStore &points, qsizetype first, qsizetype count)
+{
+    QString error;
+    const bool ok = PointJournal::append(journalPath, onto.size(), PointJournal::fingerprint(onto),
+                                         points, first, count, &error);
+    if (!ok) {
+        qWarning() << error;
+    }
+    return ok;
+}
+
+void TestPointJournal::appendAndReplay()
+{
+    QVERIFY(append(base, extended, base.size(), 20000));
+    QVERIFY(append(base, extended, base.size() + 20000, 1));
+
+    PointStore points = base;
+    PointJournal::ReplayResult result;
+    QString error;
+    QVERIFY2(PointJournal::replay(journalPath, points, &result, &error), qPrintable(error));
+    QVERIFY(TestPoints::sameOrder(points, extended));
+    QCOMPARE(result.basePointCount, quint64(base.size()));
+    QCOMPARE(result.baseFingerprint, PointJournal::fingerprint(base));
+    QCOMPARE(result.blockCount, qint64(2));
+    QCOMPARE(result.pointCount, qint64(20001));
+    QVERIFY(!result.truncated);
+}
+
+void TestPointJournal::otherBase()
+{
+    QVERIFY(append(base, extended, base.size(), 20000));
+
+    const PointStore other = TestPoints::make(base.size(), 3);
+    PointStore points = other;
+    QString error;
+    QVERIFY(!PointJournal::replay(journalPath, points, nullptr, &error));
+    QVERIFY(!error.isEmpty());
+    QVERIFY(TestPoints::sameOrder(points, other));
+}
+
+// A journal written for another base is replaced, not appended to
+void TestPointJournal::startsOverForNewBase()
+{
+    QVERIFY(append(base, extended, base.size(), 20000));
+    QVERIFY(append(extended, extended, extended.size() - 1, 1));
+
+    PointStore points = extended;
+    PointJournal::ReplayResult result;
+    QVERIFY(PointJournal::replay(journalPath, points, &result));
+    QCOMPARE(result.blockCount, qint64(1));
+    QCOMPARE(result.pointCount, qint64(1));
+}
+
+// An incomplete last block is cut off, and the next block follows the last
+// good one
+void TestPointJournal::damagedTail()
+{
+    QVERIFY(append(base, extended, base.size(), 10000));
+    QVERIFY(append(base, extended, base.size() + 10000, 10000));
+    const qint64 damagedSize = TestPoints::fileSize(journalPath) - 3;
+    QVERIFY(QFile::resize(journalPath, damagedSize));
+
+    PointStore points = base;
+    PointJournal::ReplayResult result;
+    QVERIFY(PointJournal::replay(journalPath, points, &result));
+    QCOMPARE(result.blockCount, qint64(1));
+    QVERIFY(result.truncated);
+    QVERIFY(TestPoints::sameOrder(points, extended.mid(0, base.size() + 10000)));
+    QVERIFY(TestPoints::fileSize(journalPath) < damagedSize);
+
+    QVERIFY(append(base, extended, base.size() + 10000, 10001));
+    points = base;
+    QVERIFY(PointJournal::replay(journalPath, points, &result));
+    QCOMPARE(result.blockCount, qint64(2));
+    QVERIFY(!result.truncated);
+    QVERIFY(TestPoints::sameOrder(points, extended));
+}
+
+void TestPointJournal::corruptPayload()
+{
+    QVERIFY(append(base, extended, base.size(), 10000));
+    QVERIFY(append(base, extended, base.size() + 10000, 10001));
+    QVERIFY(TestPoints::patch(journalPath, TestPoints::fileSize(journalPath) - 7, QByteArray(1, '\x5A')));
+
+    PointStore points = base;
+    PointJournal::ReplayResult result;
+    QVERIFY(PointJournal::replay(journalPath, points, &result));
+    QCOMPARE(result.blockCount, qint64(1));
+    QCOMPARE(result.pointCount, qint64(10000));
+    QVERIFY(result.truncated);
+}
+
+void TestPointJournal::notJournal()
+{
+    PointStore points = base;
+    QVERIFY(TestPoints::write(journalPath, QByteArray(64, 'x')));
+    QVERIFY(!PointJournal::replay(journalPath, points));
+    QVERIFY(TestPoints::write(journalPath, "MLDJOURN"));
+    QVERIFY(!PointJournal::replay(journalPath, points));
+    QVERIFY(TestPoints::sameOrder(points, base));
+}
+
+// Reversing the points also reorders their area table
+void TestPointJournal::fingerprintIgnoresOrder()
+{
+    PointStore reversed;
+    for (qsizetype i = base.size() - 1; i >= 0; i--) {
+        reversed.append(base.x(i), base.y(i), base.areaNumber(i));
+    }
+    QCOMPARE(PointJournal::fingerprint(reversed), PointJournal::fingerprint(base));
+}
+
+void TestPointJournal::fingerprintSeesChanges()
+{
+    const quint64 fingerprint = PointJournal::fingerprint(base);
+
+    PointStore moved = base;
+    moved.set(100, moved.x(100) + 1, moved.y(100), moved.areaIndex(100));
+    QVERIFY(PointJournal::fingerprint(moved) != fingerprint);
+
+    PointStore relabelled;
+    for (qsizetype i = 0; i < base.size(); i++) {
+        relabelled.append(base.x(i), base.y(i), i == 100 ? 42 : base.areaNumber(i));
+    }
+    QVERIFY(PointJournal::fingerprint(relabelled) != fingerprint);
+
+    QVERIFY(PointJournal::fingerprint(base.mid(0, base.size() - 1)) != fingerprint);
+}
+
+// The compressed format reorders the points; a journal must still match
+void TestPointJournal::fingerprintSurvivesCompressedFile()
+{
+    const QString filePath = dir.filePath("points.mlpz");
+    QVERIFY(PointFile::saveCompressed(filePath, base, TestPoints::areas()));
+    PointStore loaded;
+    QVERIFY(PointFile::loadCompressed(filePath, loaded));
+    QVERIFY(!TestPoints::sameOrder(loaded, base));
+    QCOMPARE(PointJournal::fingerprint(loaded), PointJournal::fingerprint(base));
+}
+
+QTEST_GUILESS_MAIN(TestPointJournal)
+#include "tst_pointjournal.moc"
@@ -0,0 +1,200 @@
+#include <QtTest>
+#include "pointstore.h"
+
+// Chunks of the point store: points across chunk borders, chunks shared by
+// copies and detached only where a copy is written
+class TestPointStore : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void appendAcrossChunks();
+    void copySharesChunks();
+    void extendAcrossChunks();
+    void midSharesAlignedChunks();
+    void midUnaligned();
+    void appendStore();
+    void shrinkAndGrow();
+    void versions();
+
+private:
+    // Point i of the reference store as written by fill()
+    static int expectedX(qsizetype i) { return int(i % 601) - 300; }
+    static int expectedY(qsizetype i) { return int(i * 7 % 601) - 300; }
+
+    // Fill points [first, end) of points a run at a time
+    static void fill(PointStore &points, qsizetype first, qsizetype end, quint16 areaIndex);
+
+    // The points of chunk c of a and b are the same columns
+    static bool sharesChunk(const PointStore &a, const PointStore &b, int c);
+
+    // Two full chunks and a few points, so the last chunk is short
+    PointStore points;
+};
+
+static const qsizetype ChunkSize = PointStore::ChunkSize;
+
+void TestPointStore::fill(PointStore &points, qsizetype first, qsizetype end, quint16 areaIndex)
+{
+    points.forEachWritableRun(first, end, [&](qsizetype begin, qsizetype length, qint16 *xs, qint16 *ys,
+                                              quint16 *areaIndices) {
+        for (qsizetype k = 0; k < length; k++) {
+            xs[k] = static_cast<qint16>(expectedX(begin + k));
+            ys[k] = static_cast<qint16>(expectedY(begin + k));
+            areaIndices[k] = areaIndex;
+        }
+    });
+}
+
+bool TestPointStore::sharesChunk(const PointStore &a, const PointStore &b, int c)
+{
+    return a.xData(c) == b.xData(c) && a.yData(c) == b.yData(c) && a.areaIndexData(c) == b.areaIndexData(c);
+}
+
+void TestPointStore::initTestCase()
+{
+    for (qsizetype i = 0; i < 2 * ChunkSize + 10; i++) {
+        points.append(expectedX(i), expectedY(i), i % 2 ? 7 : 3);
+    }
+}
+
+void TestPointStore::appendAcrossChunks()
+{
+    QCOMPARE(points.size(), 2 * ChunkSize + 10);
+    QCOMPARE(points.chunkCount(), 3);
+    QCOMPARE(points.chunkLength(1), ChunkSize);
+    QCOMPARE(points.chunkLength(2), qsizetype(10));
+    for (qsizetype i : {qsizetype(0), ChunkSize - 1, ChunkSize, 2 * ChunkSize + 9}) {
+        QCOMPARE(points.x(i), expectedX(i));
+        QCOMPARE(points.y(i), expectedY(i));
+        QCOMPARE(points.areaNumber(i), i % 2 ? 7 : 3);
+    }
+}
+
+void TestPointStore::copySharesChunks()
+{
+    PointStore copy = points;
+    for (int c = 0; c < points.chunkCount(); c++) {
+        QVERIFY(sharesChunk(copy, points, c));
+    }
+
+    // Appending copies the last chunk only
+    copy.append(1, 2, 3);
+    QVERIFY(sharesChunk(copy, points, 0));
+    QVERIFY(sharesChunk(copy, points, 1));
+    QVERIFY(!sharesChunk(copy, points, 2));
+    QCOMPARE(points.size(), 2 * ChunkSize + 10);
+    QCOMPARE(copy.size(), 2 * ChunkSize + 11);
+    QCOMPARE(copy.x(2 * ChunkSize + 10), 1);
+
+    // Writing a point copies its chunk only
+    PointStore written = points;
+    written.set(ChunkSize + 5, 9, 9, 0);
+    QVERIFY(sharesChunk(written, points, 0));
+    QVERIFY(!sharesChunk(written, points, 1));
+    QCOMPARE(points.x(ChunkSize + 5), expectedX(ChunkSize + 5));
+}
+
+void TestPointStore::extendAcrossChunks()
+{
+    PointStore extended = points;
+    const qsizetype first = extended.extend(ChunkSize);
+    QCOMPARE(first, 2 * ChunkSize + 10);
+    QCOMPARE(extended.chunkCount(), 4);
+    QCOMPARE(extended.chunkLength(2), ChunkSize);
+    QCOMPARE(extended.chunkLength(3), qsizetype(10));
+    QVERIFY(sharesChunk(extended, points, 1));
+
+    int runs = 0;
+    extended.forEachRun(first, extended.size(), [&](qsizetype, qsizetype, const qint16 *, const qint16 *,
+                                                    const quint16 *) {
+        runs++;
+    });
+    QCOMPARE(runs, 2);
+
+    fill(extended, first, extended.size(), 0);
+    for (qsizetype i : {first - 1, first, 3 * ChunkSize - 1, 3 * ChunkSize, extended.size() - 1}) {
+        QCOMPARE(extended.x(i), expectedX(i));
+        QCOMPARE(extended.y(i), expectedY(i));
+    }
+    QCOMPARE(points.chunkLength(2), qsizetype(10));
+}
+
+void TestPointStore::midSharesAlignedChunks()
+{
+    const PointStore middle = points.mid(ChunkSize, ChunkSize + 5);
+    QCOMPARE(middle.size(), ChunkSize + 5);
+    QCOMPARE(middle.getAreaNumbers(), points.getAreaNumbers());
+    QCOMPARE(middle.xData(0), points.xData(1));
+    QCOMPARE(middle.chunkLength(1), qsizetype(5));
+    QCOMPARE(points.chunkLength(2), qsizetype(10));
+    for (qsizetype i = 0; i < middle.size(); i += 4099) {
+        QCOMPARE(middle.x(i), points.x(ChunkSize + i));
+        QCOMPARE(middle.areaNumber(i), points.areaNumber(ChunkSize + i));
+    }
+}
+
+void TestPointStore::midUnaligned()
+{
+    const PointStore middle = points.mid(5, ChunkSize + 3);
+    QCOMPARE(middle.size(), ChunkSize + 3);
+    QCOMPARE(middle.chunkCount(), 2);
+    for (qsizetype i = 0; i < middle.size(); i++) {
+        if (middle.x(i) != points.x(5 + i) || middle.y(i) != points.y(5 + i)
+            || middle.areaNumber(i) != points.areaNumber(5 + i)) {
+            QFAIL(qPrintable(QString("Point %1 differs").arg(i)));
+        }
+    }
+}
+
+void TestPointStore::appendStore()
+{
+    PointStore joined;
+    joined.append(0, 0, 11);
+    joined.append(0, 0, 7);
+    joined.append(points);
+    QCOMPARE(joined.size(), points.size() + 2);
+    QCOMPARE(joined.getAreaNumbers(), QVector<int>({11, 7, 3}));
+    for (qsizetype i = 0; i < points.size(); i++) {
+        if (joined.x(i + 2) != points.x(i) || joined.y(i + 2) != points.y(i)
+            || joined.areaNumber(i + 2) != points.areaNumber(i)) {
+            QFAIL(qPrintable(QString("Point %1 differs").arg(i)));
+        }
+    }
+}
+
+void TestPointStore::shrinkAndGrow()
+{
+    PointStore resized = points;
+    resized.resize(ChunkSize - 1);
+    QCOMPARE(resized.chunkCount(), 1);
+    QCOMPARE(resized.chunkLength(0), ChunkSize - 1);
+    QCOMPARE(points.chunkLength(0), ChunkSize);
+
+    resized.resize(ChunkSize + 1);
+    QCOMPARE(resized.chunkCount(), 2);
+    QCOMPARE(resized.chunkLength(0), ChunkSize);
+    QCOMPARE(resized.x(ChunkSize - 2), expectedX(ChunkSize - 2));
+    fill(resized, ChunkSize - 1, ChunkSize + 1, 0);
+    QCOMPARE(resized.x(ChunkSize), expectedX(ChunkSize));
+}
+
+void TestPointStore::versions()
+{
+    PointStore copy = points;
+    QCOMPARE(copy.version(), points.version());
+
+    // Appending keeps the base version, shrinking renews it
+    copy.append(1, 1, 3);
+    QVERIFY(copy.version() != points.version());
+    QCOMPARE(copy.baseVersion(), points.baseVersion());
+    copy.extend(ChunkSize);
+    QCOMPARE(copy.baseVersion(), points.baseVersion());
+    copy.resize(ChunkSize);
+    QVERIFY(copy.baseVersion() != points.baseVersion());
+}
+
+QTEST_GUILESS_MAIN(TestPointStore)
+#include "tst_pointstore.moc"
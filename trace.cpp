@@ -0,0 +1,189 @@
+#include "trace.h"
+#include <QCoreApplication>
+#include <QSaveFile>
+#include <QThread>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+// Fields are relaxed atomics so a dump can read a buffer while its thread
+// keeps recording; events overwritten during the copy are dropped
+struct Event {
+    std::atomic<const char *> name{nullptr};
+    std::atomic<qint64> start{0};
+    std::atomic<qint64> duration{0};
+};
+
+struct ThreadBuffer {
+    int threadId = 0;
+    QString threadName;
+    std::unique_ptr<Event[]> events{new Event[Trace::BufferEvents]};
+    std::atomic<quint64> written{0};   // Events ever recorded
+    std::atomic<quint64> clearedAt{0}; // Value of written at the last clear()
+};
+
+// Buffers live until the process exits, so the events of finished threads
+// stay in the trace
+std::mutex registryMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> registry;
+
+thread_local ThreadBuffer *localBuffer = nullptr;
+thread_local QString pendingThreadName;
+
+const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+QString defaultThreadName(int threadId)
+{
+    QThread *thread = QThread::currentThread();
+    if (QCoreApplication::instance() && thread == QCoreApplication::instance()->thread()) {
+        return QStringLiteral("main");
+    }
+    if (thread && !thread->objectName().isEmpty()) {
+        return thread->objectName();
+    }
+    if (thread && qstrcmp(thread->metaObject()->className(), "QThread") != 0
+        && qstrcmp(thread->metaObject()->className(), "QAdoptedThread") != 0) {
+        return QString::fromLatin1(thread->metaObject()->className());
+    }
+    return QStringLiteral("thread %1").arg(threadId);
+}
+
+ThreadBuffer *threadBuffer()
+{
+    if (!localBuffer) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.push_back(std::make_unique<ThreadBuffer>());
+        localBuffer = registry.back().get();
+        localBuffer->threadId = static_cast<int>(registry.size());
+        localBuffer->threadName = pendingThreadName.isEmpty() ? defaultThreadName(localBuffer->threadId)
+                                                              : pendingThreadName;
+    }
+    return localBuffer;
+}
+
+QByteArray jsonString(const QString &text)
+{
+    QByteArray escaped;
+    for (QChar c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += static_cast<char>(c.unicode());
+        } else if (c.unicode() < 0x20) {
+            escaped += QByteArray("\\u") + QByteArray::number(c.unicode(), 16).rightJustified(4, '0');
+        } else {
+            escaped += QString(c).toUtf8();
+        }
+    }
+    return '"' + escaped + '"';
+}
+
+} // namespace
+
+namespace Trace {
+
+std::atomic<bool> enabled{false};
+
+void setEnabled(bool on)
+{
+    enabled.store(on, std::memory_order_relaxed);
+}
+
+void clear()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const std::unique_ptr<ThreadBuffer> &buffer : registry) {
+        buffer->clearedAt.store(buffer->written.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+}
+
+qint64 now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void record(const char *name, qint64 start, qint64 end)
+{
+    ThreadBuffer *buffer = threadBuffer();
+    const quint64 index = buffer->written.load(std::memory_order_relaxed);
+    Event &event = buffer->events[index % BufferEvents];
+    event.name.store(name, std::memory_order_relaxed);
+    event.start.store(start, std::memory_order_relaxed);
+    event.duration.store(end - start, std::memory_order_relaxed);
+    buffer->written.store(index + 1, std::memory_order_release);
+}
+
+void setThreadName(const QString &name)
+{
+    pendingThreadName = name;
+    if (localBuffer) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        localBuffer->threadName = name;
+    }
+}
+
+bool writeChromeJson(const QString &filePath, QString *errorMessage)
+{
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        if (errorMessage) {
+            *errorMessage = file.errorString();
+        }
+        return false;
+    }
+
+    QByteArray json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    auto append = [&](const QByteArray &line) {
+        if (!first) {
+            json += ",\n";
+        }
+        first = false;
+        json += line;
+    };
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const std::unique_ptr<ThreadBuffer> &buffer : registry) {
+        const QByteArray tid = QByteArray::number(buffer->threadId);
+        append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + tid
+               + ",\"args\":{\"name\":" + jsonString(buffer->threadName) + "}}");
+
+        const quint64 written = buffer->written.load(std::memory_order_acquire);
+        const quint64 capacity = BufferEvents;
+        const quint64 begin = qMax(buffer->clearedAt.load(std::memory_order_relaxed),
+                                   written > capacity ? written - capacity : 0);
+        std::vector<std::tuple<const char *, qint64, qint64>> events;
+        events.reserve(written - begin);
+        for (quint64 i = begin; i < written; i++) {
+            const Event &event = buffer->events[i % BufferEvents];
+            events.emplace_back(event.name.load(std::memory_order_relaxed),
+                                event.start.load(std::memory_order_relaxed),
+                                event.duration.load(std::memory_order_relaxed));
+        }
+
+        // Events the thread overwrote while they were copied are unreliable
+        const quint64 writtenAfter = buffer->written.load(std::memory_order_acquire);
+        const quint64 firstValid = writtenAfter > capacity ? writtenAfter - capacity : 0;
+        for (quint64 i = qMax(begin, firstValid); i < written; i++) {
+            const auto &event = events[i - begin];
+            append("{\"name\":" + jsonString(QString::fromUtf8(std::get<0>(event)))
+                   + ",\"ph\":\"X\",\"pid\":1,\"tid\":" + tid
+                   + ",\"ts\":" + QByteArray::number(std::get<1>(event) / 1000.0, 'f', 3)
+                   + ",\"dur\":" + QByteArray::number(std::get<2>(event) / 1000.0, 'f', 3) + "}");
+        }
+    }
+    json += "\n]}\n";
+
+    if (file.write(json) != json.size() || !file.commit()) {
+        if (errorMessage) {
+            *errorMessage = file.errorString();
+        }
+        return false;
+    }
+    return true;
+}
+
+} // namespace Trace
@@ -0,0 +1,70 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QString>
+#include <atomic>
+
+// Scoped trace spans for finding where time goes, exported in the Chrome
+// trace-event format (chrome://tracing, ui.perfetto.dev).
+// Every thread records into its own ring buffer, so recording takes no lock;
+// once a buffer is full its oldest events are overwritten. When tracing is
+// disabled a span costs one relaxed atomic load.
+namespace Trace {
+
+// Events kept per thread
+const int BufferEvents = 1 << 16;
+
+extern std::atomic<bool> enabled;
+
+inline bool isEnabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void setEnabled(bool on);
+
+// Drop the events recorded so far
+void clear();
+
+// Nanoseconds on the trace clock
+qint64 now();
+
+// Record a complete event; name must outlive the trace (a string literal)
+void record(const char *name, qint64 start, qint64 end);
+
+// Name shown for the calling thread (default: its QThread object name or
+// class name)
+void setThreadName(const QString &name);
+
+// Write the events still in the buffers as trace-event JSON
+bool writeChromeJson(const QString &filePath, QString *errorMessage = nullptr);
+
+} // namespace Trace
+
+// Records the lifetime of the object as one event:
+//     TraceSpan span("PointFile::save");
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name)
+        : name(Trace::isEnabled() ? name : nullptr)
+        , start(this->name ? Trace::now() : 0)
+    {
+    }
+
+    ~TraceSpan()
+    {
+        if (name) {
+            Trace::record(name, start, Trace::now());
+        }
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    const char *name;
+    qint64 start;
+};
+
+#endif // TRACE_H
@@ -0,0 +1,148 @@
+#include "trainer.h"
+#include "parallel.h"
+#include "trace.h"
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <algorithm>
+#include <numeric>
+
+Trainer::Trainer(QObject *parent)
+    : QThread(parent)
+    , classCount(0)
+{
+}
+
+void Trainer::setData(const QVector<float> &inputs, const QVector<int> &labels, int classCount)
+{
+    this->inputs = inputs;
+    this->labels = labels;
+    this->classCount = classCount;
+}
+
+void Trainer::setPoints(const PointStore &points, const QVector<AreaDefinition> &areas)
+{
+    // Class of each area slot of the store (-1 for undefined areas)
+    const QVector<int> &areaNumbers = points.getAreaNumbers();
+    QVector<int> classForSlot(areaNumbers.size(), -1);
+    for (int slot = 0; slot < areaNumbers.size(); slot++) {
+        for (int i = 0; i < areas.size(); i++) {
+            if (areas[i].areaNumber == areaNumbers[slot]) {
+                classForSlot[slot] = i;
+                break;
+            }
+        }
+    }
+
+    inputs.clear();
+    labels.clear();
+    inputs.reserve(points.size() * 2);
+    labels.reserve(points.size());
+    for (qsizetype i = 0; i < points.size(); i++) {
+        const int label = classForSlot[points.areaIndex(i)];
+        if (label < 0) {
+            continue;
+        }
+        inputs.append(normalize(points.x(i)));
+        inputs.append(normalize(points.y(i)));
+        labels.append(label);
+    }
+    classCount = areas.size();
+}
+
+void Trainer::setConfig(const TrainingConfig &config)
+{
+    this->config = config;
+}
+
+void Trainer::run()
+{
+    trained.reset();
+
+    const int samples = labels.size();
+    if (samples == 0 || classCount < 1) {
+        return;
+    }
+
+    QVector<int> layerSizes;
+    layerSizes << 2 << config.hiddenLayers << classCount;
+    NeuralNetwork network(layerSizes, config.seed);
+
+    const int batchSize = qMax(1, config.batchSize);
+    const int tasks = Parallel::threadCount();
+
+    // Per-thread workspaces, each with its own gradient accumulator
+    QVector<NeuralNetwork::Workspace> workspaces;
+    for (int t = 0; t < tasks; t++) {
+        workspaces.append(network.createWorkspace(batchSize));
+    }
+    QVector<double> taskLoss(tasks);
+    QVector<int> taskCorrect(tasks);
+    QVector<int> taskRows(tasks);
+    QVector<float> gradients(network.parameterCount());
+
+    QVector<int> order(samples);
+    std::iota(order.begin(), order.end(), 0);
+    QRandomGenerator rng(config.seed);
+
+    for (int epoch = 0; epoch < config.epochs; epoch++) {
+        TraceSpan span("Trainer epoch");
+        QElapsedTimer timer;
+        timer.start();
+
+        std::shuffle(order.begin(), order.end(), rng);
+
+        double epochLoss = 0.0;
+        qint64 epochCorrect = 0;
+
+        for (int start = 0; start < samples; start += batchSize) {
+            if (isInterruptionRequested()) {
+                return;
+            }
+
+            const int rows = qMin(batchSize, samples - start);
+            const float scale = 1.0f / rows;
+            taskRows.fill(0);
+
+            Parallel::forRange(rows, 16, [&](int task, qsizetype begin, qsizetype end) {
+                NeuralNetwork::Workspace &ws = workspaces[task];
+                const int count = static_cast<int>(end - begin);
+
+                // Gather this slice of the shuffled batch into contiguous rows
+                for (int r = 0; r < count; r++) {
+                    const int sample = order[start + static_cast<int>(begin) + r];
+                    ws.inputs[2 * r] = inputs[2 * sample];
+                    ws.inputs[2 * r + 1] = inputs[2 * sample + 1];
+                    ws.labels[r] = labels[sample];
+                }
+
+                ws.gradients.fill(0.0f);
+                taskLoss[task] = 0.0;
+                taskCorrect[task] = 0;
+                network.accumulateGradients(count, scale, ws, taskLoss[task], taskCorrect[task]);
+                taskRows[task] = count;
+            });
+
+            // Merge the per-thread accumulators
+            gradients.fill(0.0f);
+            for (int t = 0; t < tasks; t++) {
+                if (taskRows[t] == 0) {
+                    continue;
+                }
+                const float *g = workspaces[t].gradients.constData();
+                for (int i = 0; i < gradients.size(); i++) {
+                    gradients[i] += g[i];
+                }
+                epochLoss += taskLoss[t];
+                epochCorrect += taskCorrect[t];
+            }
+
+            network.applyGradients(gradients, config.optimizer, config.learningRate);
+        }
+
+        const double seconds = qMax<qint64>(1, timer.nsecsElapsed()) / 1e9;
+        emit epochFinished(epoch + 1, config.epochs, epochLoss / samples,
+                           static_cast<double>(epochCorrect) / samples, 1.0 / seconds, samples);
+    }
+
+    trained.reset(new NeuralNetwork(network));
+}
@@ -0,0 +1,66 @@
+#ifndef TRAINER_H
+#define TRAINER_H
+
+#include <QThread>
+#include <QVector>
+#include <memory>
+#include "areadefinition.h"
+#include "neuralnetwork.h"
+#include "pointstore.h"
+
+// Hyper-parameters for a training run
+struct TrainingConfig {
+    QVector<int> hiddenLayers = {32, 32};
+    Optimizer optimizer = Optimizer::Adam;
+    float learningRate = 0.005f;
+    int batchSize = 256;
+    int epochs = 50;
+    quint32 seed = 1;
+};
+
+// Trains a NeuralNetwork classifier on a worker thread.
+// Each mini-batch is split across the shared worker pool; every worker runs
+// forward/backward on its slice into its own gradient accumulator and the
+// accumulators are summed before the optimizer step.
+class Trainer : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit Trainer(QObject *parent = nullptr);
+
+    // Training samples: inputs holds (x, y) pairs normalized to [-1, 1],
+    // labels holds the class index of each sample in [0, classCount)
+    void setData(const QVector<float> &inputs, const QVector<int> &labels, int classCount);
+
+    // Training samples from points: each defined area is one class, in the
+    // order of areas; points of other areas are skipped
+    void setPoints(const PointStore &points, const QVector<AreaDefinition> &areas);
+
+    // Network input for a logical coordinate
+    static float normalize(int coordinate) { return coordinate / static_cast<float>(LogicalMax); }
+
+    void setConfig(const TrainingConfig &config);
+
+    // Network of the last run that completed all epochs, for predictions
+    // once the thread has finished; nullptr if there is none
+    const NeuralNetwork *getNetwork() const { return trained.get(); }
+
+signals:
+    // Emitted after every epoch with the mean training loss, the training
+    // accuracy in [0, 1] and the measured throughput
+    void epochFinished(int epoch, int totalEpochs, double loss, double accuracy,
+                       double epochsPerSecond, int sampleCount);
+
+protected:
+    void run() override;
+
+private:
+    QVector<float> inputs;
+    QVector<int> labels;
+    int classCount;
+    TrainingConfig config;
+    std::unique_ptr<NeuralNetwork> trained;
+};
+
+#endif // TRAINER_H
@@ -0,0 +1,85 @@
+#include "trainingchart.h"
+#include <QPainter>
+#include <QPainterPath>
+#include <algorithm>
+
+TrainingChart::TrainingChart(QWidget *parent)
+    : QWidget(parent)
+{
+    // Set background to white
+    setAutoFillBackground(true);
+    QPalette pal = palette();
+    pal.setColor(QPalette::Window, Qt::white);
+    setPalette(pal);
+
+    setMinimumHeight(120);
+}
+
+void TrainingChart::clear()
+{
+    losses.clear();
+    accuracies.clear();
+    update();
+}
+
+void TrainingChart::addEpoch(double loss, double accuracy)
+{
+    losses.append(loss);
+    accuracies.append(accuracy);
+    update();
+}
+
+void TrainingChart::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::Antialiasing);
+
+    QRect plot = rect().adjusted(8, 18, -8, -8);
+
+    // Frame
+    painter.setPen(QPen(QColor(220, 220, 220), 1));
+    painter.drawRect(plot);
+
+    // Legend
+    painter.setPen(Qt::red);
+    painter.drawText(8, 13, tr("Loss"));
+    painter.setPen(Qt::darkGreen);
+    painter.drawText(60, 13, tr("Accuracy"));
+
+    if (losses.size() < 2) {
+        return;
+    }
+
+    // Loss is scaled to its maximum, accuracy is plotted on [0, 1]
+    double maxLoss = *std::max_element(losses.begin(), losses.end());
+    if (maxLoss <= 0.0) {
+        maxLoss = 1.0;
+    }
+
+    const double xStep = plot.width() / static_cast<double>(losses.size() - 1);
+    QPainterPath lossPath;
+    QPainterPath accuracyPath;
+    for (int i = 0; i < losses.size(); i++) {
+        QPointF lossPoint(plot.left() + i * xStep, plot.bottom() - plot.height() * losses[i] / maxLoss);
+        QPointF accuracyPoint(plot.left() + i * xStep, plot.bottom() - plot.height() * accuracies[i]);
+        if (i == 0) {
+            lossPath.moveTo(lossPoint);
+            accuracyPath.moveTo(accuracyPoint);
+        } else {
+            lossPath.lineTo(lossPoint);
+            accuracyPath.lineTo(accuracyPoint);
+        }
+    }
+
+    painter.setBrush(Qt::NoBrush);
+    painter.setPen(QPen(Qt::red, 2));
+    painter.drawPath(lossPath);
+    painter.setPen(QPen(Qt::darkGreen, 2));
+    painter.drawPath(accuracyPath);
+
+    // Latest values
+    painter.setPen(Qt::black);
+    painter.drawText(plot.adjusted(4, 4, -4, -4), Qt::AlignRight | Qt::AlignTop,
+                     tr("%1 / %2%").arg(losses.last(), 0, 'f', 3).arg(accuracies.last() * 100.0, 0, 'f', 1));
+}
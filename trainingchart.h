@@ -0,0 +1,29 @@
+#ifndef TRAININGCHART_H
+#define TRAININGCHART_H
+
+#include <QWidget>
+#include <QVector>
+
+// Live loss and accuracy curves for a training run
+class TrainingChart : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit TrainingChart(QWidget *parent = nullptr);
+
+    // Remove all recorded epochs
+    void clear();
+
+    // Append the results of one epoch and repaint
+    void addEpoch(double loss, double accuracy);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    QVector<double> losses;
+    QVector<double> accuracies;
+};
+
+#endif // TRAININGCHART_H